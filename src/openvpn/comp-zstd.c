@@ -0,0 +1,460 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if defined(ENABLE_ZSTD)
+
+#include <zstd.h>
+
+#include "comp.h"
+#include "error.h"
+#include "platform.h"
+
+#include "memdbg.h"
+
+/*
+ * With a dictionary even small packets compress well.
+ */
+#define ZSTD_DICT_COMPRESS_THRESHOLD 32
+
+/*
+ * A dictionary file, loaded once and shared by all contexts.
+ */
+struct zstd_dict
+{
+    struct zstd_dict *next;
+    char *file;
+    struct buffer content;
+    unsigned int id;
+    int level;                  /* level cdict was prepared for */
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+};
+
+static struct zstd_dict *zstd_dicts; /* GLOBAL */
+
+static struct buffer
+zstd_dict_read(const char *file)
+{
+    struct buffer ret = { 0 };
+    platform_stat_t st;
+    FILE *fp;
+
+    if (platform_stat(file, &st) < 0 || st.st_size <= 0)
+    {
+        return ret;
+    }
+
+    fp = platform_fopen(file, "rb");
+    if (!fp)
+    {
+        return ret;
+    }
+
+    ret = alloc_buf(st.st_size);
+    if (fread(BPTR(&ret), 1, st.st_size, fp) != (size_t)st.st_size)
+    {
+        free_buf(&ret);
+    }
+    else
+    {
+        ASSERT(buf_inc_len(&ret, st.st_size));
+    }
+    fclose(fp);
+    return ret;
+}
+
+static struct zstd_dict *
+zstd_dict_get(const char *file)
+{
+    struct zstd_dict *d;
+
+    for (d = zstd_dicts; d; d = d->next)
+    {
+        if (!strcmp(d->file, file))
+        {
+            return d;
+        }
+    }
+
+    ALLOC_OBJ_CLEAR(d, struct zstd_dict);
+    d->content = zstd_dict_read(file);
+    if (!buf_valid(&d->content))
+    {
+        msg(M_WARN | M_ERRNO, "zstd: cannot read dictionary %s", file);
+        free(d);
+        return NULL;
+    }
+
+    d->id = ZSTD_getDictID_fromDict(BPTR(&d->content), BLEN(&d->content));
+    if (!d->id)
+    {
+        msg(M_WARN, "zstd: %s is not a zstd dictionary, create one with 'zstd --train'",
+            file);
+        free_buf(&d->content);
+        free(d);
+        return NULL;
+    }
+
+    d->ddict = ZSTD_createDDict(BPTR(&d->content), BLEN(&d->content));
+    check_malloc_return(d->ddict);
+    d->file = string_alloc(file, NULL);
+
+    d->next = zstd_dicts;
+    zstd_dicts = d;
+
+    msg(D_INIT_MEDIUM, "zstd: loaded dictionary %s, ID %u, %d bytes",
+        file, d->id, BLEN(&d->content));
+    return d;
+}
+
+void
+zstd_dict_preload(const char *dict_file)
+{
+    if (dict_file)
+    {
+        zstd_dict_get(dict_file);
+    }
+}
+
+unsigned int
+zstd_dict_id(const char *dict_file)
+{
+    const struct zstd_dict *d = zstd_dict_get(dict_file);
+    return d ? d->id : 0;
+}
+
+static void
+zstd_use_dict(struct zstd_workspace *zw)
+{
+    const size_t ret = ZSTD_CCtx_refCDict(zw->cctx, zw->cdict);
+
+    if (ZSTD_isError(ret))
+    {
+        msg(D_COMP_ERRORS, "zstd: cannot use dictionary: %s",
+            ZSTD_getErrorName(ret));
+        return;
+    }
+    msg(D_INIT_MEDIUM, "zstd: compressing with dictionary %u", zw->dict->id);
+    zw->use_dict = true;
+}
+
+static void
+zstd_compress_init(struct compress_context *compctx)
+{
+    struct zstd_workspace *zw = &compctx->wu.zstd;
+
+    msg(D_INIT_MEDIUM, "zstd compression initializing");
+
+    if (zw->level < ZSTD_minCLevel() || zw->level > ZSTD_maxCLevel())
+    {
+        msg(M_WARN, "zstd: compression level %d is out of range %d..%d, using the default",
+            zw->level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+        zw->level = 0;
+    }
+
+    zw->cctx = ZSTD_createCCtx();
+    zw->dctx = ZSTD_createDCtx();
+    check_malloc_return(zw->cctx);
+    check_malloc_return(zw->dctx);
+
+    /* every packet is a frame of its own, keep the frame header small */
+    ZSTD_CCtx_setParameter(zw->cctx, ZSTD_c_compressionLevel, zw->level);
+    ZSTD_CCtx_setParameter(zw->cctx, ZSTD_c_contentSizeFlag, 0);
+    ZSTD_CCtx_setParameter(zw->cctx, ZSTD_c_checksumFlag, 0);
+    ZSTD_CCtx_setParameter(zw->cctx, ZSTD_c_dictIDFlag, 1);
+
+    if (zw->dict_file)
+    {
+        zw->dict = zstd_dict_get(zw->dict_file);
+    }
+    if (zw->dict)
+    {
+        struct zstd_dict *d = zw->dict;
+
+        /* the first context prepares the shared CDict at its level */
+        if (!d->cdict)
+        {
+            d->cdict = ZSTD_createCDict(BPTR(&d->content), BLEN(&d->content),
+                                        zw->level);
+            check_malloc_return(d->cdict);
+            d->level = zw->level;
+        }
+        if (d->level == zw->level)
+        {
+            zw->cdict = d->cdict;
+        }
+        else
+        {
+            zw->cdict = ZSTD_createCDict(BPTR(&d->content), BLEN(&d->content),
+                                         zw->level);
+            check_malloc_return(zw->cdict);
+            zw->own_cdict = true;
+        }
+
+        /* unless we have to wait for the peer to tell us it has it too */
+        if (!(compctx->flags & COMP_F_DICT_NEGOTIATE))
+        {
+            zstd_use_dict(zw);
+        }
+    }
+}
+
+static void
+zstd_compress_uninit(struct compress_context *compctx)
+{
+    struct zstd_workspace *zw = &compctx->wu.zstd;
+
+    ZSTD_freeCCtx(zw->cctx);
+    ZSTD_freeDCtx(zw->dctx);
+    if (zw->own_cdict)
+    {
+        ZSTD_freeCDict(zw->cdict);
+    }
+}
+
+void
+zstd_check_peer_info(struct compress_context *compctx, const char *peer_info)
+{
+    struct zstd_workspace *zw;
+    const char *optstr;
+    unsigned int id;
+
+    if (!compctx || compctx->alg.compress != zstd_alg.compress)
+    {
+        return;
+    }
+
+    zw = &compctx->wu.zstd;
+    optstr = peer_info ? strstr(peer_info, "IV_ZSTD_DICT=") : NULL;
+    if (zw->dict && !zw->use_dict && optstr
+        && sscanf(optstr, "IV_ZSTD_DICT=%u", &id) == 1 && id == zw->dict->id)
+    {
+        zstd_use_dict(zw);
+    }
+}
+
+static bool
+do_zstd_compress(struct buffer *buf,
+                 struct buffer *work,
+                 struct compress_context *compctx,
+                 const struct frame *frame)
+{
+    struct zstd_workspace *zw = &compctx->wu.zstd;
+    const int threshold = zw->use_dict ? ZSTD_DICT_COMPRESS_THRESHOLD
+                          : COMPRESS_THRESHOLD;
+
+    if (buf->len >= threshold)
+    {
+        const size_t ps = PAYLOAD_SIZE(frame);
+        size_t zlen_max = ps + COMP_EXTRA_BUFFER(ps);
+        size_t zlen;
+
+        ASSERT(buf_init(work, FRAME_HEADROOM(frame)));
+        ASSERT(buf_safe(work, zlen_max));
+
+        if (buf->len > ps)
+        {
+            dmsg(D_COMP_ERRORS, "zstd compression buffer overflow");
+            buf->len = 0;
+            return false;
+        }
+
+        zlen = ZSTD_compress2(zw->cctx, BPTR(work), zlen_max,
+                              BPTR(buf), BLEN(buf));
+
+        if (ZSTD_isError(zlen))
+        {
+            dmsg(D_COMP_ERRORS, "zstd compression error: %s",
+                 ZSTD_getErrorName(zlen));
+            buf->len = 0;
+            return false;
+        }
+
+        ASSERT(buf_safe(work, zlen));
+        work->len = zlen;
+
+        dmsg(D_COMP, "zstd compress %d -> %d", buf->len, work->len);
+        compctx->pre_compress += buf->len;
+        compctx->post_compress += work->len;
+        return true;
+    }
+    return false;
+}
+
+static void
+zstd_compress(struct buffer *buf, struct buffer work,
+              struct compress_context *compctx,
+              const struct frame *frame)
+{
+    bool compressed;
+    if (buf->len <= 0)
+    {
+        return;
+    }
+
+    compressed = do_zstd_compress(buf, &work, compctx, frame);
+
+    /* On Error just return */
+    if (buf->len == 0)
+    {
+        return;
+    }
+
+    /* did compression save us anything?  Include 2 byte compression header
+     * in calculation */
+    if (compressed && work.len + 2 < buf->len)
+    {
+        ASSERT(buf_prepend(&work, 2));
+        uint8_t *head = BPTR(&work);
+        head[0] = COMP_ALGV2_INDICATOR_BYTE;
+        head[1] = COMP_ALGV2_ZSTD_BYTE;
+        *buf = work;
+    }
+    else
+    {
+        compv2_escape_data_ifneeded(buf);
+    }
+}
+
+static void
+do_zstd_decompress(size_t zlen_max,
+                   struct buffer *work,
+                   struct buffer *buf,
+                   struct compress_context *compctx)
+{
+    struct zstd_workspace *zw = &compctx->wu.zstd;
+    const unsigned int id = ZSTD_getDictID_fromFrame(BPTR(buf), BLEN(buf));
+    size_t uncomp_len;
+
+    ASSERT(buf_safe(work, zlen_max));
+    if (!id)
+    {
+        uncomp_len = ZSTD_decompressDCtx(zw->dctx, BPTR(work), zlen_max,
+                                         BPTR(buf), BLEN(buf));
+    }
+    else if (zw->dict && id == zw->dict->id)
+    {
+        /* our peer has our dictionary, so we can use it too */
+        if (!zw->use_dict)
+        {
+            zstd_use_dict(zw);
+        }
+        uncomp_len = ZSTD_decompress_usingDDict(zw->dctx, BPTR(work), zlen_max,
+                                                BPTR(buf), BLEN(buf),
+                                                zw->dict->ddict);
+    }
+    else
+    {
+        dmsg(D_COMP_ERRORS, "zstd decompression error: unknown dictionary %u", id);
+        buf->len = 0;
+        return;
+    }
+
+    if (ZSTD_isError(uncomp_len))
+    {
+        dmsg(D_COMP_ERRORS, "zstd decompression error: %s",
+             ZSTD_getErrorName(uncomp_len));
+        buf->len = 0;
+        return;
+    }
+
+    ASSERT(buf_safe(work, uncomp_len));
+    work->len = uncomp_len;
+
+    dmsg(D_COMP, "zstd decompress %d -> %d", buf->len, work->len);
+    compctx->pre_decompress += buf->len;
+    compctx->post_decompress += work->len;
+
+    *buf = *work;
+}
+
+static void
+zstd_decompress(struct buffer *buf, struct buffer work,
+                struct compress_context *compctx,
+                const struct frame *frame)
+{
+    size_t zlen_max = EXPANDED_SIZE(frame);
+    uint8_t c;          /* flag indicating whether or not our peer compressed */
+
+    if (buf->len <= 0)
+    {
+        return;
+    }
+
+    ASSERT(buf_init(&work, FRAME_HEADROOM(frame)));
+
+    uint8_t *head = BPTR(buf);
+    c = *head;
+
+    /* Not compressed */
+    if (c != COMP_ALGV2_INDICATOR_BYTE)
+    {
+        return;
+    }
+
+    /* Packet to short to make sense */
+    if (buf->len <= 1)
+    {
+        buf->len = 0;
+        return;
+    }
+
+    c = head[1];
+    if (c == COMP_ALGV2_ZSTD_BYTE) /* packet was compressed */
+    {
+        buf_advance(buf, 2);
+        do_zstd_decompress(zlen_max, &work, buf, compctx);
+    }
+    else if (c == COMP_ALGV2_UNCOMPRESSED_BYTE)
+    {
+        buf_advance(buf, 2);
+    }
+    else
+    {
+        dmsg(D_COMP_ERRORS, "Bad zstd decompression header byte: %d", c);
+        buf->len = 0;
+    }
+}
+
+const struct compress_alg zstd_alg = {
+    "zstd",
+    zstd_compress_init,
+    zstd_compress_uninit,
+    zstd_compress,
+    zstd_decompress
+};
+
+#else  /* if defined(ENABLE_ZSTD) */
+static void
+dummy(void)
+{
+}
+#endif /* ENABLE_ZSTD */
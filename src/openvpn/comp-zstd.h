@@ -0,0 +1,73 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * zstd compression, optionally with a dictionary shared by both peers
+ * (--compress-dict).  A dictionary trained on typical traffic with
+ * "zstd --train" gives much better ratios on small packets, which
+ * compress poorly on their own.
+ */
+
+#ifndef OPENVPN_COMP_ZSTD_H
+#define OPENVPN_COMP_ZSTD_H
+
+#if defined(ENABLE_ZSTD)
+
+#include "buffer.h"
+
+extern const struct compress_alg zstd_alg;
+
+struct zstd_dict;
+
+struct zstd_workspace
+{
+    int level;                  /* --compress-level, 0 for the default */
+    const char *dict_file;      /* --compress-dict */
+
+    struct ZSTD_CCtx_s *cctx;
+    struct ZSTD_DCtx_s *dctx;
+    struct zstd_dict *dict;     /* shared between all contexts */
+    struct ZSTD_CDict_s *cdict; /* dictionary prepared for our level */
+    bool own_cdict;
+    bool use_dict;              /* peer has our dictionary, compress with it */
+};
+
+/*
+ * Load the dictionary once for the whole process, so that it is
+ * still available after --chroot and --user.
+ */
+void zstd_dict_preload(const char *dict_file);
+
+/*
+ * The ID of the dictionary in dict_file, 0 if it cannot be loaded.
+ */
+unsigned int zstd_dict_id(const char *dict_file);
+
+/*
+ * Start compressing with our dictionary if the peer says it has it.
+ */
+void zstd_check_peer_info(struct compress_context *compctx,
+                          const char *peer_info);
+
+#endif /* ENABLE_ZSTD */
+#endif /* ifndef OPENVPN_COMP_ZSTD_H */
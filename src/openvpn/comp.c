@@ -75,6 +75,15 @@ comp_init(const struct compress_options *opt)
             compctx->flags = opt->flags;
             compctx->alg = lz4v2_alg;
             break;
+#endif
+#ifdef ENABLE_ZSTD
+        case COMP_ALGV2_ZSTD:
+            ALLOC_OBJ_CLEAR(compctx, struct compress_context);
+            compctx->flags = opt->flags;
+            compctx->alg = zstd_alg;
+            compctx->wu.zstd.level = opt->level;
+            compctx->wu.zstd.dict_file = opt->dict_file;
+            break;
 #endif
     }
     if (compctx)
@@ -116,6 +125,29 @@ comp_uninit(struct compress_context *compctx)
     }
 }
 
+/*
+ * Load what the compression algorithms share between all instances
+ * while we still have the privileges to read it.
+ */
+void
+comp_init_global(const struct compress_options *opt)
+{
+#ifdef ENABLE_ZSTD
+    zstd_dict_preload(opt->dict_file);
+#endif
+}
+
+/*
+ * Adapt to what our peer told us it supports.
+ */
+void
+comp_check_peer_info(struct compress_context *compctx, const char *peer_info)
+{
+#ifdef ENABLE_ZSTD
+    zstd_check_peer_info(compctx, peer_info);
+#endif
+}
+
 void
 comp_add_to_extra_frame(struct frame *frame)
 {
@@ -158,6 +190,17 @@ comp_generate_peer_info_string(const struct compress_options *opt, struct buffer
             buf_printf(out, "IV_LZ4=1\n");
             buf_printf(out, "IV_LZ4v2=1\n");
 #endif
+#if defined(ENABLE_ZSTD)
+            buf_printf(out, "IV_ZSTD=1\n");
+            if (opt->dict_file)
+            {
+                const unsigned int id = zstd_dict_id(opt->dict_file);
+                if (id)
+                {
+                    buf_printf(out, "IV_ZSTD_DICT=%u\n", id);
+                }
+            }
+#endif
 #if defined(ENABLE_LZO)
             buf_printf(out, "IV_LZO=1\n");
             lzo_avail = true;
@@ -23,7 +23,7 @@
 
 /*
  * Generic compression support.  Currently we support
- * LZO 2 and LZ4.
+ * LZO 2, LZ4 and zstd.
  */
 #ifndef OPENVPN_COMP_H
 #define OPENVPN_COMP_H
@@ -50,12 +50,14 @@
  #define COMP_ALGV2_LZO     12
  #define COMP_ALGV2_SNAPPY   13
  */
+#define COMP_ALGV2_ZSTD     14
 
 /* Compression flags */
 #define COMP_F_ADAPTIVE   (1<<0) /* COMP_ALG_LZO only */
 #define COMP_F_ASYM       (1<<1) /* only downlink is compressed, not uplink */
 #define COMP_F_SWAP       (1<<2) /* initial command byte is swapped with last byte in buffer to preserve payload alignment */
 #define COMP_F_ADVERTISE_STUBS_ONLY (1<<3) /* tell server that we only support compression stubs */
+#define COMP_F_DICT_NEGOTIATE (1<<4) /* use a shared dictionary only once the peer has shown that it has it */
 
 
 /*
@@ -80,6 +82,7 @@
 #define COMP_ALGV2_LZ4_BYTE             1
 #define COMP_ALGV2_LZO_BYTE             2
 #define COMP_ALGV2_SNAPPY_BYTE          3
+#define COMP_ALGV2_ZSTD_BYTE            4
 
 /*
  * Compress worst case size expansion (for any algorithm)
@@ -87,6 +90,7 @@
  * LZO:    len + len/8 + 128 + 3
  * Snappy: len + len/6 + 32
  * LZ4:    len + len/255 + 16  (LZ4_COMPRESSBOUND(len))
+ * zstd:   len + len/256 + 64   (ZSTD_COMPRESSBOUND(len) for small len)
  */
 #define COMP_EXTRA_BUFFER(len) ((len)/6 + 128 + 3 + COMP_PREFIX_LEN)
 
@@ -126,6 +130,10 @@ struct compress_alg
 #include "comp-lz4.h"
 #endif
 
+#ifdef ENABLE_ZSTD
+#include "comp-zstd.h"
+#endif
+
 /*
  * Information that basically identifies a compression
  * algorithm and related flags.
@@ -134,6 +142,8 @@ struct compress_options
 {
     int alg;
     unsigned int flags;
+    int level;                  /* compression level, 0 for the default */
+    const char *dict_file;      /* shared dictionary */
 };
 
 /*
@@ -147,6 +157,9 @@ union compress_workspace_union
 #ifdef ENABLE_LZ4
     struct lz4_workspace lz4;
 #endif
+#ifdef ENABLE_ZSTD
+    struct zstd_workspace zstd;
+#endif
 };
 
 /*
@@ -172,6 +185,10 @@ struct compress_context *comp_init(const struct compress_options *opt);
 
 void comp_uninit(struct compress_context *compctx);
 
+void comp_init_global(const struct compress_options *opt);
+
+void comp_check_peer_info(struct compress_context *compctx, const char *peer_info);
+
 void comp_add_to_extra_frame(struct frame *frame);
 
 void comp_add_to_extra_buffer(struct frame *frame);
@@ -69,12 +69,11 @@ openvpn_encrypt_aead(struct buffer *buf, struct buffer work,
     int outlen = 0;
     const struct key_ctx *ctx = &opt->key_ctx_bi.encrypt;
     uint8_t *mac_out = NULL;
-    const cipher_kt_t *cipher_kt = cipher_ctx_get_cipher_kt(ctx->cipher);
-    const int mac_len = cipher_kt_tag_size(cipher_kt);
+    const int mac_len = ctx->mac_len;
 
     /* IV, packet-ID and implicit IV required for this mode. */
     ASSERT(ctx->cipher);
-    ASSERT(cipher_kt_mode_aead(cipher_kt));
+    ASSERT(ctx->mode == KEY_CTX_MODE_AEAD);
     ASSERT(packet_id_initialized(&opt->packet_id));
 
     gc_init(&gc);
@@ -83,7 +82,7 @@ openvpn_encrypt_aead(struct buffer *buf, struct buffer work,
     {
         struct buffer iv_buffer;
         uint8_t iv[OPENVPN_MAX_IV_LENGTH] = {0};
-        const int iv_len = cipher_ctx_iv_length(ctx->cipher);
+        const int iv_len = ctx->iv_len;
 
         ASSERT(iv_len >= OPENVPN_AEAD_MIN_IV_LEN && iv_len <= OPENVPN_MAX_IV_LENGTH);
 
@@ -115,7 +114,7 @@ openvpn_encrypt_aead(struct buffer *buf, struct buffer work,
     dmsg(D_PACKET_CONTENT, "ENCRYPT FROM: %s", format_hex(BPTR(buf), BLEN(buf), 80, &gc));
 
     /* Buffer overflow check */
-    if (!buf_safe(&work, buf->len + cipher_ctx_block_size(ctx->cipher)))
+    if (!buf_safe(&work, buf->len + ctx->block_size))
     {
         msg(D_CRYPT_ERRORS,
             "ENCRYPT: buffer size error, bc=%d bo=%d bl=%d wc=%d wo=%d wl=%d",
@@ -157,9 +156,15 @@ err:
 #endif /* ifdef HAVE_AEAD_CIPHER_MODES */
 }
 
-static void
+/*
+ * The mode argument is the mode of the encrypt key_ctx.  It is a
+ * constant at each call site in openvpn_encrypt(), so that the compiler
+ * can build a copy of this function for each mode without the branches
+ * of the other modes.
+ */
+static inline void
 openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
-                   struct crypto_options *opt)
+                   struct crypto_options *opt, const int mode)
 {
     struct gc_arena gc;
     gc_init(&gc);
@@ -171,22 +176,21 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
         const uint8_t *hmac_start = NULL;
 
         /* Do Encrypt from buf -> work */
-        if (ctx->cipher)
+        if (mode != KEY_CTX_MODE_NONE)
         {
             uint8_t iv_buf[OPENVPN_MAX_IV_LENGTH] = {0};
-            const int iv_size = cipher_ctx_iv_length(ctx->cipher);
-            const cipher_kt_t *cipher_kt = cipher_ctx_get_cipher_kt(ctx->cipher);
+            const int iv_size = ctx->iv_len;
             int outlen;
 
             /* Reserve space for HMAC */
             if (ctx->hmac)
             {
-                mac_out = buf_write_alloc(&work, hmac_ctx_size(ctx->hmac));
+                mac_out = buf_write_alloc(&work, ctx->mac_len);
                 ASSERT(mac_out);
                 hmac_start = BEND(&work);
             }
 
-            if (cipher_kt_mode_cbc(cipher_kt))
+            if (mode == KEY_CTX_MODE_CBC)
             {
                 /* generate pseudo-random IV */
                 prng_bytes(iv_buf, iv_size);
@@ -201,7 +205,7 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
                     goto err;
                 }
             }
-            else if (cipher_kt_mode_ofb_cfb(cipher_kt))
+            else if (mode == KEY_CTX_MODE_OFB_CFB)
             {
                 struct buffer b;
 
@@ -227,7 +231,7 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
             ASSERT(cipher_ctx_reset(ctx->cipher, iv_buf));
 
             /* Buffer overflow check */
-            if (!buf_safe(&work, buf->len + cipher_ctx_block_size(ctx->cipher)))
+            if (!buf_safe(&work, buf->len + ctx->block_size))
             {
                 msg(D_CRYPT_ERRORS, "ENCRYPT: buffer size error, bc=%d bo=%d bl=%d wc=%d wo=%d wl=%d cbs=%d",
                     buf->capacity,
@@ -236,7 +240,7 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
                     work.capacity,
                     work.offset,
                     work.len,
-                    cipher_ctx_block_size(ctx->cipher));
+                    ctx->block_size);
                 goto err;
             }
 
@@ -249,8 +253,7 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
             ASSERT(buf_inc_len(&work, outlen));
 
             /* For all CBC mode ciphers, check the last block is complete */
-            ASSERT(cipher_kt_mode(cipher_kt) != OPENVPN_MODE_CBC
-                   || outlen == iv_size);
+            ASSERT(mode != KEY_CTX_MODE_CBC || outlen == iv_size);
         }
         else                            /* No Encryption */
         {
@@ -264,7 +267,7 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
             if (ctx->hmac)
             {
                 hmac_start = BPTR(buf);
-                ASSERT(mac_out = buf_prepend(buf, hmac_ctx_size(ctx->hmac)));
+                ASSERT(mac_out = buf_prepend(buf, ctx->mac_len));
             }
             if (BLEN(&work))
             {
@@ -280,7 +283,7 @@ openvpn_encrypt_v1(struct buffer *buf, struct buffer work,
             hmac_ctx_update(ctx->hmac, hmac_start, BEND(&work) - hmac_start);
             hmac_ctx_final(ctx->hmac, mac_out);
             dmsg(D_PACKET_CONTENT, "ENCRYPT HMAC: %s",
-                 format_hex(mac_out, hmac_ctx_size(ctx->hmac), 80, &gc));
+                 format_hex(mac_out, ctx->mac_len, 80, &gc));
         }
 
         *buf = work;
@@ -305,16 +308,27 @@ openvpn_encrypt(struct buffer *buf, struct buffer work,
 {
     if (buf->len > 0 && opt)
     {
-        const cipher_kt_t *cipher_kt =
-            cipher_ctx_get_cipher_kt(opt->key_ctx_bi.encrypt.cipher);
-
-        if (cipher_kt_mode_aead(cipher_kt))
+        switch (opt->key_ctx_bi.encrypt.mode)
         {
-            openvpn_encrypt_aead(buf, work, opt);
-        }
-        else
-        {
-            openvpn_encrypt_v1(buf, work, opt);
+            case KEY_CTX_MODE_AEAD:
+                openvpn_encrypt_aead(buf, work, opt);
+                break;
+
+            case KEY_CTX_MODE_CBC:
+                openvpn_encrypt_v1(buf, work, opt, KEY_CTX_MODE_CBC);
+                break;
+
+            case KEY_CTX_MODE_OFB_CFB:
+                openvpn_encrypt_v1(buf, work, opt, KEY_CTX_MODE_OFB_CFB);
+                break;
+
+            case KEY_CTX_MODE_NONE:
+                openvpn_encrypt_v1(buf, work, opt, KEY_CTX_MODE_NONE);
+                break;
+
+            default:
+                /* We only support CBC, CFB, OFB or AEAD modes right now */
+                ASSERT(0);
         }
     }
 }
@@ -365,7 +379,6 @@ openvpn_decrypt_aead(struct buffer *buf, struct buffer work,
     static const char error_prefix[] = "AEAD Decrypt error";
     struct packet_id_net pin = { 0 };
     const struct key_ctx *ctx = &opt->key_ctx_bi.decrypt;
-    const cipher_kt_t *cipher_kt = cipher_ctx_get_cipher_kt(ctx->cipher);
     uint8_t *tag_ptr = NULL;
     int tag_size = 0;
     int outlen;
@@ -377,7 +390,7 @@ openvpn_decrypt_aead(struct buffer *buf, struct buffer work,
     ASSERT(frame);
     ASSERT(buf->len > 0);
     ASSERT(ctx->cipher);
-    ASSERT(cipher_kt_mode_aead(cipher_kt));
+    ASSERT(ctx->mode == KEY_CTX_MODE_AEAD);
 
     dmsg(D_PACKET_CONTENT, "DECRYPT FROM: %s",
          format_hex(BPTR(buf), BLEN(buf), 80, &gc));
@@ -392,7 +405,7 @@ openvpn_decrypt_aead(struct buffer *buf, struct buffer work,
     /* Combine IV from explicit part from packet and implicit part from context */
     {
         uint8_t iv[OPENVPN_MAX_IV_LENGTH] = { 0 };
-        const int iv_len = cipher_ctx_iv_length(ctx->cipher);
+        const int iv_len = ctx->iv_len;
         const size_t packet_iv_len = iv_len - ctx->implicit_iv_len;
 
         ASSERT(ctx->implicit_iv_len <= iv_len);
@@ -420,7 +433,7 @@ openvpn_decrypt_aead(struct buffer *buf, struct buffer work,
     }
 
     /* keep the tag value to feed in later */
-    tag_size = cipher_kt_tag_size(cipher_kt);
+    tag_size = ctx->mac_len;
     if (buf->len < tag_size)
     {
         CRYPT_ERROR("missing tag");
@@ -444,7 +457,7 @@ openvpn_decrypt_aead(struct buffer *buf, struct buffer work,
     dmsg(D_PACKET_CONTENT, "DECRYPT FROM: %s", format_hex(BPTR(buf), BLEN(buf), 0, &gc));
 
     /* Buffer overflow check (should never fail) */
-    if (!buf_safe(&work, buf->len + cipher_ctx_block_size(ctx->cipher)))
+    if (!buf_safe(&work, buf->len + ctx->block_size))
     {
         CRYPT_ERROR("potential buffer overflow");
     }
@@ -502,10 +515,13 @@ error_exit:
  * Set buf->len to 0 and return false on decrypt error.
  *
  * On success, buf is set to point to plaintext, true is returned.
+ *
+ * Like openvpn_encrypt_v1(), mode is a constant at each call site.
  */
-static bool
+static inline bool
 openvpn_decrypt_v1(struct buffer *buf, struct buffer work,
-                   struct crypto_options *opt, const struct frame *frame)
+                   struct crypto_options *opt, const struct frame *frame,
+                   const int mode)
 {
     static const char error_prefix[] = "Authenticate/Decrypt packet error";
     struct gc_arena gc;
@@ -529,7 +545,7 @@ openvpn_decrypt_v1(struct buffer *buf, struct buffer work,
             hmac_ctx_reset(ctx->hmac);
 
             /* Assume the length of the input HMAC */
-            hmac_len = hmac_ctx_size(ctx->hmac);
+            hmac_len = ctx->mac_len;
 
             /* Authentication fails if insufficient data in packet for HMAC */
             if (buf->len < hmac_len)
@@ -551,10 +567,9 @@ openvpn_decrypt_v1(struct buffer *buf, struct buffer work,
 
         /* Decrypt packet ID + payload */
 
-        if (ctx->cipher)
+        if (mode != KEY_CTX_MODE_NONE)
         {
-            const int iv_size = cipher_ctx_iv_length(ctx->cipher);
-            const cipher_kt_t *cipher_kt = cipher_ctx_get_cipher_kt(ctx->cipher);
+            const int iv_size = ctx->iv_len;
             uint8_t iv_buf[OPENVPN_MAX_IV_LENGTH] = { 0 };
             int outlen;
 
@@ -582,7 +597,7 @@ openvpn_decrypt_v1(struct buffer *buf, struct buffer work,
             }
 
             /* Buffer overflow check (should never happen) */
-            if (!buf_safe(&work, buf->len + cipher_ctx_block_size(ctx->cipher)))
+            if (!buf_safe(&work, buf->len + ctx->block_size))
             {
                 CRYPT_ERROR("potential buffer overflow");
             }
@@ -606,7 +621,7 @@ openvpn_decrypt_v1(struct buffer *buf, struct buffer work,
 
             /* Get packet ID from plaintext buffer or IV, depending on cipher mode */
             {
-                if (cipher_kt_mode_cbc(cipher_kt))
+                if (mode == KEY_CTX_MODE_CBC)
                 {
                     if (packet_id_initialized(&opt->packet_id))
                     {
@@ -617,7 +632,7 @@ openvpn_decrypt_v1(struct buffer *buf, struct buffer work,
                         have_pin = true;
                     }
                 }
-                else if (cipher_kt_mode_ofb_cfb(cipher_kt))
+                else if (mode == KEY_CTX_MODE_OFB_CFB)
                 {
                     struct buffer b;
 
@@ -677,14 +692,27 @@ openvpn_decrypt(struct buffer *buf, struct buffer work,
 
     if (buf->len > 0 && opt)
     {
-        const struct key_ctx *ctx = &opt->key_ctx_bi.decrypt;
-        if (cipher_kt_mode_aead(cipher_ctx_get_cipher_kt(ctx->cipher)))
-        {
-            ret = openvpn_decrypt_aead(buf, work, opt, frame, ad_start);
-        }
-        else
+        switch (opt->key_ctx_bi.decrypt.mode)
         {
-            ret = openvpn_decrypt_v1(buf, work, opt, frame);
+            case KEY_CTX_MODE_AEAD:
+                ret = openvpn_decrypt_aead(buf, work, opt, frame, ad_start);
+                break;
+
+            case KEY_CTX_MODE_CBC:
+                ret = openvpn_decrypt_v1(buf, work, opt, frame, KEY_CTX_MODE_CBC);
+                break;
+
+            case KEY_CTX_MODE_OFB_CFB:
+                ret = openvpn_decrypt_v1(buf, work, opt, frame, KEY_CTX_MODE_OFB_CFB);
+                break;
+
+            case KEY_CTX_MODE_NONE:
+                ret = openvpn_decrypt_v1(buf, work, opt, frame, KEY_CTX_MODE_NONE);
+                break;
+
+            default:
+                /* We only support CBC, CFB, OFB or AEAD modes right now */
+                ASSERT(0);
         }
     }
     else
@@ -836,6 +864,26 @@ init_key_ctx(struct key_ctx *ctx, const struct key *key,
             translate_cipher_name_to_openvpn(cipher_kt_name(kt->cipher)),
             kt->cipher_length *8);
 
+        ctx->iv_len = cipher_ctx_iv_length(ctx->cipher);
+        ctx->block_size = cipher_ctx_block_size(ctx->cipher);
+        if (cipher_kt_mode_aead(kt->cipher))
+        {
+            ctx->mode = KEY_CTX_MODE_AEAD;
+            ctx->mac_len = cipher_kt_tag_size(kt->cipher);
+        }
+        else if (cipher_kt_mode_cbc(kt->cipher))
+        {
+            ctx->mode = KEY_CTX_MODE_CBC;
+        }
+        else if (cipher_kt_mode_ofb_cfb(kt->cipher))
+        {
+            ctx->mode = KEY_CTX_MODE_OFB_CFB;
+        }
+        else
+        {
+            ctx->mode = KEY_CTX_MODE_OTHER;
+        }
+
         dmsg(D_SHOW_KEYS, "%s: CIPHER KEY: %s", prefix,
              format_hex(key->cipher, kt->cipher_length, 0, &gc));
         dmsg(D_CRYPTO_DEBUG, "%s: CIPHER block_size=%d iv_size=%d",
@@ -853,6 +901,10 @@ init_key_ctx(struct key_ctx *ctx, const struct key *key,
     {
         ctx->hmac = hmac_ctx_new();
         hmac_ctx_init(ctx->hmac, key->hmac, kt->hmac_length, kt->digest);
+        if (ctx->mode != KEY_CTX_MODE_AEAD)
+        {
+            ctx->mac_len = hmac_ctx_size(ctx->hmac);
+        }
 
         msg(D_HANDSHAKE,
             "%s: Using %d bit message hash '%s' for HMAC authentication",
@@ -905,6 +957,10 @@ free_key_ctx(struct key_ctx *ctx)
         hmac_ctx_free(ctx->hmac);
         ctx->hmac = NULL;
     }
+    ctx->mode = KEY_CTX_MODE_NONE;
+    ctx->iv_len = 0;
+    ctx->block_size = 0;
+    ctx->mac_len = 0;
     ctx->implicit_iv_len = 0;
 }
 
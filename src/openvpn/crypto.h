@@ -165,11 +165,27 @@ struct key_ctx
 {
     cipher_ctx_t *cipher;       /**< Generic cipher %context. */
     hmac_ctx_t *hmac;           /**< Generic HMAC %context. */
+    int mode;                   /**< \c KEY_CTX_MODE_x of \c cipher */
+    int iv_len;                 /**< IV length of \c cipher */
+    int block_size;             /**< Block size of \c cipher */
+    int mac_len;                /**< Length of the AEAD tag, or of the
+                                 *   HMAC if there is no AEAD cipher */
     uint8_t implicit_iv[OPENVPN_MAX_IV_LENGTH];
     /**< The implicit part of the IV */
     size_t implicit_iv_len;     /**< The length of implicit_iv */
 };
 
+/*
+ * Packet formats of the data channel, cached in key_ctx.mode by
+ * init_key_ctx() so that openvpn_encrypt() and openvpn_decrypt() can
+ * select the code for a packet without asking the crypto library.
+ */
+#define KEY_CTX_MODE_NONE     0 /* no cipher, HMAC and/or packet ID only */
+#define KEY_CTX_MODE_CBC      1
+#define KEY_CTX_MODE_OFB_CFB  2
+#define KEY_CTX_MODE_AEAD     3
+#define KEY_CTX_MODE_OTHER    4 /* not usable for the data channel */
+
 #define KEY_DIRECTION_BIDIRECTIONAL 0 /* same keys for both directions */
 #define KEY_DIRECTION_NORMAL        1 /* encrypt with keys[0], decrypt with keys[1] */
 #define KEY_DIRECTION_INVERSE       2 /* encrypt with keys[1], decrypt with keys[0] */
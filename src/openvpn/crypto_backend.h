@@ -415,6 +415,10 @@ const cipher_kt_t *cipher_ctx_get_cipher_kt(const cipher_ctx_t *ctx);
  * Resets the given cipher context, setting the IV to the specified value.
  * Preserves the associated key information.
  *
+ * This is called for every data channel packet, implementations should
+ * only set the IV and keep the key schedule (and GCM tables) from
+ * \c cipher_ctx_init().
+ *
  * @param ctx           Cipher's context. May not be NULL.
  * @param iv_buf        The IV to use.
  *
@@ -657,6 +661,10 @@ int hmac_ctx_size(const hmac_ctx_t *ctx);
 /*
  * Resets the given HMAC context, preserving the associated key information
  *
+ * This is called for every data channel packet, implementations should
+ * restart from the hash state after the key rather than hash the key
+ * again.
+ *
  * @param ctx           HMAC context. May not be NULL.
  */
 void hmac_ctx_reset(hmac_ctx_t *ctx);
@@ -49,6 +49,9 @@
 #include <openssl/objects.h>
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 /*
  * Check for key size creepage.
@@ -788,7 +791,21 @@ int
 cipher_ctx_get_tag(EVP_CIPHER_CTX *ctx, uint8_t *tag_buf, int tag_size)
 {
 #ifdef HAVE_AEAD_CIPHER_MODES
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /*
+     * Since OpenSSL 3.0, EVP_CIPHER_CTX_ctrl() translates the control
+     * into a parameter for the provider, it is cheaper to pass that
+     * directly.  This runs for every data channel packet.
+     */
+    OSSL_PARAM params[2];
+
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG,
+                                                  tag_buf, tag_size);
+    params[1] = OSSL_PARAM_construct_end();
+    return EVP_CIPHER_CTX_get_params(ctx, params);
+#else
     return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, tag_size, tag_buf);
+#endif
 #else
     ASSERT(0);
 #endif
@@ -857,10 +874,23 @@ cipher_ctx_final_check_tag(EVP_CIPHER_CTX *ctx, uint8_t *dst, int *dst_len,
 {
 #ifdef HAVE_AEAD_CIPHER_MODES
     ASSERT(tag_len < SIZE_MAX);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /* see cipher_ctx_get_tag() */
+    OSSL_PARAM params[2];
+
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG,
+                                                  tag, tag_len);
+    params[1] = OSSL_PARAM_construct_end();
+    if (!EVP_CIPHER_CTX_set_params(ctx, params))
+    {
+        return 0;
+    }
+#else
     if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, tag_len, tag))
     {
         return 0;
     }
+#endif
 
     return cipher_ctx_final(ctx, dst, dst_len);
 #else  /* ifdef HAVE_AEAD_CIPHER_MODES */
@@ -0,0 +1,256 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if P2MP_SERVER
+
+#include "egress.h"
+#include "proto.h"
+#include "error.h"
+
+#include "memdbg.h"
+
+/* DSCP code points with a default class other than MBUF_CLASS_DEFAULT */
+#define DSCP_LE   1
+#define DSCP_CS1  8
+#define DSCP_CS3  24
+#define DSCP_AF31 26
+#define DSCP_AF32 28
+#define DSCP_AF33 30
+#define DSCP_CS4  32
+#define DSCP_AF41 34
+#define DSCP_AF42 36
+#define DSCP_AF43 38
+#define DSCP_CS5  40
+#define DSCP_VA   44
+#define DSCP_EF   46
+#define DSCP_CS6  48
+#define DSCP_CS7  56
+
+static int
+egress_prio_from_name(const char *name)
+{
+    int i;
+    for (i = 0; i < MBUF_N_CLASSES; ++i)
+    {
+        if (!strcmp(name, mbuf_class_name(i)))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+struct egress_rule_list *
+new_egress_rule_list(struct gc_arena *gc)
+{
+    struct egress_rule_list *ret;
+    ALLOC_OBJ_CLEAR_GC(ret, struct egress_rule_list, gc);
+    return ret;
+}
+
+void
+add_egress_rule(struct egress_rule_list *list,
+                const char *prio,
+                const char *type,
+                const char *value,
+                int msglevel)
+{
+    struct egress_rule e;
+    int max;
+
+    CLEAR(e);
+    e.prio = egress_prio_from_name(prio);
+    if (e.prio < 0)
+    {
+        msg(msglevel, "--egress-class: bad class '%s', must be realtime, interactive, default or bulk", prio);
+        return;
+    }
+
+    if (!strcmp(type, "dscp"))
+    {
+        e.type = ER_DSCP;
+        max = 63;
+    }
+    else if (!strcmp(type, "tcp-port"))
+    {
+        e.type = ER_TCP_PORT;
+        max = 65535;
+    }
+    else if (!strcmp(type, "udp-port"))
+    {
+        e.type = ER_UDP_PORT;
+        max = 65535;
+    }
+    else
+    {
+        msg(msglevel, "--egress-class: bad match type '%s', must be dscp, tcp-port or udp-port", type);
+        return;
+    }
+
+    e.value = atoi(value);
+    if (e.value < 0 || e.value > max || !isdigit((unsigned char) *value))
+    {
+        msg(msglevel, "--egress-class: bad %s value '%s'", type, value);
+        return;
+    }
+
+    if (list->n >= MAX_EGRESS_RULES)
+    {
+        msg(msglevel, "--egress-class: too many rules (max %d)", MAX_EGRESS_RULES);
+        return;
+    }
+    list->rules[list->n++] = e;
+}
+
+void
+print_egress_rule_list(const struct egress_rule_list *list, int msglevel)
+{
+    static const char *types[] = { "dscp", "tcp-port", "udp-port" };
+    int i;
+
+    msg(msglevel, "*** EGRESS CLASS list");
+    for (i = 0; i < list->n; ++i)
+    {
+        const struct egress_rule *e = &list->rules[i];
+        msg(msglevel, "  %d %s %s %d", i, mbuf_class_name(e->prio), types[e->type], e->value);
+    }
+}
+
+static int
+egress_prio_from_dscp(const int dscp)
+{
+    switch (dscp)
+    {
+        case DSCP_EF:
+        case DSCP_VA:
+        case DSCP_CS5:
+        case DSCP_CS6:
+        case DSCP_CS7:
+            return MBUF_CLASS_REALTIME;
+
+        case DSCP_AF41:
+        case DSCP_AF42:
+        case DSCP_AF43:
+        case DSCP_CS4:
+        case DSCP_AF31:
+        case DSCP_AF32:
+        case DSCP_AF33:
+        case DSCP_CS3:
+            return MBUF_CLASS_INTERACTIVE;
+
+        case DSCP_CS1:
+        case DSCP_LE:
+            return MBUF_CLASS_BULK;
+
+        default:
+            return MBUF_CLASS_DEFAULT;
+    }
+}
+
+int
+egress_classify(const struct egress_rule_list *list,
+                int tunnel_type,
+                const struct buffer *buf)
+{
+    struct buffer ipbuf = *buf;
+    int dscp, proto = -1, hlen;
+    int sport = -1, dport = -1;
+    int i;
+
+    if (is_ipv4(tunnel_type, &ipbuf))
+    {
+        const struct openvpn_iphdr *ip = (const struct openvpn_iphdr *) BPTR(&ipbuf);
+
+        dscp = ip->tos >> 2;
+        hlen = OPENVPN_IPH_GET_LEN(ip->version_len);
+        /* only the first fragment has the ports */
+        if (!(ntohs(ip->frag_off) & OPENVPN_IP_OFFMASK))
+        {
+            proto = ip->protocol;
+        }
+    }
+    else if (is_ipv6(tunnel_type, &ipbuf)
+             && BLEN(&ipbuf) >= (int) sizeof(struct openvpn_ipv6hdr))
+    {
+        const struct openvpn_ipv6hdr *ip6 = (const struct openvpn_ipv6hdr *) BPTR(&ipbuf);
+
+        dscp = (((ip6->version_prio & 0x0f) << 4) | (ip6->flow_lbl[0] >> 4)) >> 2;
+        hlen = sizeof(struct openvpn_ipv6hdr);
+        /* extension headers are not followed */
+        proto = ip6->nexthdr;
+    }
+    else
+    {
+        return MBUF_CLASS_DEFAULT;
+    }
+
+    /* both the TCP and the UDP header start with the ports */
+    if ((proto == OPENVPN_IPPROTO_TCP || proto == OPENVPN_IPPROTO_UDP)
+        && BLEN(&ipbuf) >= hlen + (int) sizeof(struct openvpn_udphdr))
+    {
+        const struct openvpn_udphdr *uh = (const struct openvpn_udphdr *) (BPTR(&ipbuf) + hlen);
+        sport = ntohs(uh->source);
+        dport = ntohs(uh->dest);
+    }
+
+    for (i = 0; list && i < list->n; ++i)
+    {
+        const struct egress_rule *e = &list->rules[i];
+        switch (e->type)
+        {
+            case ER_DSCP:
+                if (dscp == e->value)
+                {
+                    return e->prio;
+                }
+                break;
+
+            case ER_TCP_PORT:
+            case ER_UDP_PORT:
+                if (proto == (e->type == ER_TCP_PORT ? OPENVPN_IPPROTO_TCP : OPENVPN_IPPROTO_UDP)
+                    && (sport == e->value || dport == e->value))
+                {
+                    return e->prio;
+                }
+                break;
+        }
+    }
+
+    return egress_prio_from_dscp(dscp);
+}
+
+#else  /* if P2MP_SERVER */
+static void
+dummy(void)
+{
+}
+#endif /* P2MP_SERVER */
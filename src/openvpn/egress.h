@@ -0,0 +1,90 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/**
+ * @file
+ * Classification of tunnel packets into the traffic classes of the
+ * server's egress queues (--egress-queue).
+ */
+
+#ifndef EGRESS_H
+#define EGRESS_H
+
+#if P2MP_SERVER
+
+#include "buffer.h"
+#include "mbuf.h"
+
+#define MAX_EGRESS_RULES 64
+
+struct egress_rule
+{
+#define ER_DSCP     0
+#define ER_TCP_PORT 1
+#define ER_UDP_PORT 2
+    int type;
+    int value;
+    int prio;               /* MBUF_CLASS_x */
+};
+
+struct egress_rule_list
+{
+    int n;
+    struct egress_rule rules[MAX_EGRESS_RULES];
+};
+
+struct egress_rule_list *new_egress_rule_list(struct gc_arena *gc);
+
+/**
+ * Parse an --egress-class option and add the rule to \c list.
+ */
+void add_egress_rule(struct egress_rule_list *list,
+                     const char *prio,
+                     const char *type,
+                     const char *value,
+                     int msglevel);
+
+void print_egress_rule_list(const struct egress_rule_list *list, int msglevel);
+
+/**
+ * Return the traffic class of a packet read from the tun/tap device.
+ *
+ * The rules in \c list are tried in order, the first match wins.  If
+ * none matches, the DSCP of the packet selects the class: EF, VOICE-ADMIT
+ * and CS5-CS7 are realtime, AF3x, AF4x, CS3 and CS4 interactive, CS1 and
+ * LE bulk, and everything else default.  Non-IP packets are in the
+ * default class.
+ *
+ * @param list        The --egress-class rules, may be NULL.
+ * @param tunnel_type DEV_TYPE_TUN or DEV_TYPE_TAP.
+ * @param buf         The packet.
+ *
+ * @return One of the MBUF_CLASS_x values.
+ */
+int egress_classify(const struct egress_rule_list *list,
+                    int tunnel_type,
+                    const struct buffer *buf);
+
+#endif /* if P2MP_SERVER */
+#endif /* ifndef EGRESS_H */
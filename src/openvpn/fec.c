@@ -0,0 +1,809 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "error.h"
+#include "fec.h"
+#include "integer.h"
+#include "otime.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FEC_HAVE_SSSE3 1
+#include <immintrin.h>
+#endif
+
+#include "memdbg.h"
+
+/* x^8 + x^4 + x^3 + x^2 + 1 */
+#define GF_POLY 0x11d
+
+static uint8_t gf_exp[512];             /* GLOBAL */
+static uint8_t gf_log[256];             /* GLOBAL */
+static uint8_t gf_mul_table[256][256];  /* GLOBAL */
+static bool gf_initialized;             /* GLOBAL */
+#ifdef FEC_HAVE_SSSE3
+static bool gf_use_ssse3;               /* GLOBAL */
+#endif
+
+/*
+ * Cauchy matrix, coefficient of data packet i in parity packet j is
+ * 1 / (x_j + y_i) with x_j = FEC_MAX_DATA + j and y_i = i.  Every square
+ * submatrix of a Cauchy matrix is invertible.
+ */
+static uint8_t fec_coef[FEC_MAX_PARITY][FEC_MAX_DATA]; /* GLOBAL */
+
+static inline uint8_t
+gf_inv(uint8_t a)
+{
+    return gf_exp[255 - gf_log[a]];
+}
+
+void
+fec_gf_init(void)
+{
+    int i, j, x = 1;
+
+    if (gf_initialized)
+    {
+        return;
+    }
+
+    for (i = 0; i < 255; ++i)
+    {
+        gf_exp[i] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+        {
+            x ^= GF_POLY;
+        }
+    }
+    for (i = 255; i < 512; ++i)
+    {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+
+    for (i = 1; i < 256; ++i)
+    {
+        for (j = 1; j < 256; ++j)
+        {
+            gf_mul_table[i][j] = gf_exp[gf_log[i] + gf_log[j]];
+        }
+    }
+
+    for (j = 0; j < FEC_MAX_PARITY; ++j)
+    {
+        for (i = 0; i < FEC_MAX_DATA; ++i)
+        {
+            fec_coef[j][i] = gf_inv((FEC_MAX_DATA + j) ^ i);
+        }
+    }
+
+#ifdef FEC_HAVE_SSSE3
+    __builtin_cpu_init();
+    gf_use_ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+    gf_initialized = true;
+}
+
+uint8_t
+fec_gf_mul(uint8_t a, uint8_t b)
+{
+    return gf_mul_table[a][b];
+}
+
+#ifdef FEC_HAVE_SSSE3
+/*
+ * c * s = c * (s & 0xf0) + c * (s & 0x0f), so two 16 entry tables and
+ * pshufb multiply 16 bytes at a time.
+ */
+__attribute__((target("ssse3")))
+static void
+gf_mul_add_ssse3(uint8_t *dst, const uint8_t *src, uint8_t c, int len)
+{
+    const uint8_t *row = gf_mul_table[c];
+    uint8_t lo[16], hi[16];
+    __m128i tlo, thi, mask;
+    int i;
+
+    for (i = 0; i < 16; ++i)
+    {
+        lo[i] = row[i];
+        hi[i] = row[i << 4];
+    }
+    tlo = _mm_loadu_si128((const __m128i *) lo);
+    thi = _mm_loadu_si128((const __m128i *) hi);
+    mask = _mm_set1_epi8(0x0f);
+
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        const __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+        const __m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+        const __m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        const __m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+    }
+    for (; i < len; ++i)
+    {
+        dst[i] ^= row[src[i]];
+    }
+}
+#endif /* ifdef FEC_HAVE_SSSE3 */
+
+void
+fec_gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, int len)
+{
+    int i;
+
+    if (c == 0)
+    {
+        return;
+    }
+    if (c == 1)
+    {
+        for (i = 0; i < len; ++i)
+        {
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+#ifdef FEC_HAVE_SSSE3
+    if (gf_use_ssse3)
+    {
+        gf_mul_add_ssse3(dst, src, c, len);
+        return;
+    }
+#endif
+    {
+        const uint8_t *row = gf_mul_table[c];
+        for (i = 0; i < len; ++i)
+        {
+            dst[i] ^= row[src[i]];
+        }
+    }
+}
+
+/*
+ * Invert the n x n matrix m by Gauss-Jordan elimination, m is destroyed.
+ */
+static bool
+gf_invert(uint8_t m[FEC_MAX_PARITY][FEC_MAX_PARITY],
+          uint8_t inv[FEC_MAX_PARITY][FEC_MAX_PARITY], const int n)
+{
+    int row, col, k;
+
+    for (row = 0; row < n; ++row)
+    {
+        for (col = 0; col < n; ++col)
+        {
+            inv[row][col] = (row == col);
+        }
+    }
+
+    for (col = 0; col < n; ++col)
+    {
+        uint8_t scale;
+
+        for (row = col; row < n && !m[row][col]; ++row)
+        {
+        }
+        if (row == n)
+        {
+            return false;
+        }
+        if (row != col)
+        {
+            for (k = 0; k < n; ++k)
+            {
+                uint8_t t = m[row][k];
+                m[row][k] = m[col][k];
+                m[col][k] = t;
+                t = inv[row][k];
+                inv[row][k] = inv[col][k];
+                inv[col][k] = t;
+            }
+        }
+
+        scale = gf_inv(m[col][col]);
+        for (k = 0; k < n; ++k)
+        {
+            m[col][k] = gf_mul_table[scale][m[col][k]];
+            inv[col][k] = gf_mul_table[scale][inv[col][k]];
+        }
+
+        for (row = 0; row < n; ++row)
+        {
+            const uint8_t factor = m[row][col];
+            if (row != col && factor)
+            {
+                for (k = 0; k < n; ++k)
+                {
+                    m[row][k] ^= gf_mul_table[factor][m[col][k]];
+                    inv[row][k] ^= gf_mul_table[factor][inv[col][k]];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static int
+count_bits(unsigned int map)
+{
+    int n = 0;
+    for (; map; map &= map - 1)
+    {
+        ++n;
+    }
+    return n;
+}
+
+static inline void
+fec_prepend_header(struct buffer *buf, fec_header_type h)
+{
+    h = htonl(h);
+    ASSERT(buf_write_prepend(buf, &h, sizeof(h)));
+}
+
+static inline fec_header_type
+fec_header(int type, int loss, int block, int index)
+{
+    return ((fec_header_type) type << FEC_TYPE_SHIFT)
+           | (loss << FEC_LOSS_SHIFT)
+           | (block << FEC_BLOCK_SHIFT)
+           | (index << FEC_INDEX_SHIFT);
+}
+
+/* the loss we observe, as reported to the peer */
+static inline int
+fec_loss_feedback(const struct fec_master *f)
+{
+    return min_int((f->rx_loss + 5) / 10, FEC_LOSS_MASK);
+}
+
+/*
+ * One parity packet per block while the link is clean, and enough to
+ * cover twice the loss the peer reports.
+ */
+static int
+fec_parity_count(const struct fec_master *f)
+{
+    const int p = 1 + (2 * f->k * f->peer_loss + 99) / 100;
+    return constrain_int(p, 1, f->max_p);
+}
+
+struct fec_master *
+fec_init(struct frame *frame, int k, int max_parity)
+{
+    struct fec_master *ret;
+
+    ASSERT(k >= 1 && k <= FEC_MAX_DATA);
+    ASSERT(max_parity >= 1 && max_parity <= FEC_MAX_PARITY);
+
+    fec_gf_init();
+
+    ALLOC_OBJ_CLEAR(ret, struct fec_master);
+    ret->k = k;
+    ret->max_p = max_parity;
+
+    /* parity packets carry the length of the longest packet in the block */
+    frame_add_to_extra_frame(frame, FEC_HEADER_SIZE + FEC_LEN_SIZE);
+    return ret;
+}
+
+void
+fec_frame_init(struct fec_master *f, const struct frame *frame)
+{
+    int j;
+
+    f->buf_size = BUF_SIZE(frame);
+    f->headroom = FRAME_HEADROOM(frame);
+    for (j = 0; j < f->max_p; ++j)
+    {
+        f->tx_acc[j] = alloc_buf(f->buf_size);
+        f->tx_parity[j] = alloc_buf(f->buf_size);
+    }
+}
+
+void
+fec_free(struct fec_master *f)
+{
+    int i, j;
+
+    for (j = 0; j < FEC_MAX_PARITY; ++j)
+    {
+        free_buf(&f->tx_acc[j]);
+        free_buf(&f->tx_parity[j]);
+    }
+    for (i = 0; i < FEC_N_BLOCKS; ++i)
+    {
+        for (j = 0; j < FEC_MAX_DATA; ++j)
+        {
+            free_buf(&f->rx[i].data[j]);
+        }
+        for (j = 0; j < FEC_MAX_PARITY; ++j)
+        {
+            free_buf(&f->rx[i].parity[j]);
+        }
+    }
+    for (i = 0; i < FEC_N_RECOVERED; ++i)
+    {
+        free_buf(&f->recovered[i]);
+    }
+    free(f);
+}
+
+/*
+ * Move the parity of the current block to the send queue and start
+ * a new block.  Parity of the previous block that could not be sent
+ * yet is dropped.
+ */
+static void
+fec_close_block(struct fec_master *f)
+{
+    const int p = min_int(f->tx_p, f->tx_n);
+    const fec_header_type h = fec_header(FEC_PARITY, fec_loss_feedback(f), f->tx_block, 0)
+                              | ((f->tx_n - 1) << FEC_N_SHIFT)
+                              | ((p - 1) << FEC_P_SHIFT);
+    int j;
+
+    for (j = 0; j < p; ++j)
+    {
+        struct buffer *out = &f->tx_parity[j];
+        ASSERT(buf_init(out, f->headroom));
+        ASSERT(buf_copy(out, &f->tx_acc[j]));
+        fec_prepend_header(out, h | (j << FEC_INDEX_SHIFT));
+    }
+    for (j = 0; j < f->tx_p; ++j)
+    {
+        ASSERT(buf_init(&f->tx_acc[j], 0));
+    }
+
+    dmsg(D_FEC_DEBUG, "FEC: block %d closed, %d data, %d parity",
+         f->tx_block, f->tx_n, p);
+
+    f->tx_parity_next = 0;
+    f->tx_parity_count = p;
+    f->n_parity_sent += p;
+    f->tx_block = (f->tx_block + 1) & FEC_BLOCK_MASK;
+    f->tx_n = 0;
+}
+
+void
+fec_outgoing(struct fec_master *f, struct buffer *buf)
+{
+    const int len = BLEN(buf);
+    const int index = f->tx_n;
+    uint8_t prefix[FEC_LEN_SIZE];
+    int j;
+
+    if (len <= 0)
+    {
+        return;
+    }
+
+    if (index == 0)
+    {
+        openvpn_gettimeofday(&f->tx_start, NULL);
+        f->tx_p = fec_parity_count(f);
+        f->tx_unit_len = 0;
+    }
+
+    /* shorter packets are padded with zeros */
+    if (FEC_LEN_SIZE + len > f->tx_unit_len)
+    {
+        f->tx_unit_len = FEC_LEN_SIZE + len;
+        for (j = 0; j < f->tx_p; ++j)
+        {
+            struct buffer *acc = &f->tx_acc[j];
+            const int grow = f->tx_unit_len - BLEN(acc);
+            uint8_t *p = buf_write_alloc(acc, grow);
+            ASSERT(p);
+            memset(p, 0, grow);
+        }
+    }
+
+    prefix[0] = (len >> 8) & 0xff;
+    prefix[1] = len & 0xff;
+    for (j = 0; j < f->tx_p; ++j)
+    {
+        const uint8_t c = fec_coef[j][index];
+        uint8_t *acc = BPTR(&f->tx_acc[j]);
+        fec_gf_mul_add(acc, prefix, c, FEC_LEN_SIZE);
+        fec_gf_mul_add(acc + FEC_LEN_SIZE, BPTR(buf), c, len);
+    }
+
+    fec_prepend_header(buf, fec_header(FEC_DATA, fec_loss_feedback(f), f->tx_block, index));
+    ++f->n_data_sent;
+
+    if (++f->tx_n == f->k)
+    {
+        fec_close_block(f);
+    }
+}
+
+bool
+fec_parity_ready(struct fec_master *f, struct buffer *buf)
+{
+    if (fec_outgoing_defined(f))
+    {
+        *buf = f->tx_parity[f->tx_parity_next++];
+        return true;
+    }
+    return false;
+}
+
+void
+fec_housekeeping(struct fec_master *f, struct timeval *tv)
+{
+    if (f->tx_n)
+    {
+        struct timeval now;
+        int remaining;
+
+        openvpn_gettimeofday(&now, NULL);
+        remaining = FEC_FLUSH_USEC - tv_subtract(&now, &f->tx_start, 1);
+        if (remaining <= 0)
+        {
+            fec_close_block(f);
+        }
+        else if (tv->tv_sec > 0 || tv->tv_usec > remaining)
+        {
+            tv->tv_sec = 0;
+            tv->tv_usec = remaining;
+        }
+    }
+}
+
+/*
+ * Account for a block that leaves the receive window.
+ */
+static void
+fec_rx_block_done(struct fec_master *f, const struct fec_rx_block *b)
+{
+    const int expected = b->n ? b->n + b->p : b->max_index + 1;
+
+    if (b->n && !b->decoded)
+    {
+        const unsigned int all = (1u << b->n) - 1;
+        f->n_unrecovered += b->n - count_bits(b->data_map & all);
+    }
+
+    if (expected > 0 && b->received <= expected)
+    {
+        const int sample = (expected - b->received) * 1000 / expected;
+        f->rx_loss = (f->rx_loss * 7 + sample) / 8;
+    }
+}
+
+/*
+ * Return the block with the given id, or NULL if it is older than
+ * the receive window.
+ */
+static struct fec_rx_block *
+fec_rx_block_get(struct fec_master *f, const int id)
+{
+    struct fec_rx_block *b = &f->rx[id % FEC_N_BLOCKS];
+
+    if (b->defined)
+    {
+        if (b->id == id)
+        {
+            return b;
+        }
+        if (((id - b->id) & FEC_BLOCK_MASK) > FEC_BLOCK_MASK / 2)
+        {
+            return NULL;
+        }
+        fec_rx_block_done(f, b);
+    }
+
+    b->defined = true;
+    b->decoded = false;
+    b->id = id;
+    b->n = 0;
+    b->p = 0;
+    b->received = 0;
+    b->max_index = -1;
+    b->data_map = 0;
+    b->parity_map = 0;
+    return b;
+}
+
+static bool
+fec_store(struct fec_master *f, struct buffer *dest,
+          const uint8_t *prefix, const int prefix_len, const struct buffer *src)
+{
+    if (!buf_defined(dest))
+    {
+        *dest = alloc_buf(f->buf_size);
+    }
+    ASSERT(buf_init(dest, 0));
+    return (!prefix_len || buf_write(dest, prefix, prefix_len)) && buf_copy(dest, src);
+}
+
+static void
+fec_queue_recovered(struct fec_master *f, const struct fec_rx_block *b,
+                    const int index, const uint8_t *data, const int len)
+{
+    struct buffer *q;
+
+    if (f->recovered_len == FEC_N_RECOVERED)
+    {
+        ++f->n_unrecovered;
+        return;
+    }
+
+    q = &f->recovered[(f->recovered_head + f->recovered_len) % FEC_N_RECOVERED];
+    if (!buf_defined(q))
+    {
+        *q = alloc_buf(f->buf_size);
+    }
+    ASSERT(buf_init(q, f->headroom));
+    if (!buf_write(q, data, len))
+    {
+        ++f->n_unrecovered;
+        return;
+    }
+    fec_prepend_header(q, fec_header(FEC_DATA, f->peer_loss, b->id, index));
+    ++f->recovered_len;
+    ++f->n_recovered;
+}
+
+/*
+ * Rebuild the missing data packets of a block once enough parity
+ * has arrived.
+ */
+static void
+fec_decode(struct fec_master *f, struct fec_rx_block *b)
+{
+    uint8_t m[FEC_MAX_PARITY][FEC_MAX_PARITY];
+    uint8_t inv[FEC_MAX_PARITY][FEC_MAX_PARITY];
+    int missing[FEC_MAX_DATA];
+    int rows[FEC_MAX_PARITY];
+    int e = 0, r = 0, i, j, unit_len;
+
+    if (b->decoded || !b->n)
+    {
+        return;
+    }
+
+    for (i = 0; i < b->n; ++i)
+    {
+        if (!(b->data_map & (1u << i)))
+        {
+            missing[e++] = i;
+        }
+    }
+    if (!e)
+    {
+        b->decoded = true;
+        return;
+    }
+
+    for (j = 0; j < FEC_MAX_PARITY && r < e; ++j)
+    {
+        if (b->parity_map & (1u << j))
+        {
+            rows[r++] = j;
+        }
+    }
+    if (r < e)
+    {
+        return;
+    }
+
+    /* from here on the block is done with, whether we succeed or not */
+    b->decoded = true;
+
+    unit_len = BLEN(&b->parity[rows[0]]);
+    for (r = 1; r < e; ++r)
+    {
+        if (BLEN(&b->parity[rows[r]]) != unit_len)
+        {
+            msg(D_FEC_ERRORS, "FEC: parity packets of block %d differ in length", b->id);
+            return;
+        }
+    }
+
+    /* remove the data packets we have from the parity */
+    for (i = 0; i < b->n; ++i)
+    {
+        if (b->data_map & (1u << i))
+        {
+            if (BLEN(&b->data[i]) > unit_len)
+            {
+                msg(D_FEC_ERRORS, "FEC: data packet longer than parity in block %d", b->id);
+                return;
+            }
+            for (r = 0; r < e; ++r)
+            {
+                fec_gf_mul_add(BPTR(&b->parity[rows[r]]), BPTR(&b->data[i]),
+                               fec_coef[rows[r]][i], BLEN(&b->data[i]));
+            }
+        }
+    }
+
+    /* what is left is the missing packets times the matching coefficients */
+    for (r = 0; r < e; ++r)
+    {
+        for (i = 0; i < e; ++i)
+        {
+            m[r][i] = fec_coef[rows[r]][missing[i]];
+        }
+    }
+    if (!gf_invert(m, inv, e))
+    {
+        msg(D_FEC_ERRORS, "FEC: cannot decode block %d", b->id);
+        return;
+    }
+
+    for (i = 0; i < e; ++i)
+    {
+        struct buffer *dest = &b->data[missing[i]];
+        uint8_t *unit;
+        int len;
+
+        if (!buf_defined(dest))
+        {
+            *dest = alloc_buf(f->buf_size);
+        }
+        ASSERT(buf_init(dest, 0));
+        unit = buf_write_alloc(dest, unit_len);
+        ASSERT(unit);
+        memset(unit, 0, unit_len);
+        for (r = 0; r < e; ++r)
+        {
+            fec_gf_mul_add(unit, BPTR(&b->parity[rows[r]]), inv[i][r], unit_len);
+        }
+
+        len = (unit[0] << 8) | unit[1];
+        if (len > unit_len - FEC_LEN_SIZE)
+        {
+            msg(D_FEC_ERRORS, "FEC: bad length in recovered packet of block %d", b->id);
+            ++f->n_unrecovered;
+            continue;
+        }
+        b->data_map |= 1u << missing[i];
+        fec_queue_recovered(f, b, missing[i], unit + FEC_LEN_SIZE, len);
+    }
+
+    dmsg(D_FEC_DEBUG, "FEC: recovered %d packets of block %d", e, b->id);
+}
+
+void
+fec_incoming(struct fec_master *f, struct buffer *buf)
+{
+    fec_header_type h;
+    struct fec_rx_block *b;
+    int type, id, index;
+    const bool recovered = f->recovered_out;
+
+    f->recovered_out = false;
+    if (buf->len <= 0)
+    {
+        return;
+    }
+
+    if (!buf_read(buf, &h, sizeof(h)))
+    {
+        msg(D_FEC_ERRORS, "FEC: packet too short");
+        buf->len = 0;
+        return;
+    }
+    h = ntohl(h);
+
+    type = (h >> FEC_TYPE_SHIFT) & FEC_TYPE_MASK;
+    id = (h >> FEC_BLOCK_SHIFT) & FEC_BLOCK_MASK;
+    index = (h >> FEC_INDEX_SHIFT) & FEC_INDEX_MASK;
+    f->peer_loss = (h >> FEC_LOSS_SHIFT) & FEC_LOSS_MASK;
+
+    if (type == FEC_DATA)
+    {
+        b = fec_rx_block_get(f, id);
+
+        if (b && (b->data_map & (1u << index)))
+        {
+            /*
+             * Recovered packets come back through here and are already
+             * known.  A packet from the wire that is already known arrived
+             * after it had been recovered from parity, and has been
+             * delivered then.
+             */
+            if (!recovered)
+            {
+                buf->len = 0;
+            }
+        }
+        else if (b)
+        {
+            const uint8_t prefix[FEC_LEN_SIZE] = { (BLEN(buf) >> 8) & 0xff, BLEN(buf) & 0xff };
+            if (fec_store(f, &b->data[index], prefix, FEC_LEN_SIZE, buf))
+            {
+                b->data_map |= 1u << index;
+                ++b->received;
+                b->max_index = max_int(b->max_index, index);
+                fec_decode(f, b);
+            }
+        }
+    }
+    else if (type == FEC_PARITY)
+    {
+        const int n = ((h >> FEC_N_SHIFT) & FEC_N_MASK) + 1;
+        const int p = ((h >> FEC_P_SHIFT) & FEC_P_MASK) + 1;
+
+        if (p > FEC_MAX_PARITY || index >= p)
+        {
+            msg(D_FEC_ERRORS, "FEC: bad parity header");
+        }
+        else if ((b = fec_rx_block_get(f, id))
+                 && !(b->parity_map & (1u << index))
+                 && fec_store(f, &b->parity[index], NULL, 0, buf))
+        {
+            b->n = n;
+            b->p = p;
+            b->parity_map |= 1u << index;
+            ++b->received;
+            fec_decode(f, b);
+        }
+        buf->len = 0;
+    }
+    else
+    {
+        msg(D_FEC_ERRORS, "FEC: unknown packet type %d", type);
+        buf->len = 0;
+    }
+}
+
+bool
+fec_recovered_ready(struct fec_master *f, struct buffer *buf)
+{
+    if (f->recovered_len)
+    {
+        *buf = f->recovered[f->recovered_head];
+        f->recovered_head = (f->recovered_head + 1) % FEC_N_RECOVERED;
+        --f->recovered_len;
+        f->recovered_out = true;
+        return true;
+    }
+    return false;
+}
+
+void
+fec_print_stats(const struct fec_master *f, struct status_output *so)
+{
+    status_printf(so, "FEC data packets sent," counter_format, f->n_data_sent);
+    status_printf(so, "FEC parity packets sent," counter_format, f->n_parity_sent);
+    status_printf(so, "FEC packets recovered," counter_format, f->n_recovered);
+    status_printf(so, "FEC packets unrecoverable," counter_format, f->n_unrecovered);
+    status_printf(so, "FEC observed loss permille,%d", f->rx_loss);
+    status_printf(so, "FEC peer loss percent,%d", f->peer_loss);
+}
@@ -0,0 +1,226 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Forward error correction for the data channel (--fec).
+ *
+ * Outgoing packets are grouped into blocks of up to \c k packets.  Each
+ * packet is sent unchanged behind a small header, and when a block is
+ * complete (or has waited for \c FEC_FLUSH_USEC) up to \c m parity packets
+ * are sent for it.  The parity is computed with a systematic Cauchy
+ * Reed-Solomon code over GF(2^8), so any \c p missing packets of a block
+ * can be rebuilt from any \c p of its parity packets.
+ *
+ * The FEC stage sits between fragmentation and encryption, parity packets
+ * are encrypted and authenticated like any other data channel packet.
+ *
+ * Every packet carries the loss rate its sender observes on the way in,
+ * and the number of parity packets per block follows the loss the peer
+ * reports.  Parity packets describe the block they belong to, so the
+ * receiving side does not need to know the sender's parameters.
+ */
+
+#ifndef FEC_H
+#define FEC_H
+
+#include "buffer.h"
+#include "common.h"
+#include "mtu.h"
+#include "status.h"
+
+#define FEC_MAX_DATA      16    /**< Maximum data packets per block. */
+#define FEC_MAX_PARITY    8     /**< Maximum parity packets per block. */
+#define FEC_N_BLOCKS      4     /**< Blocks kept for decoding on the receive side. */
+#define FEC_FLUSH_USEC    20000 /**< Longest time an incomplete block waits
+                                 *   before its parity is sent. */
+#define FEC_N_RECOVERED   16    /**< Recovered packets waiting for delivery. */
+
+/**
+ * FEC header, in network byte order, in front of every packet:
+ *
+ *  bits 31-30  type, \c FEC_DATA or \c FEC_PARITY
+ *  bits 29-24  loss observed by the sender, in percent
+ *  bits 23-16  block id
+ *  bits 15-12  index of the packet within the data or parity packets
+ *  bits 11-8   number of data packets in the block - 1 (parity only)
+ *  bits 7-4    number of parity packets of the block - 1 (parity only)
+ *  bits 3-0    reserved, zero
+ */
+typedef uint32_t fec_header_type;
+
+#define FEC_HEADER_SIZE   sizeof(fec_header_type)
+#define FEC_LEN_SIZE      2     /**< Length prefix of a packet inside
+                                 *   the parity computation. */
+
+#define FEC_TYPE_SHIFT    30
+#define FEC_TYPE_MASK     0x03
+#define FEC_DATA          0
+#define FEC_PARITY        1
+#define FEC_LOSS_SHIFT    24
+#define FEC_LOSS_MASK     0x3f
+#define FEC_BLOCK_SHIFT   16
+#define FEC_BLOCK_MASK    0xff
+#define FEC_INDEX_SHIFT   12
+#define FEC_INDEX_MASK    0x0f
+#define FEC_N_SHIFT       8
+#define FEC_N_MASK        0x0f
+#define FEC_P_SHIFT       4
+#define FEC_P_MASK        0x0f
+
+/**
+ * A block being received.
+ */
+struct fec_rx_block {
+    bool defined;
+    bool decoded;               /**< Nothing left to recover. */
+    int id;                     /**< Block id. */
+    int n;                      /**< Data packets in the block, 0 until
+                                 *   a parity packet was received. */
+    int p;                      /**< Parity packets of the block. */
+    int received;               /**< Packets that arrived. */
+    int max_index;              /**< Highest data index that arrived. */
+    unsigned int data_map;      /**< Data packets we have. */
+    unsigned int parity_map;    /**< Parity packets we have. */
+
+    struct buffer data[FEC_MAX_DATA];   /**< Length prefix and payload. */
+    struct buffer parity[FEC_MAX_PARITY];
+};
+
+/**
+ * FEC state of one peer.
+ */
+struct fec_master {
+    int k;                      /**< Data packets per block. */
+    int max_p;                  /**< Upper bound for parity packets per block. */
+    int buf_size;
+    int headroom;
+
+    /* sending */
+    int tx_block;               /**< Id of the block being built. */
+    int tx_n;                   /**< Data packets in that block so far. */
+    int tx_p;                   /**< Parity packets it will get. */
+    int tx_unit_len;            /**< Longest packet in the block, with
+                                 *   length prefix. */
+    struct timeval tx_start;    /**< When the block got its first packet. */
+    struct buffer tx_acc[FEC_MAX_PARITY];    /**< Parity being computed. */
+    struct buffer tx_parity[FEC_MAX_PARITY]; /**< Parity ready to be sent. */
+    int tx_parity_next;
+    int tx_parity_count;
+    int peer_loss;              /**< Loss in percent reported by the peer. */
+
+    /* receiving */
+    struct fec_rx_block rx[FEC_N_BLOCKS];
+    int rx_loss;                /**< Average loss we observe, in permille. */
+    struct buffer recovered[FEC_N_RECOVERED];
+    int recovered_head;
+    int recovered_len;
+    bool recovered_out;         /**< The next packet given to
+                                 *   fec_incoming() came from
+                                 *   fec_recovered_ready(). */
+
+    /* statistics */
+    counter_type n_data_sent;
+    counter_type n_parity_sent;
+    counter_type n_recovered;
+    counter_type n_unrecovered;
+};
+
+/**
+ * Allocate the FEC state and account for its overhead in \c frame.
+ *
+ * @param frame        The data channel frame.
+ * @param k            Data packets per block.
+ * @param max_parity   Upper bound for parity packets per block.
+ */
+struct fec_master *fec_init(struct frame *frame, int k, int max_parity);
+
+/**
+ * Allocate the packet buffers once the frame size is known.
+ */
+void fec_frame_init(struct fec_master *f, const struct frame *frame);
+
+void fec_free(struct fec_master *f);
+
+/**
+ * Add an outgoing packet to the current block and prepend the FEC header.
+ * Completing a block makes its parity available through
+ * fec_parity_ready().
+ */
+void fec_outgoing(struct fec_master *f, struct buffer *buf);
+
+/**
+ * Return the next parity packet to send, if any.
+ *
+ * @param f    The FEC state.
+ * @param buf  Set to the parity packet, which stays valid until the next
+ *             block is completed.
+ *
+ * @return true if \c buf was set.
+ */
+bool fec_parity_ready(struct fec_master *f, struct buffer *buf);
+
+/**
+ * Complete a block that has waited too long for more packets, and reduce
+ * \c tv to the time until that is due for the current block.
+ */
+void fec_housekeeping(struct fec_master *f, struct timeval *tv);
+
+/**
+ * Process an incoming packet and strip its FEC header.  Parity packets
+ * are consumed, \c buf->len is set to 0 for them.  Packets rebuilt from
+ * parity are made available through fec_recovered_ready().
+ */
+void fec_incoming(struct fec_master *f, struct buffer *buf);
+
+/**
+ * Return the next recovered packet, with its FEC header, to be passed
+ * through fec_incoming() again.  It stays valid until the next packet is
+ * given to fec_incoming().
+ *
+ * @return true if \c buf was set.
+ */
+bool fec_recovered_ready(struct fec_master *f, struct buffer *buf);
+
+void fec_print_stats(const struct fec_master *f, struct status_output *so);
+
+/*
+ * GF(2^8) arithmetic
+ */
+
+void fec_gf_init(void);
+
+uint8_t fec_gf_mul(uint8_t a, uint8_t b);
+
+/**
+ * dst[i] ^= c * src[i] for \c len bytes.
+ */
+void fec_gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, int len);
+
+static inline bool
+fec_outgoing_defined(const struct fec_master *f)
+{
+    return f->tx_parity_next < f->tx_parity_count;
+}
+
+#endif /* ifndef FEC_H */
@@ -247,6 +247,51 @@ check_fragment(struct context *c)
 }
 #endif
 
+/*
+ * Should we send FEC parity or deliver a recovered packet?
+ */
+static inline void
+check_fec(struct context *c)
+{
+    void check_fec_dowork(struct context *c);
+
+    if (c->c2.fec)
+    {
+        check_fec_dowork(c);
+    }
+}
+
+#if ENABLE_IP_PKTINFO
+/*
+ * Should we probe a path or answer a probe of the peer?
+ */
+static inline void
+check_mpath(struct context *c)
+{
+    void check_mpath_dowork(struct context *c);
+
+    if (c->c2.mpath)
+    {
+        check_mpath_dowork(c);
+    }
+}
+#endif
+
+/*
+ * Should we send packets that waited for their --pacing departure time?
+ * A server sends them from its event loop.
+ */
+static inline void
+check_pacing(struct context *c)
+{
+    void check_pacing_dowork(struct context *c);
+
+    if (c->c2.pacing_calendar && c->mode == CM_P2P)
+    {
+        check_pacing_dowork(c);
+    }
+}
+
 #if P2MP
 
 /*
@@ -395,6 +440,10 @@ check_incoming_control_channel_dowork(struct context *c)
             {
                 server_pushed_signal(c, &buf, false, 4);
             }
+            else if (buf_string_match_head_str(&buf, "HC_RESYNC") && c->c2.hc)
+            {
+                hc_resync(c->c2.hc, &buf);
+            }
             else
             {
                 msg(D_PUSH_ERRORS, "WARNING: Received unknown control message: %s", BSTR(&buf));
@@ -642,6 +691,10 @@ check_fragment_dowork(struct context *c)
         {
             /* encrypt a fragment for output to TCP/UDP port */
             ASSERT(fragment_ready_to_send(c->c2.fragment, &c->c2.buf, &c->c2.frame_fragment));
+            if (c->c2.fec)
+            {
+                fec_outgoing(c->c2.fec, &c->c2.buf);
+            }
             encrypt_sign(c, false);
         }
     }
@@ -650,6 +703,67 @@ check_fragment_dowork(struct context *c)
 }
 #endif /* ifdef ENABLE_FRAGMENT */
 
+/*
+ * Should we send FEC parity or deliver a recovered packet?
+ */
+void
+check_fec_dowork(struct context *c)
+{
+    /* send parity of blocks that have been waiting too long */
+    fec_housekeeping(c->c2.fec, &c->c2.timeval);
+
+    if (!c->c2.to_link.len && fec_parity_ready(c->c2.fec, &c->c2.buf))
+    {
+        encrypt_sign(c, false);
+    }
+
+    if (!c->c2.to_tun.len && fec_recovered_ready(c->c2.fec, &c->c2.buf))
+    {
+        process_incoming_link_part2(c, get_link_socket_info(c), BPTR(&c->c2.buf));
+    }
+}
+
+#if ENABLE_IP_PKTINFO
+/*
+ * Should we probe a path or answer a probe of the peer?
+ */
+void
+check_mpath_dowork(struct context *c)
+{
+    mpath_housekeeping(c->c2.mpath, &c->c2.timeval);
+
+    if (!c->c2.to_link.len)
+    {
+        c->c2.buf = c->c2.buffers->aux_buf;
+        ASSERT(buf_init(&c->c2.buf, FRAME_HEADROOM(&c->c2.frame)));
+        if (mpath_next_msg(c->c2.mpath, &c->c2.buf))
+        {
+            /* like a ping, the probe goes through the data channel */
+            encrypt_sign(c, true);
+            c->c2.buf.len = 0;
+            c->c2.mpath->pinned = NULL; /* in case it was not sent */
+        }
+    }
+}
+#endif
+
+/*
+ * Should we send packets that waited for their --pacing departure time?
+ */
+void
+check_pacing_dowork(struct context *c)
+{
+    const uint64_t t = pacing_now();
+    struct pacing_entry *e;
+
+    while ((e = pacing_calendar_next(c->c2.pacing_calendar, t)))
+    {
+        const int size = link_socket_write(c->c2.link_socket, &e->buf, &e->to);
+        check_status(size, "write", c->c2.link_socket, NULL);
+    }
+    pacing_calendar_timeout(c->c2.pacing_calendar, t, &c->c2.timeval);
+}
+
 /*
  * Buffer reallocation, for use with null encryption.
  */
@@ -692,6 +806,10 @@ encrypt_sign(struct context *c, bool comp_frag)
 
     if (comp_frag)
     {
+        if (c->c2.hc)
+        {
+            hc_compress(c->c2.hc, &c->c2.buf, &c->c2.frame);
+        }
 #ifdef USE_COMP
         /* Compress the packet. */
         if (c->c2.comp_context)
@@ -705,6 +823,10 @@ encrypt_sign(struct context *c, bool comp_frag)
             fragment_outgoing(c->c2.fragment, &c->c2.buf, &c->c2.frame_fragment);
         }
 #endif
+        if (c->c2.fec)
+        {
+            fec_outgoing(c->c2.fec, &c->c2.buf);
+        }
     }
 
     /* initialize work buffer with FRAME_HEADROOM bytes of prepend capacity */
@@ -745,6 +867,12 @@ encrypt_sign(struct context *c, bool comp_frag)
      */
     link_socket_get_outgoing_addr(&c->c2.buf, get_link_socket_info(c),
                                   &c->c2.to_link_addr);
+#if ENABLE_IP_PKTINFO
+    if (c->c2.mpath && c->c2.buf.len > 0)
+    {
+        c->c2.to_link_addr = mpath_select(c->c2.mpath, BLEN(&c->c2.buf));
+    }
+#endif
 
     /* if null encryption, copy result to read_tun_buf */
     buffer_turnover(orig_buf, &c->c2.to_link, &c->c2.buf, &b->read_tun_buf);
@@ -1065,6 +1193,19 @@ process_incoming_link_part1(struct context *c, struct link_socket_info *lsi, boo
     {
         struct crypto_options *co = NULL;
         const uint8_t *ad_start = NULL;
+#if ENABLE_IP_PKTINFO
+        if (c->c2.mpath)
+        {
+            c->c2.from_path = mpath_incoming(c->c2.mpath, &c->c2.from, BLEN(&c->c2.buf));
+        }
+        if (c->c2.from_path > 0)
+        {
+            /* additional paths are not in the remote list, and the
+             * data channel keys are not bound to them */
+            floated = true;
+        }
+        else
+#endif
         if (!link_socket_verify_incoming_addr(&c->c2.buf, lsi, &c->c2.from))
         {
             link_socket_bad_incoming_addr(&c->c2.buf, lsi, &c->c2.from);
@@ -1141,6 +1282,11 @@ process_incoming_link_part2(struct context *c, struct link_socket_info *lsi, con
 {
     if (c->c2.buf.len > 0)
     {
+        if (c->c2.fec)
+        {
+            fec_incoming(c->c2.fec, &c->c2.buf);
+        }
+
 #ifdef ENABLE_FRAGMENT
         if (c->c2.fragment)
         {
@@ -1156,6 +1302,24 @@ process_incoming_link_part2(struct context *c, struct link_socket_info *lsi, con
         }
 #endif
 
+        if (c->c2.hc)
+        {
+            hc_decompress(c->c2.hc, &c->c2.buf, &c->c2.frame);
+#if P2MP
+            /* ask the peer for the full headers of a flow we lost */
+            if (c->c2.hc->n_resync && c->c2.tls_multi)
+            {
+                struct gc_arena gc = gc_new();
+                struct buffer out = alloc_buf_gc(32, &gc);
+                if (hc_resync_request(c->c2.hc, &out))
+                {
+                    send_control_channel_string(c, BSTR(&out), D_COMP);
+                }
+                gc_free(&gc);
+            }
+#endif
+        }
+
 #ifdef PACKET_TRUNCATION_CHECK
         /* if (c->c2.buf.len > 1) --c->c2.buf.len; */
         ipv4_packet_size_verify(BPTR(&c->c2.buf),
@@ -1174,7 +1338,11 @@ process_incoming_link_part2(struct context *c, struct link_socket_info *lsi, con
          *
          * Also, update the persisted version of our packet-id.
          */
-        if (!TLS_MODE(c))
+        if (!TLS_MODE(c)
+#if ENABLE_IP_PKTINFO
+            && c->c2.from_path <= 0
+#endif
+            )
         {
             link_socket_set_outgoing_addr(&c->c2.buf, lsi, &c->c2.from, NULL, c->c2.es);
         }
@@ -1199,6 +1367,15 @@ process_incoming_link_part2(struct context *c, struct link_socket_info *lsi, con
             c->c2.buf.len = 0; /* drop packet */
         }
 
+#if ENABLE_IP_PKTINFO
+        /* Did we just receive a multipath probe? */
+        if (c->c2.mpath && is_mpath_msg(&c->c2.buf))
+        {
+            mpath_process_msg(c->c2.mpath, &c->c2.buf, &c->c2.from);
+            c->c2.buf.len = 0;
+        }
+#endif
+
 #ifdef ENABLE_OCC
         /* Did we just receive an OCC packet? */
         if (is_occ_msg(&c->c2.buf))
@@ -1423,6 +1600,15 @@ process_incoming_tun(struct context *c)
                                 &c->c2.n_trunc_pre_encrypt);
 #endif
 
+#if P2MP_SERVER
+        if (c->options.egress_queue)
+        {
+            c->c2.to_link_prio = egress_classify(c->options.egress_rules,
+                                                 TUNNEL_TYPE(c->c1.tuntap),
+                                                 &c->c2.buf);
+        }
+#endif
+
         encrypt_sign(c, true);
     }
     else
@@ -1514,6 +1700,55 @@ process_ip_header(struct context *c, unsigned int flags, struct buffer *buf)
     }
 }
 
+/*
+ * Write c->c2.to_link according to --pacing.  A UDP packet that is not
+ * due yet is given its departure time with SO_TXTIME, or waits in the
+ * pacing calendar.  TCP sockets are paced by the kernel.
+ *
+ * Returns the result of link_socket_write(), the size of a packet that
+ * went to the calendar, or 0 if the packet was dropped.
+ */
+static int
+link_socket_write_paced(struct context *c, struct link_socket_actual *to_addr)
+{
+    struct link_socket *sock = c->c2.link_socket;
+    struct buffer *buf = &c->c2.to_link;
+    uint64_t t_now, t;
+
+    if (!proto_is_udp(sock->info.proto))
+    {
+        if (c->c2.pacer.tcp_rate != c->options.pacing)
+        {
+            link_socket_set_pacing_rate(sock, c->options.pacing);
+            c->c2.pacer.tcp_rate = c->options.pacing;
+        }
+        return link_socket_write(sock, buf, to_addr);
+    }
+
+    t_now = pacing_now();
+    t = pacer_schedule(&c->c2.pacer, c->options.pacing,
+                       BLEN(buf) + datagram_overhead(c->options.ce.proto), t_now);
+    if (!t)
+    {
+        return 0;
+    }
+    if (t > t_now)
+    {
+#if ENABLE_TXTIME
+        if (!c->options.pacing_internal && link_socket_txtime(sock))
+        {
+            return link_socket_write_udp_txtime(sock, buf, to_addr, t);
+        }
+#endif
+        if (c->c2.pacing_calendar)
+        {
+            return pacing_calendar_add(c->c2.pacing_calendar, t, buf, to_addr)
+                   ? BLEN(buf) : 0;
+        }
+    }
+    return link_socket_write(sock, buf, to_addr);
+}
+
 /*
  * Input: c->c2.to_link
  */
@@ -1586,9 +1821,16 @@ process_outgoing_link(struct context *c)
                 socks_preprocess_outgoing_link(c, &to_addr, &size_delta);
 
                 /* Send packet */
-                size = link_socket_write(c->c2.link_socket,
-                                         &c->c2.to_link,
-                                         to_addr);
+                if (c->options.pacing)
+                {
+                    size = link_socket_write_paced(c, to_addr);
+                }
+                else
+                {
+                    size = link_socket_write(c->c2.link_socket,
+                                             &c->c2.to_link,
+                                             to_addr);
+                }
 
                 /* Undo effect of prepend */
                 link_socket_write_post_size_adjust(&size, size_delta, &c->c2.to_link);
@@ -1660,6 +1902,9 @@ process_outgoing_link(struct context *c)
     }
 
     buf_reset(&c->c2.to_link);
+#if P2MP_SERVER
+    c->c2.to_link_prio = MBUF_CLASS_REALTIME;
+#endif
 
     perf_pop();
     gc_free(&gc);
@@ -1814,22 +2059,77 @@ pre_select(struct context *c)
     check_fragment(c);
 #endif
 
+    /* Should we send FEC parity or deliver a recovered packet? */
+    check_fec(c);
+
+#if ENABLE_IP_PKTINFO
+    /* Should we probe a path or answer a probe of the peer? */
+    check_mpath(c);
+#endif
+
+    /* Should we send packets that waited for their departure time? */
+    check_pacing(c);
+
     /* Update random component of timeout */
     check_timeout_random_component(c);
 }
 
+/*
+ * --busy-poll: check for events without sleeping, for up to the
+ * configured time or until the next timer.  Sleeping and being woken
+ * up costs tens of microseconds, which a packet that arrives soon
+ * after does not have to wait.  The time spent is taken off the
+ * timeout of the wait that follows if nothing happened.
+ */
+static int
+io_wait_busy_poll(struct context *c, struct event_set_return *esr, int n)
+{
+    const struct timeval *tv = &c->c2.timeval;
+    struct timeval zero, start, t;
+    int budget, elapsed, status;
+
+    budget = tv->tv_sec ? c->options.busy_poll : min_int(c->options.busy_poll, tv->tv_usec);
+    openvpn_gettimeofday(&start, NULL);
+    do
+    {
+        tv_clear(&zero);
+        status = event_wait(c->c2.event_set, &zero, esr, n);
+        openvpn_gettimeofday(&t, NULL);
+        elapsed = (t.tv_sec - start.tv_sec) * 1000000 + (t.tv_usec - start.tv_usec);
+    } while (status == 0 && elapsed < budget);
+
+    if (status == 0)
+    {
+        c->c2.timeval.tv_usec -= elapsed;
+        while (c->c2.timeval.tv_usec < 0)
+        {
+            c->c2.timeval.tv_usec += 1000000;
+            c->c2.timeval.tv_sec--;
+        }
+        if (c->c2.timeval.tv_sec < 0)
+        {
+            tv_clear(&c->c2.timeval);
+        }
+        c->c2.busy_poll_sleeps++;
+    }
+    else
+    {
+        c->c2.busy_poll_hits++;
+    }
+    return status;
+}
+
 /*
  * Wait for I/O events.  Used for both TCP & UDP sockets
  * in point-to-point mode and for UDP sockets in
  * point-to-multipoint mode.
  */
-
 void
 io_wait_dowork(struct context *c, const unsigned int flags)
 {
     unsigned int socket = 0;
     unsigned int tuntap = 0;
-    struct event_set_return esr[4];
+    struct event_set_return esr[5];
 
     /* These shifts all depend on EVENT_READ and EVENT_WRITE */
     static int socket_shift = 0;   /* depends on SOCKET_READ and SOCKET_WRITE */
@@ -1841,6 +2141,9 @@ io_wait_dowork(struct context *c, const unsigned int flags)
 #ifdef ENABLE_ASYNC_PUSH
     static int file_shift = 8;     /* listening inotify events */
 #endif
+#ifndef _WIN32
+    static int reload_shift = 9;   /* --graceful-reload check reply */
+#endif
 
     /*
      * Decide what kind of events we want to wait for.
@@ -1928,6 +2231,14 @@ io_wait_dowork(struct context *c, const unsigned int flags)
         socket |= EVENT_WRITE;
     }
 
+    /*
+     * --tcp-coalesce: data left over from a partial write?
+     */
+    if (flags & IOW_STREAM_OUT)
+    {
+        socket |= EVENT_WRITE;
+    }
+
     /*
      * Force wait on TUN input, even if also waiting on TCP/UDP output
      */
@@ -1957,6 +2268,14 @@ io_wait_dowork(struct context *c, const unsigned int flags)
     }
 #endif
 
+#ifndef _WIN32
+    /* reply of a --graceful-reload configuration check */
+    if (c->options.mode == MODE_SERVER && c->c2.reload_fd >= 0)
+    {
+        event_ctl(c->c2.event_set, c->c2.reload_fd, EVENT_READ, (void *)&reload_shift);
+    }
+#endif
+
     /*
      * Possible scenarios:
      *  (1) tcp/udp port has data available to read
@@ -1985,7 +2304,15 @@ io_wait_dowork(struct context *c, const unsigned int flags)
             /*
              * Wait for something to happen.
              */
-            status = event_wait(c->c2.event_set, &c->c2.timeval, esr, SIZE(esr));
+            status = 0;
+            if (c->options.busy_poll && tv_defined(&c->c2.timeval))
+            {
+                status = io_wait_busy_poll(c, esr, SIZE(esr));
+            }
+            if (status == 0)
+            {
+                status = event_wait(c->c2.event_set, &c->c2.timeval, esr, SIZE(esr));
+            }
 
             check_status(status, "event_wait", NULL, NULL);
 
@@ -2022,6 +2349,39 @@ io_wait_dowork(struct context *c, const unsigned int flags)
     dmsg(D_EVENT_WAIT, "I/O WAIT status=0x%04x", c->c2.event_set_status);
 }
 
+/*
+ * With --tcp-coalesce, keep reading from the tun device after a packet
+ * was read, so that the packets of a burst end up in the send buffer of
+ * the socket together and are written with one system call.
+ */
+#define TCP_COALESCE_MAX_READS 32
+
+static void
+process_incoming_tun_burst(struct context *c)
+{
+    int i;
+
+    for (i = 0; i < TCP_COALESCE_MAX_READS; ++i)
+    {
+        if (c->c2.to_link.len <= 0 || IS_SIG(c)
+            || !link_socket_out_room(c->c2.link_socket))
+        {
+            break;
+        }
+        process_outgoing_link(c);
+        if (c->c2.to_link.len > 0 || IS_SIG(c))
+        {
+            break;
+        }
+        read_incoming_tun(c);
+        if (c->c2.buf.len <= 0 || IS_SIG(c))
+        {
+            break;
+        }
+        process_incoming_tun(c);
+    }
+}
+
 void
 process_io(struct context *c)
 {
@@ -2038,7 +2398,15 @@ process_io(struct context *c)
     /* TCP/UDP port ready to accept write */
     if (status & SOCKET_WRITE)
     {
-        process_outgoing_link(c);
+        if (link_socket_out_pending(c->c2.link_socket))
+        {
+            const int size = link_socket_flush(c->c2.link_socket);
+            check_status(size, "write", c->c2.link_socket, NULL);
+        }
+        if (link_socket_out_room(c->c2.link_socket))
+        {
+            process_outgoing_link(c);
+        }
     }
     /* TUN device ready to accept write */
     else if (status & TUN_WRITE)
@@ -2062,5 +2430,17 @@ process_io(struct context *c)
         {
             process_incoming_tun(c);
         }
+        if (c->c2.link_socket && c->c2.link_socket->stream_out.data)
+        {
+            process_incoming_tun_burst(c);
+        }
+    }
+
+    /* --tcp-coalesce: hand what was collected in this round to the
+     * kernel, on a signal link_socket_close() sends what is left */
+    if (link_socket_out_pending(c->c2.link_socket) && !IS_SIG(c))
+    {
+        const int size = link_socket_flush(c->c2.link_socket);
+        check_status(size, "write", c->c2.link_socket, NULL);
     }
 }
@@ -0,0 +1,365 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if SOCKET_HANDOVER
+
+#include "error.h"
+#include "fdmisc.h"
+#include "handover.h"
+
+#include "memdbg.h"
+
+/* sent by the old server in front of the descriptors */
+#define HANDOVER_MAGIC "OVPN-HANDOVER-1"
+
+/* the descriptors, in the order they are sent */
+#define HANDOVER_FD_LINK 0
+#define HANDOVER_FD_TUN  1
+#define HANDOVER_N_FDS   2
+
+/*
+ * How long the new server waits for the old one to exit.  This covers the
+ * --explicit-exit-notify delay of the old server.
+ */
+#define HANDOVER_EXIT_TIMEOUT 60
+
+/* descriptors received from the old server */
+static socket_descriptor_t inherited_link_sd = SOCKET_UNDEFINED; /* GLOBAL */
+static int inherited_tun_fd = -1;                                 /* GLOBAL */
+
+/* listening socket, and connection to the new server after a handover */
+static socket_descriptor_t listen_sd = SOCKET_UNDEFINED;   /* GLOBAL */
+static socket_descriptor_t handover_sd = SOCKET_UNDEFINED; /* GLOBAL */
+static char *listen_path;                                  /* GLOBAL */
+
+static bool
+handover_sockaddr(struct sockaddr_un *addr, const char *path)
+{
+    CLEAR(*addr);
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        msg(M_WARN, "SOCKET HANDOVER: socket path too long: %s", path);
+        return false;
+    }
+    strncpynt(addr->sun_path, path, sizeof(addr->sun_path));
+    return true;
+}
+
+static bool
+handover_recv_fds(socket_descriptor_t sd)
+{
+    char magic[sizeof(HANDOVER_MAGIC)];
+    int fds[HANDOVER_N_FDS];
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(fds))];
+    } control;
+    struct msghdr mesg;
+    struct cmsghdr *h;
+    struct iovec iov;
+
+    CLEAR(mesg);
+    CLEAR(control);
+    iov.iov_base = magic;
+    iov.iov_len = sizeof(magic);
+    mesg.msg_iov = &iov;
+    mesg.msg_iovlen = 1;
+    mesg.msg_control = control.buf;
+    mesg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(sd, &mesg, 0) != sizeof(magic)
+        || memcmp(magic, HANDOVER_MAGIC, sizeof(magic)))
+    {
+        msg(M_WARN | M_ERRNO, "SOCKET HANDOVER: no valid handover message received");
+        return false;
+    }
+
+    h = CMSG_FIRSTHDR(&mesg);
+    if (!h || h->cmsg_level != SOL_SOCKET || h->cmsg_type != SCM_RIGHTS
+        || h->cmsg_len != CMSG_LEN(sizeof(fds)))
+    {
+        msg(M_WARN, "SOCKET HANDOVER: handover message without descriptors");
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(h), sizeof(fds));
+
+    inherited_link_sd = fds[HANDOVER_FD_LINK];
+    inherited_tun_fd = fds[HANDOVER_FD_TUN];
+    if (socket_defined(inherited_link_sd))
+    {
+        set_cloexec(inherited_link_sd);
+    }
+    if (inherited_tun_fd >= 0)
+    {
+        set_cloexec(inherited_tun_fd);
+    }
+    return true;
+}
+
+/*
+ * The old server keeps the connection open until it has exited, wait for
+ * the end of file.  Returns false if it did not exit in time.
+ */
+static bool
+handover_wait_exit(socket_descriptor_t sd)
+{
+    const time_t deadline = time(NULL) + HANDOVER_EXIT_TIMEOUT;
+    struct pollfd pfd;
+    char c;
+
+    pfd.fd = sd;
+    pfd.events = POLLIN;
+    while (true)
+    {
+        const time_t left = deadline - time(NULL);
+        ssize_t n;
+        int ret;
+
+        if (left <= 0)
+        {
+            return false;
+        }
+        ret = poll(&pfd, 1, (int) left * 1000);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            msg(M_WARN | M_ERRNO, "SOCKET HANDOVER: poll on handover connection failed");
+            return false;
+        }
+        if (ret == 0)
+        {
+            return false;
+        }
+
+        n = read(sd, &c, sizeof(c));
+        if (n == 0)
+        {
+            return true;
+        }
+        if (n < 0 && errno != EINTR && errno != EAGAIN)
+        {
+            /* a reset connection also means that the old server is gone */
+            return errno == ECONNRESET;
+        }
+    }
+}
+
+void
+handover_takeover(const char *path)
+{
+    struct sockaddr_un addr;
+    socket_descriptor_t sd;
+
+    if (!handover_sockaddr(&addr, path))
+    {
+        return;
+    }
+
+    sd = socket(PF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0)
+    {
+        msg(M_WARN | M_ERRNO, "SOCKET HANDOVER: cannot create unix socket");
+        return;
+    }
+
+    if (connect(sd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        /* nobody to take over from, this is a normal start */
+        openvpn_close_socket(sd);
+        return;
+    }
+
+    msg(M_INFO, "SOCKET HANDOVER: taking over from the server listening on %s", path);
+    if (handover_recv_fds(sd))
+    {
+        /* only one of us may read from the socket */
+        if (!handover_wait_exit(sd))
+        {
+            msg(M_FATAL, "SOCKET HANDOVER: previous server did not exit within %d seconds",
+                HANDOVER_EXIT_TIMEOUT);
+        }
+        msg(M_INFO, "SOCKET HANDOVER: previous server has exited, using its socket and tun device");
+    }
+    openvpn_close_socket(sd);
+}
+
+socket_descriptor_t
+handover_take_link_socket(int af)
+{
+    socket_descriptor_t sd = inherited_link_sd;
+    struct openvpn_sockaddr local;
+    socklen_t len = sizeof(local.addr);
+
+    if (!socket_defined(sd))
+    {
+        return SOCKET_UNDEFINED;
+    }
+    inherited_link_sd = SOCKET_UNDEFINED;
+
+    CLEAR(local);
+    if (getsockname(sd, &local.addr.sa, &len) < 0 || local.addr.sa.sa_family != af)
+    {
+        msg(M_WARN, "SOCKET HANDOVER: inherited socket does not match the configuration, not using it");
+        openvpn_close_socket(sd);
+        return SOCKET_UNDEFINED;
+    }
+    return sd;
+}
+
+int
+handover_take_tun_fd(void)
+{
+    const int fd = inherited_tun_fd;
+    inherited_tun_fd = -1;
+    return fd;
+}
+
+void
+handover_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    mode_t old_umask;
+
+    ASSERT(!socket_defined(listen_sd));
+
+    if (!handover_sockaddr(&addr, path))
+    {
+        return;
+    }
+
+    listen_sd = socket(PF_UNIX, SOCK_STREAM, 0);
+    if (listen_sd < 0)
+    {
+        msg(M_WARN | M_ERRNO, "SOCKET HANDOVER: cannot create unix socket");
+        listen_sd = SOCKET_UNDEFINED;
+        return;
+    }
+    set_nonblock(listen_sd);
+    set_cloexec(listen_sd);
+
+    /* only processes running as our user may take over */
+    unlink(path);
+    old_umask = umask(S_IRWXG | S_IRWXO);
+    if (bind(listen_sd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+        || listen(listen_sd, 1) < 0)
+    {
+        msg(M_WARN | M_ERRNO, "SOCKET HANDOVER: cannot listen on %s", path);
+        openvpn_close_socket(listen_sd);
+        listen_sd = SOCKET_UNDEFINED;
+    }
+    else
+    {
+        listen_path = string_alloc(path, NULL);
+        msg(M_INFO, "SOCKET HANDOVER: listening on %s", path);
+    }
+    umask(old_umask);
+}
+
+bool
+handover_send(socket_descriptor_t link_sd, int tun_fd)
+{
+    const int fds[HANDOVER_N_FDS] = { link_sd, tun_fd };
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(fds))];
+    } control;
+    struct msghdr mesg;
+    struct cmsghdr *h;
+    struct iovec iov;
+    socket_descriptor_t sd;
+
+    if (!socket_defined(listen_sd) || socket_defined(handover_sd))
+    {
+        return false;
+    }
+
+    sd = accept(listen_sd, NULL, NULL);
+    if (sd < 0)
+    {
+        return false;
+    }
+
+    CLEAR(mesg);
+    CLEAR(control);
+    iov.iov_base = HANDOVER_MAGIC;
+    iov.iov_len = sizeof(HANDOVER_MAGIC);
+    mesg.msg_iov = &iov;
+    mesg.msg_iovlen = 1;
+    mesg.msg_control = control.buf;
+    mesg.msg_controllen = sizeof(control.buf);
+
+    h = CMSG_FIRSTHDR(&mesg);
+    h->cmsg_level = SOL_SOCKET;
+    h->cmsg_type = SCM_RIGHTS;
+    h->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(h), fds, sizeof(fds));
+
+    if (sendmsg(sd, &mesg, MSG_NOSIGNAL) != sizeof(HANDOVER_MAGIC))
+    {
+        msg(M_WARN | M_ERRNO, "SOCKET HANDOVER: handover to new server failed");
+        openvpn_close_socket(sd);
+        return false;
+    }
+
+    msg(M_INFO, "SOCKET HANDOVER: socket and tun device handed over to new server, shutting down");
+    set_cloexec(sd);
+    handover_sd = sd;
+    return true;
+}
+
+void
+handover_close(void)
+{
+    if (socket_defined(listen_sd))
+    {
+        openvpn_close_socket(listen_sd);
+        listen_sd = SOCKET_UNDEFINED;
+        unlink(listen_path);
+        free(listen_path);
+        listen_path = NULL;
+    }
+
+    /* handover_sd is left open on purpose, it is closed when we exit,
+     * after the tun device has been deconfigured */
+}
+
+#else  /* if SOCKET_HANDOVER */
+static void
+dummy(void)
+{
+}
+#endif /* SOCKET_HANDOVER */
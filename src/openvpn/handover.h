@@ -0,0 +1,94 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Socket handover of a UDP server (--handover-socket).
+ *
+ * A running server listens on a unix socket.  A new server process started
+ * with the same --handover-socket path connects to it and receives the UDP
+ * socket and the tun device with SCM_RIGHTS.  The old server then shuts
+ * down as if it had received SIGTERM, and the new one waits until the old
+ * one has exited before it starts using the inherited descriptors.
+ *
+ * Only the UDP port and the tun interface survive: the port never becomes
+ * unbound and the interface is never destroyed, so routes and firewall
+ * rules on it stay in place.
+ *
+ * This is not a live upgrade.  Client sessions are not carried over:
+ * keys, packet-id state and peer-ids stay with the old process, so every
+ * client has to reconnect and renegotiate with the new process.
+ */
+
+#ifndef HANDOVER_H
+#define HANDOVER_H
+
+#if SOCKET_HANDOVER
+
+#include "basic.h"
+#include "socket.h"
+
+/**
+ * Take over the socket and tun device of a server that is listening on
+ * \c path, and wait until that server has exited.  Does nothing if no
+ * server is listening, exits if it does not exit within a minute.
+ */
+void handover_takeover(const char *path);
+
+/**
+ * Return the inherited UDP socket if its address family is \c af, and
+ * forget about it.
+ *
+ * @return The socket, or SOCKET_UNDEFINED.
+ */
+socket_descriptor_t handover_take_link_socket(int af);
+
+/**
+ * Return the inherited tun device fd, and forget about it.
+ *
+ * @return The fd, or -1.
+ */
+int handover_take_tun_fd(void);
+
+/**
+ * Start listening for a new server process on \c path.
+ */
+void handover_listen(const char *path);
+
+/**
+ * Hand \c link_sd and \c tun_fd over to a new server process, if one has
+ * connected.  Does not block.
+ *
+ * @return true if the descriptors were handed over, the caller should
+ *         shut down.
+ */
+bool handover_send(socket_descriptor_t link_sd, int tun_fd);
+
+/**
+ * Stop listening.  After a handover the connection to the new server is
+ * kept open until the process exits, the new server waits for that.
+ */
+void handover_close(void);
+
+#endif /* if SOCKET_HANDOVER */
+#endif /* ifndef HANDOVER_H */
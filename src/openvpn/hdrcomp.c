@@ -0,0 +1,792 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "hdrcomp.h"
+#include "error.h"
+#include "otime.h"
+#include "proto.h"
+
+#include "memdbg.h"
+
+#define HC_PROBE 4              /* slots a flow may occupy */
+#define HC_CO_MAX (4 + 2 + 2 + 1 + 1 + 6 + 2)
+
+/*
+ * Decode the low 8 bits of a value as the one closest to what is
+ * expected, from 64 below to 191 above it.  The sender checks that
+ * the value is from 32 below to 127 above what it expects itself.
+ */
+static inline uint16_t
+lsb_decode(uint8_t lsb, uint16_t ref)
+{
+    int d = (uint8_t)(lsb - ref);
+    if (d >= 192)
+    {
+        d -= 256;
+    }
+    return ref + d;
+}
+
+static inline bool
+lsb_fits(uint16_t v, uint16_t ref)
+{
+    const int d = (int16_t)(v - ref);
+    return d >= -32 && d <= 127;
+}
+
+/* offsets of the fields we touch, from the start of the IP header */
+#define V4_TOS      1
+#define V4_LEN      2
+#define V4_ID       4
+#define V4_FRAG     6
+#define V4_TTL      8
+#define V4_PROTO    9
+#define V4_CSUM     10
+#define V4_ADDR     12
+#define V6_LEN      4
+#define V6_NEXT     6
+#define V6_HOP      7
+#define V6_ADDR     8
+
+/* and from the start of the UDP header */
+#define UDP_LEN     4
+#define UDP_CSUM    6
+#define RTP_M_PT    (8 + 1)
+#define RTP_SN      (8 + 2)
+#define RTP_TS      (8 + 4)
+
+static uint8_t crc8_table[256]; /* GLOBAL */
+
+static void
+crc8_init(void)
+{
+    int i, j;
+
+    for (i = 0; i < 256; ++i)
+    {
+        uint8_t c = i;
+        for (j = 0; j < 8; ++j)
+        {
+            c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+        }
+        crc8_table[i] = c;
+    }
+}
+
+static uint8_t
+crc8(const uint8_t *p, int len)
+{
+    uint8_t c = 0;
+
+    while (len--)
+    {
+        c = crc8_table[c ^ *p++];
+    }
+    return c;
+}
+
+static inline uint16_t
+get16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline void
+put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline uint32_t
+get32(const uint8_t *p)
+{
+    return ((uint32_t)get16(p) << 16) | get16(p + 2);
+}
+
+static inline void
+put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v >> 16);
+    put16(p + 2, v);
+}
+
+static inline uint8_t
+get_tos(const uint8_t *p, int ip_len)
+{
+    return ip_len == 20 ? p[V4_TOS] : (p[0] << 4) | (p[1] >> 4);
+}
+
+static inline void
+put_tos(uint8_t *p, int ip_len, uint8_t tos)
+{
+    if (ip_len == 20)
+    {
+        p[V4_TOS] = tos;
+    }
+    else
+    {
+        p[0] = 0x60 | (tos >> 4);
+        p[1] = (tos << 4) | (p[1] & 0x0f);
+    }
+}
+
+static inline int
+ttl_off(int ip_len)
+{
+    return ip_len == 20 ? V4_TTL : V6_HOP;
+}
+
+static uint16_t
+ipv4_checksum(const uint8_t *p)
+{
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i < 20; i += 2)
+    {
+        if (i != V4_CSUM)
+        {
+            sum += get16(p + i);
+        }
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+/*
+ * Length of the headers we can compress, IPv4 without options or
+ * IPv6 without extension headers, UDP and maybe RTP, or 0.
+ */
+static int
+hc_header_len(const uint8_t *p, int len, int *ip_len, bool *rtp)
+{
+    const uint8_t *u;
+
+    if (len >= 28 && p[0] == 0x45)
+    {
+        if (p[V4_PROTO] != OPENVPN_IPPROTO_UDP
+            || (get16(p + V4_FRAG) & 0x3fff) || get16(p + V4_LEN) != len)
+        {
+            return 0;
+        }
+        *ip_len = 20;
+    }
+    else if (len >= 48 && (p[0] >> 4) == 6)
+    {
+        if (p[V6_NEXT] != OPENVPN_IPPROTO_UDP || get16(p + V6_LEN) != len - 40)
+        {
+            return 0;
+        }
+        *ip_len = 40;
+    }
+    else
+    {
+        return 0;
+    }
+
+    u = p + *ip_len;
+    if (get16(u + UDP_LEN) != len - *ip_len)
+    {
+        return 0;
+    }
+
+    /* RTP version 2, but not RTCP (payload types 72-76 with marker) */
+    *rtp = len - *ip_len >= 8 + 12 && (u[8] & 0xc0) == 0x80
+           && ((u[RTP_M_PT] & 0x7f) < 72 || (u[RTP_M_PT] & 0x7f) > 76);
+
+    return *ip_len + 8 + (*rtp ? 12 : 0);
+}
+
+/*
+ * Copy the fields that may change from packet to packet.
+ */
+static void
+hc_copy_dynamic(uint8_t *dst, const uint8_t *src, int ip_len, bool rtp)
+{
+    uint8_t *du = dst + ip_len;
+    const uint8_t *su = src + ip_len;
+
+    put_tos(dst, ip_len, get_tos(src, ip_len));
+    dst[ttl_off(ip_len)] = src[ttl_off(ip_len)];
+    if (ip_len == 20)
+    {
+        memcpy(dst + V4_LEN, src + V4_LEN, 4); /* length and id */
+        memcpy(dst + V4_CSUM, src + V4_CSUM, 2);
+    }
+    else
+    {
+        memcpy(dst + V6_LEN, src + V6_LEN, 2);
+    }
+    memcpy(du + UDP_LEN, su + UDP_LEN, 4); /* length and checksum */
+    if (rtp)
+    {
+        du[RTP_M_PT] = (du[RTP_M_PT] & 0x7f) | (su[RTP_M_PT] & 0x80);
+        memcpy(du + RTP_SN, su + RTP_SN, 6); /* sequence number, timestamp */
+    }
+}
+
+static bool
+hc_same_static(const struct hc_flow *f, const uint8_t *p, int hdr_len)
+{
+    uint8_t tmp[HC_MAX_HDR];
+
+    if (f->hdr_len != hdr_len)
+    {
+        return false;
+    }
+    memcpy(tmp, p, hdr_len);
+    hc_copy_dynamic(tmp, f->hdr, f->ip_len, f->rtp);
+    return !memcmp(tmp, f->hdr, hdr_len);
+}
+
+/*
+ * Start a flow from a full header, the same way on both sides.
+ */
+static void
+hc_flow_init(struct hc_flow *f, const uint8_t *p, int ip_len, int hdr_len,
+             bool rtp)
+{
+    const uint8_t *u = p + ip_len;
+    const uint16_t ipid = ip_len == 20 ? get16(p + V4_ID) : 0;
+
+    f->valid = true;
+    f->rtp = rtp;
+    f->ip_len = ip_len;
+    f->hdr_len = hdr_len;
+    memcpy(f->hdr, p, hdr_len);
+
+    f->sn = rtp ? get16(u + RTP_SN) : 0;
+    f->ipid_zero = ipid == 0;
+    f->ipid_off = ipid - f->sn;
+    f->ts_ref = rtp ? get32(u + RTP_TS) : 0;
+    f->ts_sn = f->sn;
+    f->ts_stride = 0;
+
+    f->ipid_left = f->ttl_left = f->tos_left = f->ts_left = 0;
+    f->ts_miss = true;
+}
+
+static inline uint16_t
+hc_predict_ipid(const struct hc_flow *f, uint16_t sn)
+{
+    return f->ipid_zero ? 0 : (uint16_t)(f->ipid_off + sn);
+}
+
+static inline uint32_t
+hc_predict_ts(const struct hc_flow *f, uint16_t sn)
+{
+    return f->ts_ref + (uint32_t)(uint16_t)(sn - f->ts_sn) * f->ts_stride;
+}
+
+struct hc_context *
+hc_init(int n, const struct frame *frame)
+{
+    struct hc_context *hc;
+
+    ASSERT(n > 0 && n <= HC_CONTEXTS_MAX);
+    if (!crc8_table[1])
+    {
+        crc8_init();
+    }
+
+    ALLOC_OBJ_CLEAR(hc, struct hc_context);
+    hc->n = n;
+    ALLOC_ARRAY_CLEAR(hc->tx, struct hc_flow, n);
+    ALLOC_ARRAY_CLEAR(hc->rx, struct hc_flow, n);
+    hc->work = alloc_buf(BUF_SIZE(frame));
+    return hc;
+}
+
+void
+hc_free(struct hc_context *hc)
+{
+    if (hc)
+    {
+        free_buf(&hc->work);
+        free(hc->tx);
+        free(hc->rx);
+        free(hc);
+    }
+}
+
+/*
+ * Find the context of a flow, by addresses and ports, or replace the
+ * least recently used one.
+ */
+static int
+hc_lookup(struct hc_context *hc, const uint8_t *p, int ip_len)
+{
+    const int key_off = ip_len == 20 ? V4_ADDR : V6_ADDR;
+    const int key_len = ip_len - key_off + 4;
+    uint32_t h = 2166136261u;
+    int i, oldest = -1;
+
+    for (i = 0; i < key_len; ++i)
+    {
+        h = (h ^ p[key_off + i]) * 16777619u;
+    }
+
+    for (i = 0; i < HC_PROBE && i < hc->n; ++i)
+    {
+        const int cid = (h + i) % hc->n;
+        const struct hc_flow *f = &hc->tx[cid];
+
+        if (f->ip_len == ip_len && !memcmp(f->hdr + key_off, p + key_off, key_len))
+        {
+            return cid;
+        }
+        if (oldest < 0 || f->used < hc->tx[oldest].used)
+        {
+            oldest = cid;
+        }
+    }
+
+    hc->tx[oldest].valid = false;
+    hc->tx[oldest].ip_len = 0;
+    return oldest;
+}
+
+void
+hc_compress(struct hc_context *hc, struct buffer *buf, const struct frame *frame)
+{
+    uint8_t *p = BPTR(buf);
+    const int len = BLEN(buf);
+    uint8_t co[HC_CO_MAX];
+    uint8_t *c = co + 4;
+    const uint8_t *u;
+    struct hc_flow *f;
+    int ip_len, hdr_len, cid;
+    bool rtp;
+    uint16_t sn;
+
+    hdr_len = hc_header_len(p, len, &ip_len, &rtp);
+    if (!hdr_len)
+    {
+        return;
+    }
+    u = p + ip_len;
+
+    cid = hc_lookup(hc, p, ip_len);
+    f = &hc->tx[cid];
+    f->used = ++hc->clock;
+
+    if (f->valid && (f->rtp != rtp || !hc_same_static(f, p, hdr_len)))
+    {
+        f->valid = false;
+    }
+    if (!f->valid)
+    {
+        f->ir_left = HC_REPEAT;
+    }
+    else if (--f->refresh <= 0 && !f->ir_left)
+    {
+        f->ir_left = 1;
+    }
+
+    if (f->ir_left)
+    {
+        /* a full header that does not fit is left for the next packet */
+        if (len + HC_IR_LEN > TUN_MTU_SIZE(frame) || !buf_prepend(buf, HC_IR_LEN))
+        {
+            f->valid = false;
+            return;
+        }
+        hc_flow_init(f, p, ip_len, hdr_len, rtp);
+        f->ir_left--;
+        f->refresh = HC_REFRESH;
+
+        p = BPTR(buf);
+        p[0] = HC_IR;
+        p[1] = cid;
+        hc->pre_compress += len;
+        hc->post_compress += BLEN(buf);
+        hc->n_ir++;
+        return;
+    }
+
+    co[0] = HC_CO;
+    co[1] = cid;
+    co[2] = 0;
+    co[3] = crc8(p, hdr_len);
+
+    /* sequence number, sent as its low 8 bits while the receiver cannot
+     * be more than 64 packets behind */
+    sn = rtp ? get16(u + RTP_SN) : f->sn + 1;
+    if (!lsb_fits(sn, f->sn))
+    {
+        co[2] |= HC_F_SN16;
+        put16(c, sn);
+        c += 2;
+    }
+    else
+    {
+        *c++ = sn;
+    }
+
+    if (ip_len == 20)
+    {
+        /* many stacks do not simply count the id up, but most of them
+         * keep it close to that */
+        const uint16_t ipid = get16(p + V4_ID);
+        const uint16_t predicted = hc_predict_ipid(f, sn);
+        if (ipid != predicted)
+        {
+            f->ipid_left = HC_REPEAT;
+        }
+        if (f->ipid_left)
+        {
+            f->ipid_left--;
+            if (lsb_fits(ipid, predicted))
+            {
+                co[2] |= HC_F_IPID;
+                *c++ = ipid;
+            }
+            else
+            {
+                co[2] |= HC_F_IPID16;
+                put16(c, ipid);
+                c += 2;
+            }
+            f->ipid_zero = ipid == 0;
+            f->ipid_off = ipid - sn;
+        }
+    }
+
+    if (p[ttl_off(ip_len)] != f->hdr[ttl_off(ip_len)])
+    {
+        f->ttl_left = HC_REPEAT;
+    }
+    if (f->ttl_left)
+    {
+        f->ttl_left--;
+        co[2] |= HC_F_TTL;
+        *c++ = p[ttl_off(ip_len)];
+    }
+
+    if (get_tos(p, ip_len) != get_tos(f->hdr, ip_len))
+    {
+        f->tos_left = HC_REPEAT;
+    }
+    if (f->tos_left)
+    {
+        f->tos_left--;
+        co[2] |= HC_F_TOS;
+        *c++ = get_tos(p, ip_len);
+    }
+
+    if (rtp)
+    {
+        const uint32_t ts = get32(u + RTP_TS);
+        const bool miss = ts != hc_predict_ts(f, sn);
+
+        /* a single miss is a jump, like after silence, the stride is
+         * only learned anew from the previous packet after two */
+        if (miss && f->ts_miss)
+        {
+            const uint16_t d_sn = sn - f->sn;
+            const uint32_t d_ts = ts - get32(f->hdr + ip_len + RTP_TS);
+
+            f->ts_stride = (d_sn && d_ts % d_sn == 0 && d_ts / d_sn <= 0xffff)
+                           ? d_ts / d_sn : 0;
+        }
+        if (miss)
+        {
+            f->ts_left = HC_REPEAT;
+        }
+        f->ts_miss = miss;
+        if (f->ts_left)
+        {
+            f->ts_left--;
+            f->ts_ref = ts;
+            f->ts_sn = sn;
+            co[2] |= HC_F_TS;
+            put32(c, ts);
+            put16(c + 4, f->ts_stride);
+            c += 6;
+        }
+        if (u[RTP_M_PT] & 0x80)
+        {
+            co[2] |= HC_F_MARKER;
+        }
+    }
+
+    if (get16(u + UDP_CSUM))
+    {
+        co[2] |= HC_F_CSUM;
+        memcpy(c, u + UDP_CSUM, 2);
+        c += 2;
+    }
+
+    memcpy(f->hdr, p, hdr_len);
+    f->sn = sn;
+
+    /* replace the headers, the compressed ones are always shorter */
+    ASSERT(buf_advance(buf, hdr_len - (c - co)));
+    memcpy(BPTR(buf), co, c - co);
+
+    hc->pre_compress += len;
+    hc->post_compress += BLEN(buf);
+    hc->n_co++;
+}
+
+static void
+hc_fail(struct hc_context *hc, struct hc_flow *f, struct buffer *buf)
+{
+    buf->len = 0;
+    hc->n_failed++;
+    if (!f->resync && now >= f->resync_requested + HC_RESYNC_INTERVAL)
+    {
+        f->resync = true;
+        hc->n_resync++;
+    }
+}
+
+void
+hc_decompress(struct hc_context *hc, struct buffer *buf, const struct frame *frame)
+{
+    const uint8_t *p = BPTR(buf);
+    const int len = BLEN(buf);
+    const uint8_t *c, *end = p + len;
+    uint8_t hdr[HC_MAX_HDR];
+    uint8_t *u = hdr;
+    struct hc_flow *f;
+    int ip_len, hdr_len, plen;
+    bool rtp;
+    uint8_t flags;
+    uint16_t sn, ipid = 0, stride = 0;
+    uint32_t ts = 0;
+
+    if (len < 2 || (p[0] != HC_IR && p[0] != HC_CO))
+    {
+        return;
+    }
+    if (p[1] >= hc->n)
+    {
+        dmsg(D_COMP_ERRORS, "Header compression: bad context %d", p[1]);
+        buf->len = 0;
+        return;
+    }
+    f = &hc->rx[p[1]];
+
+    if (p[0] == HC_IR)
+    {
+        hdr_len = hc_header_len(p + HC_IR_LEN, len - HC_IR_LEN, &ip_len, &rtp);
+        if (!hdr_len)
+        {
+            dmsg(D_COMP_ERRORS, "Header compression: bad full header");
+            buf->len = 0;
+            return;
+        }
+        hc_flow_init(f, p + HC_IR_LEN, ip_len, hdr_len, rtp);
+        buf_advance(buf, HC_IR_LEN);
+        return;
+    }
+
+    if (!f->valid || len < 5)
+    {
+        hc_fail(hc, f, buf);
+        return;
+    }
+
+    flags = p[2];
+    c = p + 4;
+    ip_len = f->ip_len;
+    hdr_len = f->hdr_len;
+    memcpy(hdr, f->hdr, hdr_len);
+    u = hdr + ip_len;
+
+#define HC_NEED(n) if (end - c < (n)) { goto error; }
+
+    if (flags & HC_F_SN16)
+    {
+        HC_NEED(2);
+        sn = get16(c);
+        c += 2;
+    }
+    else
+    {
+        HC_NEED(1);
+        sn = lsb_decode(*c++, f->sn);
+    }
+
+    if (ip_len == 20)
+    {
+        if (flags & HC_F_IPID16)
+        {
+            HC_NEED(2);
+            ipid = get16(c);
+            c += 2;
+        }
+        else if (flags & HC_F_IPID)
+        {
+            HC_NEED(1);
+            ipid = lsb_decode(*c++, hc_predict_ipid(f, sn));
+        }
+        else
+        {
+            ipid = hc_predict_ipid(f, sn);
+        }
+        put16(hdr + V4_ID, ipid);
+    }
+    if (flags & HC_F_TTL)
+    {
+        HC_NEED(1);
+        hdr[ttl_off(ip_len)] = *c++;
+    }
+    if (flags & HC_F_TOS)
+    {
+        HC_NEED(1);
+        put_tos(hdr, ip_len, *c++);
+    }
+    if (f->rtp)
+    {
+        if (flags & HC_F_TS)
+        {
+            HC_NEED(6);
+            ts = get32(c);
+            stride = get16(c + 4);
+            c += 6;
+        }
+        else
+        {
+            ts = hc_predict_ts(f, sn);
+        }
+        put16(u + RTP_SN, sn);
+        put32(u + RTP_TS, ts);
+        u[RTP_M_PT] = (u[RTP_M_PT] & 0x7f) | ((flags & HC_F_MARKER) ? 0x80 : 0);
+    }
+    if (flags & HC_F_CSUM)
+    {
+        HC_NEED(2);
+        memcpy(u + UDP_CSUM, c, 2);
+        c += 2;
+    }
+    else
+    {
+        put16(u + UDP_CSUM, 0);
+    }
+
+#undef HC_NEED
+
+    plen = end - c;
+    put16(u + UDP_LEN, hdr_len - ip_len + plen);
+    if (ip_len == 20)
+    {
+        put16(hdr + V4_LEN, hdr_len + plen);
+        put16(hdr + V4_CSUM, ipv4_checksum(hdr));
+    }
+    else
+    {
+        put16(hdr + V6_LEN, hdr_len - ip_len + plen);
+    }
+
+    if (crc8(hdr, hdr_len) != p[3])
+    {
+        dmsg(D_COMP_ERRORS, "Header compression: CRC mismatch in context %d", p[1]);
+        hc_fail(hc, f, buf);
+        return;
+    }
+
+    /* the header is right, so is what we learned from it */
+    memcpy(f->hdr, hdr, hdr_len);
+    f->sn = sn;
+    if (flags & (HC_F_IPID|HC_F_IPID16))
+    {
+        f->ipid_zero = ipid == 0;
+        f->ipid_off = ipid - sn;
+    }
+    if (flags & HC_F_TS)
+    {
+        f->ts_ref = ts;
+        f->ts_sn = sn;
+        f->ts_stride = stride;
+    }
+
+    ASSERT(buf_init(&hc->work, FRAME_HEADROOM(frame)));
+    if (!buf_write(&hc->work, hdr, hdr_len) || !buf_write(&hc->work, c, plen))
+    {
+        dmsg(D_COMP_ERRORS, "Header compression: buffer overflow");
+        buf->len = 0;
+        return;
+    }
+    *buf = hc->work;
+    return;
+
+error:
+    dmsg(D_COMP_ERRORS, "Header compression: short packet in context %d", p[1]);
+    hc_fail(hc, f, buf);
+}
+
+bool
+hc_resync_request(struct hc_context *hc, struct buffer *out)
+{
+    int i;
+
+    for (i = 0; hc->n_resync && i < hc->n; ++i)
+    {
+        struct hc_flow *f = &hc->rx[i];
+        if (f->resync)
+        {
+            f->resync = false;
+            f->resync_requested = now;
+            hc->n_resync--;
+            buf_printf(out, "HC_RESYNC,%d", i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+hc_resync(struct hc_context *hc, const struct buffer *msg)
+{
+    int cid;
+
+    if (sscanf(BSTR(msg), "HC_RESYNC,%d", &cid) == 1 && cid >= 0 && cid < hc->n)
+    {
+        dmsg(D_COMP, "Header compression: resync of context %d", cid);
+        hc->tx[cid].ir_left = HC_REPEAT;
+    }
+}
+
+void
+hc_print_stats(const struct hc_context *hc, struct status_output *so)
+{
+    status_printf(so, "Header compression pre bytes," counter_format, hc->pre_compress);
+    status_printf(so, "Header compression post bytes," counter_format, hc->post_compress);
+    status_printf(so, "Header compression full headers," counter_format, hc->n_ir);
+    status_printf(so, "Header compression compressed headers," counter_format, hc->n_co);
+    status_printf(so, "Header compression failures," counter_format, hc->n_failed);
+}
@@ -0,0 +1,172 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Header compression for the tunneled IP packets (--header-compress).
+ *
+ * Small UDP packets, like voice (RTP) or sensor data, carry an inner
+ * IPv4/IPv6 and UDP header, and often an RTP header, that can be larger
+ * than their payload.  Most of these header fields never change within a
+ * flow, and the others change in a predictable way.  In the spirit of
+ * ROHC (RFC 3095), both peers keep a context for every flow: the sender
+ * sends the complete packet once (\c HC_IR), and from then on only what
+ * cannot be predicted from the context (\c HC_CO).  A compressed IPv4,
+ * UDP and RTP header usually shrinks from 40 to 5 bytes.
+ *
+ * Packets may be lost, so sequence numbers are sent as their low 8 bits
+ * and a changed field is repeated in the next few packets.  A CRC of the
+ * original header lets the receiver detect a context that is out of
+ * sync.  It then asks for the full header over the control channel
+ * (HC_RESYNC), without TLS it has to wait for the periodic refresh.
+ *
+ * The header compression stage sits before compression on the way out
+ * and after decompression on the way in.
+ */
+
+#ifndef HDRCOMP_H
+#define HDRCOMP_H
+
+#include "buffer.h"
+#include "common.h"
+#include "mtu.h"
+#include "status.h"
+
+#define HC_CONTEXTS_DEFAULT 16  /**< Flows per peer and direction. */
+#define HC_CONTEXTS_MAX     256
+
+/* first byte of a packet from the header compressor, an IP packet starts
+ * with 0x4X or 0x6X */
+#define HC_IR               0xC1 /**< Context id and the full packet. */
+#define HC_CO               0xC2 /**< Context id, flags, CRC, sequence
+                                  *   number, changed fields, payload. */
+
+/* flags of an HC_CO packet, telling which fields follow */
+#define HC_F_SN16           (1<<0) /**< 16 bit instead of 8 bit sequence number */
+#define HC_F_IPID           (1<<1) /**< low 8 bits of the IPv4 id */
+#define HC_F_TTL            (1<<2) /**< TTL or hop limit */
+#define HC_F_TOS            (1<<3) /**< TOS or traffic class */
+#define HC_F_TS             (1<<4) /**< RTP timestamp and its stride */
+#define HC_F_MARKER         (1<<5) /**< RTP marker bit, no field */
+#define HC_F_CSUM           (1<<6) /**< UDP checksum */
+#define HC_F_IPID16         (1<<7) /**< IPv4 id, all 16 bits */
+
+#define HC_IR_LEN           2
+#define HC_MAX_HDR          (40 + 8 + 12)  /**< IPv6, UDP and RTP */
+
+#define HC_REPEAT           3    /**< How often a change is sent. */
+#define HC_REFRESH          1000 /**< Packets between full headers. */
+#define HC_RESYNC_INTERVAL  1    /**< Seconds between HC_RESYNC requests
+                                  *   for the same flow. */
+
+/**
+ * The state of one flow, on either side.
+ */
+struct hc_flow
+{
+    bool valid;
+    bool rtp;
+    int ip_len;                 /**< IP header length, 20 or 40. */
+    int hdr_len;                /**< IP, UDP and RTP header length. */
+    uint8_t hdr[HC_MAX_HDR];    /**< Last header of the flow. */
+
+    uint16_t sn;                /**< RTP sequence number, or a counter of
+                                 *   our own for other flows. */
+    bool ipid_zero;             /**< IPv4 id is always 0, */
+    uint16_t ipid_off;          /**< or else id - sn. */
+    uint32_t ts_ref;            /**< RTP timestamp at sequence number */
+    uint16_t ts_sn;             /**< ts_sn, and how much it grows per */
+    uint16_t ts_stride;         /**< sequence number. */
+
+    /* compressor */
+    int ir_left;                /**< Full headers still to send. */
+    int refresh;                /**< Packets until the next full header. */
+    int ipid_left;              /**< Times a change is still repeated. */
+    int ttl_left;
+    int tos_left;
+    int ts_left;
+    bool ts_miss;               /**< Last timestamp was not predicted. */
+    unsigned int used;          /**< For replacing the oldest flow. */
+
+    /* decompressor */
+    bool resync;                /**< Ask the peer for a full header. */
+    time_t resync_requested;
+};
+
+/**
+ * Header compression state of one peer.
+ */
+struct hc_context
+{
+    int n;                      /**< Number of contexts. */
+    struct hc_flow *tx;
+    struct hc_flow *rx;
+    unsigned int clock;
+    struct buffer work;
+    int n_resync;               /**< Flows with a resync request pending. */
+
+    /* statistics */
+    counter_type pre_compress;
+    counter_type post_compress;
+    counter_type n_ir;
+    counter_type n_co;
+    counter_type n_failed;      /**< Packets dropped for lack of a context. */
+};
+
+/**
+ * Allocate the state for \c n flows in each direction.
+ */
+struct hc_context *hc_init(int n, const struct frame *frame);
+
+void hc_free(struct hc_context *hc);
+
+/**
+ * Compress the headers of an outgoing IP packet, if it is UDP.
+ */
+void hc_compress(struct hc_context *hc, struct buffer *buf,
+                 const struct frame *frame);
+
+/**
+ * Restore the headers of an incoming packet.  Packets that cannot be
+ * restored are dropped, and a resync of their flow is requested.
+ */
+void hc_decompress(struct hc_context *hc, struct buffer *buf,
+                   const struct frame *frame);
+
+/**
+ * Write the next resync request, "HC_RESYNC,<id>", for the control
+ * channel.
+ *
+ * @return false if no request is pending.
+ */
+bool hc_resync_request(struct hc_context *hc, struct buffer *out);
+
+/**
+ * Handle a resync request of the peer, the next packets of the flow are
+ * sent with full headers.
+ */
+void hc_resync(struct hc_context *hc, const struct buffer *msg);
+
+void hc_print_stats(const struct hc_context *hc, struct status_output *so);
+
+#endif /* HDRCOMP_H */
@@ -535,7 +535,7 @@ helper_keepalive(struct options *o)
         /*
          * Expand.
          */
-        if (o->mode == MODE_POINT_TO_POINT)
+        if (o->mode == MODE_POINT_TO_POINT || o->mode == MODE_LOADGEN)
         {
             o->ping_rec_timeout_action = PING_RESTART;
             o->ping_send_timeout = o->keepalive_ping;
@@ -65,6 +65,7 @@ static struct context *static_context; /* GLOBAL */
 #define CF_INIT_TLS_AUTH_STANDALONE (1<<2)
 
 static void do_init_first_time(struct context *c);
+static void do_init_hdrcomp(struct context *c);
 
 void
 context_clear(struct context *c)
@@ -2201,6 +2202,11 @@ do_deferred_options(struct context *c, const unsigned int found)
     }
 #endif
 
+    if (found & OPT_P_COMP)
+    {
+        do_init_hdrcomp(c);
+    }
+
     if (found & OPT_P_SHAPER)
     {
         msg(D_PUSH, "OPTIONS IMPORT: traffic shaper enabled");
@@ -2492,6 +2498,7 @@ do_init_crypto_static(struct context *c, const unsigned int flags)
     {
         packet_id_init(&c->c2.crypto_options.packet_id,
                        options->replay_window,
+                       options->replay_window_max,
                        options->replay_time,
                        "STATIC", 0);
         c->c2.crypto_options.pid_persist = &c->c1.pid_persist;
@@ -2704,6 +2711,7 @@ do_init_crypto_tls(struct context *c, const unsigned int flags)
     to.key_method = options->key_method;
     to.replay = options->replay;
     to.replay_window = options->replay_window;
+    to.replay_window_max = options->replay_window_max;
     to.replay_time = options->replay_time;
     to.tcp_mode = link_socket_proto_connection_oriented(options->ce.proto);
     to.config_ciphername = c->c1.ciphername;
@@ -3293,6 +3301,16 @@ do_init_socket_2(struct context *c)
 {
     link_socket_init_phase2(c->c2.link_socket, &c->c2.frame,
                             c->sig);
+
+    if (c->options.busy_poll)
+    {
+        link_socket_set_busy_poll(c->c2.link_socket, c->options.busy_poll);
+    }
+
+    if (c->options.tcp_coalesce)
+    {
+        link_socket_set_tcp_coalesce(c->c2.link_socket, c->options.tcp_coalesce);
+    }
 }
 
 /*
@@ -3529,6 +3547,42 @@ do_close_fragment(struct context *c)
 }
 #endif
 
+/*
+ * (Re)start header compression, on tun devices only.
+ */
+static void
+do_init_hdrcomp(struct context *c)
+{
+    hc_free(c->c2.hc);
+    c->c2.hc = NULL;
+
+    if (c->options.hc_contexts
+        && dev_type_enum(c->options.dev, c->options.dev_type) == DEV_TYPE_TUN)
+    {
+        c->c2.hc = hc_init(c->options.hc_contexts, &c->c2.frame);
+    }
+}
+
+static void
+do_close_hdrcomp(struct context *c)
+{
+    hc_free(c->c2.hc);
+    c->c2.hc = NULL;
+}
+
+/*
+ * Close forward error correction.
+ */
+static void
+do_close_fec(struct context *c)
+{
+    if (c->c2.fec)
+    {
+        fec_free(c->c2.fec);
+        c->c2.fec = NULL;
+    }
+}
+
 /*
  * Open and close our event objects.
  */
@@ -4123,6 +4177,21 @@ init_instance(struct context *c, const struct env_set *env, const unsigned int f
     }
 #endif
 
+    /* initialize forward error correction */
+    if (options->fec_k && c->mode == CM_P2P)
+    {
+        c->c2.fec = fec_init(&c->c2.frame, options->fec_k, options->fec_m);
+    }
+
+#if ENABLE_IP_PKTINFO
+    /* resolve the additional paths */
+    if (options->mpath && c->mode == CM_P2P)
+    {
+        c->c2.mpath = mpath_new(options->mpath, &c->c1.link_socket_addr.actual,
+                                options->ce.remote_port);
+    }
+#endif
+
     /* init crypto layer */
     {
         unsigned int crypto_flags = 0;
@@ -4146,6 +4215,12 @@ init_instance(struct context *c, const struct env_set *env, const unsigned int f
     }
 
 #ifdef USE_COMP
+    /* load compression dictionaries before we drop privileges */
+    if (!child)
+    {
+        comp_init_global(&options->comp);
+    }
+
     /* initialize compression library. */
     if (comp_enabled(&options->comp) && (c->mode == CM_P2P || child))
     {
@@ -4159,6 +4234,13 @@ init_instance(struct context *c, const struct env_set *env, const unsigned int f
     /* initialize TLS MTU variables */
     do_init_frame_tls(c);
 
+    /* stay on some CPUs?  Done before the buffers are allocated, so
+     * that they end up on the NUMA node of these CPUs */
+    if (c->first_time && (c->mode == CM_P2P || c->mode == CM_TOP))
+    {
+        platform_cpu_affinity(options->cpu_affinity);
+    }
+
     /* init workspace buffers whose size is derived from frame size */
     if (c->mode == CM_P2P || c->mode == CM_CHILD_TCP)
     {
@@ -4173,6 +4255,25 @@ init_instance(struct context *c, const struct env_set *env, const unsigned int f
     }
 #endif
 
+    if (c->c2.fec)
+    {
+        fec_frame_init(c->c2.fec, &c->c2.frame);
+    }
+
+    /* initialize header compression, a pushed --header-compress
+     * restarts it in do_deferred_options */
+    if (c->mode == CM_P2P || child)
+    {
+        do_init_hdrcomp(c);
+    }
+
+    /* UDP packets wait here for their --pacing departure time if the
+     * kernel cannot pace them (servers share one, see multi_init) */
+    if (options->pacing && c->mode == CM_P2P && proto_is_dgram(options->ce.proto))
+    {
+        c->c2.pacing_calendar = pacing_calendar_new(BUF_SIZE(&c->c2.frame));
+    }
+
     /* initialize dynamic MTU variable */
     frame_init_mssfix(&c->c2.frame, &c->options);
 
@@ -4312,7 +4413,8 @@ close_instance(struct context *c)
         do_close_tls(c);
 
         /* free key schedules */
-        do_close_free_key_schedule(c, (c->mode == CM_P2P || c->mode == CM_TOP));
+        do_close_free_key_schedule(c, (c->mode == CM_P2P || c->mode == CM_TOP)
+                                   && !c->ssl_ctx_shared);
 
         restore_ncp_options(c);
 
@@ -4349,6 +4451,28 @@ close_instance(struct context *c)
         do_close_fragment(c);
 #endif
 
+        /* close forward error correction */
+        do_close_fec(c);
+
+        /* close header compression */
+        do_close_hdrcomp(c);
+
+        /* free the --pacing calendar, unless it is the server's */
+        if (c->c2.pacing_calendar && c->mode == CM_P2P)
+        {
+            pacing_calendar_free(c->c2.pacing_calendar);
+        }
+        c->c2.pacing_calendar = NULL;
+
+#if ENABLE_IP_PKTINFO
+        /* close multipath state */
+        if (c->c2.mpath)
+        {
+            mpath_free(c->c2.mpath);
+            c->c2.mpath = NULL;
+        }
+#endif
+
         /* close --ifconfig-pool-persist obj */
         do_close_ifconfig_pool_persist(c);
 
@@ -4487,6 +4611,64 @@ inherit_context_top(struct context *dest,
 #endif
 }
 
+#if P2MP_SERVER
+/*
+ * Set up a simulated client of --mode loadgen.  It is a CM_P2P
+ * context with signal state, options and --remote list of its own,
+ * which tunnel_loadgen() initializes and restarts itself.
+ */
+void
+inherit_context_loadgen(struct context *dest,
+                        const struct context *src)
+{
+    struct options *o = &dest->options;
+    struct connection_list *l;
+
+    CLEAR(*dest);
+    dest->mode = CM_P2P;
+    dest->ssl_ctx_shared = true;
+
+    /* the load generator paces reconnections, not socket_restart_pause() */
+    dest->first_time = true;
+
+    dest->gc = gc_new();
+    ALLOC_OBJ_CLEAR_GC(dest->sig, struct signal_info, &dest->gc);
+
+    /* c1 init */
+    packet_id_persist_init(&dest->c1.pid_persist);
+
+    /* options */
+    *o = src->options;
+    options_detach(o);
+    o->mode = MODE_POINT_TO_POINT;
+
+    ALLOC_OBJ_GC(l, struct connection_list, &o->gc);
+    *l = *src->options.connection_list;
+    o->connection_list = l;
+
+    /* the clients have no tun/tap device, but present themselves to
+     * the server like a client with the configured one */
+    o->loadgen_dev_type = dev_type_string(o->dev, o->dev_type);
+    o->dev = "null";
+    o->dev_type = NULL;
+    o->dev_node = NULL;
+    o->persist_tun = false;
+
+    /* process-wide settings are done once by the load generator */
+    o->ifconfig_noexec = true;
+    o->route_noexec = true;
+    o->status_file = NULL;
+    o->cpu_affinity = NULL;
+    o->mlock = false;
+    o->username = NULL;
+    o->groupname = NULL;
+    o->chroot_dir = NULL;
+
+    init_connection_list(dest);
+    save_ncp_options(dest);
+}
+#endif /* P2MP_SERVER */
+
 void
 close_context(struct context *c, int sig, unsigned int flags)
 {
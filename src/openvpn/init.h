@@ -30,7 +30,7 @@
  * Baseline maximum number of events
  * to wait for.
  */
-#define BASE_N_EVENTS 4
+#define BASE_N_EVENTS 5
 
 void context_clear(struct context *c);
 
@@ -102,6 +102,9 @@ void inherit_context_child(struct context *dest,
 void inherit_context_top(struct context *dest,
                          const struct context *src);
 
+void inherit_context_loadgen(struct context *dest,
+                             const struct context *src);
+
 #define CC_GC_FREE          (1<<0)
 #define CC_USR1_TO_HUP      (1<<1)
 #define CC_HARD_USR1_TO_HUP (1<<2)
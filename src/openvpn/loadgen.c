@@ -0,0 +1,842 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if P2MP_SERVER
+
+#include "forward.h"
+#include "init.h"
+#include "schedule.h"
+#include "loadgen.h"
+
+#include "memdbg.h"
+
+#define LOADGEN_REPORT_INTERVAL 10  /* seconds between progress reports */
+#define LOADGEN_DRAIN_TIME      1   /* seconds to wait for the last replies */
+#define LOADGEN_MAX_STARTS      16  /* clients started per event loop pass */
+#define LOADGEN_MAX_BURST       8   /* UDP packets sent per client wakeup */
+
+/*
+ * The ICMP echo header, followed by the time the request was sent,
+ * from which the round trip time of the reply is computed.
+ */
+struct loadgen_echo {
+#define LOADGEN_ICMP_ECHO_REPLY   0
+#define LOADGEN_ICMP_ECHO_REQUEST 8
+    uint8_t type;
+    uint8_t code;
+    uint16_t check;
+    uint16_t id;
+    uint16_t seq;
+    uint32_t sec;
+    uint32_t usec;
+};
+
+struct loadgen_client
+{
+    struct schedule_entry se;   /* this must be the first element of the structure */
+    struct context context;
+    int index;
+    char msg_prefix[16];
+
+    bool active;                /* context is initialized */
+    bool connected;             /* tunnel is up */
+    bool stopped;               /* exited, will not be restarted */
+    unsigned int rwflags;       /* events its socket is registered for */
+    unsigned int pass;          /* event loop pass it was last serviced in */
+    int failures;               /* consecutive attempts which did not connect */
+
+    struct timeval connect_start;
+    struct timeval next_packet;
+    in_addr_t target;           /* host order */
+    uint16_t seq;
+};
+
+struct loadgen_counters
+{
+    counter_type handshakes;
+    counter_type failures;
+    counter_type disconnects;
+    counter_type tx_packets;
+    counter_type tx_bytes;
+    counter_type rx_packets;
+    counter_type rx_bytes;
+    counter_type rtt_sum;       /* microseconds */
+    unsigned int rtt_max;
+};
+
+struct loadgen
+{
+    struct context *top;
+    struct loadgen_client *clients;
+    int n_clients;
+    int n_started;
+    int n_connected;
+    unsigned int pass;
+
+    struct schedule *schedule;
+    struct event_set *es;
+    struct event_set_return *esr;
+    int maxevents;
+
+    /* SSL context and key types, shared by all clients */
+    struct key_schedule ks;
+
+    /* --loadgen-traffic */
+    unsigned int packet_interval; /* microseconds */
+    int packet_size;
+    in_addr_t target;           /* host order, 0 = the server */
+
+    struct timeval now;
+    struct timeval start;
+    struct timeval next_start;
+    struct timeval next_report;
+    struct timeval end;         /* undefined = run until signalled */
+    bool draining;
+
+    struct loadgen_counters total;
+    struct loadgen_counters last; /* at the previous report */
+    struct timeval last_report;
+
+    /* connect latencies in microseconds */
+    unsigned int *latency;
+    int n_latency;
+    int latency_capacity;
+};
+
+static void
+loadgen_tv_add_usec(struct timeval *tv, unsigned int usec)
+{
+    tv->tv_sec += usec / 1000000;
+    tv->tv_usec += usec % 1000000;
+    if (tv->tv_usec >= 1000000)
+    {
+        tv->tv_usec -= 1000000;
+        tv->tv_sec += 1;
+    }
+}
+
+/*
+ * Update lg->now and the coarse time.  update_time() must not run
+ * first, it would advance now without now_usec, and
+ * openvpn_gettimeofday() would then keep returning the old
+ * microseconds until they are passed again.
+ */
+static void
+loadgen_update_time(struct loadgen *lg)
+{
+    openvpn_gettimeofday(&lg->now, NULL);
+#ifndef TIME_BACKTRACK_PROTECTION
+    update_time();
+#endif
+}
+
+static int64_t
+loadgen_usec_since(const struct timeval *then, const struct timeval *now)
+{
+    struct timeval d;
+    tv_delta(&d, then, now);
+    return (int64_t) d.tv_sec * 1000000 + d.tv_usec;
+}
+
+static uint16_t
+loadgen_checksum(const uint8_t *p, int len)
+{
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i + 1 < len; i += 2)
+    {
+        sum += (p[i] << 8) | p[i + 1];
+    }
+    if (len & 1)
+    {
+        sum += p[len - 1] << 8;
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return htons(~sum);
+}
+
+static inline void
+loadgen_set_prefix(struct loadgen_client *cl)
+{
+    msg_set_prefix(cl->msg_prefix);
+}
+
+/*
+ * Which address the echo requests of a client go to: --loadgen-traffic's
+ * ip, the pushed route-gateway, or the server's address on a subnet
+ * topology tunnel, else the remote end of the point-to-point tunnel.
+ */
+static in_addr_t
+loadgen_client_target(const struct loadgen *lg, const struct context *c)
+{
+    const struct tuntap *tt = c->c1.tuntap;
+
+    if (lg->target)
+    {
+        return lg->target;
+    }
+    if (c->options.route_default_gateway)
+    {
+        bool succeeded = false;
+        const in_addr_t gw = getaddr(GETADDR_HOST_ORDER, c->options.route_default_gateway,
+                                     0, &succeeded, NULL);
+        if (succeeded)
+        {
+            return gw;
+        }
+    }
+    if (tt->topology == TOP_SUBNET)
+    {
+        return (tt->local & tt->remote_netmask) + 1;
+    }
+    return tt->remote_netmask;
+}
+
+/*
+ * Put an ICMP echo request from the client's tunnel address into
+ * c2.buf and hand it to process_incoming_tun(), as if it was read
+ * from the tun device.
+ */
+static void
+loadgen_send_echo(struct loadgen *lg, struct loadgen_client *cl)
+{
+    struct context *c = &cl->context;
+    struct buffer *buf = &c->c2.buf;
+    const int size = min_int(lg->packet_size, TUN_MTU_SIZE(&c->c2.frame));
+    struct openvpn_iphdr *ip;
+    struct loadgen_echo *echo;
+    uint8_t *p;
+
+    *buf = c->c2.buffers->read_tun_buf;
+    ASSERT(buf_init(buf, FRAME_HEADROOM(&c->c2.frame)));
+    ASSERT(buf_safe(buf, size));
+    p = BPTR(buf);
+    memset(p, 0x5a, size);
+
+    ip = (struct openvpn_iphdr *) p;
+    CLEAR(*ip);
+    ip->version_len = 0x45;
+    ip->tot_len = htons(size);
+    ip->id = htons(cl->seq);
+    ip->ttl = 64;
+    ip->protocol = OPENVPN_IPPROTO_ICMP;
+    ip->saddr = htonl(c->c1.tuntap->local);
+    ip->daddr = htonl(cl->target);
+    ip->check = loadgen_checksum(p, sizeof(*ip));
+
+    echo = (struct loadgen_echo *) (p + sizeof(*ip));
+    echo->type = LOADGEN_ICMP_ECHO_REQUEST;
+    echo->code = 0;
+    echo->check = 0;
+    echo->id = htons(cl->index & 0xffff);
+    echo->seq = htons(cl->seq++);
+    echo->sec = htonl(lg->now.tv_sec);
+    echo->usec = htonl(lg->now.tv_usec);
+    echo->check = loadgen_checksum((uint8_t *) echo, size - sizeof(*ip));
+
+    ASSERT(buf_inc_len(buf, size));
+    process_incoming_tun(c);
+
+    ++lg->total.tx_packets;
+    lg->total.tx_bytes += size;
+}
+
+/*
+ * Account for a packet read from the link if it is the reply to one of
+ * our echo requests.  process_incoming_link() does not keep it in
+ * c2.to_tun for the null device, but it is left decrypted in c2.buf.
+ */
+static void
+loadgen_receive(struct loadgen *lg, struct loadgen_client *cl)
+{
+    struct context *c = &cl->context;
+    struct buffer *buf = &c->c2.buf;
+
+    if (!(c->c2.event_set_status & SOCKET_READ))
+    {
+        return;
+    }
+
+    if (BLEN(buf) >= (int) (sizeof(struct openvpn_iphdr) + sizeof(struct loadgen_echo)))
+    {
+        const struct openvpn_iphdr *ip = (const struct openvpn_iphdr *) BPTR(buf);
+        const int hlen = OPENVPN_IPH_GET_LEN(ip->version_len);
+        const struct loadgen_echo *echo = (const struct loadgen_echo *) (BPTR(buf) + hlen);
+
+        if (OPENVPN_IPH_GET_VER(ip->version_len) == 4
+            && ip->protocol == OPENVPN_IPPROTO_ICMP
+            && BLEN(buf) >= hlen + (int) sizeof(struct loadgen_echo)
+            && echo->type == LOADGEN_ICMP_ECHO_REPLY
+            && ntohs(echo->id) == (cl->index & 0xffff))
+        {
+            struct timeval sent;
+            unsigned int rtt;
+
+            sent.tv_sec = ntohl(echo->sec);
+            sent.tv_usec = ntohl(echo->usec);
+            rtt = (unsigned int) loadgen_usec_since(&sent, &lg->now);
+
+            ++lg->total.rx_packets;
+            lg->total.rx_bytes += BLEN(buf);
+            lg->total.rtt_sum += rtt;
+            if (rtt > lg->total.rtt_max)
+            {
+                lg->total.rtt_max = rtt;
+            }
+        }
+    }
+    buf->len = 0;
+}
+
+static void
+loadgen_record_latency(struct loadgen *lg, unsigned int usec)
+{
+    if (lg->n_latency == lg->latency_capacity)
+    {
+        lg->latency_capacity = lg->latency_capacity ? lg->latency_capacity * 2 : 1024;
+        lg->latency = realloc(lg->latency, lg->latency_capacity * sizeof(*lg->latency));
+        check_malloc_return(lg->latency);
+    }
+    lg->latency[lg->n_latency++] = usec;
+}
+
+static void
+loadgen_connected(struct loadgen *lg, struct loadgen_client *cl)
+{
+    struct context *c = &cl->context;
+
+    cl->connected = true;
+    cl->failures = 0;
+    ++lg->n_connected;
+    ++lg->total.handshakes;
+    loadgen_record_latency(lg, (unsigned int) loadgen_usec_since(&cl->connect_start, &lg->now));
+
+    cl->target = 0;
+    if (lg->packet_interval)
+    {
+        if (c->c1.tuntap && c->c1.tuntap->local)
+        {
+            cl->target = loadgen_client_target(lg, c);
+        }
+        else
+        {
+            msg(M_WARN, "LOADGEN: no IPv4 tunnel address was pushed, not sending traffic");
+        }
+
+        /* spread the clients' packets over the interval */
+        cl->next_packet = lg->now;
+        loadgen_tv_add_usec(&cl->next_packet, get_random() % lg->packet_interval);
+    }
+}
+
+static void
+loadgen_schedule(struct loadgen *lg, struct loadgen_client *cl, const struct timeval *wakeup)
+{
+    schedule_add_entry(lg->schedule, &cl->se, wakeup, 0);
+}
+
+/*
+ * Close a client after it has got a signal, and reconnect it after
+ * --connect-retry seconds, doubling the time after each failed attempt
+ * up to the --connect-retry maximum.
+ */
+static void
+loadgen_client_close(struct loadgen *lg, struct loadgen_client *cl)
+{
+    struct context *c = &cl->context;
+    const int sig = c->sig->signal_received;
+    const char *text = c->sig->signal_text ? c->sig->signal_text : "";
+
+    if (cl->active)
+    {
+        if (cl->rwflags)
+        {
+            event_del(lg->es, socket_event_handle(c->c2.link_socket));
+            cl->rwflags = 0;
+        }
+        close_instance(c);
+        cl->active = false;
+    }
+
+    if (cl->connected)
+    {
+        cl->connected = false;
+        --lg->n_connected;
+        ++lg->total.disconnects;
+    }
+    else
+    {
+        ++cl->failures;
+        ++lg->total.failures;
+    }
+
+    if (sig == SIGUSR1 || sig == SIGHUP)
+    {
+        const struct connection_entry *ce = &c->options.ce;
+        unsigned int sec = ce->connect_retry_seconds;
+        struct timeval wakeup = lg->now;
+
+        if (cl->failures > 1)
+        {
+            sec = min_int(sec << min_int(cl->failures - 1, 15), ce->connect_retry_seconds_max);
+        }
+        msg(M_INFO, "LOADGEN: client %s (%s), reconnecting in %u seconds",
+            signal_name(sig, true), text, sec);
+        loadgen_tv_add_usec(&wakeup, sec * 1000000 + get_random() % 1000000);
+        loadgen_schedule(lg, cl, &wakeup);
+    }
+    else
+    {
+        msg(M_INFO, "LOADGEN: client %s (%s), not restarted", signal_name(sig, true), text);
+        cl->stopped = true;
+        schedule_remove_entry(lg->schedule, &cl->se);
+    }
+}
+
+/*
+ * The part of tunnel_point_to_point()'s loop which follows the I/O:
+ * run the timers and TLS, inject traffic, send what is to be sent,
+ * and register for the next wakeup.
+ */
+static void
+loadgen_client_post(struct loadgen *lg, struct loadgen_client *cl)
+{
+    struct context *c = &cl->context;
+    const bool dgram = proto_is_dgram(c->options.ce.proto);
+    struct timeval wakeup;
+    int i;
+
+    for (i = 0; i < LOADGEN_MAX_BURST; ++i)
+    {
+        pre_select(c);
+        if (IS_SIG(c))
+        {
+            break;
+        }
+
+        if (!cl->connected && c->c2.do_up_ran)
+        {
+            loadgen_connected(lg, cl);
+        }
+
+        if (cl->target && !lg->draining && !LINK_OUT(c)
+            && !tv_gt(&cl->next_packet, &lg->now))
+        {
+            loadgen_send_echo(lg, cl);
+            loadgen_tv_add_usec(&cl->next_packet, lg->packet_interval);
+            if (tv_lt(&cl->next_packet, &lg->now))
+            {
+                /* do not try to catch up after a stall */
+                cl->next_packet = lg->now;
+            }
+        }
+
+        /* UDP sockets are always writable, like with --fast-io */
+        if (!dgram || !LINK_OUT(c))
+        {
+            break;
+        }
+        process_outgoing_link(c);
+        if (IS_SIG(c))
+        {
+            break;
+        }
+    }
+
+    if (IS_SIG(c))
+    {
+        loadgen_client_close(lg, cl);
+        return;
+    }
+
+    socket_set(c->c2.link_socket, lg->es, EVENT_READ | (LINK_OUT(c) ? EVENT_WRITE : 0),
+               cl, &cl->rwflags);
+
+    wakeup = lg->now;
+    tv_add(&wakeup, &c->c2.timeval);
+    if (cl->target && !lg->draining && tv_lt(&cl->next_packet, &wakeup))
+    {
+        wakeup = cl->next_packet;
+    }
+    loadgen_schedule(lg, cl, &wakeup);
+}
+
+static void
+loadgen_client_start(struct loadgen *lg, struct loadgen_client *cl)
+{
+    struct context *c = &cl->context;
+
+    loadgen_set_prefix(cl);
+
+    /* key_schedule_free() clears these on every close */
+    c->c1.ks.ssl_ctx = lg->ks.ssl_ctx;
+    c->c1.ks.key_type = lg->ks.key_type;
+
+    context_clear_2(c);
+    cl->connect_start = lg->now;
+    init_instance(c, lg->top->es, 0);
+    loadgen_update_time(lg);
+
+    if (IS_SIG(c))
+    {
+        /* init_instance() has closed the context */
+        loadgen_client_close(lg, cl);
+    }
+    else
+    {
+        /* all clients share the event set of the load generator */
+        event_free(c->c2.event_set);
+        c->c2.event_set = NULL;
+        c->c2.event_set_owned = false;
+
+        cl->active = true;
+        cl->pass = lg->pass;
+        loadgen_client_post(lg, cl);
+    }
+    msg_set_prefix(NULL);
+}
+
+static void
+loadgen_client_io(struct loadgen *lg, struct loadgen_client *cl, unsigned int rwflags)
+{
+    struct context *c = &cl->context;
+
+    if (!cl->active)
+    {
+        return;
+    }
+    loadgen_set_prefix(cl);
+
+    c->c2.event_set_status = ((rwflags & EVENT_READ) ? SOCKET_READ : 0)
+                             | ((rwflags & EVENT_WRITE) ? SOCKET_WRITE : 0);
+    process_io(c);
+    loadgen_receive(lg, cl);
+
+    /* a TCP read may have brought in more than one packet, which
+     * stream_buf_read_setup() finds complete in the residual data */
+    while (!IS_SIG(c) && !stream_buf_read_setup(c->c2.link_socket))
+    {
+        c->c2.event_set_status = SOCKET_READ;
+        process_io(c);
+        loadgen_receive(lg, cl);
+    }
+
+    if (IS_SIG(c))
+    {
+        loadgen_client_close(lg, cl);
+    }
+    else
+    {
+        cl->pass = lg->pass;
+        loadgen_client_post(lg, cl);
+    }
+    msg_set_prefix(NULL);
+}
+
+static int
+loadgen_cmp_uint(const void *a, const void *b)
+{
+    const unsigned int x = *(const unsigned int *) a;
+    const unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+static void
+loadgen_report(struct loadgen *lg, bool final)
+{
+    const struct loadgen_counters *t = &lg->total;
+    const struct loadgen_counters *l = final ? NULL : &lg->last;
+    const struct timeval *since = final ? &lg->start : &lg->last_report;
+    const int64_t usec = loadgen_usec_since(since, &lg->now);
+    const double secs = (usec > 0 ? usec : 1) / 1e6;
+    const counter_type tx = t->tx_packets - (l ? l->tx_packets : 0);
+    const counter_type rx = t->rx_packets - (l ? l->rx_packets : 0);
+
+    msg(M_INFO, "LOADGEN%s: %d/%d connected, %.1f handshakes/s, "
+        counter_format " failed, " counter_format " disconnected, "
+        "tx %.0f pps %.2f Mbps, rx %.0f pps %.2f Mbps, loss %.2f%%",
+        final ? " RESULT" : "", lg->n_connected, lg->n_clients,
+        (t->handshakes - (l ? l->handshakes : 0)) / secs,
+        t->failures, t->disconnects,
+        tx / secs, (t->tx_bytes - (l ? l->tx_bytes : 0)) * 8 / secs / 1e6,
+        rx / secs, (t->rx_bytes - (l ? l->rx_bytes : 0)) * 8 / secs / 1e6,
+        tx ? 100.0 * ((double) tx - (double) rx) / tx : 0.0);
+
+    if (lg->n_latency)
+    {
+        unsigned long long sum = 0;
+        int i;
+
+        qsort(lg->latency, lg->n_latency, sizeof(*lg->latency), loadgen_cmp_uint);
+        for (i = 0; i < lg->n_latency; ++i)
+        {
+            sum += lg->latency[i];
+        }
+        msg(M_INFO, "LOADGEN%s: connect ms min/avg/p50/p99/max %.1f/%.1f/%.1f/%.1f/%.1f",
+            final ? " RESULT" : "",
+            lg->latency[0] / 1e3, (double) sum / lg->n_latency / 1e3,
+            lg->latency[lg->n_latency / 2] / 1e3,
+            lg->latency[(int) ((lg->n_latency - 1) * 0.99)] / 1e3,
+            lg->latency[lg->n_latency - 1] / 1e3);
+    }
+    if (t->rx_packets)
+    {
+        msg(M_INFO, "LOADGEN%s: echo rtt ms avg/max %.2f/%.2f",
+            final ? " RESULT" : "",
+            (double) t->rtt_sum / t->rx_packets / 1e3, t->rtt_max / 1e3);
+    }
+
+    lg->last = lg->total;
+    lg->last_report = lg->now;
+}
+
+static void
+loadgen_init(struct loadgen *lg, struct context *top)
+{
+    const struct options *o = &top->options;
+    int i;
+
+    CLEAR(*lg);
+    lg->top = top;
+    lg->n_clients = o->loadgen_clients;
+
+    /* the SSL context is set up once, as do_init_crypto_tls_c1() would */
+    init_ssl(o, &lg->ks.ssl_ctx);
+    if (!tls_ctx_initialised(&lg->ks.ssl_ctx))
+    {
+        msg(M_FATAL, "Error: private key password verification failed");
+    }
+    init_key_type(&lg->ks.key_type, o->ciphername, o->authname, o->keysize, true, true);
+    prng_init(o->prng_hash, o->prng_nonce_secret_len);
+
+    if (o->loadgen_pps)
+    {
+        lg->packet_interval = max_int(1000000 / o->loadgen_pps, 1);
+        lg->packet_size = o->loadgen_size;
+        if (o->loadgen_target)
+        {
+            lg->target = getaddr(GETADDR_HOST_ORDER|GETADDR_RESOLVE|GETADDR_FATAL,
+                                 o->loadgen_target, 0, NULL, NULL);
+        }
+    }
+
+    platform_cpu_affinity(o->cpu_affinity);
+
+    lg->schedule = schedule_init();
+    lg->maxevents = lg->n_clients;
+    lg->es = event_set_init(&lg->maxevents, 0);
+    ALLOC_ARRAY_CLEAR(lg->esr, struct event_set_return, lg->maxevents);
+
+    ALLOC_ARRAY_CLEAR(lg->clients, struct loadgen_client, lg->n_clients);
+    for (i = 0; i < lg->n_clients; ++i)
+    {
+        struct loadgen_client *cl = &lg->clients[i];
+        cl->index = i;
+        openvpn_snprintf(cl->msg_prefix, sizeof(cl->msg_prefix), "client%d", i);
+        inherit_context_loadgen(&cl->context, top);
+    }
+
+    loadgen_update_time(lg);
+    lg->start = lg->now;
+    lg->next_start = lg->now;
+    lg->last_report = lg->now;
+    lg->next_report = lg->now;
+    lg->next_report.tv_sec += LOADGEN_REPORT_INTERVAL;
+    if (o->loadgen_duration)
+    {
+        lg->end = lg->now;
+        lg->end.tv_sec += o->loadgen_duration;
+    }
+
+    msg(M_INFO, "LOADGEN: simulating %d clients, connecting %d per second",
+        lg->n_clients, o->loadgen_rate);
+}
+
+static void
+loadgen_free(struct loadgen *lg)
+{
+    int i;
+
+    for (i = 0; i < lg->n_clients; ++i)
+    {
+        struct loadgen_client *cl = &lg->clients[i];
+        if (cl->active)
+        {
+            loadgen_set_prefix(cl);
+            cl->context.sig->signal_received = SIGTERM;
+            close_instance(&cl->context);
+            msg_set_prefix(NULL);
+        }
+        context_gc_free(&cl->context);
+    }
+    free(lg->clients);
+    free(lg->esr);
+    free(lg->latency);
+    event_free(lg->es);
+    schedule_free(lg->schedule);
+    tls_ctx_free(&lg->ks.ssl_ctx);
+}
+
+/*
+ * Start clients which are due, service the clients whose timers have
+ * expired, and report.  Each client is serviced at most once per pass,
+ * so that one which asks to be woken up immediately does not starve
+ * the others.
+ */
+static void
+loadgen_timers(struct loadgen *lg)
+{
+    const struct options *o = &lg->top->options;
+    struct schedule_entry *e;
+    struct timeval wakeup;
+    int i;
+
+    for (i = 0; i < LOADGEN_MAX_STARTS && lg->n_started < lg->n_clients
+         && !lg->draining && !tv_gt(&lg->next_start, &lg->now); ++i)
+    {
+        loadgen_client_start(lg, &lg->clients[lg->n_started++]);
+        loadgen_tv_add_usec(&lg->next_start, 1000000 / o->loadgen_rate);
+    }
+
+    while ((e = schedule_get_earliest_wakeup(lg->schedule, &wakeup))
+           && !tv_gt(&wakeup, &lg->now))
+    {
+        struct loadgen_client *cl = (struct loadgen_client *) e;
+
+        if (cl->pass == lg->pass)
+        {
+            break;
+        }
+        cl->pass = lg->pass;
+        schedule_remove_entry(lg->schedule, e);
+
+        if (cl->active)
+        {
+            loadgen_set_prefix(cl);
+            loadgen_client_post(lg, cl);
+            msg_set_prefix(NULL);
+        }
+        else if (!cl->stopped && !lg->draining)
+        {
+            loadgen_client_start(lg, cl);
+        }
+    }
+
+    if (!tv_gt(&lg->next_report, &lg->now))
+    {
+        loadgen_report(lg, false);
+        lg->next_report.tv_sec += LOADGEN_REPORT_INTERVAL;
+    }
+
+    if (tv_defined(&lg->end) && !tv_gt(&lg->end, &lg->now))
+    {
+        if (!lg->draining)
+        {
+            /* stop sending, wait for the replies in flight */
+            lg->draining = true;
+            lg->end.tv_sec += LOADGEN_DRAIN_TIME;
+        }
+        else
+        {
+            lg->top->sig->signal_received = SIGTERM;
+            lg->top->sig->signal_text = "loadgen-duration";
+        }
+    }
+}
+
+/* how long to wait for I/O until the next timer is due */
+static void
+loadgen_timeout(struct loadgen *lg, struct timeval *timeout)
+{
+    struct timeval wakeup = lg->next_report;
+    struct timeval e;
+
+    if (schedule_get_earliest_wakeup(lg->schedule, &e) && tv_lt(&e, &wakeup))
+    {
+        wakeup = e;
+    }
+    if (lg->n_started < lg->n_clients && !lg->draining && tv_lt(&lg->next_start, &wakeup))
+    {
+        wakeup = lg->next_start;
+    }
+    if (tv_defined(&lg->end) && tv_lt(&lg->end, &wakeup))
+    {
+        wakeup = lg->end;
+    }
+    tv_delta(timeout, &lg->now, &wakeup);
+}
+
+void
+tunnel_loadgen(struct context *top)
+{
+    struct loadgen lg;
+
+    loadgen_init(&lg, top);
+    post_init_signal_catch();
+
+    while (!IS_SIG(top))
+    {
+        struct timeval timeout;
+        int status;
+
+        loadgen_timeout(&lg, &timeout);
+        status = event_wait(lg.es, &timeout, lg.esr, lg.maxevents);
+        check_status(status, "event_wait", NULL, NULL);
+        loadgen_update_time(&lg);
+        ++lg.pass;
+
+        if (status > 0)
+        {
+            int i;
+            for (i = 0; i < status; ++i)
+            {
+                loadgen_client_io(&lg, lg.esr[i].arg, lg.esr[i].rwflags);
+            }
+        }
+        loadgen_timers(&lg);
+
+        /* SIGUSR2 reports the progress so far */
+        if (top->sig->signal_received == SIGUSR2)
+        {
+            loadgen_report(&lg, false);
+            top->sig->signal_received = 0;
+        }
+    }
+
+    loadgen_report(&lg, true);
+    loadgen_free(&lg);
+}
+
+#endif /* if P2MP_SERVER */
@@ -0,0 +1,53 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * --mode loadgen: many simulated clients of a --mode server in one
+ * process, for capacity testing.
+ */
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#if P2MP_SERVER
+
+struct context;
+
+/**************************************************************************/
+/**
+ * Main event loop of OpenVPN in load generator mode.
+ * @ingroup eventloop
+ *
+ * Starts \c --loadgen client instances at the configured rate, each a
+ * full \c CM_P2P context which does its own TLS handshake and pulls its
+ * options from the server.  Connected clients send ICMP echo requests
+ * through the tunnel if \c --loadgen-traffic is given.  Handshake rate,
+ * connect latency, throughput and packet loss are logged periodically
+ * and when the test ends.
+ *
+ * @param top          - Top-level context structure.
+ */
+void tunnel_loadgen(struct context *top);
+
+#endif /* P2MP_SERVER */
+#endif /* LOADGEN_H */
@@ -35,17 +35,24 @@
 #include "error.h"
 #include "integer.h"
 #include "misc.h"
+#include "otime.h"
 #include "mbuf.h"
 
 #include "memdbg.h"
 
+/* deficit round robin quantum, scaled by the class weight below */
+#define MBUF_DRR_QUANTUM 1500
+
+static const int mbuf_drr_weight[MBUF_N_CLASSES] = { 0, 4, 2, 1 };
+
 struct mbuf_set *
-mbuf_init(unsigned int size)
+mbuf_init(unsigned int size, unsigned int flags)
 {
     struct mbuf_set *ret;
     ALLOC_OBJ_CLEAR(ret, struct mbuf_set);
     ret->capacity = adjust_power_of_2(size);
-    ALLOC_ARRAY(ret->array, struct mbuf_item, ret->capacity);
+    ret->flags = flags;
+    ret->drr_class = MBUF_CLASS_BULK; /* so that the first round starts at interactive */
     return ret;
 }
 
@@ -54,25 +61,38 @@ mbuf_free(struct mbuf_set *ms)
 {
     if (ms)
     {
-        int i;
-        for (i = 0; i < (int) ms->len; ++i)
+        int c, i;
+        for (c = 0; c < MBUF_N_CLASSES; ++c)
         {
-            struct mbuf_item *item = &ms->array[MBUF_INDEX(ms->head, i, ms->capacity)];
-            mbuf_free_buf(item->buffer);
+            struct mbuf_class *mc = &ms->classes[c];
+            for (i = 0; i < (int) mc->len; ++i)
+            {
+                struct mbuf_item *item = &mc->array[MBUF_INDEX(mc->head, i, ms->capacity)];
+                mbuf_free_buf(item->buffer);
+            }
+            free(mc->array);
         }
-        free(ms->array);
         free(ms);
     }
 }
 
 struct mbuf_buffer *
-mbuf_alloc_buf(const struct buffer *buf)
+mbuf_alloc_buf(struct pkt_pool *pool, const struct buffer *buf)
 {
     struct mbuf_buffer *ret;
     ALLOC_OBJ(ret, struct mbuf_buffer);
-    ret->buf = clone_buf(buf);
+    ret->pkt = pool ? pkt_clone(pool, buf) : NULL;
+    if (ret->pkt)
+    {
+        ret->buf = ret->pkt->buf;
+    }
+    else
+    {
+        ret->buf = clone_buf(buf);
+    }
     ret->refcount = 1;
     ret->flags = 0;
+    ret->prio = MBUF_CLASS_DEFAULT;
     return ret;
 }
 
@@ -83,27 +103,169 @@ mbuf_free_buf(struct mbuf_buffer *mb)
     {
         if (--mb->refcount <= 0)
         {
-            free_buf(&mb->buf);
+            if (mb->pkt)
+            {
+                pkt_free(mb->pkt);
+            }
+            else
+            {
+                free_buf(&mb->buf);
+            }
             free(mb);
         }
     }
 }
 
+static void
+mbuf_class_pop(struct mbuf_set *ms, struct mbuf_class *mc, struct mbuf_item *item)
+{
+    *item = mc->array[mc->head];
+    mc->head = MBUF_INDEX(mc->head, 1, ms->capacity);
+    --mc->len;
+    --ms->len;
+}
+
+/*
+ * Drop items at the head of each class whose instance has gone away, so
+ * that the scheduler only sees packets that will actually be sent.
+ */
+static void
+mbuf_purge_heads(struct mbuf_set *ms)
+{
+    int c;
+    for (c = 0; c < MBUF_N_CLASSES; ++c)
+    {
+        struct mbuf_class *mc = &ms->classes[c];
+        while (mc->len && !mc->array[mc->head].instance)
+        {
+            struct mbuf_item item;
+            mbuf_class_pop(ms, mc, &item);
+        }
+    }
+}
+
+/*
+ * Return the class whose head packet is to be sent next, or -1 if the set
+ * is empty.  The realtime class has strict priority, the other classes are
+ * served by deficit round robin.  The scheduler state is only updated if
+ * commit is true, so that mbuf_peek() and mbuf_extract_item() agree.
+ */
+static int
+mbuf_schedule(struct mbuf_set *ms, const bool commit)
+{
+    int deficit[MBUF_N_CLASSES];
+    int c;
+
+    mbuf_purge_heads(ms);
+
+    if (!ms->len)
+    {
+        return -1;
+    }
+    if (ms->classes[MBUF_CLASS_REALTIME].len)
+    {
+        return MBUF_CLASS_REALTIME;
+    }
+
+    for (c = 0; c < MBUF_N_CLASSES; ++c)
+    {
+        deficit[c] = ms->classes[c].deficit;
+    }
+
+    c = ms->drr_class;
+    while (true)
+    {
+        const struct mbuf_class *mc = &ms->classes[c];
+
+        if (mc->len)
+        {
+            const int size = BLEN(&mc->array[mc->head].buffer->buf);
+            if (deficit[c] >= size)
+            {
+                deficit[c] -= size;
+                break;
+            }
+        }
+        else
+        {
+            deficit[c] = 0;
+        }
+
+        /* next class gets its quantum for this round */
+        c = (c == MBUF_N_CLASSES - 1) ? MBUF_CLASS_INTERACTIVE : c + 1;
+        if (ms->classes[c].len)
+        {
+            deficit[c] += MBUF_DRR_QUANTUM * mbuf_drr_weight[c];
+        }
+    }
+
+    if (commit)
+    {
+        int i;
+        for (i = 0; i < MBUF_N_CLASSES; ++i)
+        {
+            ms->classes[i].deficit = deficit[i];
+        }
+        ms->drr_class = c;
+    }
+    return c;
+}
+
 void
 mbuf_add_item(struct mbuf_set *ms, const struct mbuf_item *item)
 {
+    struct mbuf_class *mc;
+    int prio;
+
     ASSERT(ms);
+    prio = item->buffer->prio;
+    ASSERT(prio >= 0 && prio < MBUF_N_CLASSES);
+    mc = &ms->classes[prio];
+
+    if (ms->len == ms->capacity)
+    {
+        /* packets of closed instances may be taking up the room */
+        mbuf_purge_heads(ms);
+    }
     if (ms->len == ms->capacity)
     {
         struct mbuf_item rm;
-        ASSERT(mbuf_extract_item(ms, &rm));
+        int victim;
+
+        /* make room by dropping from the lowest priority class */
+        for (victim = MBUF_N_CLASSES - 1; victim >= 0; --victim)
+        {
+            if (ms->classes[victim].len)
+            {
+                break;
+            }
+        }
+
+        if (victim < prio)
+        {
+            /* everything queued is more important than this packet */
+            ++mc->stats.dropped;
+            msg(D_MULTI_DROPPED, "MBUF: mbuf packet dropped");
+            return;
+        }
+        mbuf_class_pop(ms, &ms->classes[victim], &rm);
         mbuf_free_buf(rm.buffer);
+        ++ms->classes[victim].stats.dropped;
         msg(D_MULTI_DROPPED, "MBUF: mbuf packet dropped");
     }
 
     ASSERT(ms->len < ms->capacity);
 
-    ms->array[MBUF_INDEX(ms->head, ms->len, ms->capacity)] = *item;
+    if (!mc->array)
+    {
+        ALLOC_ARRAY(mc->array, struct mbuf_item, ms->capacity);
+    }
+    mc->array[MBUF_INDEX(mc->head, mc->len, ms->capacity)] = *item;
+    if (ms->flags & MBUF_STATS)
+    {
+        openvpn_gettimeofday(&mc->array[MBUF_INDEX(mc->head, mc->len, ms->capacity)].queued, NULL);
+    }
+    ++mc->len;
     if (++ms->len > ms->max_queued)
     {
         ms->max_queued = ms->len;
@@ -117,16 +279,27 @@ mbuf_extract_item(struct mbuf_set *ms, struct mbuf_item *item)
     bool ret = false;
     if (ms)
     {
-        while (ms->len)
+        const int c = mbuf_schedule(ms, true);
+        if (c >= 0)
         {
-            *item = ms->array[ms->head];
-            ms->head = MBUF_INDEX(ms->head, 1, ms->capacity);
-            --ms->len;
-            if (item->instance) /* ignore dereferenced instances */
+            struct mbuf_class *mc = &ms->classes[c];
+            mbuf_class_pop(ms, mc, item);
+            ++mc->stats.packets;
+            if (ms->flags & MBUF_STATS)
             {
-                ret = true;
-                break;
+                struct timeval tv;
+                int delay;
+
+                openvpn_gettimeofday(&tv, NULL);
+                delay = tv_subtract(&tv, &item->queued, 60);
+                delay = delay < 0 ? 0 : delay;
+                mc->stats.delay_sum += delay;
+                if ((unsigned int) delay > mc->stats.delay_max)
+                {
+                    mc->stats.delay_max = delay;
+                }
             }
+            ret = true;
         }
     }
     return ret;
@@ -138,15 +311,11 @@ mbuf_peek_dowork(struct mbuf_set *ms)
     struct multi_instance *ret = NULL;
     if (ms)
     {
-        int i;
-        for (i = 0; i < (int) ms->len; ++i)
+        const int c = mbuf_schedule(ms, false);
+        if (c >= 0)
         {
-            struct mbuf_item *item = &ms->array[MBUF_INDEX(ms->head, i, ms->capacity)];
-            if (item->instance)
-            {
-                ret = item->instance;
-                break;
-            }
+            const struct mbuf_class *mc = &ms->classes[c];
+            ret = mc->array[mc->head].instance;
         }
     }
     return ret;
@@ -157,21 +326,48 @@ mbuf_dereference_instance(struct mbuf_set *ms, struct multi_instance *mi)
 {
     if (ms)
     {
-        int i;
-        for (i = 0; i < (int) ms->len; ++i)
+        int c, i;
+        for (c = 0; c < MBUF_N_CLASSES; ++c)
         {
-            struct mbuf_item *item = &ms->array[MBUF_INDEX(ms->head, i, ms->capacity)];
-            if (item->instance == mi)
+            struct mbuf_class *mc = &ms->classes[c];
+            for (i = 0; i < (int) mc->len; ++i)
             {
-                mbuf_free_buf(item->buffer);
-                item->buffer = NULL;
-                item->instance = NULL;
-                msg(D_MBUF, "MBUF: dereferenced queued packet");
+                struct mbuf_item *item = &mc->array[MBUF_INDEX(mc->head, i, ms->capacity)];
+                if (item->instance == mi)
+                {
+                    mbuf_free_buf(item->buffer);
+                    item->buffer = NULL;
+                    item->instance = NULL;
+                    msg(D_MBUF, "MBUF: dereferenced queued packet");
+                }
             }
         }
     }
 }
 
+const char *
+mbuf_class_name(int prio)
+{
+    switch (prio)
+    {
+        case MBUF_CLASS_REALTIME:
+            return "realtime";
+
+        case MBUF_CLASS_INTERACTIVE:
+            return "interactive";
+
+        case MBUF_CLASS_DEFAULT:
+            return "default";
+
+        case MBUF_CLASS_BULK:
+            return "bulk";
+
+        default:
+            return "UNDEF";
+    }
+}
+
+
 #else  /* if P2MP */
 static void
 dummy(void)
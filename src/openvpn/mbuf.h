@@ -35,11 +35,24 @@
 
 #include "basic.h"
 #include "buffer.h"
+#include "common.h"
+#include "pktbuf.h"
 
 struct multi_instance;
 
 #define MBUF_INDEX(head, offset, size) (((head) + (offset)) & ((size)-1))
 
+/*
+ * Traffic classes, in order of decreasing priority.  The realtime class
+ * is always served first, the others share the remaining bandwidth by
+ * deficit round robin.
+ */
+#define MBUF_CLASS_REALTIME    0
+#define MBUF_CLASS_INTERACTIVE 1
+#define MBUF_CLASS_DEFAULT     2
+#define MBUF_CLASS_BULK        3
+#define MBUF_N_CLASSES         4
+
 struct mbuf_buffer
 {
     struct buffer buf;
@@ -47,37 +60,72 @@ struct mbuf_buffer
 
 #define MF_UNICAST (1<<0)
     unsigned int flags;
+    int prio;               /* traffic class, MBUF_CLASS_x */
+    struct pkt *pkt;        /* holds buf if it came from a pool */
 };
 
 struct mbuf_item
 {
     struct mbuf_buffer *buffer;
     struct multi_instance *instance;
+    struct timeval queued;  /* set by mbuf_add_item if MBUF_STATS */
 };
 
-struct mbuf_set
+struct mbuf_class_stats
+{
+    counter_type packets;   /* packets dequeued */
+    counter_type dropped;   /* packets dropped because the set was full */
+    counter_type delay_sum; /* total queueing delay in usec */
+    unsigned int delay_max; /* maximum queueing delay in usec */
+};
+
+struct mbuf_class
 {
     unsigned int head;
     unsigned int len;
+    int deficit;
+    struct mbuf_item *array;  /* allocated on first use */
+    struct mbuf_class_stats stats;
+};
+
+struct mbuf_set
+{
+    unsigned int len;         /* total over all classes */
     unsigned int capacity;
     unsigned int max_queued;
-    struct mbuf_item *array;
+
+#define MBUF_STATS (1<<0)     /* measure queueing delay */
+    unsigned int flags;
+
+    int drr_class;            /* class currently served by round robin */
+    struct mbuf_class classes[MBUF_N_CLASSES];
 };
 
-struct mbuf_set *mbuf_init(unsigned int size);
+struct mbuf_set *mbuf_init(unsigned int size, unsigned int flags);
 
 void mbuf_free(struct mbuf_set *ms);
 
-struct mbuf_buffer *mbuf_alloc_buf(const struct buffer *buf);
+/*
+ * Copy buf into a new mbuf_buffer.  The copy is taken from pool if it is
+ * not NULL and has room for it, otherwise from the heap.
+ */
+struct mbuf_buffer *mbuf_alloc_buf(struct pkt_pool *pool, const struct buffer *buf);
 
 void mbuf_free_buf(struct mbuf_buffer *mb);
 
+/*
+ * Queue item in the class given by item->buffer->prio.  If the set is full, the
+ * oldest packet of the lowest priority class is dropped to make room,
+ * or the new packet itself if it has the lowest priority.
+ */
 void mbuf_add_item(struct mbuf_set *ms, const struct mbuf_item *item);
 
 bool mbuf_extract_item(struct mbuf_set *ms, struct mbuf_item *item);
 
 void mbuf_dereference_instance(struct mbuf_set *ms, struct multi_instance *mi);
 
+const char *mbuf_class_name(int prio);
+
 static inline bool
 mbuf_defined(const struct mbuf_set *ms)
 {
@@ -0,0 +1,409 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if ENABLE_IP_PKTINFO
+
+#include "error.h"
+#include "integer.h"
+#include "mpath.h"
+#include "otime.h"
+
+#include "memdbg.h"
+
+/*
+ * This random string identifies a multipath probe.  Probes travel
+ * inside the data channel like pings, see ping.c.
+ */
+static const uint8_t mpath_string[] = {
+    0x5c, 0x91, 0x0e, 0xa7, 0x3b, 0xd2, 0x68, 0x14,
+    0xf9, 0x2e, 0x83, 0x57, 0xc0, 0x6a, 0x1d, 0xb5
+};
+
+#define MPATH_PROBE   0
+#define MPATH_REPLY   1
+
+/* magic, type, path, seq, timestamp */
+#define MPATH_MSG_SIZE (sizeof(mpath_string) + 1 + 1 + 4 + 4 + 4)
+
+struct mpath_options *
+new_mpath_options(struct gc_arena *gc)
+{
+    struct mpath_options *ret;
+    ALLOC_OBJ_CLEAR_GC(ret, struct mpath_options, gc);
+    return ret;
+}
+
+bool
+add_mpath_entry(struct mpath_options *o, const char *local,
+                const char *remote, const char *port, int weight,
+                int msglevel)
+{
+    struct mpath_entry *e;
+
+    if (o->n >= MPATH_MAX_PATHS - 1)
+    {
+        msg(msglevel, "--multipath: at most %d additional paths are supported",
+            MPATH_MAX_PATHS - 1);
+        return false;
+    }
+    if (weight < 1 || weight > MPATH_MAX_WEIGHT)
+    {
+        msg(msglevel, "--multipath: weight must be between 1 and %d", MPATH_MAX_WEIGHT);
+        return false;
+    }
+
+    e = &o->paths[o->n++];
+    e->local = local;
+    e->remote = remote;
+    e->port = port;
+    e->weight = weight;
+    return true;
+}
+
+void
+print_mpath_options(const struct mpath_options *o, int msglevel)
+{
+    int i;
+
+    msg(msglevel, "*** MULTIPATH list");
+    for (i = 0; i < o->n; ++i)
+    {
+        const struct mpath_entry *e = &o->paths[i];
+        msg(msglevel, "  %d %s -> %s %s weight %d", i + 1, e->local, e->remote,
+            e->port ? e->port : "[default port]", e->weight);
+    }
+}
+
+/*
+ * Fill in the peer address of a path, and the local address as the
+ * source address to use with IP_PKTINFO.
+ */
+static void
+mpath_resolve(struct link_socket_actual *act, const struct mpath_entry *e,
+              const char *port)
+{
+    const unsigned int flags = GETADDR_RESOLVE | GETADDR_FATAL | GETADDR_DATAGRAM;
+    struct addrinfo *remote = NULL, *local = NULL;
+
+    openvpn_getaddrinfo(flags, e->remote, port, 0, NULL, AF_UNSPEC, &remote);
+    openvpn_getaddrinfo(flags, e->local, NULL, 0, NULL, remote->ai_family, &local);
+
+    CLEAR(*act);
+    memcpy(&act->dest.addr, remote->ai_addr, remote->ai_addrlen);
+    switch (local->ai_family)
+    {
+        case AF_INET:
+#if defined(HAVE_IN_PKTINFO) && defined(HAVE_IPI_SPEC_DST)
+            act->pi.in4.ipi_spec_dst = ((struct sockaddr_in *) local->ai_addr)->sin_addr;
+#else
+            act->pi.in4 = ((struct sockaddr_in *) local->ai_addr)->sin_addr;
+#endif
+            break;
+
+        case AF_INET6:
+            act->pi.in6.ipi6_addr = ((struct sockaddr_in6 *) local->ai_addr)->sin6_addr;
+            break;
+    }
+
+    freeaddrinfo(remote);
+    freeaddrinfo(local);
+}
+
+struct mpath *
+mpath_new(const struct mpath_options *o, struct link_socket_actual *primary,
+          const char *remote_port)
+{
+    struct mpath *m;
+    int i;
+
+    ALLOC_OBJ_CLEAR(m, struct mpath);
+    m->primary = primary;
+    m->n = o->n + 1;
+
+    /* the regular connection is used right away, the others once
+     * they have answered a probe */
+    m->paths[0].weight = MPATH_DEFAULT_WEIGHT;
+    m->paths[0].up = true;
+    for (i = 0; i < o->n; ++i)
+    {
+        const struct mpath_entry *e = &o->paths[i];
+        mpath_resolve(&m->paths[i + 1].remote, e, e->port ? e->port : remote_port);
+        m->paths[i + 1].weight = e->weight;
+    }
+
+    event_timeout_init(&m->probe_interval, MPATH_PROBE_INTERVAL, now);
+    return m;
+}
+
+void
+mpath_free(struct mpath *m)
+{
+    free(m);
+}
+
+static inline struct link_socket_actual *
+mpath_addr(struct mpath *m, int i)
+{
+    return i ? &m->paths[i].remote : m->primary;
+}
+
+/*
+ * Smooth weighted round robin: every path collects its weight on each
+ * packet, the path with most collected sends and gives back the total.
+ */
+struct link_socket_actual *
+mpath_select(struct mpath *m, int len)
+{
+    int i, best = -1, total = 0;
+
+    if (m->pinned)
+    {
+        struct link_socket_actual *ret = m->pinned;
+        m->pinned = NULL;
+        return ret;
+    }
+
+    for (i = 0; i < m->n; ++i)
+    {
+        struct mpath_path *p = &m->paths[i];
+        if (p->up && (i || link_socket_actual_defined(m->primary)))
+        {
+            const int w = max_int(p->weight * (1000 - p->loss) / 1000, 1);
+            p->current += w;
+            total += w;
+            if (best < 0 || p->current > m->paths[best].current)
+            {
+                best = i;
+            }
+        }
+    }
+
+    if (best < 0)
+    {
+        /* nothing is known to work, fall back to the regular connection */
+        best = 0;
+    }
+    else
+    {
+        m->paths[best].current -= total;
+    }
+
+    ++m->paths[best].tx_packets;
+    m->paths[best].tx_bytes += len;
+    return mpath_addr(m, best);
+}
+
+int
+mpath_incoming(struct mpath *m, const struct link_socket_actual *from, int len)
+{
+    int i;
+
+    for (i = 0; i < m->n; ++i)
+    {
+        if (addr_port_match(&from->dest, &mpath_addr(m, i)->dest))
+        {
+            ++m->paths[i].rx_packets;
+            m->paths[i].rx_bytes += len;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+mpath_housekeeping(struct mpath *m, struct timeval *tv)
+{
+    int i;
+
+    if (!event_timeout_trigger(&m->probe_interval, tv, ETT_DEFAULT))
+    {
+        return;
+    }
+
+    for (i = 0; i < m->n; ++i)
+    {
+        struct mpath_path *p = &m->paths[i];
+
+        if (p->probe_pending)
+        {
+            p->probe_pending = false;
+            ++p->unanswered;
+            p->loss = (p->loss * 7 + 1000) / 8;
+            if (p->up && p->unanswered >= MPATH_DOWN_PROBES)
+            {
+                struct gc_arena gc = gc_new();
+                p->up = false;
+                msg(M_INFO, "MULTIPATH: path %d to %s is down", i,
+                    print_link_socket_actual(mpath_addr(m, i), &gc));
+                gc_free(&gc);
+            }
+        }
+    }
+    m->probes_due = (1u << m->n) - 1;
+}
+
+static void
+mpath_write_msg(struct buffer *buf, int type, int path, uint32_t seq,
+                const struct timeval *ts)
+{
+    ASSERT(buf_write(buf, mpath_string, sizeof(mpath_string)));
+    ASSERT(buf_write_u8(buf, type));
+    ASSERT(buf_write_u8(buf, path));
+    ASSERT(buf_write_u32(buf, seq));
+    ASSERT(buf_write_u32(buf, ts->tv_sec));
+    ASSERT(buf_write_u32(buf, ts->tv_usec));
+}
+
+bool
+mpath_next_msg(struct mpath *m, struct buffer *buf)
+{
+    int i;
+
+    if (m->reply_pending)
+    {
+        m->reply_pending = false;
+        mpath_write_msg(buf, MPATH_REPLY, m->reply_path, m->reply_seq, &m->reply_ts);
+        m->pinned = &m->reply_to;
+        return true;
+    }
+
+    for (i = 0; i < m->n && m->probes_due; ++i)
+    {
+        if (m->probes_due & (1u << i))
+        {
+            struct mpath_path *p = &m->paths[i];
+            struct timeval tv;
+
+            m->probes_due &= ~(1u << i);
+            if (!link_socket_actual_defined(mpath_addr(m, i)))
+            {
+                continue;
+            }
+
+            openvpn_gettimeofday(&tv, NULL);
+            p->probe_seq = ++m->seq;
+            p->probe_pending = true;
+            mpath_write_msg(buf, MPATH_PROBE, i, p->probe_seq, &tv);
+            m->pinned = mpath_addr(m, i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+is_mpath_msg(const struct buffer *buf)
+{
+    return BLEN(buf) == MPATH_MSG_SIZE
+           && !memcmp(BPTR(buf), mpath_string, sizeof(mpath_string));
+}
+
+void
+mpath_process_msg(struct mpath *m, const struct buffer *buf,
+                  const struct link_socket_actual *from)
+{
+    struct buffer b = *buf;
+    struct timeval ts;
+    uint32_t seq;
+    int type, path;
+
+    ASSERT(buf_advance(&b, sizeof(mpath_string)));
+    type = buf_read_u8(&b);
+    path = buf_read_u8(&b);
+    seq = buf_read_u32(&b, NULL);
+    ts.tv_sec = buf_read_u32(&b, NULL);
+    ts.tv_usec = buf_read_u32(&b, NULL);
+
+    if (type == MPATH_PROBE)
+    {
+        /* answer on the path the probe came in on */
+        m->reply_pending = true;
+        m->reply_to = *from;
+        m->reply_path = path;
+        m->reply_seq = seq;
+        m->reply_ts = ts;
+    }
+    else if (type == MPATH_REPLY && path < m->n)
+    {
+        struct mpath_path *p = &m->paths[path];
+        struct timeval tv;
+        int rtt;
+
+        if (!p->probe_pending || seq != p->probe_seq)
+        {
+            return;
+        }
+
+        openvpn_gettimeofday(&tv, NULL);
+        rtt = max_int(tv_subtract(&tv, &ts, 60), 0);
+        p->srtt = p->srtt ? (p->srtt * 7 + rtt) / 8 : rtt;
+        p->loss = p->loss * 7 / 8;
+        p->probe_pending = false;
+        p->unanswered = 0;
+
+        if (!p->up)
+        {
+            struct gc_arena gc = gc_new();
+            p->up = true;
+            p->current = 0;
+            msg(M_INFO, "MULTIPATH: path %d to %s is up, rtt %d ms", path,
+                print_link_socket_actual(mpath_addr(m, path), &gc), p->srtt / 1000);
+            gc_free(&gc);
+        }
+    }
+}
+
+void
+mpath_print_status(const struct mpath *m, struct status_output *so)
+{
+    struct gc_arena gc = gc_new();
+    int i;
+
+    for (i = 0; i < m->n; ++i)
+    {
+        const struct mpath_path *p = &m->paths[i];
+        const struct link_socket_actual *to = i ? &p->remote : m->primary;
+
+        status_printf(so, "Path %d,%s,%s,weight %d,rtt %d ms,loss %d permille,"
+                      "tx " counter_format "/" counter_format ",rx " counter_format "/" counter_format,
+                      i, print_link_socket_actual(to, &gc), p->up ? "up" : "down",
+                      p->weight, p->srtt / 1000, p->loss,
+                      p->tx_packets, p->tx_bytes, p->rx_packets, p->rx_bytes);
+    }
+    gc_free(&gc);
+}
+
+#else  /* if ENABLE_IP_PKTINFO */
+static void
+dummy(void)
+{
+}
+#endif /* ENABLE_IP_PKTINFO */
@@ -0,0 +1,186 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Multipath UDP tunnels (--multipath).
+ *
+ * Besides the regular connection (path 0), a point-to-point UDP tunnel
+ * can use additional paths, each one a pair of a local address of this
+ * host and an address of the peer.  All paths share the one UDP socket,
+ * the local address of a path is selected per packet with IP_PKTINFO,
+ * like --multihome does.
+ *
+ * Every path is probed once per second with an authenticated probe that
+ * the peer answers on the same path, which gives its round trip time
+ * and loss.  Data channel packets are spread over the paths that are up
+ * in proportion to their weight, reduced by their loss.  A path that
+ * does not answer three probes in a row is taken out of the rotation
+ * until it answers again, the tunnel itself is not affected.
+ */
+
+#ifndef MPATH_H
+#define MPATH_H
+
+#if ENABLE_IP_PKTINFO
+
+#include "buffer.h"
+#include "interval.h"
+#include "socket.h"
+#include "status.h"
+
+#define MPATH_MAX_PATHS       8     /**< Including the regular connection. */
+#define MPATH_DEFAULT_WEIGHT  10    /**< Weight of the regular connection. */
+#define MPATH_MAX_WEIGHT      100
+#define MPATH_PROBE_INTERVAL  1     /**< Seconds between probes of a path. */
+#define MPATH_DOWN_PROBES     3     /**< Unanswered probes until a path is down. */
+
+/**
+ * Replay window used with --multipath unless --replay-window is given,
+ * packets sent over paths with different delays arrive out of order.
+ */
+#define MPATH_REPLAY_WINDOW   512
+
+/** A --multipath option. */
+struct mpath_entry
+{
+    const char *local;
+    const char *remote;
+    const char *port;       /**< NULL for the port of the connection. */
+    int weight;
+};
+
+struct mpath_options
+{
+    int n;
+    struct mpath_entry paths[MPATH_MAX_PATHS - 1];
+};
+
+struct mpath_path
+{
+    struct link_socket_actual remote;   /**< Unused for path 0. */
+    int weight;
+    bool up;
+    int current;            /**< Smooth weighted round robin state. */
+
+    bool probe_pending;     /**< Last probe not answered yet. */
+    uint32_t probe_seq;
+    int unanswered;         /**< Probes in a row without answer. */
+    int srtt;               /**< Smoothed round trip time in usec. */
+    int loss;               /**< Probe loss in permille, averaged. */
+
+    counter_type tx_packets;
+    counter_type tx_bytes;
+    counter_type rx_packets;
+    counter_type rx_bytes;
+};
+
+struct mpath
+{
+    int n;
+    struct mpath_path paths[MPATH_MAX_PATHS];
+    struct link_socket_actual *primary; /**< Peer address of path 0. */
+
+    struct event_timeout probe_interval;
+    unsigned int probes_due;            /**< Paths still to be probed. */
+    uint32_t seq;
+
+    /** Send the next packet there instead of scheduling it. */
+    struct link_socket_actual *pinned;
+
+    /** Answer to a probe of the peer, waiting to be sent. */
+    bool reply_pending;
+    struct link_socket_actual reply_to;
+    uint8_t reply_path;
+    uint32_t reply_seq;
+    struct timeval reply_ts;
+};
+
+struct mpath_options *new_mpath_options(struct gc_arena *gc);
+
+/**
+ * Add a --multipath option to \c o.
+ *
+ * @return false if the path cannot be added.
+ */
+bool add_mpath_entry(struct mpath_options *o, const char *local,
+                     const char *remote, const char *port, int weight,
+                     int msglevel);
+
+void print_mpath_options(const struct mpath_options *o, int msglevel);
+
+/**
+ * Resolve the paths in \c o.
+ *
+ * @param o             The --multipath options.
+ * @param primary       Peer address of the regular connection.
+ * @param remote_port   Port of the regular connection.
+ */
+struct mpath *mpath_new(const struct mpath_options *o,
+                        struct link_socket_actual *primary,
+                        const char *remote_port);
+
+void mpath_free(struct mpath *m);
+
+/**
+ * Choose the path for an outgoing data channel packet.
+ *
+ * @param m     The multipath state.
+ * @param len   Packet length.
+ *
+ * @return The address to send the packet to.
+ */
+struct link_socket_actual *mpath_select(struct mpath *m, int len);
+
+/**
+ * Account for an incoming packet.
+ *
+ * @return The path the packet came in on, -1 if it is not from the peer
+ *         address of any path.
+ */
+int mpath_incoming(struct mpath *m, const struct link_socket_actual *from, int len);
+
+/**
+ * Run the probe timer.
+ */
+void mpath_housekeeping(struct mpath *m, struct timeval *tv);
+
+/**
+ * Write the next probe or probe answer to \c buf and pin it to its path.
+ *
+ * @return false if there is nothing to send.
+ */
+bool mpath_next_msg(struct mpath *m, struct buffer *buf);
+
+/**
+ * Handle a probe or probe answer from the peer.
+ */
+void mpath_process_msg(struct mpath *m, const struct buffer *buf,
+                       const struct link_socket_actual *from);
+
+bool is_mpath_msg(const struct buffer *buf);
+
+void mpath_print_status(const struct mpath *m, struct status_output *so);
+
+#endif /* if ENABLE_IP_PKTINFO */
+#endif /* ifndef MPATH_H */
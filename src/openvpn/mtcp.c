@@ -69,6 +69,10 @@
 #define MTCP_FILE_CLOSE_WRITE ((void *)5)
 #endif
 
+#ifndef _WIN32
+#define MTCP_RELOAD      ((void *)6)
+#endif
+
 #define MTCP_N           ((void *)16) /* upper bound on MTCP_x */
 
 struct ta_iow_flags
@@ -175,7 +179,8 @@ bool
 multi_tcp_instance_specific_init(struct multi_context *m, struct multi_instance *mi)
 {
     /* buffer for queued TCP socket output packets */
-    mi->tcp_link_out_deferred = mbuf_init(m->top.options.n_bcast_buf);
+    mi->tcp_link_out_deferred = mbuf_init(m->top.options.n_bcast_buf,
+                                          m->top.options.egress_queue ? MBUF_STATS : 0);
 
     ASSERT(mi->context.c2.link_socket);
     ASSERT(mi->context.c2.link_socket->info.lsa);
@@ -283,6 +288,14 @@ multi_tcp_wait(const struct context *c,
     event_ctl(mtcp->es, c->c2.inotify_fd, EVENT_READ, MTCP_FILE_CLOSE_WRITE);
 #endif
 
+#ifndef _WIN32
+    /* reply of a --graceful-reload configuration check */
+    if (c->c2.reload_fd >= 0)
+    {
+        event_ctl(mtcp->es, c->c2.reload_fd, EVENT_READ, MTCP_RELOAD);
+    }
+#endif
+
     status = event_wait(mtcp->es, &c->c2.timeval, mtcp->esr, mtcp->maxevents);
     update_time();
     mtcp->n_esr = 0;
@@ -344,9 +357,11 @@ multi_tcp_process_outgoing_link(struct multi_context *m, bool defer, const unsig
             struct buffer *buf = &mi->context.c2.to_link;
             if (BLEN(buf) > 0)
             {
-                struct mbuf_buffer *mb = mbuf_alloc_buf(buf);
+                struct mbuf_buffer *mb = mbuf_alloc_buf(m->pkt_pool, buf);
                 struct mbuf_item item;
 
+                mb->prio = m->top.options.egress_queue
+                           ? mi->context.c2.to_link_prio : MBUF_CLASS_DEFAULT;
                 set_prefix(mi);
                 dmsg(D_MULTI_TCP, "MULTI TCP: queuing deferred packet");
                 item.buffer = mb;
@@ -354,6 +369,7 @@ multi_tcp_process_outgoing_link(struct multi_context *m, bool defer, const unsig
                 mbuf_add_item(mi->tcp_link_out_deferred, &item);
                 mbuf_free_buf(mb);
                 buf_reset(buf);
+                mi->context.c2.to_link_prio = MBUF_CLASS_REALTIME;
                 ret = multi_process_post(m, mi, mpp_flags);
                 if (!ret)
                 {
@@ -740,6 +756,12 @@ multi_tcp_process_io(struct multi_context *m)
             {
                 multi_process_file_closed(m, MPP_PRE_SELECT | MPP_RECORD_TOUCH);
             }
+#endif
+#ifndef _WIN32
+            else if (e->arg == MTCP_RELOAD)
+            {
+                multi_reload_read(m);
+            }
 #endif
         }
         if (IS_SIG(&m->top))
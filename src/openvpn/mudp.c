@@ -34,6 +34,7 @@
 #include "multi.h"
 #include <inttypes.h>
 #include "forward.h"
+#include "handover.h"
 
 #include "memdbg.h"
 
@@ -70,13 +71,18 @@ multi_get_create_instance_udp(struct multi_context *m, bool *floated)
         if (v2)
         {
             uint32_t peer_id = ntohl(*(uint32_t *)ptr) & 0xFFFFFF;
-            peer_id_disabled = (peer_id == MAX_PEER_ID);
+            const struct peer_table_slot *slot = NULL;
 
-            if (!peer_id_disabled && (peer_id < m->max_clients) && (m->instances[peer_id]))
+            peer_id_disabled = (peer_id == MAX_PEER_ID);
+            if (!peer_id_disabled)
             {
-                mi = m->instances[peer_id];
+                slot = peer_table_lookup(m->peers, peer_id);
+            }
+            if (slot)
+            {
+                mi = slot->mi;
 
-                *floated = !link_socket_actual_match(&mi->context.c2.from, &m->top.c2.from);
+                *floated = !addr_port_match(&slot->remote, &m->top.c2.from.dest);
 
                 if (*floated)
                 {
@@ -105,27 +111,15 @@ multi_get_create_instance_udp(struct multi_context *m, bool *floated)
                     mi = multi_create_instance(m, &real);
                     if (mi)
                     {
-                        int i;
-
                         hash_add_fast(hash, bucket, &mi->real, hv, mi);
                         mi->did_real_hash = true;
 
-                        /* max_clients must be less then max peer-id value */
-                        ASSERT(m->max_clients < MAX_PEER_ID);
-
-                        for (i = 0; i < m->max_clients; ++i)
-                        {
-                            if (!m->instances[i])
-                            {
-                                mi->context.c2.tls_multi->peer_id = i;
-                                m->instances[i] = mi;
-                                break;
-                            }
-                        }
+                        mi->context.c2.tls_multi->peer_id =
+                            peer_table_alloc(m->peers, mi, &m->top.c2.from.dest);
 
                         /* should not really end up here, since multi_create_instance returns null
                          * if amount of clients exceeds max_clients */
-                        ASSERT(i < m->max_clients);
+                        ASSERT(mi->context.c2.tls_multi->peer_id != MAX_PEER_ID);
                     }
                 }
                 else
@@ -167,6 +161,41 @@ multi_process_outgoing_link(struct multi_context *m, const unsigned int mpp_flag
     }
 }
 
+/*
+ * Send the packets to clients whose --pacing departure time has come.
+ */
+static void
+multi_process_pacing(struct multi_context *m)
+{
+    const uint64_t t = pacing_now();
+    struct pacing_entry *e;
+
+    while ((e = pacing_calendar_next(m->pacing, t)))
+    {
+        const int size = link_socket_write(m->top.c2.link_socket, &e->buf, &e->to);
+        check_status(size, "write", m->top.c2.link_socket, NULL);
+    }
+}
+
+/*
+ * Wake up in time for the next packet in the pacing calendar.
+ */
+static inline void
+multi_get_pacing_timeout(struct multi_context *m, struct timeval *dest)
+{
+    if (m->pacing && m->pacing->n)
+    {
+        const struct timeval tv = *dest;
+
+        pacing_calendar_timeout(m->pacing, pacing_now(), dest);
+        if (tv_lt(dest, &tv))
+        {
+            /* a timeout is not for the instance that was next */
+            m->earliest_wakeup = NULL;
+        }
+    }
+}
+
 /*
  * Process an I/O event.
  */
@@ -249,6 +278,13 @@ multi_process_io_udp(struct multi_context *m)
         multi_process_file_closed(m, mpp_flags);
     }
 #endif
+#ifndef _WIN32
+    /* --graceful-reload check replied */
+    else if (status & RELOAD_READ)
+    {
+        multi_reload_read(m);
+    }
+#endif
 }
 
 /*
@@ -302,10 +338,22 @@ tunnel_server_udp_single_threaded(struct context *top)
     top->mode = CM_TOP;
     context_clear_2(top);
 
+#if SOCKET_HANDOVER
+    /* take over socket and tun device from a server we are replacing */
+    if (top->options.handover_socket)
+    {
+        handover_takeover(top->options.handover_socket);
+        handover_listen(top->options.handover_socket);
+    }
+#endif
+
     /* initialize top-tunnel instance */
     init_instance_handle_signals(top, top->es, CC_HARD_USR1_TO_HUP);
     if (IS_SIG(top))
     {
+#if SOCKET_HANDOVER
+        handover_close();
+#endif
         return;
     }
 
@@ -336,9 +384,16 @@ tunnel_server_udp_single_threaded(struct context *top)
 
         /* set up and do the io_wait() */
         multi_get_timeout(&multi, &multi.top.c2.timeval);
+        multi_get_pacing_timeout(&multi, &multi.top.c2.timeval);
         io_wait(&multi.top, p2mp_iow_flags(&multi));
         MULTI_CHECK_SIG(&multi);
 
+        /* send paced packets that are due */
+        if (multi.pacing && multi.pacing->n)
+        {
+            multi_process_pacing(&multi);
+        }
+
         /* check on status of coarse timers */
         multi_process_per_second_timers(&multi);
 
@@ -371,6 +426,10 @@ tunnel_server_udp_single_threaded(struct context *top)
     multi_uninit(&multi);
     multi_top_free(&multi);
     close_instance(top);
+
+#if SOCKET_HANDOVER
+    handover_close();
+#endif
 }
 
 void
@@ -45,6 +45,8 @@
 #include "gremlin.h"
 #include "mstats.h"
 #include "ssl_verify.h"
+#include "fdmisc.h"
+#include "handover.h"
 #include <inttypes.h>
 
 #include "memdbg.h"
@@ -376,7 +378,27 @@ multi_init(struct multi_context *m, struct context *t, bool tcp_mode, int thread
     /*
      * Allocate broadcast/multicast buffer list
      */
-    m->mbuf = mbuf_init(t->options.n_bcast_buf);
+    m->mbuf = mbuf_init(t->options.n_bcast_buf,
+                        t->options.egress_queue ? MBUF_STATS : 0);
+
+    /*
+     * Buffers for the packets waiting in m->mbuf and in the
+     * per-instance queues, so that queueing a packet does not cost a
+     * malloc() of a full sized buffer.  Packets beyond the limit of the
+     * pool get a buffer from the heap.
+     */
+    m->pkt_pool = pkt_pool_new(BUF_SIZE(&t->c2.frame),
+                               FRAME_HEADROOM(&t->c2.frame),
+                               4 * t->options.n_bcast_buf);
+
+    /*
+     * Packets to clients with --pacing that are not due yet wait here,
+     * unless the kernel can pace them
+     */
+    if (proto_is_dgram(t->options.ce.proto))
+    {
+        m->pacing = pacing_calendar_new(BUF_SIZE(&t->c2.frame));
+    }
 
     /*
      * Different status file format options are available
@@ -434,7 +456,7 @@ multi_init(struct multi_context *m, struct context *t, bool tcp_mode, int thread
      */
     m->max_clients = t->options.max_clients;
 
-    m->instances = calloc(m->max_clients, sizeof(struct multi_instance *));
+    m->peers = peer_table_new(m->max_clients);
 
     /*
      * Initialize multi-socket TCP I/O wait object
@@ -445,6 +467,11 @@ multi_init(struct multi_context *m, struct context *t, bool tcp_mode, int thread
     }
     m->tcp_queue_limit = t->options.tcp_queue_limit;
 
+    if (t->options.trace_capture_file)
+    {
+        m->trace = trace_open_capture(t->options.trace_capture_file);
+    }
+
     /*
      * Allow client <-> client communication, without going through
      * tun/tap interface and network stack?
@@ -605,6 +632,36 @@ multi_client_disconnect_script(struct multi_context *m,
     }
 }
 
+/*
+ * Free the configurations of earlier --graceful-reloads which no instance
+ * uses anymore.  The newest one is the current configuration of m->top.
+ */
+static void
+multi_reload_gc(struct multi_context *m)
+{
+    struct multi_reload **rp;
+
+    if (!m->reloads)
+    {
+        return;
+    }
+    rp = &m->reloads->next;
+    while (*rp)
+    {
+        struct multi_reload *r = *rp;
+        if (r->refcount == 0)
+        {
+            *rp = r->next;
+            uninit_options(&r->options);
+            free(r);
+        }
+        else
+        {
+            rp = &r->next;
+        }
+    }
+}
+
 void
 multi_close_instance(struct multi_context *m,
                      struct multi_instance *mi,
@@ -621,6 +678,7 @@ multi_close_instance(struct multi_context *m,
     m->n_clients += mi->n_clients_delta;
     update_mstat_n_clients(m->n_clients);
     mi->n_clients_delta = 0;
+    m->pacing_dropped += mi->context.c2.pacer.dropped;
 
     /* prevent dangling pointers */
     if (m->pending == mi)
@@ -659,7 +717,7 @@ multi_close_instance(struct multi_context *m,
 
         if (mi->context.c2.tls_multi->peer_id != MAX_PEER_ID)
         {
-            m->instances[mi->context.c2.tls_multi->peer_id] = NULL;
+            peer_table_release(m->peers, mi->context.c2.tls_multi->peer_id);
         }
 
         schedule_remove_entry(m->schedule, (struct schedule_entry *) mi);
@@ -691,6 +749,13 @@ multi_close_instance(struct multi_context *m,
         close_context(&mi->context, SIGTERM, CC_GC_FREE);
     }
 
+    if (mi->reload)
+    {
+        --mi->reload->refcount;
+        mi->reload = NULL;
+        multi_reload_gc(m);
+    }
+
     multi_tcp_instance_specific_free(mi);
 
     ungenerate_prefix(mi);
@@ -742,7 +807,8 @@ multi_uninit(struct multi_context *m)
 #endif
             m->hash = NULL;
 
-            free(m->instances);
+            peer_table_free(m->peers);
+            m->peers = NULL;
 
 #ifdef ENABLE_ASYNC_PUSH
             hash_free(m->inotify_watchers);
@@ -751,11 +817,20 @@ multi_uninit(struct multi_context *m)
 
             schedule_free(m->schedule);
             mbuf_free(m->mbuf);
+            pkt_pool_free(m->pkt_pool);
+            m->pkt_pool = NULL;
+            if (m->pacing)
+            {
+                pacing_calendar_free(m->pacing);
+                m->pacing = NULL;
+            }
             ifconfig_pool_free(m->ifconfig_pool);
             frequency_limit_free(m->new_connection_limiter);
             multi_reap_free(m->reaper);
             mroute_helper_free(m->route_helper);
             multi_tcp_free(m->mtcp);
+            trace_close(m->trace);
+            m->trace = NULL;
             m->thread_mode = MC_UNDEF;
         }
     }
@@ -790,12 +865,19 @@ multi_create_instance(struct multi_context *m, const struct mroute_addr *real)
 
     mi->did_open_context = true;
     inherit_context_child(&mi->context, &m->top);
+    /* its options point into the configuration of the last reload */
+    mi->reload = m->reloads;
+    if (mi->reload)
+    {
+        ++mi->reload->refcount;
+    }
     if (IS_SIG(&mi->context))
     {
         goto err;
     }
 
     mi->context.c2.context_auth = CAS_PENDING;
+    mi->context.c2.pacing_calendar = m->pacing;
 
     if (hash_n_elements(m->hash) >= m->max_clients)
     {
@@ -852,6 +934,61 @@ err:
     return NULL;
 }
 
+/*
+ * Packets dropped by --pacing, for open and closed instances and
+ * by the shared calendar.
+ */
+static counter_type
+multi_pacing_dropped(struct multi_context *m)
+{
+    counter_type dropped = m->pacing_dropped;
+    struct hash_iterator hi;
+    struct hash_element *he;
+
+    if (m->pacing)
+    {
+        dropped += m->pacing->n_dropped;
+    }
+    hash_iterator_init(m->iter, &hi);
+    while ((he = hash_iterator_next(&hi)))
+    {
+        const struct multi_instance *mi = (struct multi_instance *) he->value;
+        dropped += mi->context.c2.pacer.dropped;
+    }
+    hash_iterator_free(&hi);
+    return dropped;
+}
+
+/*
+ * One EGRESS_QUEUE status line per traffic class of an output queue
+ * that has seen traffic.
+ */
+static void
+multi_print_egress_queue(struct status_output *so, const char sep,
+                         const char *name, const struct mbuf_set *ms)
+{
+    int c;
+
+    if (!ms)
+    {
+        return;
+    }
+    for (c = 0; c < MBUF_N_CLASSES; ++c)
+    {
+        const struct mbuf_class_stats *st = &ms->classes[c].stats;
+        if (st->packets || st->dropped)
+        {
+            status_printf(so, "EGRESS_QUEUE%c%s%c%s%c" counter_format "%c" counter_format "%c" counter_format "%c%u",
+                          sep, name,
+                          sep, mbuf_class_name(c),
+                          sep, st->packets,
+                          sep, st->dropped,
+                          sep, st->packets ? st->delay_sum / st->packets : 0,
+                          sep, st->delay_max);
+        }
+    }
+}
+
 /*
  * Dump tables -- triggered by SIGUSR2.
  * If status file is defined, write to file.
@@ -930,6 +1067,29 @@ multi_print_status(struct multi_context *m, struct status_output *so, const int
                 status_printf(so, "Max bcast/mcast queue length,%d",
                               mbuf_maximum_queued(m->mbuf));
             }
+            /* only worth a look once the pool was too small */
+            if (m->pkt_pool && m->pkt_pool->stats.exhausted)
+            {
+                const struct pkt_pool_stats *ps = &m->pkt_pool->stats;
+                status_printf(so, "Packet buffers in use,%d", ps->in_use);
+                status_printf(so, "Max packet buffers in use,%d", ps->in_use_max);
+                status_printf(so, "Packet buffer pool exhausted," counter_format,
+                              ps->exhausted);
+            }
+            if (m->top.options.pacing)
+            {
+                status_printf(so, "Pacing drops," counter_format,
+                              multi_pacing_dropped(m));
+                if (m->pacing)
+                {
+                    status_printf(so, "Pacing late," counter_format,
+                                  m->pacing->n_late);
+                }
+            }
+            if (m->top.options.cpu_affinity)
+            {
+                print_placement(&m->top, so, "", ',');
+            }
 
             status_printf(so, "END");
         }
@@ -1014,6 +1174,51 @@ multi_print_status(struct multi_context *m, struct status_output *so, const int
                 status_printf(so, "GLOBAL_STATS%cMax bcast/mcast queue length%c%d",
                               sep, sep, mbuf_maximum_queued(m->mbuf));
             }
+            if (m->pkt_pool && m->pkt_pool->stats.exhausted)
+            {
+                const struct pkt_pool_stats *ps = &m->pkt_pool->stats;
+                status_printf(so, "GLOBAL_STATS%cPacket buffers in use%c%d",
+                              sep, sep, ps->in_use);
+                status_printf(so, "GLOBAL_STATS%cMax packet buffers in use%c%d",
+                              sep, sep, ps->in_use_max);
+                status_printf(so, "GLOBAL_STATS%cPacket buffer pool exhausted%c" counter_format,
+                              sep, sep, ps->exhausted);
+            }
+            if (m->top.options.pacing)
+            {
+                status_printf(so, "GLOBAL_STATS%cPacing drops%c" counter_format,
+                              sep, sep, multi_pacing_dropped(m));
+                if (m->pacing)
+                {
+                    status_printf(so, "GLOBAL_STATS%cPacing late%c" counter_format,
+                                  sep, sep, m->pacing->n_late);
+                }
+            }
+            if (m->top.options.cpu_affinity)
+            {
+                print_placement(&m->top, so, version == 3 ? "GLOBAL_STATS\t" : "GLOBAL_STATS,", sep);
+            }
+
+            if (m->top.options.egress_queue)
+            {
+                status_printf(so, "HEADER%cEGRESS_QUEUE%cQueue%cClass%cPackets%cDropped%cAvg Delay (usec)%cMax Delay (usec)",
+                              sep, sep, sep, sep, sep, sep, sep);
+                multi_print_egress_queue(so, sep, "bcast/mcast", m->mbuf);
+                hash_iterator_init(m->hash, &hi);
+                while ((he = hash_iterator_next(&hi)))
+                {
+                    struct gc_arena gc = gc_new();
+                    const struct multi_instance *mi = (struct multi_instance *) he->value;
+
+                    if (!mi->halt)
+                    {
+                        multi_print_egress_queue(so, sep, mroute_addr_print(&mi->real, &gc),
+                                                 mi->tcp_link_out_deferred);
+                    }
+                    gc_free(&gc);
+                }
+                hash_iterator_free(&hi);
+            }
 
             status_printf(so, "END");
         }
@@ -1156,6 +1361,22 @@ multi_learn_addr(struct multi_context *m,
     return owner;
 }
 
+#ifdef ENABLE_TRACE_REPLAY
+void
+multi_learn_packet_source(struct multi_context *m, struct multi_instance *mi,
+                          const struct buffer *buf)
+{
+    struct mroute_addr src, dest;
+
+    if (TUNNEL_TYPE(m->top.c1.tuntap) == DEV_TYPE_TUN
+        && (mroute_extract_addr_from_packet(&src, &dest, NULL, NULL, buf, DEV_TYPE_TUN)
+            & MROUTE_EXTRACT_SUCCEEDED))
+    {
+        multi_learn_addr(m, mi, &src, 0);
+    }
+}
+#endif
+
 /*
  * Get client instance based on virtual address.
  */
@@ -2003,6 +2224,14 @@ script_failed:
              */
             do_deferred_options(&mi->context, option_types_found);
 
+#ifdef USE_COMP
+            /*
+             * Compress with a shared dictionary if the client has it.
+             */
+            comp_check_peer_info(mi->context.c2.comp_context,
+                                 tls_get_peer_info(mi->context.c2.tls_multi));
+#endif
+
             /*
              * make sure we got ifconfig settings from somewhere
              */
@@ -2184,6 +2413,20 @@ multi_add_mbuf(struct multi_context *m,
     }
 }
 
+/*
+ * Traffic class of a packet for the output queue, see --egress-queue.
+ */
+static inline int
+multi_egress_prio(const struct multi_context *m, const struct buffer *buf)
+{
+    if (m->top.options.egress_queue)
+    {
+        return egress_classify(m->top.options.egress_rules,
+                               TUNNEL_TYPE(m->top.c1.tuntap), buf);
+    }
+    return MBUF_CLASS_DEFAULT;
+}
+
 /*
  * Add a packet to a client instance output queue.
  */
@@ -2196,8 +2439,9 @@ multi_unicast(struct multi_context *m,
 
     if (BLEN(buf) > 0)
     {
-        mb = mbuf_alloc_buf(buf);
+        mb = mbuf_alloc_buf(m->pkt_pool, buf);
         mb->flags = MF_UNICAST;
+        mb->prio = multi_egress_prio(m, buf);
         multi_add_mbuf(m, mi, mb);
         mbuf_free_buf(mb);
     }
@@ -2223,7 +2467,8 @@ multi_bcast(struct multi_context *m,
 #ifdef MULTI_DEBUG_EVENT_LOOP
         printf("BCAST len=%d\n", BLEN(buf));
 #endif
-        mb = mbuf_alloc_buf(buf);
+        mb = mbuf_alloc_buf(m->pkt_pool, buf);
+        mb->prio = multi_egress_prio(m, buf);
         hash_iterator_init(m->iter, &hi);
 
         while ((he = hash_iterator_next(&hi)))
@@ -2474,6 +2719,8 @@ multi_process_float(struct multi_context *m, struct multi_instance *mi)
     mi->context.c2.link_socket_info->lsa->actual = m->top.c2.from;
 
     tls_update_remote_addr(mi->context.c2.tls_multi, &mi->context.c2.from);
+    peer_table_set_remote(m->peers, mi->context.c2.tls_multi->peer_id,
+                          &mi->context.c2.from.dest);
 
     ASSERT(hash_add(m->hash, &mi->real, mi, false));
     ASSERT(hash_add(m->iter, &mi->real, mi, false));
@@ -2486,6 +2733,26 @@ done:
     gc_free(&gc);
 }
 
+/*
+ * Record a decrypted packet from a client for --trace-capture, after
+ * the client's common name when it is the first one.
+ */
+static void
+multi_trace_incoming_link(struct multi_context *m, struct multi_instance *mi)
+{
+    struct context *c = &mi->context;
+
+    if (!mi->did_trace)
+    {
+        const char *cn = tls_common_name(c->c2.tls_multi, false);
+        trace_capture(m->trace, TRACE_CLIENT, &c->c2.from, (const uint8_t *) cn,
+                      (int) strlen(cn));
+        mi->did_trace = true;
+    }
+    trace_capture(m->trace, TRACE_LINK, &c->c2.from,
+                  BPTR(&c->c2.to_tun), BLEN(&c->c2.to_tun));
+}
+
 /*
  * Process packets in the TCP/UDP socket -> TUN/TAP interface direction,
  * i.e. client -> server direction.
@@ -2559,6 +2826,11 @@ multi_process_incoming_link(struct multi_context *m, struct multi_instance *inst
             }
             perf_pop();
 
+            if (m->trace && BLEN(&c->c2.to_tun) > 0)
+            {
+                multi_trace_incoming_link(m, m->pending);
+            }
+
             if (TUNNEL_TYPE(m->top.c1.tuntap) == DEV_TYPE_TUN)
             {
                 /* extract packet source and dest addresses */
@@ -2765,6 +3037,12 @@ multi_process_incoming_tun(struct multi_context *m, const unsigned int mpp_flags
             return true;
         }
 
+        if (m->trace)
+        {
+            trace_capture(m->trace, TRACE_TUN, NULL,
+                          BPTR(&m->top.c2.buf), BLEN(&m->top.c2.buf));
+        }
+
         /*
          * Route an incoming tun/tap packet to
          * the appropriate multi_instance object.
@@ -2990,6 +3268,442 @@ stale_route_check_trigger(struct multi_context *m)
     return event_timeout_trigger(&m->stale_routes_check_et, &null, ETT_DEFAULT);
 }
 
+#ifndef _WIN32
+/*
+ * --graceful-reload: the configuration is only ever parsed and verified in
+ * a child process, since option errors are fatal.  The child writes the
+ * options that can be taken over to a pipe, so the server does not read
+ * the configuration files itself and a file changed in the meantime
+ * cannot take it down.
+ */
+
+/* largest reply of the child we accept */
+#define MULTI_RELOAD_MAX_REPLY (1024 * 1024)
+
+/* length of a NULL string in the reply */
+#define MULTI_RELOAD_NULL_STR 0xffffffff
+
+static void
+multi_reload_write(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len)
+    {
+        const ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            msg(M_WARN | M_ERRNO, "Graceful reload: cannot pass the new configuration on");
+            _exit(OPENVPN_EXIT_STATUS_ERROR);
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+static void
+multi_reload_write_u32(int fd, uint32_t v)
+{
+    v = htonl(v);
+    multi_reload_write(fd, &v, sizeof(v));
+}
+
+static void
+multi_reload_write_str(int fd, const char *s)
+{
+    if (s)
+    {
+        multi_reload_write_u32(fd, (uint32_t) strlen(s));
+        multi_reload_write(fd, s, strlen(s));
+    }
+    else
+    {
+        multi_reload_write_u32(fd, MULTI_RELOAD_NULL_STR);
+    }
+}
+
+static bool
+multi_reload_read_str(struct buffer *buf, const char **s, struct gc_arena *gc)
+{
+    bool good = true;
+    const uint32_t len = buf_read_u32(buf, &good);
+    char *str;
+
+    *s = NULL;
+    if (!good)
+    {
+        return false;
+    }
+    if (len == MULTI_RELOAD_NULL_STR)
+    {
+        return true;
+    }
+    if (len > (uint32_t) BLEN(buf))
+    {
+        return false;
+    }
+    str = gc_malloc(len + 1, false, gc);
+    buf_read(buf, str, len);
+    str[len] = '\0';
+    *s = str;
+    return true;
+}
+
+static void
+multi_reload_check_unchanged(bool changed, const char *option)
+{
+    if (changed)
+    {
+        msg(M_WARN, "Graceful reload: --%s has changed, the old value is kept until the server is restarted",
+            option);
+    }
+}
+
+static bool
+multi_reload_str_changed(const char *s1, const char *s2)
+{
+    return (s1 || s2) && !string_defined_equal(s1, s2);
+}
+
+/*
+ * Child side: parse and verify the configuration, warn about changes that
+ * need a restart and write the options which are taken over to fd.
+ * Never returns.
+ */
+static void
+multi_reload_child(const struct multi_context *m, int fd)
+{
+    const struct options *o = &m->top.options;
+    const struct push_entry *e;
+    struct options n;
+    uint32_t n_push = 0;
+
+    init_options(&n, true);
+    parse_argv(&n, m->top.persist.argc, m->top.persist.argv, M_USAGE, OPT_P_DEFAULT,
+               NULL, env_set_create(NULL));
+    init_options_dev(&n);
+    options_postprocess(&n);
+    if (n.mode != MODE_SERVER)
+    {
+        msg(M_WARN, "Graceful reload: new configuration is not a server configuration");
+        _exit(OPENVPN_EXIT_STATUS_ERROR);
+    }
+
+    multi_reload_check_unchanged(multi_reload_str_changed(o->dev, n.dev), "dev");
+    multi_reload_check_unchanged(o->ce.proto != n.ce.proto
+                                 || multi_reload_str_changed(o->ce.local_port,
+                                                             n.ce.local_port),
+                                 "proto/port");
+    multi_reload_check_unchanged(o->server_network != n.server_network
+                                 || o->ifconfig_pool_start != n.ifconfig_pool_start
+                                 || o->ifconfig_pool_end != n.ifconfig_pool_end,
+                                 "ifconfig-pool");
+    multi_reload_check_unchanged(o->max_clients != n.max_clients, "max-clients");
+    multi_reload_check_unchanged(multi_reload_str_changed(o->ca_file, n.ca_file)
+                                 || multi_reload_str_changed(o->cert_file, n.cert_file)
+                                 || multi_reload_str_changed(o->priv_key_file,
+                                                             n.priv_key_file)
+                                 || multi_reload_str_changed(o->dh_file, n.dh_file),
+                                 "ca/cert/key/dh");
+    multi_reload_check_unchanged(multi_reload_str_changed(o->tls_auth_file,
+                                                          n.tls_auth_file)
+                                 || multi_reload_str_changed(o->tls_crypt_file,
+                                                             n.tls_crypt_file),
+                                 "tls-auth/tls-crypt");
+    multi_reload_check_unchanged(multi_reload_str_changed(o->ciphername, n.ciphername),
+                                 "cipher");
+    if ((o->ssl_flags & SSLF_CRL_VERIFY_DIR) != (n.ssl_flags & SSLF_CRL_VERIFY_DIR))
+    {
+        multi_reload_check_unchanged(true, "crl-verify");
+    }
+
+    multi_reload_write_u32(fd, n.ccd_exclusive);
+    multi_reload_write_u32(fd, n.enable_c2c);
+    multi_reload_write_u32(fd, n.graceful_reload);
+    multi_reload_write_u32(fd, n.ssl_flags & SSLF_CRL_VERIFY_DIR);
+    multi_reload_write_str(fd, n.client_config_dir);
+    multi_reload_write_str(fd, n.crl_file);
+    multi_reload_write_str(fd, n.crl_file_inline);
+    for (e = n.push_list.head; e; e = e->next)
+    {
+        n_push += e->enable;
+    }
+    multi_reload_write_u32(fd, n_push);
+    for (e = n.push_list.head; e; e = e->next)
+    {
+        if (e->enable)
+        {
+            multi_reload_write_str(fd, e->option);
+        }
+    }
+    _exit(OPENVPN_EXIT_STATUS_GOOD);
+}
+
+/*
+ * Server side: read what the child passed on into n.
+ */
+static bool
+multi_reload_parse_reply(struct buffer *buf, struct options *n)
+{
+    bool good = true;
+    uint32_t n_push, i;
+
+    n->ccd_exclusive = buf_read_u32(buf, &good) != 0;
+    n->enable_c2c = buf_read_u32(buf, &good) != 0;
+    n->graceful_reload = buf_read_u32(buf, &good) != 0;
+    n->ssl_flags = (n->ssl_flags & ~SSLF_CRL_VERIFY_DIR)
+                   | (buf_read_u32(buf, &good) & SSLF_CRL_VERIFY_DIR);
+    good = good
+           && multi_reload_read_str(buf, &n->client_config_dir, &n->gc)
+           && multi_reload_read_str(buf, &n->crl_file, &n->gc)
+           && multi_reload_read_str(buf, &n->crl_file_inline, &n->gc);
+    n_push = buf_read_u32(buf, &good);
+    for (i = 0; good && i < n_push; ++i)
+    {
+        const char *opt;
+        good = multi_reload_read_str(buf, &opt, &n->gc) && opt;
+        if (good)
+        {
+            push_option(n, opt, M_WARN);
+        }
+    }
+    return good && !BLEN(buf);
+}
+
+/* a check that takes longer than this is given up */
+#define MULTI_RELOAD_TIMEOUT 60
+
+static void
+multi_reload_close_pipe(struct multi_context *m)
+{
+    struct multi_reload_check *rc = m->reload_check;
+
+    if (rc->fd >= 0)
+    {
+        if (m->mtcp)
+        {
+            event_del(m->mtcp->es, rc->fd);
+        }
+        close(rc->fd);
+        rc->fd = -1;
+        m->top.c2.reload_fd = -1;
+    }
+}
+
+static void
+multi_reload_check_free(struct multi_context *m)
+{
+    struct multi_reload_check *rc = m->reload_check;
+
+    multi_reload_close_pipe(m);
+    free_buf(&rc->reply);
+    free(rc);
+    m->reload_check = NULL;
+}
+
+/*
+ * Have a child check the configuration.  Its reply is read by
+ * multi_reload_read() from the event loop as it arrives, so the server
+ * keeps forwarding packets meanwhile.  After --user or --chroot the child
+ * has the same rights as the server, so the configuration has to be
+ * readable by it.
+ */
+static void
+multi_reload_start(struct multi_context *m)
+{
+    struct multi_reload_check *rc;
+    int fd[2];
+    pid_t pid;
+
+    if (m->reload_check)
+    {
+        msg(M_WARN, "Graceful reload: the previous check of the configuration has not finished, SIGHUP ignored");
+        return;
+    }
+
+    msg(M_INFO, "Graceful reload: checking new configuration");
+    if (pipe(fd) != 0)
+    {
+        msg(M_WARN | M_ERRNO, "Graceful reload: unable to create pipe");
+        return;
+    }
+
+    pid = fork();
+    if (pid == (pid_t)0) /* child side */
+    {
+        msg_forked();
+        close(fd[0]);
+        multi_reload_child(m, fd[1]);
+    }
+    close(fd[1]);
+    if (pid < (pid_t)0) /* fork failed */
+    {
+        msg(M_WARN | M_ERRNO, "Graceful reload: unable to fork");
+        close(fd[0]);
+        return;
+    }
+    set_nonblock(fd[0]);
+    set_cloexec(fd[0]);
+
+    ALLOC_OBJ_CLEAR(rc, struct multi_reload_check);
+    rc->pid = pid;
+    rc->fd = fd[0];
+    rc->reply = alloc_buf(4096);
+    rc->started = now;
+    m->reload_check = rc;
+    m->top.c2.reload_fd = fd[0];
+}
+
+/*
+ * Take over the options of a configuration the child has accepted.  Only
+ * options which are looked at again for every new client are taken over,
+ * the tunnel device, sockets, pools and TLS context stay as they are, and
+ * so do all connected clients.
+ */
+static void
+multi_reload_apply(struct multi_context *m, struct multi_reload *r)
+{
+    struct options *o = &m->top.options;
+    struct options *n = &r->options;
+
+    /* new instances clone the push list and copy the other options from
+     * m->top, existing instances keep what they were created with */
+    o->push_list = n->push_list;
+    o->client_config_dir = n->client_config_dir;
+    o->ccd_exclusive = n->ccd_exclusive;
+    o->enable_c2c = n->enable_c2c;
+    m->enable_c2c = n->enable_c2c;
+    if ((o->ssl_flags & SSLF_CRL_VERIFY_DIR) != (n->ssl_flags & SSLF_CRL_VERIFY_DIR))
+    {
+        /* keep the old value, in the new generation since the one it
+         * came from may be freed */
+        n->crl_file = o->crl_file ? string_alloc(o->crl_file, &n->gc) : NULL;
+        n->crl_file_inline = o->crl_file_inline ? string_alloc(o->crl_file_inline, &n->gc) : NULL;
+    }
+    o->crl_file = n->crl_file;
+    o->crl_file_inline = n->crl_file_inline;
+    o->graceful_reload = n->graceful_reload;
+
+    r->next = m->reloads;
+    m->reloads = r;
+    multi_reload_gc(m);
+
+    msg(M_INFO, "Graceful reload: new configuration loaded, %d client(s) kept connected",
+        m->n_clients);
+}
+
+/*
+ * Reap the child once its reply has been read, and take over the new
+ * configuration if it accepted it.  Called again from the per-second
+ * timers while the child has not exited yet, and to give up on a check
+ * that does not finish.
+ */
+static void
+multi_reload_reap(struct multi_context *m)
+{
+    struct multi_reload_check *rc = m->reload_check;
+    struct multi_reload *r;
+    int status = 0;
+    pid_t ret;
+    bool ok;
+
+    if (rc->fd >= 0)
+    {
+        if (now < rc->started + MULTI_RELOAD_TIMEOUT)
+        {
+            return;
+        }
+        msg(M_WARN, "Graceful reload: check of the new configuration did not finish within %d seconds",
+            MULTI_RELOAD_TIMEOUT);
+        kill(rc->pid, SIGKILL);
+        multi_reload_close_pipe(m);
+        rc->reply_ok = false;
+    }
+
+    ret = waitpid(rc->pid, &status, WNOHANG);
+    if (ret == 0 || (ret < 0 && errno == EINTR))
+    {
+        return;
+    }
+
+    ALLOC_OBJ_CLEAR(r, struct multi_reload);
+    init_options(&r->options, true);
+    ok = ret == rc->pid && rc->reply_ok
+         && WIFEXITED(status) && WEXITSTATUS(status) == OPENVPN_EXIT_STATUS_GOOD;
+    if (ok && !multi_reload_parse_reply(&rc->reply, &r->options))
+    {
+        msg(M_WARN, "Graceful reload: bad reply from configuration check");
+        ok = false;
+    }
+    multi_reload_check_free(m);
+
+    if (ok)
+    {
+        multi_reload_apply(m, r);
+    }
+    else
+    {
+        msg(M_WARN, "Graceful reload: new configuration rejected, keeping the current one");
+        uninit_options(&r->options);
+        free(r);
+    }
+}
+
+void
+multi_reload_read(struct multi_context *m)
+{
+    struct multi_reload_check *rc = m->reload_check;
+
+    if (!rc || rc->fd < 0)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        ssize_t len;
+
+        if (!buf_safe(&rc->reply, 1))
+        {
+            struct buffer bigger;
+            if (rc->reply.capacity >= MULTI_RELOAD_MAX_REPLY)
+            {
+                msg(M_WARN, "Graceful reload: new configuration too large");
+                rc->reply_ok = false;
+                break;
+            }
+            bigger = alloc_buf(rc->reply.capacity * 2);
+            buf_copy(&bigger, &rc->reply);
+            free_buf(&rc->reply);
+            rc->reply = bigger;
+        }
+        len = read(rc->fd, BEND(&rc->reply), buf_forward_capacity(&rc->reply));
+        if (len < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+        if (len <= 0)
+        {
+            rc->reply_ok = len == 0;
+            break;
+        }
+        rc->reply.len += len;
+    }
+
+    /* the child has written everything, or will fail writing the rest */
+    multi_reload_close_pipe(m);
+    multi_reload_reap(m);
+}
+#endif /* ifndef _WIN32 */
+
 /*
  * Process timers in the top-level context
  */
@@ -3020,6 +3734,23 @@ multi_process_per_second_timers_dowork(struct multi_context *m)
     {
         check_stale_routes(m);
     }
+
+#ifndef _WIN32
+    /* --graceful-reload check finished, or taking too long? */
+    if (m->reload_check)
+    {
+        multi_reload_reap(m);
+    }
+#endif
+
+#if SOCKET_HANDOVER
+    /* has a new server process connected to take over? */
+    if (m->top.options.handover_socket && m->top.c1.tuntap && m->top.c1.tuntap->fd >= 0
+        && handover_send(m->top.c2.link_socket->sd, m->top.c1.tuntap->fd))
+    {
+        throw_signal_soft(SIGTERM, "socket-handover");
+    }
+#endif
 }
 
 void
@@ -3027,6 +3758,9 @@ multi_top_init(struct multi_context *m, const struct context *top)
 {
     inherit_context_top(&m->top, top);
     m->top.c2.buffers = init_context_buffers(&top->c2.frame);
+#ifndef _WIN32
+    m->top.c2.reload_fd = -1;
+#endif
 }
 
 void
@@ -3034,6 +3768,24 @@ multi_top_free(struct multi_context *m)
 {
     close_context(&m->top, -1, CC_GC_FREE);
     free_context_buffers(m->top.c2.buffers);
+
+#ifndef _WIN32
+    if (m->reload_check)
+    {
+        /* a configuration check still running is not waited for */
+        kill(m->reload_check->pid, SIGKILL);
+        waitpid(m->reload_check->pid, NULL, 0);
+        multi_reload_check_free(m);
+    }
+#endif
+
+    while (m->reloads)
+    {
+        struct multi_reload *r = m->reloads;
+        m->reloads = r->next;
+        uninit_options(&r->options);
+        free(r);
+    }
 }
 
 static bool
@@ -3085,7 +3837,18 @@ multi_push_restart_schedule_exit(struct multi_context *m, bool next_server)
 bool
 multi_process_signal(struct multi_context *m)
 {
-    if (m->top.sig->signal_received == SIGUSR2)
+    if (m->top.sig->signal_received == SIGHUP && m->top.options.graceful_reload)
+    {
+#ifdef _WIN32
+        msg(M_WARN, "Graceful reload is not supported on Windows, restarting");
+        return true;
+#else
+        multi_reload_start(m);
+        m->top.sig->signal_received = 0;
+        return false;
+#endif
+    }
+    else if (m->top.sig->signal_received == SIGUSR2)
     {
         struct status_output *so = status_open(NULL, 0, M_INFO, NULL, 0);
         multi_print_status(m, so, m->status_file_version);
@@ -3386,6 +4149,13 @@ tunnel_server(struct context *top)
 {
     ASSERT(top->options.mode == MODE_SERVER);
 
+#ifdef ENABLE_TRACE_REPLAY
+    if (top->options.trace_replay_file)
+    {
+        tunnel_server_replay(top);
+        return;
+    }
+#endif
     if (proto_is_dgram(top->options.ce.proto))
     {
         tunnel_server_udp(top);
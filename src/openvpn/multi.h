@@ -37,9 +37,11 @@
 #include "list.h"
 #include "schedule.h"
 #include "pool.h"
+#include "peer_table.h"
 #include "mudp.h"
 #include "mtcp.h"
 #include "perf.h"
+#include "trace.h"
 
 #define MULTI_PREFIX_MAX_LENGTH 256
 
@@ -107,6 +109,7 @@ struct multi_instance {
 #endif
     bool connection_established_flag;
     bool did_iroutes;
+    bool did_trace;            /* common name recorded by --trace-capture */
     int n_clients_delta; /* added to multi_context.n_clients when instance is closed */
 
     struct context context;     /**< The context structure storing state
@@ -115,6 +118,9 @@ struct multi_instance {
 #ifdef ENABLE_ASYNC_PUSH
     int inotify_watch; /* watch descriptor for acf */
 #endif
+
+    struct multi_reload *reload; /* --graceful-reload configuration its
+                                  * options point into, or NULL */
 };
 
 
@@ -128,6 +134,34 @@ struct multi_instance {
  * page describes the role the structure plays when OpenVPN is running in
  * server-mode.
  */
+/**
+ * Configuration read by \c --graceful-reload.  Instances that were
+ * created after the reload point into its gc arena, so it is only freed
+ * once a newer one has been loaded and the last of these instances has
+ * been closed.
+ */
+struct multi_reload
+{
+    struct options options;
+    struct multi_reload *next;
+    int refcount;               /**< Instances created with it. */
+};
+
+#ifndef _WIN32
+/**
+ * A child process checking the configuration for \c --graceful-reload.
+ */
+struct multi_reload_check
+{
+    pid_t pid;
+    int fd;                     /**< Pipe the child writes its reply to,
+                                 *   -1 once it has been read. */
+    struct buffer reply;
+    bool reply_ok;              /**< The whole reply has been read. */
+    time_t started;
+};
+#endif
+
 struct multi_context {
 #define MC_UNDEF                      0
 #define MC_SINGLE_THREADED            (1<<0)
@@ -137,8 +171,8 @@ struct multi_context {
 #define MC_WORK_THREAD                (MC_MULTI_THREADED_WORKER|MC_MULTI_THREADED_SCHEDULER)
     int thread_mode;
 
-    struct multi_instance **instances;  /**< Array of multi_instances. An instance can be
-                                         * accessed using peer-id as an index. */
+    struct peer_table *peers;   /**< Peer-id allocator, maps the peer-id
+                                 *   of P_DATA_V2 packets to instances. */
 
     struct hash *hash;          /**< VPN tunnel instances indexed by real
                                  *   address of the remote peer. */
@@ -151,6 +185,12 @@ struct multi_context {
     struct mbuf_set *mbuf;      /**< Set of buffers for passing data
                                  *   channel packets between VPN tunnel
                                  *   instances. */
+    struct pkt_pool *pkt_pool;  /**< Buffers of the packets queued in
+                                 *   \c mbuf and in the queues of the
+                                 *   instances. */
+    struct pacing_calendar *pacing; /**< Packets to clients waiting for
+                                     *   their --pacing departure time,
+                                     *   UDP only. */
     struct multi_tcp *mtcp;     /**< State specific to OpenVPN using TCP
                                  *   as external transport. */
     struct ifconfig_pool *ifconfig_pool;
@@ -163,6 +203,7 @@ struct multi_context {
     int tcp_queue_limit;
     int status_file_version;
     int n_clients; /* current number of authenticated clients */
+    counter_type pacing_dropped; /**< --pacing drops of closed instances */
 
 #ifdef MANAGEMENT_DEF_AUTH
     struct hash *cid_hash;
@@ -189,6 +230,16 @@ struct multi_context {
 #endif
 
     struct deferred_signal_schedule_entry deferred_shutdown_signal;
+
+    struct multi_reload *reloads; /**< Configurations loaded by
+                                   *   \c --graceful-reload, newest first. */
+#ifndef _WIN32
+    struct multi_reload_check *reload_check; /**< Running check of the
+                                              *   configuration, or NULL. */
+#endif
+
+    struct trace_file *trace;   /**< Where \c --trace-capture records
+                                 *   the incoming packets. */
 };
 
 /*
@@ -217,6 +268,7 @@ struct multi_route
  * on the transport protocol used:
  *  - \c tunnel_server_udp()
  *  - \c tunnel_server_tcp()
+ *  - \c tunnel_server_replay() with \c --trace-replay
  *
  * @param top          - Top-level context structure.
  */
@@ -344,6 +396,16 @@ bool multi_process_signal(struct multi_context *m);
 
 void multi_close_instance_on_signal(struct multi_context *m, struct multi_instance *mi);
 
+#ifdef ENABLE_TRACE_REPLAY
+/*
+ * Route the source address of a packet from a client to it, as if it had
+ * been assigned to the client.  Used by --trace-replay, where clients
+ * need not get the addresses they had when the trace was captured.
+ */
+void multi_learn_packet_source(struct multi_context *m, struct multi_instance *mi,
+                               const struct buffer *buf);
+#endif
+
 void init_management_callback_multi(struct multi_context *m);
 
 void uninit_management_callback_multi(struct multi_context *m);
@@ -361,6 +423,18 @@ void multi_process_file_closed(struct multi_context *m, const unsigned int mpp_f
 
 #endif
 
+#ifndef _WIN32
+/**
+ * Called when the reply of the \c --graceful-reload configuration check
+ * can be read.  Once it is complete, the new configuration is taken over
+ * if the check accepted it.
+ *
+ * @param m multi_context
+ */
+void multi_reload_read(struct multi_context *m);
+
+#endif
+
 /*
  * Return true if our output queue is not full
  */
@@ -32,6 +32,7 @@
 #include "init.h"
 #include "forward.h"
 #include "multi.h"
+#include "loadgen.h"
 #include "win32.h"
 #include "platform.h"
 
@@ -142,6 +143,7 @@ tunnel_point_to_point(struct context *c)
  *      - Call event loop function depending on client or server mode:
  *        - \c tunnel_point_to_point()
  *        - \c tunnel_server()
+ *        - \c tunnel_loadgen()
  *    - Level 1 cleanup
  *  - Once-per-process cleanup.
  *
@@ -164,6 +166,8 @@ openvpn_main(int argc, char *argv[])
 #endif
 
     CLEAR(c);
+    c.persist.argc = argc;
+    c.persist.argv = argv;
 
     /* signify first time for components which can
      * only be initialized once per program instantiation. */
@@ -308,6 +312,10 @@ openvpn_main(int argc, char *argv[])
                         tunnel_server(&c);
                         break;
 
+                    case MODE_LOADGEN:
+                        tunnel_loadgen(&c);
+                        break;
+
 #endif
                     default:
                         ASSERT(0);
@@ -35,6 +35,10 @@
 #include "interval.h"
 #include "status.h"
 #include "fragment.h"
+#include "fec.h"
+#include "hdrcomp.h"
+#include "mpath.h"
+#include "pacing.h"
 #include "shaper.h"
 #include "route.h"
 #include "proxy.h"
@@ -115,6 +119,10 @@ struct context_buffers
 struct context_persist
 {
     int restart_sleep_seconds;
+
+    /* command line, parsed again by --graceful-reload */
+    int argc;
+    char **argv;
 };
 
 
@@ -243,10 +251,18 @@ struct context_2
 #endif
 #ifdef ENABLE_ASYNC_PUSH
 #define FILE_CLOSED       (1<<8)
+#endif
+#ifndef _WIN32
+#define RELOAD_READ       (1<<9)
 #endif
 
     unsigned int event_set_status;
 
+    /* --busy-poll: waits that found an event while polling, and that
+     * had to sleep */
+    counter_type busy_poll_hits;
+    counter_type busy_poll_sleeps;
+
     struct link_socket *link_socket;     /* socket used for TCP/UDP connection to remote */
     bool link_socket_owned;
     struct link_socket_info *link_socket_info;
@@ -266,6 +282,18 @@ struct context_2
     struct frame frame_fragment_omit;
 #endif
 
+    /* Forward error correction */
+    struct fec_master *fec;
+
+    /* Header compression of the tunneled packets */
+    struct hc_context *hc;
+
+#if ENABLE_IP_PKTINFO
+    /* Multipath, and the path the last packet came in on */
+    struct mpath *mpath;
+    int from_path;
+#endif
+
 #ifdef ENABLE_FEATURE_SHAPER
     /*
      * Traffic shaper object.
@@ -273,6 +301,11 @@ struct context_2
     struct shaper shaper;
 #endif
 
+    /* --pacing state, and the packets waiting for their departure time
+     * (shared by all instances of a UDP server) */
+    struct pacer pacer;
+    struct pacing_calendar *pacing_calendar;
+
     /*
      * Statistics
      */
@@ -381,6 +414,13 @@ struct context_2
     struct buffer to_tun;
     struct buffer to_link;
 
+#if P2MP_SERVER
+    /* --egress-queue traffic class of to_link, packets that do not come
+     * from the tun device (control channel, ping) stay realtime; not
+     * used without --egress-queue */
+    int to_link_prio;
+#endif
+
     /* should we print R|W|r|w to console on packet transfers? */
     bool log_rw;
 
@@ -481,6 +521,10 @@ struct context_2
 #ifdef ENABLE_ASYNC_PUSH
     int inotify_fd; /* descriptor for monitoring file changes */
 #endif
+
+#ifndef _WIN32
+    int reload_fd; /* reply of a running --graceful-reload check, or -1 */
+#endif
 };
 
 
@@ -530,6 +574,10 @@ struct context
     bool did_we_daemonize;      /**< Whether demonization has already
                                  *   taken place. */
 
+    bool ssl_ctx_shared;        /**< Whether the SSL context in \c c1.ks
+                                 *   belongs to someone else, as for the
+                                 *   clients of \c --mode \c loadgen. */
+
     struct context_persist persist;
     /**< Persistent %context. */
     struct context_0 *c0;       /**< Level 0 %context. */
@@ -43,6 +43,7 @@
 #include "common.h"
 #include "run_command.h"
 #include "shaper.h"
+#include "pacing.h"
 #include "crypto.h"
 #include "ssl.h"
 #include "options.h"
@@ -82,6 +83,9 @@ const char title_string[] =
 #ifdef ENABLE_LZ4
     " [LZ4]"
 #endif
+#ifdef ENABLE_ZSTD
+    " [ZSTD]"
+#endif
 #ifdef ENABLE_COMP_STUB
     " [COMP_STUB]"
 #endif
@@ -123,7 +127,8 @@ static const char usage_message[] =
     "--remote host [port] : Remote host name or ip address.\n"
     "--remote-random : If multiple --remote options specified, choose one randomly.\n"
     "--remote-random-hostname : Add a random string to remote DNS name.\n"
-    "--mode m        : Major mode, m = 'p2p' (default, point-to-point) or 'server'.\n"
+    "--mode m        : Major mode, m = 'p2p' (default, point-to-point), 'server'\n"
+    "                  or 'loadgen'.\n"
     "--proto p       : Use protocol p for communicating with peer.\n"
     "                  p = udp (default), tcp-server, or tcp-client\n"
     "--proto-force p : only consider protocol p in list of connection profiles.\n"
@@ -238,6 +243,8 @@ static const char usage_message[] =
     "                  2 -- allow calling of built-ins and scripts\n"
     "                  3 -- allow password to be passed to scripts via env\n"
     "--shaper n      : Restrict output to peer to n bytes per second.\n"
+    "--pacing n [internal] : Pace packets to each peer at n bytes per second,\n"
+    "                  [internal] don't use the kernel's pacing for UDP.\n"
     "--keepalive n m : Helper option for setting timeouts in server mode.  Send\n"
     "                  ping once every n seconds, restart if ping not received\n"
     "                  for m seconds.\n"
@@ -250,8 +257,16 @@ static const char usage_message[] =
     "--ping n        : Ping remote once every n seconds over TCP/UDP port.\n"
 #if ENABLE_IP_PKTINFO
     "--multihome     : Configure a multi-homed UDP server.\n"
+    "--multipath local remote [port] [weight] : Also send data channel packets\n"
+    "                  from local address local to the peer at remote:port.\n"
+    "                  Packets are spread over all working paths by weight\n"
+    "                  (default=10, the same as the regular connection).\n"
 #endif
     "--fast-io       : (experimental) Optimize TUN/TAP/UDP writes.\n"
+    "--busy-poll usec : Poll for packets for up to usec microseconds before\n"
+    "                  sleeping, to lower the latency at the cost of CPU time.\n"
+    "--tcp-coalesce n : With TCP, collect the packets of a burst in a buffer of\n"
+    "                  n bytes and pass them to the kernel with one system call.\n"
     "--remap-usr1 s  : On SIGUSR1 signals, remap signal (s='SIGHUP' or 'SIGTERM').\n"
     "--persist-tun   : Keep tun/tap device open across SIGUSR1 or --ping-restart.\n"
     "--persist-remote-ip : Keep remote IP address across SIGUSR1 or --ping-restart.\n"
@@ -279,6 +294,11 @@ static const char usage_message[] =
     "                  datagrams are sent which are larger than max bytes.\n"
     "                  Adds 4 bytes of overhead per datagram.\n"
 #endif
+    "--fec k [m]     : Send up to m (default=4) parity packets for every k data\n"
+    "                  packets so that lost packets can be rebuilt by the peer.\n"
+    "                  The amount of parity adapts to the loss the peer sees.\n"
+    "--header-compress [n] : Compress the IP, UDP and RTP headers of up to n\n"
+    "                  (default=16) UDP flows inside the tunnel (--dev tun only).\n"
     "--mssfix [n]    : Set upper bound on TCP MSS, default = tun-mtu size\n"
     "                  or --fragment max value, whichever is lower.\n"
     "--sndbuf size   : Set the TCP/UDP send buffer size.\n"
@@ -325,6 +345,8 @@ static const char usage_message[] =
     "--machine-readable-output : Always log timestamp, message flags to stdout/stderr.\n"
     "--writepid file : Write main process ID to file.\n"
     "--nice n        : Change process priority (>0 = lower, <0 = higher).\n"
+    "--cpu-affinity cpus : Run on the CPUs in the list cpus only, like 2 or 0-3,8,\n"
+    "                  or on those of NUMA node n with noden.\n"
     "--echo [parms ...] : Echo parameters to log output.\n"
     "--verb n        : Set output verbosity to n (default=%d):\n"
     "                  (Level 3 is recommended if you want a good summary\n"
@@ -349,6 +371,11 @@ static const char usage_message[] =
 #endif
 #if defined(USE_COMP)
     "--compress alg  : Use compression algorithm alg\n"
+#if defined(ENABLE_ZSTD)
+    "--compress-level n : Compression level for --compress zstd.\n"
+    "--compress-dict file : Compress with the zstd dictionary in file, if the\n"
+    "                  peer has the same dictionary.\n"
+#endif
 #if defined(ENABLE_LZO)
     "--comp-lzo      : Use LZO compression -- may add up to 1 byte per\n"
     "                  packet for uncompressible data.\n"
@@ -462,11 +489,18 @@ static const char usage_message[] =
     "--client-disconnect cmd : Run command cmd on client disconnection.\n"
     "--client-config-dir dir : Directory for custom client config files.\n"
     "--ccd-exclusive : Refuse connection unless custom client config is found.\n"
+    "--graceful-reload : On SIGHUP, re-read the configuration without\n"
+    "                  disconnecting clients.\n"
     "--tmp-dir dir   : Temporary directory, used for --client-connect return file and plugin communication.\n"
     "--hash-size r v : Set the size of the real address hash table to r and the\n"
     "                  virtual address table to v.\n"
     "--bcast-buffers n : Allocate n broadcast buffers.\n"
     "--tcp-queue-limit n : Maximum number of queued TCP output packets.\n"
+    "--egress-queue  : Queue packets to clients in four traffic classes selected\n"
+    "                  by DSCP, serving realtime traffic first.\n"
+    "--egress-class class type value : Put packets matching type (dscp, tcp-port\n"
+    "                  or udp-port) and value in traffic class class (realtime,\n"
+    "                  interactive, default or bulk).\n"
     "--tcp-nodelay   : Macro that sets TCP_NODELAY socket flag on the server\n"
     "                  as well as pushes it to connecting clients.\n"
     "--learn-address cmd : Run command cmd to validate client virtual addresses.\n"
@@ -484,6 +518,17 @@ static const char usage_message[] =
     "                  sessions to a web server at host:port.  dir specifies an\n"
     "                  optional directory to write origin IP:port data.\n"
 #endif
+#if SOCKET_HANDOVER
+    "--handover-socket path : In UDP server mode, hand the socket and tun device\n"
+    "                  over to a new server process which connects to the unix\n"
+    "                  socket path.  Clients reconnect to the new process.\n"
+#endif
+    "--trace-capture file : Record the packets received from clients (after\n"
+    "                  decryption) and from the tun/tap device to file.\n"
+#ifdef ENABLE_TRACE_REPLAY
+    "--trace-replay file [n] : Run a --trace-capture file n times (default=1)\n"
+    "                  through the server offline on a virtual clock, then exit.\n"
+#endif
 #endif /* if P2MP_SERVER */
     "\n"
     "Client options (when connecting to a multi-client server):\n"
@@ -510,6 +555,16 @@ static const char usage_message[] =
     "                  waiting for a response before trying the next server.\n"
     "--allow-recursive-routing : When this option is set, OpenVPN will not drop\n"
     "                  incoming tun packets with same destination as host.\n"
+#if P2MP_SERVER
+    "\n"
+    "Load generator options (when --mode loadgen is used):\n"
+    "--loadgen n [r] : Simulate n clients of the --remote server, starting\n"
+    "                  up to r new connections per second (default=50).\n"
+    "--loadgen-traffic pps size [ip] : Each connected client sends pps ICMP echo\n"
+    "                  requests of size bytes per second to the server's tunnel\n"
+    "                  address or to ip, and measures the replies.\n"
+    "--loadgen-duration n : Stop after n seconds and print the results.\n"
+#endif
 #endif /* if P2MP */
 #ifdef ENABLE_OCC
     "--explicit-exit-notify [n] : On exit/restart, send exit signal to\n"
@@ -547,6 +602,8 @@ static const char usage_message[] =
     "--replay-window n [t]  : Use a replay protection sliding window of size n\n"
     "                         and a time window of t seconds.\n"
     "                         Default n=%d t=%d\n"
+    "--replay-window-max n : Let the replay window grow up to n when packets\n"
+    "                  arrive too far out of order to fit into it.\n"
     "--replay-persist file : Persist replay-protection state across sessions\n"
     "                  using file.\n"
     "--test-crypto   : Run a self-test of crypto features enabled.\n"
@@ -843,6 +900,9 @@ init_options(struct options *o, const bool init_gc)
 #endif
 #if P2MP
     o->scheduled_exit_interval = 5;
+#endif
+#if P2MP_SERVER
+    o->loadgen_rate = LOADGEN_RATE_DEFAULT;
 #endif
     o->ciphername = "BF-CBC";
 #ifdef HAVE_AEAD_CIPHER_MODES /* IV_NCP=2 requires GCM support */
@@ -1315,6 +1375,12 @@ show_p2mp_parms(const struct options *o)
     SHOW_STR(client_disconnect_script);
     SHOW_STR(client_config_dir);
     SHOW_BOOL(ccd_exclusive);
+    SHOW_BOOL(graceful_reload);
+    SHOW_BOOL(egress_queue);
+    if (o->egress_rules)
+    {
+        print_egress_rule_list(o->egress_rules, D_SHOW_PARMS);
+    }
     SHOW_STR(tmp_dir);
     SHOW_BOOL(push_ifconfig_defined);
     msg(D_SHOW_PARMS, "  push_ifconfig_local = %s", print_in_addr_t(o->push_ifconfig_local, 0, &gc));
@@ -1335,6 +1401,11 @@ show_p2mp_parms(const struct options *o)
 #if PORT_SHARE
     SHOW_STR(port_share_host);
     SHOW_STR(port_share_port);
+#endif
+    SHOW_STR(trace_capture_file);
+#ifdef ENABLE_TRACE_REPLAY
+    SHOW_STR(trace_replay_file);
+    SHOW_INT(trace_replay_repeat);
 #endif
 #endif /* P2MP_SERVER */
 
@@ -1342,6 +1413,15 @@ show_p2mp_parms(const struct options *o)
     SHOW_BOOL(pull);
     SHOW_STR(auth_user_pass_file);
 
+#if P2MP_SERVER
+    SHOW_INT(loadgen_clients);
+    SHOW_INT(loadgen_rate);
+    SHOW_INT(loadgen_pps);
+    SHOW_INT(loadgen_size);
+    SHOW_STR(loadgen_target);
+    SHOW_INT(loadgen_duration);
+#endif
+
     gc_free(&gc);
 }
 
@@ -1596,9 +1676,20 @@ show_settings(const struct options *o)
 #ifdef ENABLE_FEATURE_SHAPER
     SHOW_INT(shaper);
 #endif
+    SHOW_INT(pacing);
+    SHOW_BOOL(pacing_internal);
 #ifdef ENABLE_OCC
     SHOW_INT(mtu_test);
 #endif
+    SHOW_INT(fec_k);
+    SHOW_INT(fec_m);
+    SHOW_INT(hc_contexts);
+#if ENABLE_IP_PKTINFO
+    if (o->mpath)
+    {
+        print_mpath_options(o->mpath, D_SHOW_PARMS);
+    }
+#endif
 
     SHOW_BOOL(mlock);
 
@@ -1641,6 +1732,7 @@ show_settings(const struct options *o)
     SHOW_BOOL(suppress_timestamps);
     SHOW_BOOL(machine_readable_output);
     SHOW_INT(nice);
+    SHOW_STR(cpu_affinity);
     SHOW_INT(verbosity);
     SHOW_INT(mute);
 #ifdef ENABLE_DEBUG
@@ -1661,10 +1753,16 @@ show_settings(const struct options *o)
     SHOW_INT(sockflags);
 
     SHOW_BOOL(fast_io);
+    SHOW_INT(busy_poll);
+    SHOW_INT(tcp_coalesce);
 
 #ifdef USE_COMP
     SHOW_INT(comp.alg);
     SHOW_INT(comp.flags);
+#ifdef ENABLE_ZSTD
+    SHOW_INT(comp.level);
+    SHOW_STR(comp.dict_file);
+#endif
 #endif
 
     SHOW_STR(route_script);
@@ -1722,6 +1820,7 @@ show_settings(const struct options *o)
     SHOW_BOOL(replay);
     SHOW_BOOL(mute_replay_warnings);
     SHOW_INT(replay_window);
+    SHOW_INT(replay_window_max);
     SHOW_INT(replay_time);
     SHOW_STR(packet_id_file);
     SHOW_BOOL(test_crypto);
@@ -2101,6 +2200,39 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
     }
 #endif
 
+    if (!proto_is_udp(ce->proto) && options->fec_k)
+    {
+        msg(M_USAGE, "--fec can only be used with --proto udp");
+    }
+
+    if (options->tcp_coalesce && options->shaper)
+    {
+        msg(M_USAGE, "--tcp-coalesce cannot be used with --shaper");
+    }
+
+    if (options->hc_contexts && dev != DEV_TYPE_TUN)
+    {
+        msg(M_USAGE, "--header-compress can only be used with --dev tun");
+    }
+
+#if ENABLE_IP_PKTINFO
+    if (options->mpath)
+    {
+        if (!proto_is_udp(ce->proto))
+        {
+            msg(M_USAGE, "--multipath can only be used with --proto udp");
+        }
+        if (ce->local)
+        {
+            msg(M_USAGE, "--multipath cannot be used with --local, the socket must be bound to all addresses");
+        }
+        if (ce->socks_proxy_server)
+        {
+            msg(M_USAGE, "--multipath cannot be used with --socks-proxy");
+        }
+    }
+#endif
+
     /* will we be pulling options from server? */
 #if P2MP
     pull = options->pull;
@@ -2284,6 +2416,38 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
             msg(M_USAGE, "--port-share only works in TCP server mode "
                 "(--proto tcp-server or tcp6-server)");
         }
+#endif
+#if SOCKET_HANDOVER
+        if (options->handover_socket && !proto_is_dgram(ce->proto))
+        {
+            msg(M_USAGE, "--handover-socket only works in UDP server mode");
+        }
+#endif
+#ifdef ENABLE_TRACE_REPLAY
+        if (options->trace_replay_file)
+        {
+#ifdef _WIN32
+            msg(M_USAGE, "--trace-replay is not supported on Windows");
+#endif
+            if (!proto_is_dgram(ce->proto))
+            {
+                msg(M_USAGE, "--trace-replay only works in UDP server mode");
+            }
+            if (options->trace_capture_file)
+            {
+                msg(M_USAGE, "--trace-capture cannot be used with --trace-replay");
+            }
+#ifdef ENABLE_MANAGEMENT
+            if (options->management_addr)
+            {
+                msg(M_USAGE, "--management cannot be used with --trace-replay");
+            }
+#endif
+            if (ce->fragment || options->hc_contexts)
+            {
+                msg(M_USAGE, "--fragment and --header-compress cannot be used with --trace-replay");
+            }
+        }
 #endif
         if (!options->tls_server)
         {
@@ -2317,6 +2481,20 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
         {
             msg(M_USAGE, "--shaper cannot be used with --mode server");
         }
+        if (options->fec_k)
+        {
+            msg(M_USAGE, "--fec cannot be used with --mode server");
+        }
+        if (options->tcp_coalesce)
+        {
+            msg(M_USAGE, "--tcp-coalesce cannot be used with --mode server");
+        }
+#if ENABLE_IP_PKTINFO
+        if (options->mpath)
+        {
+            msg(M_USAGE, "--multipath cannot be used with --mode server");
+        }
+#endif
         if (options->inetd)
         {
             msg(M_USAGE, "--inetd cannot be used with --mode server");
@@ -2370,6 +2548,10 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
         {
             msg(M_USAGE, "--ccd-exclusive must be used with --client-config-dir");
         }
+        if (options->egress_rules && !options->egress_queue)
+        {
+            msg(M_USAGE, "--egress-class must be used with --egress-queue");
+        }
         if (options->key_method != 2)
         {
             msg(M_USAGE, "--mode server requires --key-method 2");
@@ -2433,6 +2615,14 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
         {
             msg(M_USAGE, "--client-to-client requires --mode server");
         }
+        if (options->graceful_reload)
+        {
+            msg(M_USAGE, "--graceful-reload requires --mode server");
+        }
+        if (options->egress_queue || options->egress_rules)
+        {
+            msg(M_USAGE, "--egress-queue/--egress-class requires --mode server");
+        }
         if (options->duplicate_cn)
         {
             msg(M_USAGE, "--duplicate-cn requires --mode server");
@@ -2477,6 +2667,22 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
             msg(M_USAGE, "--port-share requires TCP server mode (--mode server --proto tcp-server)");
         }
 #endif
+#if SOCKET_HANDOVER
+        if (options->handover_socket)
+        {
+            msg(M_USAGE, "--handover-socket requires --mode server");
+        }
+#endif
+        if (options->trace_capture_file)
+        {
+            msg(M_USAGE, "--trace-capture requires --mode server");
+        }
+#ifdef ENABLE_TRACE_REPLAY
+        if (options->trace_replay_file)
+        {
+            msg(M_USAGE, "--trace-replay requires --mode server");
+        }
+#endif
 
         if (options->stale_routes_check_interval)
         {
@@ -2489,6 +2695,45 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
     }
 #endif /* P2MP_SERVER */
 
+#if P2MP_SERVER
+    /*
+     * Check consistency of --mode loadgen options.
+     */
+    if (options->mode == MODE_LOADGEN)
+    {
+        if (!options->loadgen_clients)
+        {
+            msg(M_USAGE, "--mode loadgen requires --loadgen");
+        }
+        if (!options->tls_client || !options->pull)
+        {
+            msg(M_USAGE, "--mode loadgen requires --client (or --tls-client and --pull)");
+        }
+        if (ce->proto == PROTO_TCP_SERVER)
+        {
+            msg(M_USAGE, "--mode loadgen cannot be used with --proto tcp-server");
+        }
+        if (ce->local_port_defined)
+        {
+            msg(M_USAGE, "--lport cannot be used with --mode loadgen, each simulated client uses a port of its own");
+        }
+        if (options->inetd)
+        {
+            msg(M_USAGE, "--inetd cannot be used with --mode loadgen");
+        }
+#ifdef ENABLE_MANAGEMENT
+        if (options->management_addr)
+        {
+            msg(M_USAGE, "--management cannot be used with --mode loadgen");
+        }
+#endif
+    }
+    else if (options->loadgen_clients || options->loadgen_pps || options->loadgen_duration)
+    {
+        msg(M_USAGE, "--loadgen, --loadgen-traffic and --loadgen-duration require --mode loadgen");
+    }
+#endif
+
     if (options->ncp_enabled && !tls_check_ncp_cipher_list(options->ncp_ciphers))
     {
         msg(M_USAGE, "NCP cipher list contains unsupported ciphers.");
@@ -2508,6 +2753,15 @@ options_postprocess_verify_ce(const struct options *options, const struct connec
     {
         msg(M_USAGE, "--replay-window doesn't make sense when replay protection is disabled with --no-replay");
     }
+    if (!options->replay && options->replay_window_max)
+    {
+        msg(M_USAGE, "--replay-window-max doesn't make sense when replay protection is disabled with --no-replay");
+    }
+    if (options->replay_window_max && options->replay_window_max < options->replay_window)
+    {
+        msg(M_USAGE, "--replay-window-max (%d) must not be smaller than the --replay-window size (%d)",
+            options->replay_window_max, options->replay_window);
+    }
 
     /*
      * SSL/TLS mode sanity checks.
@@ -2828,6 +3082,21 @@ options_postprocess_mutate_ce(struct options *o, struct connection_entry *ce)
         ce->bind_local = false;
     }
 
+#if P2MP_SERVER
+    /* the simulated clients of --mode loadgen cannot share a local port */
+    if (o->mode == MODE_LOADGEN && !ce->local_port_defined)
+    {
+        if (ce->local)
+        {
+            ce->local_port = "0";
+        }
+        else
+        {
+            ce->bind_local = false;
+        }
+    }
+#endif
+
     if (!ce->bind_local)
     {
         ce->local_port = NULL;
@@ -3028,6 +3297,15 @@ options_postprocess_mutate(struct options *o)
     helper_keepalive(o);
     helper_tcp_nodelay(o);
 
+#if P2MP_SERVER
+    /* the simulated clients of --mode loadgen stand in for tun clients,
+     * unless told otherwise */
+    if (o->mode == MODE_LOADGEN && !o->dev)
+    {
+        o->dev = "tun";
+    }
+#endif
+
     options_postprocess_mutate_invariant(o);
 
     if (o->remote_list && !o->connection_list)
@@ -3089,6 +3367,26 @@ options_postprocess_mutate(struct options *o)
         o->ncp_enabled = false;
     }
 
+#ifdef USE_COMP
+    /* a client or server only uses a shared dictionary the peer also has */
+    if (o->pull || o->mode == MODE_SERVER)
+    {
+        o->comp.flags |= COMP_F_DICT_NEGOTIATE;
+    }
+#endif
+
+#if ENABLE_IP_PKTINFO
+    /* packets sent over paths with different delays arrive out of order */
+    if (o->mpath && !o->replay_window_defined)
+    {
+        o->replay_window = MPATH_REPLAY_WINDOW;
+    }
+    if (o->mpath && o->replay && !o->replay_window_max)
+    {
+        o->replay_window_max = MAX_SEQ_BACKTRACK;
+    }
+#endif
+
 #if ENABLE_MANAGEMENT
     if (o->http_proxy_override)
     {
@@ -3375,6 +3673,10 @@ options_postprocess_filechecks(struct options *options)
     /* ** Config related ** */
     errs |= check_file_access_chroot(options->chroot_dir, CHKACC_FILE, options->tls_export_cert,
                                      R_OK|W_OK|X_OK, "--tls-export-cert");
+#ifdef ENABLE_ZSTD
+    errs |= check_file_access(CHKACC_FILE, options->comp.dict_file, R_OK,
+                              "--compress-dict");
+#endif
 #if P2MP_SERVER
     errs |= check_file_access_chroot(options->chroot_dir, CHKACC_FILE, options->client_config_dir,
                                      R_OK|X_OK, "--client-config-dir");
@@ -3572,15 +3874,23 @@ options_string(const struct options *o,
                struct gc_arena *gc)
 {
     struct buffer out = alloc_buf(OPTION_LINE_SIZE);
+    const char *dev_type = dev_type_string(o->dev, o->dev_type);
     bool tt_local = false;
 
+#if P2MP_SERVER
+    if (o->loadgen_dev_type)
+    {
+        dev_type = o->loadgen_dev_type;
+    }
+#endif
+
     buf_printf(&out, "V4");
 
     /*
      * Tunnel Options
      */
 
-    buf_printf(&out, ",dev-type %s", dev_type_string(o->dev, o->dev_type));
+    buf_printf(&out, ",dev-type %s", dev_type);
     buf_printf(&out, ",link-mtu %u", (unsigned int) calc_options_string_link_mtu(o, frame));
     buf_printf(&out, ",tun-mtu %d", PAYLOAD_SIZE(frame));
     buf_printf(&out, ",proto %s",  proto_remote(o->ce.proto, remote));
@@ -3645,6 +3955,16 @@ options_string(const struct options *o,
     }
 #endif
 
+    if (o->fec_k)
+    {
+        buf_printf(&out, ",fec");
+    }
+
+    if (o->hc_contexts)
+    {
+        buf_printf(&out, ",header-compress");
+    }
+
 #define TLS_CLIENT (o->tls_client)
 #define TLS_SERVER (o->tls_server)
 
@@ -5219,6 +5539,10 @@ add_option(struct options *options,
         {
             options->mode = MODE_SERVER;
         }
+        else if (streq(p[1], "loadgen"))
+        {
+            options->mode = MODE_LOADGEN;
+        }
 #endif
         else
         {
@@ -5722,6 +6046,26 @@ add_option(struct options *options,
         VERIFY_PERMISSION(OPT_P_GENERAL);
         options->sockflags |= SF_USE_IP_PKTINFO;
     }
+    else if (streq(p[0], "multipath") && p[1] && p[2] && !p[5])
+    {
+        int weight = MPATH_DEFAULT_WEIGHT;
+
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        if (p[3] && p[4])
+        {
+            weight = atoi(p[4]);
+        }
+        if (!options->mpath)
+        {
+            options->mpath = new_mpath_options(&options->gc);
+        }
+        if (!add_mpath_entry(options->mpath, p[1], p[2], p[3], weight, msglevel))
+        {
+            goto err;
+        }
+        /* all paths share the socket, the local address is chosen per packet */
+        options->sockflags |= SF_USE_IP_PKTINFO;
+    }
 #endif
     else if (streq(p[0], "verb") && p[1] && !p[2])
     {
@@ -5817,6 +6161,42 @@ add_option(struct options *options,
         options->ce.fragment = positive_atoi(p[1]);
     }
 #endif
+    else if (streq(p[0], "fec") && p[1] && !p[3])
+    {
+        int k, m = 4;
+
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        k = atoi(p[1]);
+        if (p[2])
+        {
+            m = atoi(p[2]);
+        }
+        if (k < 1 || k > FEC_MAX_DATA || m < 1 || m > FEC_MAX_PARITY)
+        {
+            msg(msglevel, "--fec: k must be between 1 and %d, m between 1 and %d",
+                FEC_MAX_DATA, FEC_MAX_PARITY);
+            goto err;
+        }
+        options->fec_k = k;
+        options->fec_m = m;
+    }
+    else if (streq(p[0], "header-compress") && !p[2])
+    {
+        int n = HC_CONTEXTS_DEFAULT;
+
+        VERIFY_PERMISSION(OPT_P_COMP);
+        if (p[1])
+        {
+            n = atoi(p[1]);
+        }
+        if (n < 1 || n > HC_CONTEXTS_MAX)
+        {
+            msg(msglevel, "--header-compress: n must be between 1 and %d",
+                HC_CONTEXTS_MAX);
+            goto err;
+        }
+        options->hc_contexts = n;
+    }
     else if (streq(p[0], "mtu-disc") && p[1] && !p[2])
     {
         VERIFY_PERMISSION(OPT_P_MTU|OPT_P_CONNECTION);
@@ -5834,6 +6214,16 @@ add_option(struct options *options,
         VERIFY_PERMISSION(OPT_P_NICE);
         options->nice = atoi(p[1]);
     }
+    else if (streq(p[0], "cpu-affinity") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        if (!platform_cpu_affinity_valid(p[1]))
+        {
+            msg(msglevel, "--cpu-affinity: bad CPU list or unknown NUMA node '%s'", p[1]);
+            goto err;
+        }
+        options->cpu_affinity = p[1];
+    }
     else if (streq(p[0], "rcvbuf") && p[1] && !p[2])
     {
         VERIFY_PERMISSION(OPT_P_SOCKBUF);
@@ -5897,6 +6287,30 @@ add_option(struct options *options,
         goto err;
 #endif /* ENABLE_FEATURE_SHAPER */
     }
+    else if (streq(p[0], "pacing") && p[1] && !p[3])
+    {
+        int rate;
+
+        VERIFY_PERMISSION(OPT_P_GENERAL|OPT_P_INSTANCE);
+#ifdef _WIN32
+        msg(msglevel, "--pacing is not supported on Windows");
+        goto err;
+#endif
+        rate = atoi(p[1]);
+        if (rate < PACING_MIN || rate > PACING_MAX)
+        {
+            msg(msglevel, "--pacing: rate must be between %d and %d bytes per second",
+                PACING_MIN, PACING_MAX);
+            goto err;
+        }
+        if (p[2] && !streq(p[2], "internal"))
+        {
+            msg(msglevel, "--pacing: unknown parameter '%s'", p[2]);
+            goto err;
+        }
+        options->pacing = rate;
+        options->pacing_internal = (p[2] != NULL);
+    }
     else if (streq(p[0], "port") && p[1] && !p[2])
     {
         VERIFY_PERMISSION(OPT_P_GENERAL|OPT_P_CONNECTION);
@@ -5933,6 +6347,30 @@ add_option(struct options *options,
         VERIFY_PERMISSION(OPT_P_GENERAL);
         options->fast_io = true;
     }
+    else if (streq(p[0], "busy-poll") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->busy_poll = atoi(p[1]);
+        if (options->busy_poll < 1 || options->busy_poll > 1000000)
+        {
+            msg(msglevel, "--busy-poll must be between 1 and 1000000 microseconds");
+            goto err;
+        }
+    }
+    else if (streq(p[0], "tcp-coalesce") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+#ifdef _WIN32
+        msg(msglevel, "--tcp-coalesce is not supported on Windows");
+        goto err;
+#endif
+        options->tcp_coalesce = atoi(p[1]);
+        if (options->tcp_coalesce < 4096 || options->tcp_coalesce > 1048576)
+        {
+            msg(msglevel, "--tcp-coalesce must be between 4096 and 1048576 bytes");
+            goto err;
+        }
+    }
     else if (streq(p[0], "inactive") && p[1] && !p[3])
     {
         VERIFY_PERMISSION(OPT_P_TIMER);
@@ -6813,6 +7251,11 @@ add_option(struct options *options,
         VERIFY_PERMISSION(OPT_P_GENERAL);
         options->ccd_exclusive = true;
     }
+    else if (streq(p[0], "graceful-reload") && !p[1])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->graceful_reload = true;
+    }
     else if (streq(p[0], "bcast-buffers") && p[1] && !p[2])
     {
         int n_bcast_buf;
@@ -6837,6 +7280,20 @@ add_option(struct options *options,
         }
         options->tcp_queue_limit = tcp_queue_limit;
     }
+    else if (streq(p[0], "egress-queue") && !p[1])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->egress_queue = true;
+    }
+    else if (streq(p[0], "egress-class") && p[1] && p[2] && p[3] && !p[4])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        if (!options->egress_rules)
+        {
+            options->egress_rules = new_egress_rule_list(&options->gc);
+        }
+        add_egress_rule(options->egress_rules, p[1], p[2], p[3], msglevel);
+    }
 #if PORT_SHARE
     else if (streq(p[0], "port-share") && p[1] && p[2] && !p[4])
     {
@@ -6845,6 +7302,37 @@ add_option(struct options *options,
         options->port_share_port = p[2];
         options->port_share_journal_dir = p[3];
     }
+#endif
+#if SOCKET_HANDOVER
+    else if (streq(p[0], "handover-socket") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->handover_socket = p[1];
+    }
+#endif
+    else if (streq(p[0], "trace-capture") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->trace_capture_file = p[1];
+    }
+#ifdef ENABLE_TRACE_REPLAY
+    else if (streq(p[0], "trace-replay") && p[1] && !p[3])
+    {
+        int n = 1;
+
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        if (p[2])
+        {
+            n = positive_atoi(p[2]);
+            if (n < 1)
+            {
+                msg(msglevel, "--trace-replay repeat count must be at least 1");
+                goto err;
+            }
+        }
+        options->trace_replay_file = p[1];
+        options->trace_replay_repeat = n;
+    }
 #endif
     else if (streq(p[0], "client-to-client") && !p[1])
     {
@@ -7030,6 +7518,50 @@ add_option(struct options *options,
         }
     }
 #endif
+#if P2MP_SERVER
+    else if (streq(p[0], "loadgen") && p[1] && !p[3])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->loadgen_clients = atoi(p[1]);
+        if (options->loadgen_clients < 1)
+        {
+            msg(msglevel, "--loadgen must simulate at least one client");
+            goto err;
+        }
+        if (p[2])
+        {
+            options->loadgen_rate = atoi(p[2]);
+            if (options->loadgen_rate < 1)
+            {
+                msg(msglevel, "--loadgen connection rate must be > 0");
+                goto err;
+            }
+        }
+    }
+    else if (streq(p[0], "loadgen-traffic") && p[1] && p[2] && !p[4])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->loadgen_pps = atoi(p[1]);
+        options->loadgen_size = atoi(p[2]);
+        if (options->loadgen_pps < 1 || options->loadgen_pps > 1000000)
+        {
+            msg(msglevel, "--loadgen-traffic packet rate must be between 1 and 1000000");
+            goto err;
+        }
+        if (options->loadgen_size < LOADGEN_MIN_SIZE || options->loadgen_size > 65535)
+        {
+            msg(msglevel, "--loadgen-traffic packet size must be between %d and 65535",
+                LOADGEN_MIN_SIZE);
+            goto err;
+        }
+        options->loadgen_target = p[3];
+    }
+    else if (streq(p[0], "loadgen-duration") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->loadgen_duration = positive_atoi(p[1]);
+    }
+#endif
 #endif /* if P2MP */
     else if (streq(p[0], "msg-channel") && p[1])
     {
@@ -7441,6 +7973,14 @@ add_option(struct options *options,
                 options->comp.alg = COMP_ALGV2_LZ4;
                 options->comp.flags = 0;
             }
+#endif
+#if defined(ENABLE_ZSTD)
+            else if (streq(p[1], "zstd"))
+            {
+                options->comp.alg = COMP_ALGV2_ZSTD;
+                /* a pushed --compress is parsed after postprocessing */
+                options->comp.flags &= COMP_F_DICT_NEGOTIATE;
+            }
 #endif
             else
             {
@@ -7454,6 +7994,18 @@ add_option(struct options *options,
             options->comp.flags = COMP_F_SWAP;
         }
     }
+#if defined(ENABLE_ZSTD)
+    else if (streq(p[0], "compress-level") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_COMP);
+        options->comp.level = atoi(p[1]);
+    }
+    else if (streq(p[0], "compress-dict") && p[1] && !p[2])
+    {
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        options->comp.dict_file = p[1];
+    }
+#endif
 #endif /* USE_COMP */
     else if (streq(p[0], "show-ciphers") && !p[1])
     {
@@ -7593,6 +8145,7 @@ add_option(struct options *options,
                 goto err;
             }
             options->replay_window = replay_window;
+            options->replay_window_defined = true;
 
             if (p[2])
             {
@@ -7616,6 +8169,22 @@ add_option(struct options *options,
             goto err;
         }
     }
+    else if (streq(p[0], "replay-window-max") && p[1] && !p[2])
+    {
+        int replay_window_max;
+
+        VERIFY_PERMISSION(OPT_P_GENERAL);
+        replay_window_max = atoi(p[1]);
+        if (!(MIN_SEQ_BACKTRACK < replay_window_max && replay_window_max <= MAX_SEQ_BACKTRACK))
+        {
+            msg(msglevel, "replay-window-max parameter (%d) must be between %d and %d",
+                replay_window_max,
+                MIN_SEQ_BACKTRACK + 1,
+                MAX_SEQ_BACKTRACK);
+            goto err;
+        }
+        options->replay_window_max = replay_window_max;
+    }
     else if (streq(p[0], "mute-replay-warnings") && !p[1])
     {
         VERIFY_PERMISSION(OPT_P_GENERAL);
@@ -41,6 +41,9 @@
 #include "comp.h"
 #include "pushlist.h"
 #include "clinat.h"
+#include "egress.h"
+#include "fec.h"
+#include "mpath.h"
 #include "crypto_backend.h"
 
 
@@ -184,6 +187,7 @@ struct options
     /* major mode */
 #define MODE_POINT_TO_POINT 0
 #define MODE_SERVER         1
+#define MODE_LOADGEN        2
     int mode;
 
     /* enable forward compatibility for post-2.1 features */
@@ -238,12 +242,25 @@ struct options
     int shaper;
 #endif
 
+    int pacing;                 /* bytes per second to the peer, 0 = off */
+    bool pacing_internal;       /* don't let the kernel pace UDP */
+
     int proto_force;
 
 #ifdef ENABLE_OCC
     bool mtu_test;
 #endif
 
+    /* forward error correction */
+    int fec_k;          /* data packets per block, 0 = disabled */
+    int fec_m;          /* maximum parity packets per block */
+
+    int hc_contexts;    /* header compression flows, 0 = disabled */
+
+#if ENABLE_IP_PKTINFO
+    struct mpath_options *mpath;
+#endif
+
 #ifdef ENABLE_MEMSTATS
     char *memstats_fn;
 #endif
@@ -306,6 +323,7 @@ struct options
     bool suppress_timestamps;
     bool machine_readable_output;
     int nice;
+    const char *cpu_affinity;
     int verbosity;
     int mute;
 
@@ -320,6 +338,12 @@ struct options
     /* optimize TUN/TAP/UDP writes */
     bool fast_io;
 
+    /* microseconds to poll for packets before sleeping, 0 = off */
+    int busy_poll;
+
+    /* size of the buffer for coalescing TCP writes, 0 = off */
+    int tcp_coalesce;
+
 #ifdef USE_COMP
     struct compress_options comp;
 #endif
@@ -422,9 +446,12 @@ struct options
     const char *learn_address_script;
     const char *client_config_dir;
     bool ccd_exclusive;
+    bool graceful_reload;
     bool disable;
     int n_bcast_buf;
     int tcp_queue_limit;
+    bool egress_queue;
+    struct egress_rule_list *egress_rules;
     struct iroute *iroutes;
     struct iroute_ipv6 *iroutes_ipv6;                   /* IPv6 */
     bool push_ifconfig_defined;
@@ -458,6 +485,14 @@ struct options
     char *port_share_port;
     const char *port_share_journal_dir;
 #endif
+#if SOCKET_HANDOVER
+    const char *handover_socket;
+#endif
+    const char *trace_capture_file;
+#ifdef ENABLE_TRACE_REPLAY
+    const char *trace_replay_file;
+    int trace_replay_repeat;
+#endif
 #endif /* if P2MP_SERVER */
 
     bool client;
@@ -472,6 +507,19 @@ struct options
 #ifdef ENABLE_CLIENT_CR
     struct static_challenge_info sc_info;
 #endif
+
+#if P2MP_SERVER
+    /* --mode loadgen */
+#define LOADGEN_RATE_DEFAULT 50
+#define LOADGEN_MIN_SIZE     36  /* IPv4 and ICMP header, timestamp */
+    int loadgen_clients;
+    int loadgen_rate;           /* new clients per second */
+    int loadgen_pps;            /* echo requests per second and client */
+    int loadgen_size;           /* size of an echo request packet */
+    const char *loadgen_target;
+    int loadgen_duration;       /* seconds, 0 = until signalled */
+    const char *loadgen_dev_type; /* reported by the simulated clients */
+#endif
 #endif /* if P2MP */
 
     /* Cipher parms */
@@ -489,6 +537,8 @@ struct options
     bool replay;
     bool mute_replay_warnings;
     int replay_window;
+    bool replay_window_defined; /* true if given with --replay-window */
+    int replay_window_max;
     int replay_time;
     const char *packet_id_file;
     bool test_crypto;
@@ -35,6 +35,11 @@
 
 time_t now = 0;            /* GLOBAL */
 
+#ifdef ENABLE_TRACE_REPLAY
+bool virtual_clock = false;  /* GLOBAL */
+struct timeval virtual_now;  /* GLOBAL */
+#endif
+
 #if TIME_BACKTRACK_PROTECTION
 
 static time_t now_adj = 0; /* GLOBAL */
@@ -81,6 +86,19 @@ update_now_usec(struct timeval *tv)
 
 #endif /* TIME_BACKTRACK_PROTECTION */
 
+#ifdef ENABLE_TRACE_REPLAY
+void
+set_virtual_time(const struct timeval *tv)
+{
+    virtual_clock = true;
+    virtual_now = *tv;
+    now = tv->tv_sec;
+#if TIME_BACKTRACK_PROTECTION
+    now_usec = tv->tv_usec;
+#endif
+}
+#endif /* ENABLE_TRACE_REPLAY */
+
 /*
  * Return a numerical string describing a struct timeval.
  */
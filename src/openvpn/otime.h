@@ -53,6 +53,19 @@ const char *tv_string_abs(const struct timeval *tv, struct gc_arena *gc);
 
 extern time_t now; /* updated frequently to time(NULL) */
 
+#ifdef ENABLE_TRACE_REPLAY
+/*
+ * When the clock is virtual, the system clock is no longer read, and
+ * time only advances by set_virtual_time() (see --trace-replay).  Only
+ * built with --enable-trace-replay, since it adds a test to every
+ * update_time() and openvpn_gettimeofday().
+ */
+extern bool virtual_clock;
+extern struct timeval virtual_now;
+
+void set_virtual_time(const struct timeval *tv);
+#endif
+
 void time_test(void);
 
 #if TIME_BACKTRACK_PROTECTION
@@ -65,6 +78,13 @@ void update_now_usec(struct timeval *tv);
 static inline int
 openvpn_gettimeofday(struct timeval *tv, void *tz)
 {
+#ifdef ENABLE_TRACE_REPLAY
+    if (virtual_clock)
+    {
+        *tv = virtual_now;
+        return 0;
+    }
+#endif
     const int status = gettimeofday(tv, tz);
     if (!status)
     {
@@ -78,6 +98,12 @@ openvpn_gettimeofday(struct timeval *tv, void *tz)
 static inline void
 update_time(void)
 {
+#ifdef ENABLE_TRACE_REPLAY
+    if (virtual_clock)
+    {
+        return;
+    }
+#endif
 #ifdef _WIN32
     /* on _WIN32, gettimeofday is faster than time(NULL) */
     struct timeval tv;
@@ -92,6 +118,12 @@ update_time(void)
 static inline void
 update_time(void)
 {
+#ifdef ENABLE_TRACE_REPLAY
+    if (virtual_clock)
+    {
+        return;
+    }
+#endif
 #if defined(_WIN32)
     /* on _WIN32, gettimeofday is faster than time(NULL) */
     struct timeval tv;
@@ -114,6 +146,13 @@ update_time(void)
 static inline int
 openvpn_gettimeofday(struct timeval *tv, void *tz)
 {
+#ifdef ENABLE_TRACE_REPLAY
+    if (virtual_clock)
+    {
+        *tv = virtual_now;
+        return 0;
+    }
+#endif
     return gettimeofday(tv, tz);
 }
 
@@ -0,0 +1,173 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "pacing.h"
+
+#include "memdbg.h"
+
+struct pacing_calendar *
+pacing_calendar_new(int buf_size)
+{
+    struct pacing_calendar *cal;
+    int i;
+
+    ALLOC_OBJ_CLEAR(cal, struct pacing_calendar);
+    cal->buf_size = buf_size;
+    for (i = 0; i < PACING_CALENDAR_SIZE; ++i)
+    {
+        cal->free[i] = PACING_CALENDAR_SIZE - 1 - i;
+    }
+    cal->n_free = PACING_CALENDAR_SIZE;
+    return cal;
+}
+
+void
+pacing_calendar_free(struct pacing_calendar *cal)
+{
+    int i;
+
+    for (i = 0; i < PACING_CALENDAR_SIZE; ++i)
+    {
+        free_buf(&cal->entries[i].buf);
+    }
+    free(cal);
+}
+
+static inline bool
+earlier(const struct pacing_calendar *cal, int a, int b)
+{
+    return cal->entries[cal->heap[a]].due < cal->entries[cal->heap[b]].due;
+}
+
+static inline void
+swap(struct pacing_calendar *cal, int a, int b)
+{
+    const int tmp = cal->heap[a];
+    cal->heap[a] = cal->heap[b];
+    cal->heap[b] = tmp;
+}
+
+bool
+pacing_calendar_add(struct pacing_calendar *cal, uint64_t due,
+                    const struct buffer *buf,
+                    const struct link_socket_actual *to)
+{
+    struct pacing_entry *e;
+    int i;
+
+    if (!cal->n_free || BLEN(buf) > cal->buf_size)
+    {
+        ++cal->n_dropped;
+        return false;
+    }
+
+    /* buffers are allocated on first use and kept */
+    i = cal->free[--cal->n_free];
+    e = &cal->entries[i];
+    if (!e->buf.data)
+    {
+        e->buf = alloc_buf(cal->buf_size);
+    }
+    buf_init(&e->buf, 0);
+    ASSERT(buf_copy(&e->buf, buf));
+    e->to = *to;
+    e->due = due;
+    ++cal->n_queued;
+
+    /* sift up */
+    cal->heap[cal->n] = i;
+    for (i = cal->n++; i > 0 && earlier(cal, i, (i - 1) / 2); i = (i - 1) / 2)
+    {
+        swap(cal, i, (i - 1) / 2);
+    }
+    return true;
+}
+
+struct pacing_entry *
+pacing_calendar_next(struct pacing_calendar *cal, uint64_t now)
+{
+    int top, i;
+
+    if (!cal->n || cal->entries[cal->heap[0]].due > now)
+    {
+        return NULL;
+    }
+
+    top = cal->heap[0];
+    cal->free[cal->n_free++] = top;
+    if (cal->entries[top].due + PACING_SLACK_NSEC < now)
+    {
+        ++cal->n_late;
+    }
+
+    /* sift down */
+    cal->heap[0] = cal->heap[--cal->n];
+    i = 0;
+    while (true)
+    {
+        const int l = 2 * i + 1, r = l + 1;
+        int min = i;
+
+        if (l < cal->n && earlier(cal, l, min))
+        {
+            min = l;
+        }
+        if (r < cal->n && earlier(cal, r, min))
+        {
+            min = r;
+        }
+        if (min == i)
+        {
+            break;
+        }
+        swap(cal, i, min);
+        i = min;
+    }
+
+    return &cal->entries[top];
+}
+
+void
+pacing_calendar_timeout(const struct pacing_calendar *cal, uint64_t now,
+                        struct timeval *tv)
+{
+    if (cal->n)
+    {
+        const uint64_t due = cal->entries[cal->heap[0]].due;
+        const uint64_t usec = due > now ? (due - now + 999) / 1000 : 0;
+
+        if ((uint64_t)tv->tv_sec * 1000000 + tv->tv_usec > usec)
+        {
+            tv->tv_sec = usec / 1000000;
+            tv->tv_usec = usec % 1000000;
+        }
+    }
+}
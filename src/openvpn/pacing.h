@@ -0,0 +1,167 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Pacing of the packets sent to a peer (--pacing).
+ *
+ * Every peer has a pacer which gives each outgoing packet a departure
+ * time, so that packets leave at the configured rate instead of in
+ * bursts.  On UDP sockets the departure time is handed to the kernel
+ * with SO_TXTIME where that is available.  Otherwise packets that are
+ * not due yet wait in a pacing calendar, a queue ordered by departure
+ * time that the event loop drains.  TCP sockets are paced by the kernel
+ * with SO_MAX_PACING_RATE.
+ */
+
+#ifndef PACING_H
+#define PACING_H
+
+#include "buffer.h"
+#include "socket.h"
+
+#define PACING_MIN            100           /**< Bytes per second. */
+#define PACING_MAX            1000000000
+
+#define PACING_SLACK_NSEC     1000000       /**< How far a pacer may fall
+                                             *   behind and catch up. */
+#define PACING_HORIZON_NSEC   200000000     /**< Packets due later than this
+                                             *   are dropped. */
+#define PACING_CALENDAR_SIZE  256           /**< Packets waiting in a calendar. */
+
+/**
+ * Pacing state of one peer.
+ */
+struct pacer
+{
+    uint64_t next;          /**< Earliest departure of the next packet,
+                             *   see pacing_now(). */
+    int tcp_rate;           /**< Rate set on the TCP socket. */
+    counter_type dropped;
+};
+
+struct pacing_entry
+{
+    uint64_t due;
+    struct link_socket_actual to;
+    struct buffer buf;
+};
+
+/**
+ * Packets waiting for their departure time.
+ */
+struct pacing_calendar
+{
+    int buf_size;
+    int n;                                  /**< Packets waiting. */
+    int heap[PACING_CALENDAR_SIZE];         /**< Min-heap of entries by
+                                             *   departure time. */
+    int n_free;
+    int free[PACING_CALENDAR_SIZE];
+    struct pacing_entry entries[PACING_CALENDAR_SIZE];
+
+    counter_type n_queued;
+    counter_type n_dropped;
+    counter_type n_late;                    /**< Packets sent more than
+                                             *   \c PACING_SLACK_NSEC after
+                                             *   their departure time. */
+};
+
+/**
+ * Current time in nanoseconds, on the clock SO_TXTIME uses.
+ */
+static inline uint64_t
+pacing_now(void)
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    openvpn_gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000 + (uint64_t)tv.tv_usec * 1000;
+#endif
+}
+
+/**
+ * Give a packet its departure time.
+ *
+ * @param p     The pacer of the peer.
+ * @param rate  The rate in bytes per second.
+ * @param len   Size of the packet on the wire.
+ * @param now   The current time.
+ *
+ * @return The departure time, which may be in the past, or 0 if the
+ *         packet should be dropped because the peer is too far behind.
+ */
+static inline uint64_t
+pacer_schedule(struct pacer *p, int rate, int len, uint64_t now)
+{
+    uint64_t t = p->next;
+
+    if (t + PACING_SLACK_NSEC < now)
+    {
+        t = now - PACING_SLACK_NSEC;
+    }
+    else if (t > now + PACING_HORIZON_NSEC)
+    {
+        ++p->dropped;
+        return 0;
+    }
+
+    p->next = t + (uint64_t)len * 1000000000 / rate;
+    return t;
+}
+
+struct pacing_calendar *pacing_calendar_new(int buf_size);
+
+void pacing_calendar_free(struct pacing_calendar *cal);
+
+/**
+ * Queue a copy of a packet to be sent at \c due.
+ *
+ * @return false if the calendar is full and the packet was dropped.
+ */
+bool pacing_calendar_add(struct pacing_calendar *cal, uint64_t due,
+                         const struct buffer *buf,
+                         const struct link_socket_actual *to);
+
+/**
+ * Take the next packet that is due at \c now off the calendar.  The
+ * entry stays valid until the next call of pacing_calendar_add().
+ *
+ * @return NULL if no packet is due.
+ */
+struct pacing_entry *pacing_calendar_next(struct pacing_calendar *cal,
+                                          uint64_t now);
+
+/**
+ * Reduce \c tv to the time until the next packet is due.
+ */
+void pacing_calendar_timeout(const struct pacing_calendar *cal, uint64_t now,
+                             struct timeval *tv);
+
+#endif /* ifndef PACING_H */
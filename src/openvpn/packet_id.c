@@ -44,15 +44,6 @@
 
 #include "memdbg.h"
 
-/* #define PID_SIMULATE_BACKTRACK */
-
-/*
- * Special time_t value that indicates that
- * sequence number has expired.
- */
-#define SEQ_UNSEEN  ((time_t)0)
-#define SEQ_EXPIRED ((time_t)1)
-
 static void packet_id_debug_print(int msglevel,
                                   const struct packet_id_rec *p,
                                   const struct packet_id_net *pin,
@@ -74,11 +65,175 @@ packet_id_debug(int msglevel,
 #endif
 }
 
+static inline bool
+packet_id_window_test(const struct packet_id_rec *p, packet_id_type id)
+{
+    const unsigned int bit = id & (p->window_bits - 1);
+    return (p->window[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline void
+packet_id_window_set(struct packet_id_rec *p, packet_id_type id)
+{
+    const unsigned int bit = id & (p->window_bits - 1);
+    p->window[bit >> 6] |= (uint64_t)1 << (bit & 63);
+}
+
+/*
+ * Mark the sequence numbers from + 1 to to as unseen, a word at a time
+ * where possible.  Nothing to do for from == to, the usual case.
+ */
+static void
+packet_id_window_clear(struct packet_id_rec *p, packet_id_type from, packet_id_type to)
+{
+    packet_id_type id = from + 1;
+
+    if (to - from >= p->window_bits)
+    {
+        memset(p->window, 0, p->window_bits / 8);
+        return;
+    }
+    while (id != to + 1)
+    {
+        const unsigned int bit = id & (p->window_bits - 1);
+        if (!(bit & 63) && to - id >= 63)
+        {
+            p->window[bit >> 6] = 0;
+            id += 64;
+        }
+        else
+        {
+            p->window[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+            ++id;
+        }
+    }
+}
+
+static unsigned int
+packet_id_window_bits(int seq_backtrack)
+{
+    return max_int((int)adjust_power_of_2(seq_backtrack), 64);
+}
+
+/*
+ * A packet arrived diff sequence numbers behind the highest one, too late
+ * for the replay window.  Grow the window so that the next one that late
+ * fits, up to seq_backtrack_max.  The packet itself stays rejected: the
+ * sequence numbers that were behind the window are not known to be
+ * unseen, so they are marked as seen in the bigger bitmap.
+ */
+static void
+packet_id_window_grow(struct packet_id_rec *p, packet_id_type diff)
+{
+    const int old_backtrack = p->seq_backtrack;
+    int seq_backtrack = p->seq_backtrack_max;
+    unsigned int bits;
+
+    if (diff < (packet_id_type)seq_backtrack)
+    {
+        seq_backtrack = min_int(max_int(2 * old_backtrack, (int)adjust_power_of_2(diff + 1)),
+                                seq_backtrack);
+    }
+    bits = packet_id_window_bits(seq_backtrack);
+    if (bits > p->window_bits)
+    {
+        uint64_t *window;
+        unsigned int i;
+
+        ALLOC_ARRAY(window, uint64_t, bits / 64);
+        memset(window, 0xff, bits / 8);
+        /*
+         * Only the bits within seq_backtrack are known; anything older
+         * was rejected without a look at the bitmap.
+         */
+        for (i = 0; i < (unsigned int)old_backtrack; ++i)
+        {
+            const packet_id_type id = p->id - i;
+            if (!packet_id_window_test(p, id))
+            {
+                const unsigned int bit = id & (bits - 1);
+                window[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+            }
+        }
+        free(p->window);
+        p->window = window;
+        p->window_bits = bits;
+    }
+    p->seq_backtrack = seq_backtrack;
+    msg(D_PID_DEBUG_LOW, "%s-%d: replay window grown from %d to %d, packet arrived %u behind",
+        p->name, p->unit, old_backtrack, seq_backtrack, (unsigned int)diff);
+}
+
+/* diff < MAX_SEQ_BACKTRACK, so the bucket is below PID_REORDER_BUCKETS */
+static inline void
+packet_id_reorder_stat(struct packet_id_rec *p, packet_id_type diff)
+{
+    int bucket = 0;
+
+#if defined(__GNUC__)
+    if (diff)
+    {
+        bucket = 32 - __builtin_clz((unsigned int)diff);
+    }
+#else
+    while (diff)
+    {
+        diff >>= 1;
+        ++bucket;
+    }
+#endif
+    ++p->reorder[bucket];
+}
+
+/* expire the samples older than time_backtrack */
+static void
+packet_id_expire_samples(struct packet_id_rec *p, time_t local_now)
+{
+    while (p->samples_size
+           && p->samples[p->samples_head].time + p->time_backtrack < local_now)
+    {
+        p->expired = p->samples[p->samples_head].id;
+        p->samples_head = (p->samples_head + 1) % p->samples_cap;
+        --p->samples_size;
+    }
+}
+
+/*
+ * Called by packet_id_add() in a new second: the highest sequence
+ * number received so far is the one of the previous second.
+ */
+static void
+packet_id_sample(struct packet_id_rec *p, time_t local_now)
+{
+    if (p->sample_time)
+    {
+        struct packet_id_sample *sample;
+
+        if (p->samples_size == p->samples_cap)
+        {
+            packet_id_expire_samples(p, local_now);
+        }
+        if (p->samples_size == p->samples_cap)
+        {
+            /* only delays the expiry of the oldest sequence numbers a bit */
+            p->samples_head = (p->samples_head + 1) % p->samples_cap;
+            --p->samples_size;
+        }
+        sample = &p->samples[(p->samples_head + p->samples_size) % p->samples_cap];
+        sample->time = p->sample_time;
+        sample->id = p->id;
+        ++p->samples_size;
+    }
+    p->sample_time = local_now;
+}
+
 void
-packet_id_init(struct packet_id *p, int seq_backtrack, int time_backtrack, const char *name, int unit)
+packet_id_init(struct packet_id *p, int seq_backtrack, int seq_backtrack_max,
+               int time_backtrack, const char *name, int unit)
 {
-    dmsg(D_PID_DEBUG, "PID packet_id_init seq_backtrack=%d time_backtrack=%d",
+    dmsg(D_PID_DEBUG, "PID packet_id_init seq_backtrack=%d seq_backtrack_max=%d time_backtrack=%d",
          seq_backtrack,
+         seq_backtrack_max,
          time_backtrack);
 
     ASSERT(p);
@@ -89,10 +244,19 @@ packet_id_init(struct packet_id *p, int seq_backtrack, int time_backtrack, const
     if (seq_backtrack)
     {
         ASSERT(MIN_SEQ_BACKTRACK <= seq_backtrack && seq_backtrack <= MAX_SEQ_BACKTRACK);
+        ASSERT(seq_backtrack_max <= MAX_SEQ_BACKTRACK);
         ASSERT(MIN_TIME_BACKTRACK <= time_backtrack && time_backtrack <= MAX_TIME_BACKTRACK);
-        CIRC_LIST_ALLOC(p->rec.seq_list, struct seq_list, seq_backtrack);
+        p->rec.window_bits = packet_id_window_bits(seq_backtrack);
+        ALLOC_ARRAY_CLEAR(p->rec.window, uint64_t, p->rec.window_bits / 64);
         p->rec.seq_backtrack = seq_backtrack;
+        p->rec.seq_backtrack_max = max_int(seq_backtrack, seq_backtrack_max);
         p->rec.time_backtrack = time_backtrack;
+        if (time_backtrack)
+        {
+            /* one sample per second, for as long as packet_id_reap may wait */
+            p->rec.samples_cap = time_backtrack + 2 * SEQ_REAP_INTERVAL + 2;
+            ALLOC_ARRAY_CLEAR(p->rec.samples, struct packet_id_sample, p->rec.samples_cap);
+        }
     }
     p->rec.initialized = true;
 }
@@ -103,10 +267,8 @@ packet_id_free(struct packet_id *p)
     if (p)
     {
         dmsg(D_PID_DEBUG, "PID packet_id_free");
-        if (p->rec.seq_list)
-        {
-            free(p->rec.seq_list);
-        }
+        free(p->rec.window);
+        free(p->rec.samples);
         CLEAR(*p);
     }
 }
@@ -115,43 +277,47 @@ void
 packet_id_add(struct packet_id_rec *p, const struct packet_id_net *pin)
 {
     const time_t local_now = now;
-    if (p->seq_list)
+    if (p->window)
     {
-        packet_id_type diff;
+        packet_id_type diff = 0;
+
+        if (p->samples && p->sample_time != local_now)
+        {
+            packet_id_sample(p, local_now);
+        }
 
         /*
          * If time value increases, start a new
          * sequence number sequence.
          */
-        if (!CIRC_LIST_SIZE(p->seq_list)
-            || pin->time > p->time
-            || (pin->id >= (packet_id_type)p->seq_backtrack
-                && pin->id - (packet_id_type)p->seq_backtrack > p->id))
+        if (!p->id || pin->time > p->time)
         {
             p->time = pin->time;
-            p->id = 0;
-            if (pin->id > (packet_id_type)p->seq_backtrack)
-            {
-                p->id = pin->id - (packet_id_type)p->seq_backtrack;
-            }
-            CIRC_LIST_RESET(p->seq_list);
+            p->id = pin->id;
+            p->expired = 0;
+            p->samples_size = 0;
+            memset(p->window, 0, p->window_bits / 8);
         }
-
-        while (p->id < pin->id
-#ifdef PID_SIMULATE_BACKTRACK
-               || (get_random() % 64) < 31
-#endif
-               )
+        else if (pin->id > p->id)
         {
-            CIRC_LIST_PUSH(p->seq_list, SEQ_UNSEEN);
-            ++p->id;
+            /*
+             * Only the gap is unseen, also on a jump beyond seq_backtrack:
+             * the bitmap may be grown later and must still know the ids
+             * between seq_backtrack and window_bits behind.  The bit of
+             * pin->id itself is set below.
+             */
+            packet_id_window_clear(p, p->id, pin->id - 1);
+            p->id = pin->id;
+        }
+        else
+        {
+            diff = p->id - pin->id;
         }
 
-        diff = p->id - pin->id;
-        if (diff < (packet_id_type) CIRC_LIST_SIZE(p->seq_list)
-            && local_now > SEQ_EXPIRED)
+        if (diff < (packet_id_type)p->seq_backtrack)
         {
-            CIRC_LIST_ITEM(p->seq_list, diff) = local_now;
+            packet_id_window_set(p, pin->id);
+            packet_id_reorder_stat(p, diff);
         }
     }
     else
@@ -170,25 +336,13 @@ void
 packet_id_reap(struct packet_id_rec *p)
 {
     const time_t local_now = now;
-    if (p->time_backtrack)
+    if (p->time_backtrack && p->samples)
     {
-        int i;
-        bool expire = false;
-        for (i = 0; i < CIRC_LIST_SIZE(p->seq_list); ++i)
+        packet_id_expire_samples(p, local_now);
+        if (p->sample_time && p->sample_time + p->time_backtrack < local_now)
         {
-            const time_t t = CIRC_LIST_ITEM(p->seq_list, i);
-            if (t == SEQ_EXPIRED)
-            {
-                break;
-            }
-            if (!expire && t && t + p->time_backtrack < local_now)
-            {
-                expire = true;
-            }
-            if (expire)
-            {
-                CIRC_LIST_ITEM(p->seq_list, i) = SEQ_EXPIRED;
-            }
+            p->expired = p->id;
+            p->sample_time = 0;
         }
     }
     p->last_reap = local_now;
@@ -239,25 +393,30 @@ packet_id_test(struct packet_id_rec *p,
                 packet_id_debug(D_PID_DEBUG_LOW, p, pin, "PID_ERR replay-window backtrack occurred", p->max_backtrack_stat);
             }
 
-            if (diff >= (packet_id_type) CIRC_LIST_SIZE(p->seq_list))
+            if (diff >= (packet_id_type) p->seq_backtrack)
             {
                 packet_id_debug(D_PID_DEBUG_LOW, p, pin, "PID_ERR large diff", diff);
+                ++p->too_late;
+                if (p->seq_backtrack < p->seq_backtrack_max)
+                {
+                    packet_id_window_grow(p, diff);
+                }
                 return false;
             }
 
+            if (pin->id <= p->expired)
             {
-                const time_t v = CIRC_LIST_ITEM(p->seq_list, diff);
-                if (v == 0)
-                {
-                    return true;
-                }
-                else
-                {
-                    /* raised from D_PID_DEBUG_LOW to reduce verbosity */
-                    packet_id_debug(D_PID_DEBUG_MEDIUM, p, pin, "PID_ERR replay", diff);
-                    return false;
-                }
+                packet_id_debug(D_PID_DEBUG_LOW, p, pin, "PID_ERR expired", diff);
+                return false;
+            }
+
+            if (packet_id_window_test(p, pin->id))
+            {
+                /* raised from D_PID_DEBUG_LOW to reduce verbosity */
+                packet_id_debug(D_PID_DEBUG_MEDIUM, p, pin, "PID_ERR replay", diff);
+                return false;
             }
+            return true;
         }
         else if (pin->time < p->time) /* if time goes back, reject */
         {
@@ -491,10 +650,19 @@ packet_id_persist_save(struct packet_id_persist *p)
 
         image.time = p->time;
         image.id = p->id;
+#ifdef HAVE_PWRITE
+        /* positioned write, saves the lseek() round trip on every flush */
+        seek_ret = (off_t)0;
+#else
         seek_ret = lseek(p->fd, (off_t)0, SEEK_SET);
+#endif
         if (seek_ret == (off_t)0)
         {
+#ifdef HAVE_PWRITE
+            n = pwrite(p->fd, &image, sizeof(image), (off_t)0);
+#else
             n = write(p->fd, &image, sizeof(image));
+#endif
             if (n == sizeof(image))
             {
                 p->time_last_written = p->time;
@@ -527,6 +695,7 @@ packet_id_persist_load_obj(const struct packet_id_persist *p, struct packet_id *
     {
         pid->rec.time = p->time;
         pid->rec.id = p->id;
+        pid->rec.expired = p->id;
     }
 }
 
@@ -565,7 +734,6 @@ packet_id_debug_print(int msglevel,
     struct buffer out = alloc_buf_gc(256, &gc);
     struct timeval tv;
     const time_t prev_now = now;
-    const struct seq_list *sl = p->seq_list;
     int i;
 
     CLEAR(tv);
@@ -573,36 +741,22 @@ packet_id_debug_print(int msglevel,
 
     buf_printf(&out, "%s [%d]", message, value);
     buf_printf(&out, " [%s-%d] [", p->name, p->unit);
-    for (i = 0; sl != NULL && i < sl->x_size; ++i)
+    for (i = 0; p->window != NULL && p->id && i < min_int(p->seq_backtrack, 64); ++i)
     {
+        const packet_id_type id = p->id - (packet_id_type)i;
         char c;
-        time_t v;
-        int diff;
 
-        v = CIRC_LIST_ITEM(sl, i);
-        if (v == SEQ_UNSEEN)
+        if (!id || id <= p->expired)
         {
-            c = '_';
+            c = 'E';
         }
-        else if (v == SEQ_EXPIRED)
+        else if (packet_id_window_test(p, id))
         {
-            c = 'E';
+            c = 'x';
         }
         else
         {
-            diff = (int) prev_now - v;
-            if (diff < 0)
-            {
-                c = 'N';
-            }
-            else if (diff < 10)
-            {
-                c = '0' + diff;
-            }
-            else
-            {
-                c = '>';
-            }
+            c = '_';
         }
         buf_printf(&out, "%c", c);
     }
@@ -622,16 +776,15 @@ packet_id_debug_print(int msglevel,
                p->time_backtrack,
                p->max_backtrack_stat,
                (int)p->initialized);
-    if (sl != NULL)
+    if (p->window != NULL)
     {
-        buf_printf(&out, " sl=[%d,%d,%d,%d]",
-                   sl->x_head,
-                   sl->x_size,
-                   sl->x_cap,
-                   sl->x_sizeof);
+        buf_printf(&out, " w=[%u,%d," packet_id_format ",%d]",
+                   p->window_bits,
+                   p->seq_backtrack_max,
+                   (packet_id_print_type)p->expired,
+                   p->samples_size);
     }
 
-
     msg(msglevel, "%s", BSTR(&out));
     gc_free(&gc);
 }
@@ -652,7 +805,7 @@ packet_id_interactive_test(void)
     const int seq_backtrack = 10;
     const int time_backtrack = 10;
 
-    packet_id_init(&pid, seq_backtrack, time_backtrack);
+    packet_id_init(&pid, seq_backtrack, seq_backtrack, time_backtrack, "TEST", 0);
 
     while (true)
     {
@@ -30,8 +30,8 @@
 #ifndef PACKET_ID_H
 #define PACKET_ID_H
 
-#include "circ_list.h"
 #include "buffer.h"
+#include "common.h"
 #include "error.h"
 #include "otime.h"
 
@@ -122,23 +122,49 @@ typedef unsigned int packet_id_print_type;
  */
 #define SEQ_REAP_INTERVAL 5
 
-CIRC_LIST(seq_list, time_t);
+/*
+ * Reorder distance histogram: bucket 0 counts the packets that arrived
+ * in order, bucket n > 0 those that arrived 2^(n-1) to 2^n - 1 packet
+ * ids behind the highest one received so far.
+ */
+#define PID_REORDER_BUCKETS 17
+
+/* highest sequence number received by the end of a second, for time_backtrack */
+struct packet_id_sample
+{
+    time_t time;
+    packet_id_type id;
+};
 
 /*
  * This is the data structure we keep on the receiving side,
  * to check that no packet-id (i.e. sequence number + optional timestamp)
  * is accepted more than once.
+ *
+ * Bit (n % window_bits) of window is set once sequence number n has
+ * been received, for n in (id - window_bits, id].  Sequence numbers up
+ * to expired are rejected regardless of the bitmap.
  */
 struct packet_id_rec
 {
     time_t last_reap;         /* last call of packet_id_reap */
     time_t time;              /* highest time stamp received */
     packet_id_type id;        /* highest sequence number received */
-    int seq_backtrack;        /* set from --replay-window */
+    packet_id_type expired;   /* highest sequence number expired by time_backtrack */
+    int seq_backtrack;        /* set from --replay-window, may grow */
+    int seq_backtrack_max;    /* set from --replay-window-max */
     int time_backtrack;       /* set from --replay-window */
     int max_backtrack_stat;   /* maximum backtrack seen so far */
     bool initialized;         /* true if packet_id_init was called */
-    struct seq_list *seq_list; /* packet-id "memory" */
+    unsigned int window_bits; /* size of window, a power of two */
+    uint64_t *window;         /* packet-id "memory" */
+    struct packet_id_sample *samples; /* ring of per-second samples */
+    time_t sample_time;       /* second of the sample not yet in samples */
+    int samples_cap;
+    int samples_head;         /* oldest sample */
+    int samples_size;
+    counter_type reorder[PID_REORDER_BUCKETS]; /* accepted packets by reorder distance */
+    counter_type too_late;    /* packets rejected because they were behind the window */
     const char *name;
     int unit;
 };
@@ -208,7 +234,17 @@ struct packet_id
     struct packet_id_rec rec;
 };
 
-void packet_id_init(struct packet_id *p, int seq_backtrack, int time_backtrack, const char *name, int unit);
+/**
+ * Initialize a packet_id.
+ *
+ * @param seq_backtrack      The replay window, 0 for TCP style linear ids.
+ * @param seq_backtrack_max  The size the replay window may grow to when
+ *                           packets arrive too far out of order to fit
+ *                           into it; no growth if not above seq_backtrack.
+ * @param time_backtrack     How many seconds a packet may arrive late.
+ */
+void packet_id_init(struct packet_id *p, int seq_backtrack, int seq_backtrack_max,
+                    int time_backtrack, const char *name, int unit);
 
 void packet_id_free(struct packet_id *p);
 
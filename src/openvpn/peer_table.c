@@ -0,0 +1,207 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if P2MP_SERVER
+
+#include "buffer.h"
+#include "error.h"
+#include "integer.h"
+#include "peer_table.h"
+
+#include "memdbg.h"
+
+/*
+ * Grow the slot array to new_size entries.  New slots are appended to
+ * the tail of the free list, so slots that were released earlier are
+ * still reused first.
+ */
+static void
+peer_table_resize(struct peer_table *pt, uint32_t new_size)
+{
+    void *alloc;
+    union peer_table_entry *entries;
+    uint32_t i;
+
+    ASSERT(new_size > pt->size && new_size <= pt->max_size);
+
+    check_malloc_return(alloc = calloc(1, array_mult_safe(sizeof(union peer_table_entry),
+                                                          new_size,
+                                                          PEER_TABLE_CACHE_LINE)));
+    entries = (union peer_table_entry *)
+              (((uintptr_t)alloc + PEER_TABLE_CACHE_LINE - 1)
+               & ~(uintptr_t)(PEER_TABLE_CACHE_LINE - 1));
+
+    if (pt->size)
+    {
+        memcpy(entries, pt->entries, pt->size * sizeof(union peer_table_entry));
+    }
+    free(pt->entries_alloc);
+    pt->entries_alloc = alloc;
+    pt->entries = entries;
+
+    for (i = pt->size; i < new_size; ++i)
+    {
+        struct peer_table_slot *slot = &pt->entries[i].slot;
+        slot->peer_id = i;
+        slot->next_free = PEER_TABLE_NO_SLOT;
+
+        if (pt->free_tail == PEER_TABLE_NO_SLOT)
+        {
+            pt->free_head = i;
+        }
+        else
+        {
+            pt->entries[pt->free_tail].slot.next_free = i;
+        }
+        pt->free_tail = i;
+    }
+    pt->size = new_size;
+}
+
+struct peer_table *
+peer_table_new(int max_peers)
+{
+    struct peer_table *pt;
+
+    ASSERT(max_peers < PEER_TABLE_INVALID_ID);
+
+    ALLOC_OBJ_CLEAR(pt, struct peer_table);
+    pt->max_size = max_int(max_peers, 0);
+    pt->free_head = PEER_TABLE_NO_SLOT;
+    pt->free_tail = PEER_TABLE_NO_SLOT;
+
+    pt->index_bits = 1;
+    while ((1u << pt->index_bits) < pt->max_size)
+    {
+        ++pt->index_bits;
+    }
+    pt->index_mask = (1u << pt->index_bits) - 1;
+
+    if (pt->max_size)
+    {
+        peer_table_resize(pt, min_int(pt->max_size, PEER_TABLE_INITIAL_SIZE));
+    }
+    return pt;
+}
+
+void
+peer_table_free(struct peer_table *pt)
+{
+    if (pt)
+    {
+        free(pt->entries_alloc);
+        free(pt);
+    }
+}
+
+uint32_t
+peer_table_alloc(struct peer_table *pt, struct multi_instance *mi,
+                 const struct openvpn_sockaddr *remote)
+{
+    struct peer_table_slot *slot;
+    uint32_t index;
+
+    ASSERT(mi);
+
+    if (pt->free_head == PEER_TABLE_NO_SLOT)
+    {
+        if (pt->size >= pt->max_size)
+        {
+            return PEER_TABLE_INVALID_ID;
+        }
+        peer_table_resize(pt, (uint32_t)min_int(pt->max_size, pt->size * 2));
+    }
+
+    index = pt->free_head;
+    slot = &pt->entries[index].slot;
+    pt->free_head = slot->next_free;
+    if (pt->free_head == PEER_TABLE_NO_SLOT)
+    {
+        pt->free_tail = PEER_TABLE_NO_SLOT;
+    }
+
+    slot->mi = mi;
+    slot->next_free = PEER_TABLE_NO_SLOT;
+    if (remote)
+    {
+        slot->remote = *remote;
+    }
+    else
+    {
+        CLEAR(slot->remote);
+    }
+    ++pt->n_used;
+
+    return slot->peer_id;
+}
+
+void
+peer_table_release(struct peer_table *pt, uint32_t peer_id)
+{
+    struct peer_table_slot *slot = peer_table_lookup(pt, peer_id);
+    uint32_t index;
+
+    if (!slot)
+    {
+        return;
+    }
+
+    index = peer_id & pt->index_mask;
+
+    /* advance the generation stored in the bits above the slot index,
+     * skipping the reserved "disabled" peer-id */
+    slot->peer_id = (peer_id + (1u << pt->index_bits)) & PEER_TABLE_ID_MASK;
+    if (slot->peer_id == PEER_TABLE_INVALID_ID)
+    {
+        slot->peer_id = index;
+    }
+    slot->mi = NULL;
+    CLEAR(slot->remote);
+
+    slot->next_free = PEER_TABLE_NO_SLOT;
+    if (pt->free_tail == PEER_TABLE_NO_SLOT)
+    {
+        pt->free_head = index;
+    }
+    else
+    {
+        pt->entries[pt->free_tail].slot.next_free = index;
+    }
+    pt->free_tail = index;
+    --pt->n_used;
+}
+
+#else  /* if P2MP_SERVER */
+static void
+dummy(void)
+{
+}
+#endif /* P2MP_SERVER */
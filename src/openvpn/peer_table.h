@@ -0,0 +1,166 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Peer-id allocation and lookup for server mode.
+ *
+ * The 24 bit peer-id carried in P_DATA_V2 packets is split into a slot
+ * index (low bits) and a generation counter (high bits).  The generation
+ * is bumped every time a slot is released, so a packet that still carries
+ * the peer-id of a client that has just disconnected will not be
+ * delivered to the next client that is given the same slot.
+ *
+ * Free slots are kept on a FIFO list, which makes allocation and release
+ * O(1) and maximises the time before a slot gets reused.  The slot array
+ * grows on demand up to the configured maximum and every slot occupies
+ * exactly one cache line, so the UDP fast path only touches that line to
+ * map a peer-id to its instance and to detect a float.
+ */
+
+#ifndef PEER_TABLE_H
+#define PEER_TABLE_H
+
+#if P2MP_SERVER
+
+#include "basic.h"
+#include "socket.h"
+
+struct multi_instance;
+
+#define PEER_TABLE_CACHE_LINE   64
+#define PEER_TABLE_ID_BITS      24
+#define PEER_TABLE_ID_MASK      ((1u << PEER_TABLE_ID_BITS) - 1)
+#define PEER_TABLE_INITIAL_SIZE 64
+#define PEER_TABLE_NO_SLOT      0xFFFFFFFF
+
+/* peer-id that is never handed out, same value as MAX_PEER_ID which
+ * represents "disabled peer-id" on the wire */
+#define PEER_TABLE_INVALID_ID   PEER_TABLE_ID_MASK
+
+/**
+ * Per peer-id state, read by the data channel fast path.
+ */
+struct peer_table_slot
+{
+    struct multi_instance *mi;  /**< Owner of this slot, or NULL if the
+                                 *   slot is on the free list. */
+    uint32_t peer_id;           /**< Full peer-id (generation | index)
+                                 *   which is currently valid for, or will
+                                 *   be handed out next by, this slot. */
+    uint32_t next_free;         /**< Index of the next slot on the free
+                                 *   list. */
+    struct openvpn_sockaddr remote; /**< Real address the peer is expected
+                                     *   to send from. */
+};
+
+static_assert(sizeof(struct peer_table_slot) <= PEER_TABLE_CACHE_LINE,
+              "peer_table_slot must fit into a single cache line");
+
+union peer_table_entry
+{
+    struct peer_table_slot slot;
+    uint8_t pad[PEER_TABLE_CACHE_LINE];
+};
+
+struct peer_table
+{
+    union peer_table_entry *entries; /**< Cache line aligned slot array */
+    void *entries_alloc;        /**< Unaligned allocation backing entries */
+    uint32_t size;              /**< Number of allocated slots */
+    uint32_t max_size;          /**< Upper bound for size */
+    uint32_t index_bits;        /**< Number of peer-id bits used for the
+                                 *   slot index. */
+    uint32_t index_mask;
+    uint32_t free_head;         /**< Oldest free slot, reused first */
+    uint32_t free_tail;         /**< Most recently released slot */
+    uint32_t n_used;
+};
+
+/**
+ * Allocate a new peer-id table.
+ *
+ * @param max_peers  Maximum number of simultaneously allocated peer-ids,
+ *                   must be less than PEER_TABLE_INVALID_ID.
+ */
+struct peer_table *peer_table_new(int max_peers);
+
+void peer_table_free(struct peer_table *pt);
+
+/**
+ * Assign a peer-id to an instance.
+ *
+ * @param pt      The peer-id table
+ * @param mi      The instance that will own the peer-id
+ * @param remote  The real address the peer is currently sending from
+ *
+ * @return The newly assigned peer-id, or PEER_TABLE_INVALID_ID if the
+ *         table is full.
+ */
+uint32_t peer_table_alloc(struct peer_table *pt, struct multi_instance *mi,
+                          const struct openvpn_sockaddr *remote);
+
+/**
+ * Release a peer-id and bump the generation of its slot, so that any
+ * packet still in flight for the old owner is no longer recognised.
+ */
+void peer_table_release(struct peer_table *pt, uint32_t peer_id);
+
+/**
+ * Look up the slot that currently owns \c peer_id.
+ *
+ * @return The slot, or NULL if \c peer_id is unknown, released or stale.
+ */
+static inline struct peer_table_slot *
+peer_table_lookup(const struct peer_table *pt, uint32_t peer_id)
+{
+    const uint32_t index = peer_id & pt->index_mask;
+
+    if (index < pt->size)
+    {
+        struct peer_table_slot *slot = &pt->entries[index].slot;
+        if (slot->mi && slot->peer_id == peer_id)
+        {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Update the real address a peer is expected to send from, e.g. after
+ * the peer has floated.
+ */
+static inline void
+peer_table_set_remote(struct peer_table *pt, uint32_t peer_id,
+                      const struct openvpn_sockaddr *remote)
+{
+    struct peer_table_slot *slot = peer_table_lookup(pt, peer_id);
+    if (slot)
+    {
+        slot->remote = *remote;
+    }
+}
+
+#endif /* P2MP_SERVER */
+#endif /* PEER_TABLE_H */
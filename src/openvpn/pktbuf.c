@@ -0,0 +1,150 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "pktbuf.h"
+
+#include "memdbg.h"
+
+struct pkt_pool *
+pkt_pool_new(int buf_size, int headroom, int limit)
+{
+    struct pkt_pool *pool;
+
+    ASSERT(buf_size > 0 && headroom >= 0 && headroom < buf_size && limit > 0);
+    ALLOC_OBJ_CLEAR(pool, struct pkt_pool);
+    pool->buf_size = buf_size;
+    pool->headroom = headroom;
+    pool->limit = limit;
+    return pool;
+}
+
+static void
+pkt_pool_release(struct pkt_pool *pool)
+{
+    while (pool->free_list)
+    {
+        struct pkt *p = pool->free_list;
+        pool->free_list = p->next;
+        free(p);
+    }
+    free(pool);
+}
+
+void
+pkt_pool_free(struct pkt_pool *pool)
+{
+    if (pool)
+    {
+        if (pool->stats.in_use > 0)
+        {
+            pool->closed = true;
+        }
+        else
+        {
+            pkt_pool_release(pool);
+        }
+    }
+}
+
+struct pkt *
+pkt_alloc(struct pkt_pool *pool)
+{
+    struct pkt *p;
+
+    if (pool->stats.in_use >= pool->limit)
+    {
+        ++pool->stats.exhausted;
+        return NULL;
+    }
+
+    if (pool->free_list)
+    {
+        p = pool->free_list;
+        pool->free_list = p->next;
+    }
+    else
+    {
+        /* descriptor and buffer in one allocation */
+        p = (struct pkt *) malloc(sizeof(struct pkt) + pool->buf_size);
+        check_malloc_return(p);
+        p->buf.data = (uint8_t *) (p + 1);
+        p->buf.capacity = pool->buf_size;
+        p->pool = pool;
+        ++pool->stats.allocated;
+    }
+
+    p->buf.offset = pool->headroom;
+    p->buf.len = 0;
+    p->next = NULL;
+
+    ++pool->stats.allocs;
+    if (++pool->stats.in_use > pool->stats.in_use_max)
+    {
+        pool->stats.in_use_max = pool->stats.in_use;
+    }
+    return p;
+}
+
+struct pkt *
+pkt_clone(struct pkt_pool *pool, const struct buffer *src)
+{
+    struct pkt *p;
+
+    if (BLEN(src) > pool->buf_size - pool->headroom)
+    {
+        ++pool->stats.oversize;
+        return NULL;
+    }
+    p = pkt_alloc(pool);
+    if (p)
+    {
+        memcpy(BPTR(&p->buf), BPTR(src), BLEN(src));
+        p->buf.len = BLEN(src);
+    }
+    return p;
+}
+
+void
+pkt_free(struct pkt *p)
+{
+    if (p)
+    {
+        struct pkt_pool *pool = p->pool;
+
+        p->next = pool->free_list;
+        pool->free_list = p;
+        if (--pool->stats.in_use == 0 && pool->closed)
+        {
+            pkt_pool_release(pool);
+        }
+    }
+}
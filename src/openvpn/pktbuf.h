@@ -0,0 +1,127 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * Pool of packet buffers.
+ *
+ * A packet that has to outlive the handling of the event that produced
+ * it because it waits in a queue is held in a packet descriptor from a
+ * pool instead of a buffer of its own.  The buffers of a pool all have
+ * the size and the headroom of a packet of the tunnel, so the code that
+ * later sends the packet can prepend its headers in place.  Freed
+ * descriptors go back to a free list and are handed out again most
+ * recently used first.
+ *
+ * For now only the copies made by mbuf_alloc_buf() come from a pool.
+ * The packet being worked on in forward.c, c2.buf, c2.to_link and
+ * c2.to_tun, still lives in the context_buffers of its context, so
+ * there is one packet in flight per direction and context.
+ *
+ * A pool is not thread safe.  Each thread, in practice each event loop,
+ * has its own.
+ */
+
+#ifndef PKTBUF_H
+#define PKTBUF_H
+
+#include "buffer.h"
+#include "common.h"
+
+/**
+ * A packet held in a pool buffer.
+ */
+struct pkt
+{
+    struct buffer buf;          /**< The packet, its data is in the pool
+                                 *   buffer that follows the descriptor. */
+    struct pkt *next;           /**< Free for the holder to chain packets,
+                                 *   links the free list in the pool. */
+    struct pkt_pool *pool;
+};
+
+/**
+ * Usage counters of a pool.
+ */
+struct pkt_pool_stats
+{
+    counter_type allocs;        /**< Packets handed out. */
+    counter_type exhausted;     /**< Requests refused because \c limit
+                                 *   packets were in use. */
+    counter_type oversize;      /**< Requests refused because the packet
+                                 *   did not fit a pool buffer. */
+    int in_use;                 /**< Packets handed out and not freed. */
+    int in_use_max;             /**< Highest \c in_use so far. */
+    int allocated;              /**< Descriptors in use or in the free list. */
+};
+
+struct pkt_pool
+{
+    struct pkt *free_list;
+    int buf_size;               /**< Capacity of a pool buffer. */
+    int headroom;               /**< Offset of the packet data in it. */
+    int limit;                  /**< Most packets in use at a time. */
+    bool closed;                /**< pkt_pool_free() was called with
+                                 *   packets still in use. */
+    struct pkt_pool_stats stats;
+};
+
+/**
+ * Create a pool.  Descriptors are allocated as needed, up to \c limit,
+ * and kept for reuse when they are freed.
+ *
+ * @param buf_size  Size of a pool buffer, usually BUF_SIZE() of the frame.
+ * @param headroom  Room to leave in front of the packet data, usually
+ *                  FRAME_HEADROOM() of the frame.
+ * @param limit     Maximum number of packets in use at the same time.
+ */
+struct pkt_pool *pkt_pool_new(int buf_size, int headroom, int limit);
+
+/**
+ * Free a pool.  If packets are still in use, the pool is freed together
+ * with the last of them.
+ */
+void pkt_pool_free(struct pkt_pool *pool);
+
+/**
+ * Get an empty packet from the pool, with the buffer initialized to the
+ * headroom of the pool.
+ *
+ * @return The packet, or NULL if \c limit packets are in use.
+ */
+struct pkt *pkt_alloc(struct pkt_pool *pool);
+
+/**
+ * Get a packet from the pool holding a copy of \c src.
+ *
+ * @return The packet, or NULL if \c limit packets are in use or \c src
+ *         does not fit behind the headroom of a pool buffer.
+ */
+struct pkt *pkt_clone(struct pkt_pool *pool, const struct buffer *src);
+
+/**
+ * Return a packet to its pool.  Does nothing if \c p is NULL.
+ */
+void pkt_free(struct pkt *p);
+
+#endif /* PKTBUF_H */
@@ -172,6 +172,192 @@ platform_nice(int niceval)
     }
 }
 
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET)
+
+/*
+ * Parse a CPU list like "2" or "0-3,8", the format of --cpu-affinity
+ * and of the cpulist files in sysfs.
+ */
+static bool
+parse_cpu_list(const char *p, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    while (*p && *p != '\n')
+    {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+
+        if (end == p)
+        {
+            return false;
+        }
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p)
+            {
+                return false;
+            }
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        for (; first <= last; ++first)
+        {
+            CPU_SET(first, set);
+        }
+        p = end;
+        if (*p == ',')
+        {
+            ++p;
+        }
+        else if (*p && *p != '\n')
+        {
+            return false;
+        }
+    }
+    return CPU_COUNT(set) > 0;
+}
+
+/*
+ * The CPUs of a NUMA node, from sysfs on Linux.
+ */
+static bool
+numa_node_cpus(int node, cpu_set_t *set)
+{
+    char fn[64], line[1024];
+    bool ret = false;
+    FILE *fp;
+
+    openvpn_snprintf(fn, sizeof(fn), "/sys/devices/system/node/node%d/cpulist", node);
+    fp = fopen(fn, "r");
+    if (fp)
+    {
+        ret = fgets(line, sizeof(line), fp) && parse_cpu_list(line, set);
+        fclose(fp);
+    }
+    return ret;
+}
+
+/*
+ * Parse --cpu-affinity, a CPU list or "node<n>", into set.  Returns
+ * false if it is malformed or names a NUMA node that does not exist.
+ */
+static bool
+parse_cpu_affinity(const char *cpus, cpu_set_t *set)
+{
+    const bool node = !strncmp(cpus, "node", 4);
+    const char *p = node ? cpus + 4 : cpus;
+
+    if (!*p || strspn(p, node ? "0123456789" : "0123456789,-") != strlen(p))
+    {
+        return false;
+    }
+    if (node)
+    {
+        /* at most five digits keep atoi() in range */
+        return strlen(p) <= 5 && numa_node_cpus(atoi(p), set);
+    }
+    return parse_cpu_list(p, set);
+}
+
+#endif /* if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET) */
+
+/*
+ * Check the argument of --cpu-affinity.  Where the affinity cannot be
+ * set, anything is accepted and platform_cpu_affinity() warns.
+ */
+bool
+platform_cpu_affinity_valid(const char *cpus)
+{
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET)
+    cpu_set_t set;
+
+    return parse_cpu_affinity(cpus, &set);
+#else
+    return true;
+#endif
+}
+
+/*
+ * Pin the process to the CPUs in a list like "2" or "0-3,8", or to the
+ * CPUs of a NUMA node with "node1".  This keeps a busy polling event
+ * loop on one core, and memory that is first used afterwards, like the
+ * packet buffers, on its node.
+ */
+void
+platform_cpu_affinity(const char *cpus)
+{
+    if (cpus)
+    {
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET)
+        cpu_set_t set;
+
+        /* checked when the option was parsed, unless the node went away */
+        if (!parse_cpu_affinity(cpus, &set))
+        {
+            msg(M_WARN, "WARNING: --cpu-affinity: no CPUs found for '%s'", cpus);
+        }
+        else if (sched_setaffinity(0, sizeof(set), &set))
+        {
+            msg(M_WARN | M_ERRNO, "WARNING: setting the CPU affinity to %s failed", cpus);
+        }
+        else
+        {
+            msg(M_INFO, "CPU affinity set to %s", cpus);
+        }
+#else  /* if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET) */
+        msg(M_WARN, "WARNING: setting the CPU affinity failed (function not implemented)");
+#endif
+    }
+}
+
+/* The CPU we are running on, or -1 if unknown */
+int
+platform_current_cpu(void)
+{
+#ifdef HAVE_SCHED_GETCPU
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+/* The NUMA node of a CPU, or -1 if unknown.  sysfs is read only once. */
+int
+platform_cpu_node(int cpu)
+{
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET)
+    static int cpu_nodes[CPU_SETSIZE]; /* GLOBAL: node + 1, 0 if unknown */
+    static bool cpu_nodes_read;        /* GLOBAL */
+
+    if (!cpu_nodes_read)
+    {
+        cpu_set_t set;
+        int node, i;
+
+        for (node = 0; numa_node_cpus(node, &set); ++node)
+        {
+            for (i = 0; i < CPU_SETSIZE; ++i)
+            {
+                if (CPU_ISSET(i, &set))
+                {
+                    cpu_nodes[i] = node + 1;
+                }
+            }
+        }
+        cpu_nodes_read = true;
+    }
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+    {
+        return cpu_nodes[cpu] - 1;
+    }
+#endif
+    return -1;
+}
+
 /* Get current PID */
 unsigned int
 platform_getpid(void)
@@ -113,6 +113,14 @@ void platform_chroot(const char *path);
 
 void platform_nice(int niceval);
 
+bool platform_cpu_affinity_valid(const char *cpus);
+
+void platform_cpu_affinity(const char *cpus);
+
+int platform_current_cpu(void);
+
+int platform_cpu_node(int cpu);
+
 unsigned int platform_getpid(void);
 
 void platform_mlockall(bool print_msg);  /* Disable paging */
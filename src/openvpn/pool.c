@@ -232,6 +232,10 @@ ifconfig_pool_acquire(struct ifconfig_pool *pool, in_addr_t *local, in_addr_t *r
     {
         struct ifconfig_pool_entry *ipe = &pool->list[i];
         ASSERT(!ipe->in_use);
+        if (!ipe->common_name || !common_name || strcmp(ipe->common_name, common_name))
+        {
+            ++pool->generation;
+        }
         ifconfig_pool_entry_free(ipe, true);
         ipe->in_use = true;
         if (common_name)
@@ -276,6 +280,10 @@ ifconfig_pool_release(struct ifconfig_pool *pool, ifconfig_pool_handle hand, con
     bool ret = false;
     if (pool && hand >= 0 && hand < pool->ipv4.size)
     {
+        if (hard && pool->list[hand].common_name)
+        {
+            ++pool->generation;
+        }
         ifconfig_pool_entry_free(&pool->list[hand], hard);
         ret = true;
     }
@@ -371,6 +379,7 @@ ifconfig_pool_set(struct ifconfig_pool *pool, const char *cn, const in_addr_t ad
         e->common_name = string_alloc(cn, NULL);
         e->last_release = now;
         e->fixed = fixed;
+        ++pool->generation;
     }
 }
 
@@ -529,9 +538,17 @@ ifconfig_pool_write(struct ifconfig_pool_persist *persist, const struct ifconfig
 {
     if (persist && persist->file && (status_rw_flags(persist->file) & STATUS_OUTPUT_WRITE) && pool)
     {
+        /* rewriting a large pool file is expensive, skip it if no
+         * assignment has changed since the last write */
+        if (persist->written && persist->generation_written == pool->generation)
+        {
+            return;
+        }
         status_reset(persist->file);
         ifconfig_pool_list(pool, persist->file);
         status_flush(persist->file);
+        persist->written = true;
+        persist->generation_written = pool->generation;
     }
 }
 
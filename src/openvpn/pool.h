@@ -62,12 +62,17 @@ struct ifconfig_pool
         unsigned int size;
     } ipv6;
     struct ifconfig_pool_entry *list;
+    unsigned int generation;    /* incremented whenever the list of
+                                 * common_name -> address assignments
+                                 * written by ifconfig_pool_list changes */
 };
 
 struct ifconfig_pool_persist
 {
     struct status_output *file;
     bool fixed;
+    bool written;               /* file has been written at least once */
+    unsigned int generation_written; /* pool generation last written */
 };
 
 typedef int ifconfig_pool_handle;
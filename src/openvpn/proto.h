@@ -95,6 +95,7 @@ struct openvpn_iphdr {
 
     uint8_t ttl;
 
+#define OPENVPN_IPPROTO_ICMP 1  /* ICMP protocol */
 #define OPENVPN_IPPROTO_IGMP 2  /* IGMP protocol */
 #define OPENVPN_IPPROTO_TCP  6  /* TCP protocol */
 #define OPENVPN_IPPROTO_UDP 17  /* UDP protocol */
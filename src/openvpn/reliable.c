@@ -305,32 +305,101 @@ done:
  * struct reliable member functions.
  */
 
-void
-reliable_init(struct reliable *rel, int buf_size, int offset, int array_size, bool hold)
+/*
+ * Pool of control channel buffers.
+ *
+ * A key_state only needs its control channel buffers while a handshake or
+ * renegotiation is in progress, most of the time they sit idle.  Instead of
+ * keeping RELIABLE_CAPACITY full sized buffers per direction and per key
+ * around for the lifetime of the key, buffers are taken from this pool when
+ * needed and put back once the control channel goes idle.  The pool is
+ * shared by all key states, so a server with many connected clients only
+ * needs as many buffers as there are handshakes in flight.
+ */
+
+#define RELIABLE_POOL_MAX 256   /* idle buffers kept for reuse */
+
+static struct buffer reliable_pool[RELIABLE_POOL_MAX]; /* GLOBAL */
+static int reliable_pool_len;                          /* GLOBAL */
+
+struct buffer
+reliable_buf_alloc(int size)
 {
     int i;
 
+    /* most recently released first, it is the most likely to be in cache */
+    for (i = reliable_pool_len - 1; i >= 0; --i)
+    {
+        if (reliable_pool[i].capacity == size)
+        {
+            struct buffer buf = reliable_pool[i];
+            reliable_pool[i] = reliable_pool[--reliable_pool_len];
+            CLEAR(reliable_pool[reliable_pool_len]);
+            return buf;
+        }
+    }
+    return alloc_buf(size);
+}
+
+void
+reliable_buf_free(struct buffer *buf)
+{
+    if (buf_defined(buf))
+    {
+        if (reliable_pool_len < RELIABLE_POOL_MAX)
+        {
+            reliable_pool[reliable_pool_len++] = *buf;
+            CLEAR(*buf);
+        }
+        else
+        {
+            free_buf(buf);
+        }
+    }
+}
+
+void
+reliable_pool_free(void)
+{
+    while (reliable_pool_len > 0)
+    {
+        free_buf(&reliable_pool[--reliable_pool_len]);
+    }
+}
+
+void
+reliable_init(struct reliable *rel, int buf_size, int offset, int array_size, bool hold)
+{
     CLEAR(*rel);
     ASSERT(array_size > 0 && array_size <= RELIABLE_CAPACITY);
     rel->hold = hold;
     rel->size = array_size;
     rel->offset = offset;
+    rel->buf_size = buf_size;
+}
+
+void
+reliable_free(struct reliable *rel)
+{
+    int i;
     for (i = 0; i < rel->size; ++i)
     {
         struct reliable_entry *e = &rel->array[i];
-        e->buf = alloc_buf(buf_size);
-        ASSERT(buf_init(&e->buf, offset));
+        reliable_buf_free(&e->buf);
     }
 }
 
 void
-reliable_free(struct reliable *rel)
+reliable_release_idle(struct reliable *rel)
 {
     int i;
     for (i = 0; i < rel->size; ++i)
     {
         struct reliable_entry *e = &rel->array[i];
-        free_buf(&e->buf);
+        if (!e->active)
+        {
+            reliable_buf_free(&e->buf);
+        }
     }
 }
 
@@ -478,6 +547,10 @@ reliable_get_buf(struct reliable *rel)
         struct reliable_entry *e = &rel->array[i];
         if (!e->active)
         {
+            if (!buf_defined(&e->buf))
+            {
+                e->buf = reliable_buf_alloc(rel->buf_size);
+            }
             ASSERT(buf_init(&e->buf, rel->offset));
             return &e->buf;
         }
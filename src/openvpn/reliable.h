@@ -86,6 +86,7 @@ struct reliable
     interval_t initial_timeout;
     packet_id_type packet_id;
     int offset;
+    int buf_size; /* entry buffers are allocated on demand with this size */
     bool hold; /* don't xmit until reliable_schedule_now is called */
     struct reliable_entry array[RELIABLE_CAPACITY];
 };
@@ -188,6 +189,9 @@ bool reliable_ack_write(struct reliable_ack *ack,
  * @param array_size The number of packets that this reliable
  *     structure can store simultaneously.
  * @param hold description
+ *
+ * No buffers are allocated here, each entry gets its buffer from the
+ * control channel buffer pool the first time it is used.
  */
 void reliable_init(struct reliable *rel, int buf_size, int offset, int array_size, bool hold);
 
@@ -198,6 +202,37 @@ void reliable_init(struct reliable *rel, int buf_size, int offset, int array_siz
  */
 void reliable_free(struct reliable *rel);
 
+/**
+ * Return the buffers of all inactive entries to the control channel
+ * buffer pool.  They are allocated again when the entries are next used.
+ *
+ * @param rel The reliable structure.
+ */
+void reliable_release_idle(struct reliable *rel);
+
+/**
+ * Get a buffer of \c size bytes from the control channel buffer pool,
+ * allocating a new one if the pool has none of that size.
+ *
+ * @param size The capacity of the buffer.
+ *
+ * @return The buffer, its contents are undefined.
+ */
+struct buffer reliable_buf_alloc(int size);
+
+/**
+ * Return a buffer obtained from reliable_buf_alloc() to the pool, and
+ * clear \c buf.  Does nothing if \c buf is not defined.
+ *
+ * @param buf The buffer to release.
+ */
+void reliable_buf_free(struct buffer *buf);
+
+/**
+ * Free all buffers held by the control channel buffer pool.
+ */
+void reliable_pool_free(void);
+
 /* add to extra_frame the maximum number of bytes we will need for reliable_ack_write */
 void reliable_ack_adjust_frame_parameters(struct frame *frame, int max);
 
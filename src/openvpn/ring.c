@@ -0,0 +1,342 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "buffer.h"
+#include "error.h"
+#include "fdmisc.h"
+#include "integer.h"
+#include "ring.h"
+
+#include "memdbg.h"
+
+/*
+ * Memory ordering.  A producer fills the slots before it publishes them
+ * with a release store of prod_tail, which the consumer reads with an
+ * acquire load before it reads the slots; cons_tail is handed back the
+ * same way.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+
+#define ring_load(p)            __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ring_store(p, v)        __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define ring_exchange(p, v)     __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define ring_fence()            __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+static inline bool
+ring_cas(unsigned int *p, unsigned int old, unsigned int next)
+{
+    return __atomic_compare_exchange_n(p, &old, next, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#elif defined(_MSC_VER)
+
+/* volatile accesses have acquire and release semantics with MSVC */
+#define ring_load(p)            (*(volatile unsigned int *)(p))
+#define ring_store(p, v)        (*(volatile unsigned int *)(p) = (v))
+#define ring_exchange(p, v)     InterlockedExchange((volatile LONG *)(p), (v))
+#define ring_fence()            MemoryBarrier()
+
+static inline bool
+ring_cas(unsigned int *p, unsigned int old, unsigned int next)
+{
+    return (unsigned int) InterlockedCompareExchange((volatile LONG *)p, next, old) == old;
+}
+
+#else
+#error ring.c needs atomic operations of GCC, clang or MSVC
+#endif
+
+/*
+ * A producer of an MPSC ring that got its slots waits for the producers
+ * before it to publish theirs.  Yield the CPU after this many checks, in
+ * case one of them was preempted in between.
+ */
+#define RING_SPIN_LIMIT 64
+
+static void
+ring_wakeup_init(struct ring *r)
+{
+#ifdef _WIN32
+    r->wakeup_handle.read = CreateEvent(NULL, TRUE, FALSE, NULL);
+    r->wakeup_handle.write = NULL;
+    if (!r->wakeup_handle.read)
+    {
+        msg(M_ERR, "Error: ring: CreateEvent failed");
+    }
+    r->wakeup = &r->wakeup_handle;
+#elif defined(HAVE_SYS_EVENTFD_H)
+    r->wakeup = r->wakeup_write = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->wakeup < 0)
+    {
+        msg(M_ERR, "Error: ring: eventfd failed");
+    }
+#else
+    int fd[2];
+    if (pipe(fd) != 0)
+    {
+        msg(M_ERR, "Error: ring: pipe failed");
+    }
+    set_nonblock(fd[0]);
+    set_nonblock(fd[1]);
+    set_cloexec(fd[0]);
+    set_cloexec(fd[1]);
+    r->wakeup = fd[0];
+    r->wakeup_write = fd[1];
+#endif
+}
+
+static void
+ring_wakeup_close(struct ring *r)
+{
+#ifdef _WIN32
+    if (r->wakeup_handle.read)
+    {
+        CloseHandle(r->wakeup_handle.read);
+    }
+#else
+    if (r->wakeup >= 0)
+    {
+        close(r->wakeup);
+    }
+    if (r->wakeup_write >= 0 && r->wakeup_write != r->wakeup)
+    {
+        close(r->wakeup_write);
+    }
+#endif
+}
+
+/*
+ * Wake up the consumer if it announced that it is going to sleep.  The
+ * fence orders the publication of the new slots before the check of
+ * r->waiting, which ring_wait_set() does the other way around, so that
+ * either the consumer sees the slots or the producer sees it waiting.
+ */
+static void
+ring_notify(struct ring *r)
+{
+    ring_fence();
+    if (ring_load((unsigned int *)&r->waiting) && ring_exchange(&r->waiting, 0))
+    {
+#ifdef _WIN32
+        SetEvent(r->wakeup_handle.read);
+#elif defined(HAVE_SYS_EVENTFD_H)
+        const uint64_t one = 1;
+        if (write(r->wakeup_write, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            msg(D_EVENT_ERRORS | M_ERRNO, "ring: write to eventfd failed");
+        }
+#else
+        const uint8_t one = 1;
+        if (write(r->wakeup_write, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            msg(D_EVENT_ERRORS | M_ERRNO, "ring: write to pipe failed");
+        }
+#endif
+    }
+}
+
+struct ring *
+ring_new(unsigned int size, unsigned int flags)
+{
+    struct ring *r;
+
+    ASSERT(size > 0 && size <= (1u << 30));
+    ALLOC_OBJ_CLEAR(r, struct ring);
+    r->size = (unsigned int) adjust_power_of_2(size);
+    r->mask = r->size - 1;
+    r->flags = flags;
+    ALLOC_ARRAY_CLEAR(r->slots, void *, r->size);
+#ifndef _WIN32
+    r->wakeup = r->wakeup_write = -1;
+#endif
+    if (flags & RING_WAKEUP)
+    {
+        ring_wakeup_init(r);
+    }
+    return r;
+}
+
+void
+ring_free(struct ring *r)
+{
+    if (r)
+    {
+        if (r->flags & RING_WAKEUP)
+        {
+            ring_wakeup_close(r);
+        }
+        free(r->slots);
+        free(r);
+    }
+}
+
+static unsigned int
+ring_enqueue_burst_mp(struct ring *r, void *const *objs, unsigned int n)
+{
+    unsigned int head, next, i;
+
+    do
+    {
+        unsigned int free_slots;
+
+        head = ring_load(&r->prod_head);
+        free_slots = r->size - (head - ring_load(&r->cons_tail));
+        if (n > free_slots)
+        {
+            n = free_slots;
+        }
+        if (!n)
+        {
+            return 0;
+        }
+        next = head + n;
+    } while (!ring_cas(&r->prod_head, head, next));
+
+    for (i = 0; i < n; ++i)
+    {
+        r->slots[(head + i) & r->mask] = objs[i];
+    }
+
+    /* publish in the order the slots were reserved */
+    i = 0;
+    while (ring_load(&r->prod_tail) != head)
+    {
+        if (++i == RING_SPIN_LIMIT)
+        {
+#ifdef _WIN32
+            SwitchToThread();
+#elif defined(HAVE_SCHED_H)
+            sched_yield();
+#endif
+            i = 0;
+        }
+    }
+    ring_store(&r->prod_tail, next);
+    return n;
+}
+
+unsigned int
+ring_enqueue_burst(struct ring *r, void *const *objs, unsigned int n)
+{
+    unsigned int head, free_slots, i;
+
+    if (r->flags & RING_MP)
+    {
+        n = ring_enqueue_burst_mp(r, objs, n);
+    }
+    else
+    {
+        head = r->prod_head;
+        free_slots = r->size - (head - r->cons_cache);
+        if (n > free_slots)
+        {
+            r->cons_cache = ring_load(&r->cons_tail);
+            free_slots = r->size - (head - r->cons_cache);
+            if (n > free_slots)
+            {
+                n = free_slots;
+            }
+        }
+        for (i = 0; i < n; ++i)
+        {
+            r->slots[(head + i) & r->mask] = objs[i];
+        }
+        r->prod_head = head + n;
+        ring_store(&r->prod_tail, head + n);
+    }
+
+    if (n && (r->flags & RING_WAKEUP))
+    {
+        ring_notify(r);
+    }
+    return n;
+}
+
+unsigned int
+ring_dequeue_burst(struct ring *r, void **objs, unsigned int n)
+{
+    const unsigned int tail = r->cons_tail;
+    unsigned int avail = r->prod_cache - tail;
+    unsigned int i;
+
+    if (n > avail)
+    {
+        r->prod_cache = ring_load(&r->prod_tail);
+        avail = r->prod_cache - tail;
+        if (n > avail)
+        {
+            n = avail;
+        }
+    }
+    for (i = 0; i < n; ++i)
+    {
+        objs[i] = r->slots[(tail + i) & r->mask];
+    }
+    if (n)
+    {
+        ring_store(&r->cons_tail, tail + n);
+    }
+    return n;
+}
+
+unsigned int
+ring_count(const struct ring *r)
+{
+    return ring_load((unsigned int *)&r->prod_tail) - ring_load((unsigned int *)&r->cons_tail);
+}
+
+bool
+ring_wait_set(struct ring *r, struct event_set *es, void *arg)
+{
+    ASSERT(r->flags & RING_WAKEUP);
+    ring_exchange(&r->waiting, 1);
+    if (ring_count(r))
+    {
+        ring_store((unsigned int *)&r->waiting, 0);
+        return false;
+    }
+    event_ctl(es, r->wakeup, EVENT_READ, arg);
+    return true;
+}
+
+void
+ring_wakeup_clear(struct ring *r)
+{
+#ifdef _WIN32
+    ResetEvent(r->wakeup_handle.read);
+#else
+    uint8_t drain[64];
+    while (read(r->wakeup, drain, sizeof(drain)) > 0)
+    {
+    }
+#endif
+}
@@ -0,0 +1,161 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Lock-free rings of pointers, for handing packets from one thread to
+ * another without taking a lock.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include "basic.h"
+#include "event.h"
+
+/*
+ * The fields written by the producers, the fields written by the
+ * consumer and the constant fields of a ring are kept at least this far
+ * apart, so that the two sides do not keep stealing a cache line from
+ * each other.
+ */
+#define RING_CACHE_LINE 64
+
+/* flags for ring_new() */
+#define RING_MP      (1<<0) /**< Several threads may enqueue */
+#define RING_WAKEUP  (1<<1) /**< The consumer can sleep in event_wait() */
+
+/**
+ * A ring of \c size pointers, with one consumer and either one producer
+ * (SPSC) or, with \c RING_MP, any number of producers (MPSC).
+ *
+ * The head and tail counters run freely and wrap at UINT_MAX; a slot is
+ * found by masking a counter with \c size - 1.  A producer reserves
+ * slots by advancing \c prod_head, fills them, and publishes them by
+ * advancing \c prod_tail.  The consumer reads the slots below \c
+ * prod_tail and gives them back by advancing \c cons_tail.
+ */
+struct ring
+{
+    /* constant after ring_new() */
+    void **slots;
+    unsigned int size;
+    unsigned int mask;
+    unsigned int flags;
+    event_t wakeup;             /**< readable when the consumer should wake up */
+#ifdef _WIN32
+    struct rw_handle wakeup_handle;
+#else
+    int wakeup_write;           /**< write end of the wakeup, may be \c wakeup */
+#endif
+    uint8_t pad0[RING_CACHE_LINE];
+
+    /* written by the producers */
+    unsigned int prod_head;
+    unsigned int prod_tail;
+    unsigned int cons_cache;    /**< SPSC: last \c cons_tail seen by the producer */
+    uint8_t pad1[RING_CACHE_LINE];
+
+    /* written by the consumer */
+    unsigned int cons_tail;
+    unsigned int prod_cache;    /**< last \c prod_tail seen by the consumer */
+    int waiting;                /**< the consumer is about to sleep */
+    uint8_t pad2[RING_CACHE_LINE];
+};
+
+/**
+ * Allocate a ring.
+ *
+ * @param size      The number of slots, rounded up to a power of two.
+ * @param flags     \c RING_x flags.
+ *
+ * @return The ring; exits if the wakeup event cannot be created.
+ */
+struct ring *ring_new(unsigned int size, unsigned int flags);
+
+/**
+ * Free a ring.  The pointers still in it are not touched.
+ */
+void ring_free(struct ring *r);
+
+/**
+ * Add up to \c n pointers to the ring, in order.  Safe to call from
+ * several threads at once only for a ring with \c RING_MP.  Wakes up the
+ * consumer if it sleeps in event_wait().
+ *
+ * @return The number of pointers added, less than \c n if the ring is
+ *         full.
+ */
+unsigned int ring_enqueue_burst(struct ring *r, void *const *objs, unsigned int n);
+
+/**
+ * Remove up to \c n pointers from the ring, in the order they were
+ * added.  Only one thread may call this for a given ring.
+ *
+ * @return The number of pointers removed, 0 if the ring is empty.
+ */
+unsigned int ring_dequeue_burst(struct ring *r, void **objs, unsigned int n);
+
+/**
+ * Tell the producers that the consumer is going to sleep, and register
+ * the wakeup event of the ring with \c es for reading.  Must be called
+ * before every event_wait() of the consumer, for a ring with \c
+ * RING_WAKEUP.
+ *
+ * @return false if the ring is not empty; the consumer should then
+ *         dequeue instead of sleeping.
+ */
+bool ring_wait_set(struct ring *r, struct event_set *es, void *arg);
+
+/**
+ * Consume the wakeup, to be called by the consumer after event_wait()
+ * reported the wakeup event of the ring as readable.
+ */
+void ring_wakeup_clear(struct ring *r);
+
+/**
+ * Return the number of pointers in the ring.  Exact only in the
+ * consumer, or when no other thread uses the ring.
+ */
+unsigned int ring_count(const struct ring *r);
+
+/**
+ * Add one pointer to the ring, false if it is full.
+ */
+static inline bool
+ring_enqueue(struct ring *r, void *obj)
+{
+    return ring_enqueue_burst(r, &obj, 1) == 1;
+}
+
+/**
+ * Remove one pointer from the ring, NULL if it is empty.
+ */
+static inline void *
+ring_dequeue(struct ring *r)
+{
+    void *obj = NULL;
+    ring_dequeue_burst(r, &obj, 1);
+    return obj;
+}
+
+#endif /* RING_H */
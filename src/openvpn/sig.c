@@ -283,6 +283,67 @@ restore_signal_state(void)
 #endif
 }
 
+/*
+ * Where the event loop runs, and where the kernel handles the packets
+ * of the TCP/UDP socket, with --cpu-affinity.  Lines start with prefix
+ * and separate the name from the value with sep.
+ */
+void
+print_placement(const struct context *c, struct status_output *so,
+                const char *prefix, const char sep)
+{
+    const int cpu = platform_current_cpu();
+    const int in_cpu = link_socket_incoming_cpu(c->c2.link_socket);
+    const int napi_id = link_socket_napi_id(c->c2.link_socket);
+
+    status_printf(so, "%sCPU affinity%c%s", prefix, sep, c->options.cpu_affinity);
+    if (cpu >= 0)
+    {
+        status_printf(so, "%sCPU%c%d", prefix, sep, cpu);
+        status_printf(so, "%sNUMA node%c%d", prefix, sep, platform_cpu_node(cpu));
+    }
+    if (in_cpu >= 0)
+    {
+        status_printf(so, "%sSocket incoming CPU%c%d", prefix, sep, in_cpu);
+        status_printf(so, "%sSocket incoming NUMA node%c%d", prefix, sep,
+                      platform_cpu_node(in_cpu));
+    }
+    if (napi_id >= 0)
+    {
+        status_printf(so, "%sSocket NAPI id%c%d", prefix, sep, napi_id);
+    }
+}
+
+/*
+ * Print the replay window of the data channel and how far out of order
+ * the packets it accepted arrived.
+ */
+static void
+print_replay_status(const struct context *c, struct status_output *so)
+{
+    const struct packet_id_rec *rec = &c->c2.crypto_options.packet_id.rec;
+    int i;
+
+    if (c->c2.tls_multi)
+    {
+        rec = &c->c2.tls_multi->session[TM_ACTIVE].key[KS_PRIMARY].crypto_options.packet_id.rec;
+    }
+    if (!rec->window)
+    {
+        return;
+    }
+
+    status_printf(so, "Replay window,%d", rec->seq_backtrack);
+    status_printf(so, "Replay reorder distance 0," counter_format, rec->reorder[0]);
+    status_printf(so, "Replay reorder distance 1," counter_format, rec->reorder[1]);
+    for (i = 2; i < PID_REORDER_BUCKETS; ++i)
+    {
+        status_printf(so, "Replay reorder distance %u-%u," counter_format,
+                      1u << (i - 1), (1u << i) - 1, rec->reorder[i]);
+    }
+    status_printf(so, "Replay window drops," counter_format, rec->too_late);
+}
+
 /*
  * Print statistics.
  *
@@ -308,6 +369,44 @@ print_status(const struct context *c, struct status_output *so)
         comp_print_stats(c->c2.comp_context, so);
     }
 #endif
+    if (c->c2.fec)
+    {
+        fec_print_stats(c->c2.fec, so);
+    }
+    if (c->c2.hc)
+    {
+        hc_print_stats(c->c2.hc, so);
+    }
+#if ENABLE_IP_PKTINFO
+    if (c->c2.mpath)
+    {
+        mpath_print_status(c->c2.mpath, so);
+    }
+#endif
+    if (c->options.cpu_affinity)
+    {
+        print_placement(c, so, "", ',');
+    }
+    if (c->options.replay_window_max)
+    {
+        print_replay_status(c, so);
+    }
+    if (c->options.busy_poll)
+    {
+        status_printf(so, "Busy poll hits," counter_format, c->c2.busy_poll_hits);
+        status_printf(so, "Busy poll sleeps," counter_format, c->c2.busy_poll_sleeps);
+    }
+    if (c->options.pacing)
+    {
+        status_printf(so, "Pacing drops," counter_format,
+                      c->c2.pacer.dropped
+                      + (c->c2.pacing_calendar ? c->c2.pacing_calendar->n_dropped : 0));
+        if (c->c2.pacing_calendar)
+        {
+            status_printf(so, "Pacing late," counter_format,
+                          c->c2.pacing_calendar->n_late);
+        }
+    }
 #ifdef PACKET_TRUNCATION_CHECK
     status_printf(so, "TUN read truncations," counter_format, c->c2.n_trunc_tun_read);
     status_printf(so, "TUN write truncations," counter_format, c->c2.n_trunc_tun_write);
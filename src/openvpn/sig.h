@@ -73,6 +73,9 @@ void print_signal(const struct signal_info *si, const char *title, int msglevel)
 
 void print_status(const struct context *c, struct status_output *so);
 
+void print_placement(const struct context *c, struct status_output *so,
+                     const char *prefix, const char sep);
+
 void remap_signal(struct context *c);
 
 void signal_restart_status(const struct signal_info *si);
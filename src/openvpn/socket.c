@@ -41,6 +41,7 @@
 #include "manage.h"
 #include "openvpn.h"
 #include "forward.h"
+#include "handover.h"
 
 #include "memdbg.h"
 
@@ -988,6 +989,16 @@ create_socket(struct link_socket *sock, struct addrinfo *addr)
 {
     if (addr->ai_protocol == IPPROTO_UDP || addr->ai_socktype == SOCK_DGRAM)
     {
+#if SOCKET_HANDOVER
+        /* socket of the server we are replacing, it is already bound */
+        sock->sd = handover_take_link_socket(addr->ai_family);
+        if (socket_defined(sock->sd))
+        {
+            sock->sockflags |= SF_GETADDRINFO_DGRAM;
+            socket_set_buffers(sock->sd, &sock->socket_buffer_sizes);
+            return;
+        }
+#endif
         sock->sd = create_socket_udp(addr, sock->sockflags);
         sock->sockflags |= SF_GETADDRINFO_DGRAM;
 
@@ -2249,6 +2260,16 @@ link_socket_close(struct link_socket *sock)
 #endif
             if (!gremlin)
             {
+                /* --tcp-coalesce: the kernel still sends what it has
+                 * taken after the close, only the rest is lost */
+                while (link_socket_out_pending(sock) && link_socket_flush(sock) > 0)
+                {
+                }
+                if (link_socket_out_pending(sock))
+                {
+                    msg(M_INFO, "TCP: dropping %d bytes of queued packets on close",
+                        BLEN(&sock->stream_out));
+                }
                 msg(D_LOW, "TCP/UDP: Closing socket");
                 if (openvpn_close_socket(sock->sd))
                 {
@@ -2276,6 +2297,7 @@ link_socket_close(struct link_socket *sock)
 
         stream_buf_close(&sock->stream_buf);
         free_buf(&sock->stream_buf_data);
+        free_buf(&sock->stream_out);
         if (!gremlin)
         {
             free(sock);
@@ -3355,6 +3377,34 @@ link_socket_read_udp_posix(struct link_socket *sock,
  * Socket Write Routines
  */
 
+#ifndef _WIN32
+/*
+ * Add a framed packet to the --tcp-coalesce queue.  A packet that does
+ * not fit even after a flush is dropped, like a UDP packet would be
+ * when the socket buffer is full.
+ */
+static int
+link_socket_write_tcp_queue(struct link_socket *sock, struct buffer *buf)
+{
+    struct buffer *out = &sock->stream_out;
+
+    if (BLEN(buf) > out->capacity - BLEN(out))
+    {
+        if (link_socket_flush(sock) < 0)
+        {
+            return -1;
+        }
+        if (BLEN(buf) > out->capacity - BLEN(out))
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    ASSERT(buf_copy(out, buf));
+    return BLEN(buf);
+}
+#endif
+
 int
 link_socket_write_tcp(struct link_socket *sock,
                       struct buffer *buf,
@@ -3368,6 +3418,10 @@ link_socket_write_tcp(struct link_socket *sock,
 #ifdef _WIN32
     return link_socket_write_win32(sock, buf, to);
 #else
+    if (sock->stream_out.data)
+    {
+        return link_socket_write_tcp_queue(sock, buf);
+    }
     return link_socket_write_tcp_posix(sock, buf, to);
 #endif
 }
@@ -3451,6 +3505,213 @@ link_socket_write_udp_posix_sendmsg(struct link_socket *sock,
 
 #endif /* if ENABLE_IP_PKTINFO */
 
+#if ENABLE_TXTIME
+
+void
+link_socket_enable_txtime(struct link_socket *sock)
+{
+    struct sock_txtime st;
+
+    CLEAR(st);
+    st.clockid = CLOCK_MONOTONIC;
+    if (setsockopt(sock->sd, SOL_SOCKET, SO_TXTIME, (void *) &st, sizeof(st)) == 0)
+    {
+        msg(D_SOCKET_DEBUG, "Socket pacing with SO_TXTIME enabled");
+        sock->txtime = TXTIME_ENABLED;
+    }
+    else
+    {
+        msg(M_INFO | M_ERRNO, "NOTE: setsockopt SO_TXTIME failed, pacing packets internally");
+        sock->txtime = TXTIME_UNAVAILABLE;
+    }
+}
+
+size_t
+link_socket_write_udp_txtime(struct link_socket *sock,
+                             struct buffer *buf,
+                             struct link_socket_actual *to,
+                             uint64_t txtime)
+{
+    struct iovec iov;
+    struct msghdr mesg;
+    struct cmsghdr *cmsg;
+    union {
+        uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo))
+                    + CMSG_SPACE(sizeof(uint64_t))];
+        struct cmsghdr align;
+    } control;
+    size_t controllen = 0;
+
+    CLEAR(mesg);
+    CLEAR(control);
+    iov.iov_base = BPTR(buf);
+    iov.iov_len = BLEN(buf);
+    mesg.msg_iov = &iov;
+    mesg.msg_iovlen = 1;
+    mesg.msg_name = &to->dest.addr.sa;
+    mesg.msg_namelen = af_addr_size(to->dest.addr.sa.sa_family);
+    mesg.msg_control = control.buf;
+    mesg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&mesg);
+
+#if ENABLE_IP_PKTINFO
+    /* keep the source address, as link_socket_write_udp_posix_sendmsg() does */
+    if ((sock->sockflags & SF_USE_IP_PKTINFO) && addr_defined_ipi(to))
+    {
+        if (to->dest.addr.sa.sa_family == AF_INET)
+        {
+            struct in_pktinfo *pkti = (struct in_pktinfo *) CMSG_DATA(cmsg);
+
+            cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+            cmsg->cmsg_level = SOL_IP;
+            cmsg->cmsg_type = IP_PKTINFO;
+            pkti->ipi_ifindex = to->pi.in4.ipi_ifindex;
+            pkti->ipi_spec_dst = to->pi.in4.ipi_spec_dst;
+            pkti->ipi_addr.s_addr = 0;
+            controllen += CMSG_SPACE(sizeof(struct in_pktinfo));
+        }
+        else
+        {
+            struct in6_pktinfo *pkti6 = (struct in6_pktinfo *) CMSG_DATA(cmsg);
+
+            cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+            cmsg->cmsg_level = IPPROTO_IPV6;
+            cmsg->cmsg_type = IPV6_PKTINFO;
+            pkti6->ipi6_ifindex = to->pi.in6.ipi6_ifindex;
+            pkti6->ipi6_addr = to->pi.in6.ipi6_addr;
+            controllen += CMSG_SPACE(sizeof(struct in6_pktinfo));
+        }
+        cmsg = CMSG_NXTHDR(&mesg, cmsg);
+    }
+#endif /* if ENABLE_IP_PKTINFO */
+
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_TXTIME;
+    memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+    controllen += CMSG_SPACE(sizeof(uint64_t));
+
+    mesg.msg_controllen = controllen;
+    return sendmsg(sock->sd, &mesg, 0);
+}
+
+#endif /* if ENABLE_TXTIME */
+
+void
+link_socket_set_pacing_rate(struct link_socket *sock, int rate)
+{
+#if defined(TARGET_LINUX) && HAVE_DECL_SO_MAX_PACING_RATE
+    unsigned int r = rate;
+
+    if (setsockopt(sock->sd, SOL_SOCKET, SO_MAX_PACING_RATE, (void *) &r, sizeof(r)) != 0)
+    {
+        msg(M_WARN | M_ERRNO, "NOTE: setsockopt SO_MAX_PACING_RATE=%d failed", rate);
+    }
+#else
+    msg(M_WARN, "NOTE: --pacing is not supported for TCP on this platform");
+#endif
+}
+
+void
+link_socket_set_busy_poll(struct link_socket *sock, int usec)
+{
+    if (!socket_defined(sock->sd))
+    {
+        return;
+    }
+#if defined(TARGET_LINUX) && HAVE_DECL_SO_BUSY_POLL
+    if (setsockopt(sock->sd, SOL_SOCKET, SO_BUSY_POLL, (void *) &usec, sizeof(usec)) != 0)
+    {
+        msg(M_WARN | M_ERRNO, "NOTE: setsockopt SO_BUSY_POLL=%d failed", usec);
+    }
+#if HAVE_DECL_SO_PREFER_BUSY_POLL
+    {
+        int on = 1;
+        if (setsockopt(sock->sd, SOL_SOCKET, SO_PREFER_BUSY_POLL, (void *) &on, sizeof(on)) != 0)
+        {
+            dmsg(D_OSBUF, "NOTE: setsockopt SO_PREFER_BUSY_POLL failed");
+        }
+    }
+#endif
+#endif /* if defined(TARGET_LINUX) && HAVE_DECL_SO_BUSY_POLL */
+}
+
+void
+link_socket_set_tcp_coalesce(struct link_socket *sock, int size)
+{
+    if (!link_socket_connection_oriented(sock) || sock->stream_out.data)
+    {
+        return;
+    }
+    /* room for at least two full size packets */
+    size = max_int(size, 2 * (sock->stream_buf.maxlen + (int) sizeof(packet_size_type)));
+    sock->stream_out = alloc_buf(size);
+    dmsg(D_STREAM_DEBUG, "STREAM: coalescing writes in %d bytes", size);
+}
+
+int
+link_socket_flush(struct link_socket *sock)
+{
+    struct buffer *out = &sock->stream_out;
+    int size;
+
+    if (BLEN(out) <= 0)
+    {
+        return 0;
+    }
+#ifdef _WIN32
+    ASSERT(0);
+    size = -1;
+#else
+    size = send(sock->sd, BPTR(out), BLEN(out), MSG_NOSIGNAL);
+#endif
+    dmsg(D_STREAM_DEBUG, "STREAM: FLUSH %d of %d", size, BLEN(out));
+    if (size > 0)
+    {
+        ASSERT(buf_advance(out, size));
+        /* keep the unsent rest of a partial write at the start */
+        if (BLEN(out) > 0)
+        {
+            memmove(out->data, BPTR(out), BLEN(out));
+        }
+        out->offset = 0;
+    }
+    return size;
+}
+
+int
+link_socket_incoming_cpu(const struct link_socket *sock)
+{
+#if defined(TARGET_LINUX) && HAVE_DECL_SO_INCOMING_CPU
+    int cpu;
+    socklen_t len = sizeof(cpu);
+
+    if (sock && socket_defined(sock->sd)
+        && getsockopt(sock->sd, SOL_SOCKET, SO_INCOMING_CPU, (void *) &cpu, &len) == 0)
+    {
+        return cpu;
+    }
+#endif
+    return -1;
+}
+
+int
+link_socket_napi_id(const struct link_socket *sock)
+{
+#if defined(TARGET_LINUX) && HAVE_DECL_SO_INCOMING_NAPI_ID
+    unsigned int id;
+    socklen_t len = sizeof(id);
+
+    if (sock && socket_defined(sock->sd)
+        && getsockopt(sock->sd, SOL_SOCKET, SO_INCOMING_NAPI_ID, (void *) &id, &len) == 0
+        && id)
+    {
+        return id;
+    }
+#endif
+    return -1;
+}
+
 /*
  * Win32 overlapped socket I/O functions.
  */
@@ -218,6 +218,9 @@ struct link_socket
     struct buffer stream_buf_data;
     bool stream_reset;
 
+    /* --tcp-coalesce: framed packets not yet passed to send() */
+    struct buffer stream_out;
+
     /* HTTP proxy */
     struct http_proxy_info *http_proxy;
 
@@ -246,6 +249,14 @@ struct link_socket
 #ifdef ENABLE_DEBUG
     int gremlin; /* --gremlin bits */
 #endif
+
+#if ENABLE_TXTIME
+    /* SO_TXTIME for --pacing, enabled on first use */
+#define TXTIME_UNKNOWN     0
+#define TXTIME_ENABLED     1
+#define TXTIME_UNAVAILABLE 2
+    int txtime;
+#endif
 };
 
 /*
@@ -1169,6 +1180,82 @@ link_socket_write(struct link_socket *sock,
     }
 }
 
+#if ENABLE_TXTIME
+
+void link_socket_enable_txtime(struct link_socket *sock);
+
+/*
+ * Can packets on this UDP socket be given a transmit time?
+ */
+static inline bool
+link_socket_txtime(struct link_socket *sock)
+{
+    if (sock->txtime == TXTIME_UNKNOWN)
+    {
+        link_socket_enable_txtime(sock);
+    }
+    return sock->txtime == TXTIME_ENABLED;
+}
+
+/*
+ * write a UDP packet to link, to be sent by the kernel at txtime
+ * (CLOCK_MONOTONIC, in nanoseconds)
+ */
+size_t link_socket_write_udp_txtime(struct link_socket *sock,
+                                    struct buffer *buf,
+                                    struct link_socket_actual *to,
+                                    uint64_t txtime);
+
+#endif /* if ENABLE_TXTIME */
+
+/*
+ * Limit the rate the kernel sends at on a TCP socket, see --pacing.
+ */
+void link_socket_set_pacing_rate(struct link_socket *sock, int rate);
+
+/*
+ * Let the kernel poll the device queue for packets to this socket,
+ * see --busy-poll.
+ */
+void link_socket_set_busy_poll(struct link_socket *sock, int usec);
+
+/*
+ * Queue the packets written to a TCP socket in a buffer of size bytes,
+ * and only pass them to the kernel with link_socket_flush(), see
+ * --tcp-coalesce.  Does nothing for UDP sockets.
+ */
+void link_socket_set_tcp_coalesce(struct link_socket *sock, int size);
+
+/*
+ * Send as much of the --tcp-coalesce queue as the socket takes.
+ * Returns the result of send(), or 0 if the queue is empty.
+ */
+int link_socket_flush(struct link_socket *sock);
+
+/* Are there packets in the --tcp-coalesce queue? */
+static inline bool
+link_socket_out_pending(const struct link_socket *sock)
+{
+    return sock && sock->stream_out.len > 0;
+}
+
+/* Can a packet of the maximum size be written without blocking? */
+static inline bool
+link_socket_out_room(const struct link_socket *sock)
+{
+    return !sock->stream_out.data
+           || sock->stream_out.capacity - sock->stream_out.len
+           >= sock->stream_buf.maxlen + (int) sizeof(packet_size_type);
+}
+
+/*
+ * The CPU that last handled a packet for the socket in the kernel, and
+ * the NAPI id of the receive queue it came from, or -1 if unknown.
+ */
+int link_socket_incoming_cpu(const struct link_socket *sock);
+
+int link_socket_napi_id(const struct link_socket *sock);
+
 #if PASSTOS_CAPABILITY
 
 /*
@@ -263,7 +263,7 @@ static const tls_cipher_name_pair tls_cipher_name_translation_table[] = {
  * @param key_len               HMAC key length
  */
 static void
-key_ctx_update_implicit_iv(struct key_ctx *ctx, uint8_t *key, size_t key_len);
+key_ctx_update_implicit_iv(struct key_ctx *ctx, const uint8_t *key, size_t key_len);
 
 const tls_cipher_name_pair *
 tls_get_cipher_name_pair(const char *cipher_name, size_t len)
@@ -359,6 +359,7 @@ free_ssl_lib(void)
     prng_uninit();
 
     tls_free_lib();
+    reliable_pool_free();
 }
 
 /*
@@ -931,10 +932,8 @@ key_state_init(struct tls_session *session, struct key_state *ks)
     ALLOC_OBJ_CLEAR(ks->rec_reliable, struct reliable);
     ALLOC_OBJ_CLEAR(ks->rec_ack, struct reliable_ack);
 
-    /* allocate buffers */
-    ks->plaintext_read_buf = alloc_buf(TLS_CHANNEL_BUF_SIZE);
-    ks->plaintext_write_buf = alloc_buf(TLS_CHANNEL_BUF_SIZE);
-    ks->ack_write_buf = alloc_buf(BUF_SIZE(&session->opt->frame));
+    /* plaintext, ACK and reliable buffers are taken from the control
+     * channel buffer pool by tls_process() when they are needed */
     reliable_init(ks->send_reliable, BUF_SIZE(&session->opt->frame),
                   FRAME_HEADROOM(&session->opt->frame), TLS_RELIABLE_N_SEND_BUFFERS,
                   ks->key_id ? false : session->opt->xmit_hold);
@@ -947,7 +946,8 @@ key_state_init(struct tls_session *session, struct key_state *ks)
     if (session->opt->replay)
     {
         packet_id_init(&ks->crypto_options.packet_id,
-                       session->opt->replay_window, session->opt->replay_time, "SSL",
+                       session->opt->replay_window, session->opt->replay_window_max,
+                       session->opt->replay_time, "SSL",
                        ks->key_id);
     }
 
@@ -980,9 +980,9 @@ key_state_free(struct key_state *ks, bool clear)
     key_state_ssl_free(&ks->ks_ssl);
 
     free_key_ctx_bi(&ks->crypto_options.key_ctx_bi);
-    free_buf(&ks->plaintext_read_buf);
-    free_buf(&ks->plaintext_write_buf);
-    free_buf(&ks->ack_write_buf);
+    reliable_buf_free(&ks->plaintext_read_buf);
+    reliable_buf_free(&ks->plaintext_write_buf);
+    reliable_buf_free(&ks->ack_write_buf);
     buffer_list_free(ks->paybuf);
 
     if (ks->send_reliable)
@@ -1101,6 +1101,7 @@ tls_session_init(struct tls_multi *multi, struct tls_session *session)
 
     /* initialize packet ID replay window for --tls-auth */
     packet_id_init(&session->tls_wrap.opt.packet_id,
+                   session->opt->replay_window,
                    session->opt->replay_window,
                    session->opt->replay_time,
                    "TLS_WRAP", session->key_id);
@@ -1777,6 +1778,25 @@ openvpn_PRF(const uint8_t *secret,
     VALGRIND_MAKE_READABLE((void *)output, output_len);
 }
 
+/*
+ * Initialize the data channel key contexts of one side from the
+ * expanded key material.
+ */
+static void
+init_data_channel_key_ctx(struct key_ctx_bi *key, const struct key2 *key2,
+                          const struct key_type *key_type, bool server)
+{
+    /* Initialize OpenSSL key contexts */
+    int key_direction = server ? KEY_DIRECTION_INVERSE : KEY_DIRECTION_NORMAL;
+    init_key_ctx_bi(key, key2, key_direction, key_type, "Data Channel");
+
+    /* Initialize implicit IVs */
+    key_ctx_update_implicit_iv(&key->encrypt, key2->keys[(int)server].hmac,
+                               MAX_HMAC_KEY_LENGTH);
+    key_ctx_update_implicit_iv(&key->decrypt, key2->keys[1-(int)server].hmac,
+                               MAX_HMAC_KEY_LENGTH);
+}
+
 /*
  * Using source entropy from local and remote hosts, mix into
  * master key.
@@ -1843,15 +1863,7 @@ generate_key_expansion(struct key_ctx_bi *key,
         }
     }
 
-    /* Initialize OpenSSL key contexts */
-    int key_direction = server ? KEY_DIRECTION_INVERSE : KEY_DIRECTION_NORMAL;
-    init_key_ctx_bi(key, &key2, key_direction, key_type, "Data Channel");
-
-    /* Initialize implicit IVs */
-    key_ctx_update_implicit_iv(&key->encrypt, key2.keys[(int)server].hmac,
-                               MAX_HMAC_KEY_LENGTH);
-    key_ctx_update_implicit_iv(&key->decrypt, key2.keys[1-(int)server].hmac,
-                               MAX_HMAC_KEY_LENGTH);
+    init_data_channel_key_ctx(key, &key2, key_type, server);
 
     ret = true;
 
@@ -1863,7 +1875,7 @@ exit:
 }
 
 static void
-key_ctx_update_implicit_iv(struct key_ctx *ctx, uint8_t *key, size_t key_len)
+key_ctx_update_implicit_iv(struct key_ctx *ctx, const uint8_t *key, size_t key_len)
 {
     const cipher_kt_t *cipher_kt = cipher_ctx_get_cipher_kt(ctx->cipher);
 
@@ -1949,6 +1961,34 @@ cleanup:
     return ret;
 }
 
+/*
+ * Set the data channel cipher and auth of a session from options, and
+ * adjust the frame to their overhead.
+ */
+static void
+tls_session_update_key_type(struct tls_session *session,
+                            struct options *options, struct frame *frame)
+{
+    init_key_type(&session->opt->key_type, options->ciphername,
+                  options->authname, options->keysize, true, true);
+
+    bool packet_id_long_form = cipher_kt_mode_ofb_cfb(session->opt->key_type.cipher);
+    session->opt->crypto_flags &= ~(CO_PACKET_ID_LONG_FORM);
+    if (packet_id_long_form)
+    {
+        session->opt->crypto_flags |= CO_PACKET_ID_LONG_FORM;
+    }
+
+    /* Update frame parameters: undo worst-case overhead, add actual overhead */
+    frame_add_to_extra_frame(frame, -(crypto_max_overhead()));
+    crypto_adjust_frame_parameters(frame, &session->opt->key_type,
+                                   options->replay, packet_id_long_form);
+    frame_finalize(frame, options->ce.link_mtu_defined, options->ce.link_mtu,
+                   options->ce.tun_mtu_defined, options->ce.tun_mtu);
+    frame_init_mssfix(frame, options);
+    frame_print(frame, D_MTU_INFO, "Data Channel MTU parms");
+}
+
 bool
 tls_session_update_crypto_params(struct tls_session *session,
                                  struct options *options, struct frame *frame)
@@ -1976,27 +2016,61 @@ tls_session_update_crypto_params(struct tls_session *session,
         }
     }
 
-    init_key_type(&session->opt->key_type, options->ciphername,
-                  options->authname, options->keysize, true, true);
+    tls_session_update_key_type(session, options, frame);
 
-    bool packet_id_long_form = cipher_kt_mode_ofb_cfb(session->opt->key_type.cipher);
-    session->opt->crypto_flags &= ~(CO_PACKET_ID_LONG_FORM);
-    if (packet_id_long_form)
+    return tls_session_generate_data_channel_keys(session);
+}
+
+#if P2MP_SERVER && defined(ENABLE_TRACE_REPLAY)
+void
+tls_multi_init_replay(struct tls_multi *multi, struct options *options,
+                      struct frame *frame, const char *common_name,
+                      struct link_socket_info *lsi,
+                      const struct link_socket_actual *remote,
+                      struct key_ctx_bi *peer)
+{
+    struct tls_session *session = &multi->session[TM_ACTIVE];
+    struct key_state *ks = &session->key[KS_PRIMARY];
+    struct key2 key2;
+
+    /* the cipher push.c selects for a client that supports NCP */
+    if (options->ncp_enabled)
     {
-        session->opt->crypto_flags |= CO_PACKET_ID_LONG_FORM;
+        char *ncp_ciphers = string_alloc(options->ncp_ciphers, &options->gc);
+        options->ciphername = strtok(ncp_ciphers, ":");
+        if (strcmp(options->ciphername, session->opt->config_ciphername))
+        {
+            options->keysize = 0;
+        }
     }
+    tls_session_update_key_type(session, options, frame);
 
-    /* Update frame parameters: undo worst-case overhead, add actual overhead */
-    frame_add_to_extra_frame(frame, -(crypto_max_overhead()));
-    crypto_adjust_frame_parameters(frame, &session->opt->key_type,
-                                   options->replay, packet_id_long_form);
-    frame_finalize(frame, options->ce.link_mtu_defined, options->ce.link_mtu,
-                   options->ce.tun_mtu_defined, options->ce.tun_mtu);
-    frame_init_mssfix(frame, options);
-    frame_print(frame, D_MTU_INFO, "Data Channel MTU parms");
+    CLEAR(key2);
+    key2.n = 2;
+    generate_key_random(&key2.keys[0], &session->opt->key_type);
+    generate_key_random(&key2.keys[1], &session->opt->key_type);
+    ks->crypto_options.flags = session->opt->crypto_flags;
+    init_data_channel_key_ctx(&ks->crypto_options.key_ctx_bi, &key2,
+                              &session->opt->key_type, true);
+    init_data_channel_key_ctx(peer, &key2, &session->opt->key_type, false);
+    secure_memzero(&key2, sizeof(key2));
 
-    return tls_session_generate_data_channel_keys(session);
+    /* a renegotiation could not complete without the peer */
+    session->opt->renegotiate_seconds = 0;
+    session->opt->renegotiate_bytes = 0;
+    session->opt->renegotiate_packets = 0;
+
+    set_common_name(session, common_name);
+    ks->state = S_ACTIVE;
+    ks->authenticated = true;
+    ks->established = now;
+    ks->remote_addr = *remote;
+    multi->use_peer_id = true;
+
+    link_socket_set_outgoing_addr(NULL, lsi, remote, session->common_name,
+                                  session->opt->es);
 }
+#endif /* P2MP_SERVER && ENABLE_TRACE_REPLAY */
 
 static bool
 random_bytes_to_buf(struct buffer *buf,
@@ -2695,6 +2769,30 @@ auth_deferred_expire_window(const struct tls_options *o)
     return ret;
 }
 
+/*
+ * Return the control channel buffers of an established key state to the
+ * buffer pool once there is nothing buffered, unacknowledged or waiting
+ * to be acknowledged.  They are allocated again if the key is renegotiated
+ * or the peer sends more control messages.  Only called when to_link is
+ * empty, so that no pending outgoing packet points into them.
+ */
+static void
+key_state_release_idle_bufs(struct key_state *ks)
+{
+    if (BLEN(&ks->plaintext_read_buf) || BLEN(&ks->plaintext_write_buf)
+        || !reliable_empty(ks->send_reliable) || !reliable_empty(ks->rec_reliable)
+        || !reliable_ack_empty(ks->rec_ack))
+    {
+        return;
+    }
+
+    reliable_buf_free(&ks->plaintext_read_buf);
+    reliable_buf_free(&ks->plaintext_write_buf);
+    reliable_buf_free(&ks->ack_write_buf);
+    reliable_release_idle(ks->send_reliable);
+    reliable_release_idle(ks->rec_reliable);
+}
+
 /*
  * This is the primary routine for processing TLS stuff inside the
  * the main event loop.  When this routine exits
@@ -2926,6 +3024,10 @@ tls_process(struct tls_multi *multi,
         {
             int status;
 
+            if (!buf_defined(buf))
+            {
+                *buf = reliable_buf_alloc(TLS_CHANNEL_BUF_SIZE);
+            }
             ASSERT(buf_init(buf, 0));
             status = key_state_read_plaintext(&ks->ks_ssl, buf, TLS_CHANNEL_BUF_SIZE);
             update_time();
@@ -2949,6 +3051,10 @@ tls_process(struct tls_multi *multi,
         if (!buf->len && ((ks->state == S_START && !session->opt->server)
                           || (ks->state == S_GOT_KEY && session->opt->server)))
         {
+            if (!buf_defined(buf))
+            {
+                *buf = reliable_buf_alloc(TLS_CHANNEL_BUF_SIZE);
+            }
             if (session->opt->key_method == 1)
             {
                 if (!key_method_1_write(buf, session))
@@ -3051,7 +3157,12 @@ tls_process(struct tls_multi *multi,
     /* Send 1 or more ACKs (each received control packet gets one ACK) */
     if (!to_link->len && !reliable_ack_empty(ks->rec_ack))
     {
-        struct buffer buf = ks->ack_write_buf;
+        struct buffer buf;
+        if (!buf_defined(&ks->ack_write_buf))
+        {
+            ks->ack_write_buf = reliable_buf_alloc(BUF_SIZE(&session->opt->frame));
+        }
+        buf = ks->ack_write_buf;
         ASSERT(buf_init(&buf, FRAME_HEADROOM(&multi->opt.frame)));
         write_control_auth(session, ks, &buf, to_link_addr, P_ACK_V1,
                            RELIABLE_ACK_SIZE, false);
@@ -3060,6 +3171,12 @@ tls_process(struct tls_multi *multi,
         dmsg(D_TLS_DEBUG, "Dedicated ACK -> TCP/UDP");
     }
 
+    /* Handshake done and nothing in flight, give the buffers back */
+    if (!to_link->len && ks->state >= S_ACTIVE)
+    {
+        key_state_release_idle_bufs(ks);
+    }
+
     /* When should we wake up again? */
     {
         if (ks->state >= S_INITIAL)
@@ -3350,8 +3467,8 @@ tls_pre_decrypt(struct tls_multi *multi,
                  * passive side is the server which only listens for the connections, the
                  * active side is the client which initiates connections).
                  */
-                if (DECRYPT_KEY_ENABLED(multi, ks)
-                    && key_id == ks->key_id
+                if (key_id == ks->key_id
+                    && DECRYPT_KEY_ENABLED(multi, ks)
                     && ks->authenticated
 #ifdef ENABLE_DEF_AUTH
                     && !ks->auth_deferred
@@ -481,6 +481,30 @@ void tls_update_remote_addr(struct tls_multi *multi,
 bool tls_session_update_crypto_params(struct tls_session *session,
                                       struct options *options, struct frame *frame);
 
+#if P2MP_SERVER && defined(ENABLE_TRACE_REPLAY)
+/**
+ * Complete the key exchange of a new server-side tunnel without a
+ * client, for \c --trace-replay.  The primary key of the active session
+ * is given random data channel keys and made active and authenticated,
+ * as if the handshake with a client at \c remote had just finished.
+ *
+ * @param multi         The TLS state of the new client instance.
+ * @param options       The instance's options; the cipher is chosen
+ *                      like for a client that supports NCP.
+ * @param frame         The instance's frame, adjusted to the cipher.
+ * @param common_name   The common name the client is known by.
+ * @param lsi           The instance's link socket info.
+ * @param remote        The client's address.
+ * @param peer          Returns the client side of the data channel keys.
+ */
+void tls_multi_init_replay(struct tls_multi *multi, struct options *options,
+                           struct frame *frame, const char *common_name,
+                           struct link_socket_info *lsi,
+                           const struct link_socket_actual *remote,
+                           struct key_ctx_bi *peer);
+
+#endif
+
 /**
  * "Poor man's NCP": Use peer cipher if it is an allowed (NCP) cipher.
  * Allows non-NCP peers to upgrade their cipher individually.
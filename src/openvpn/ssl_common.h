@@ -147,6 +147,13 @@ struct key_source2 {
  */
 struct key_state
 {
+    /*
+     * The members up to and including crypto_options are read for every
+     * data channel packet by tls_pre_decrypt() and tls_pre_encrypt(),
+     * keep them together at the start of the structure so that key
+     * selection touches as few cache lines as possible.  Control channel
+     * state follows below.
+     */
     int state;
 
     /**
@@ -155,6 +162,23 @@ struct key_state
      */
     int key_id;
 
+    /*
+     * If bad username/password, TLS connection will come up but 'authenticated' will be false.
+     */
+    bool authenticated;
+#ifdef ENABLE_DEF_AUTH
+    /* If auth_deferred is true, authentication is being deferred */
+    bool auth_deferred;
+#endif
+    time_t auth_deferred_expire;
+
+    counter_type n_bytes;                /* how many bytes sent/recvd since last key exchange */
+    counter_type n_packets;              /* how many packets sent/recvd since last key exchange */
+
+    struct link_socket_actual remote_addr; /* peer's IP addr */
+
+    struct crypto_options crypto_options;/* data channel crypto options */
+
     struct key_state_ssl ks_ssl; /* contains SSL object and BIOs for the control channel */
 
     time_t established;         /* when our state went S_ACTIVE */
@@ -163,9 +187,6 @@ struct key_state
 
     int initial_opcode;         /* our initial P_ opcode */
     struct session_id session_id_remote; /* peer's random session ID */
-    struct link_socket_actual remote_addr; /* peer's IP addr */
-
-    struct crypto_options crypto_options;/* data channel crypto options */
 
     struct key_source2 *key_src;       /* source entropy for key expansion */
 
@@ -179,18 +200,7 @@ struct key_state
 
     struct buffer_list *paybuf;
 
-    counter_type n_bytes;                /* how many bytes sent/recvd since last key exchange */
-    counter_type n_packets;              /* how many packets sent/recvd since last key exchange */
-
-    /*
-     * If bad username/password, TLS connection will come up but 'authenticated' will be false.
-     */
-    bool authenticated;
-    time_t auth_deferred_expire;
-
 #ifdef ENABLE_DEF_AUTH
-    /* If auth_deferred is true, authentication is being deferred */
-    bool auth_deferred;
 #ifdef MANAGEMENT_DEF_AUTH
     unsigned int mda_key_id;
     unsigned int mda_status;
@@ -279,6 +289,7 @@ struct tls_options
     unsigned int crypto_flags;
 
     int replay_window;                 /* --replay-window parm */
+    int replay_window_max;             /* --replay-window-max parm */
     int replay_time;                   /* --replay-window parm */
     bool tcp_mode;
 
@@ -478,9 +489,10 @@ struct tls_multi
     /* used to coordinate access between main thread and TLS thread */
     /*MUTEX_PTR_DEFINE (mutex);*/
 
-    /* const options and config info */
-    struct tls_options opt;
-
+    /*
+     * Data channel state, read for every packet.  Keep these members
+     * in front of the (large) tls_options so they share a cache line.
+     */
     struct key_state *key_scan[KEY_SCAN_SIZE];
     /**< List of \c key_state objects in the
      *   order they should be scanned by data
@@ -492,6 +504,13 @@ struct tls_multi
      */
     struct key_state *save_ks;  /* temporary pointer used between pre/post routines */
 
+    /* For P_DATA_V2 */
+    uint32_t peer_id;
+    bool use_peer_id;
+
+    /* const options and config info */
+    struct tls_options opt;
+
     /*
      * Used to return outgoing address from
      * tls_multi_process.
@@ -532,10 +551,6 @@ struct tls_multi
     char *peer_info;
 #endif
 
-    /* For P_DATA_V2 */
-    uint32_t peer_id;
-    bool use_peer_id;
-
     char *remote_ciphername;    /**< cipher specified in peer's config file */
 
     char *auth_token;    /**< If server sends a generated auth-token,
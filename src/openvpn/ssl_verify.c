@@ -121,7 +121,7 @@ tls_deauthenticate(struct tls_multi *multi)
 /*
  * Set the given session's common_name
  */
-static void
+void
 set_common_name(struct tls_session *session, const char *common_name)
 {
     if (session->common_name)
@@ -116,6 +116,15 @@ void tls_lock_cert_hash_set(struct tls_multi *multi);
  */
 void tls_lock_common_name(struct tls_multi *multi);
 
+/**
+ * Sets the common name of the given session, which is normally taken
+ * from the peer's certificate or username
+ *
+ * @param session     The session to set it for
+ * @param common_name The common name, may be NULL
+ */
+void set_common_name(struct tls_session *session, const char *common_name);
+
 /**
  * Returns the common name field for the given tunnel
  *
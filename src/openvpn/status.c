@@ -111,6 +111,12 @@ status_open(const char *filename,
                 {
                     so->read_buf = alloc_buf(512);
                 }
+
+                /* allocate write buffer */
+                if (so->flags & STATUS_OUTPUT_WRITE)
+                {
+                    so->write_buf = alloc_buf(STATUS_WRITE_BUF_SIZE);
+                }
             }
             else
             {
@@ -131,6 +137,25 @@ status_open(const char *filename,
     return so;
 }
 
+/*
+ * Write out buffered output.  Files like the status file or the
+ * ifconfig-pool-persist file can hold thousands of lines, writing them
+ * one system call per line stalls the event loop.
+ */
+static void
+status_write_pending(struct status_output *so)
+{
+    if (so->fd >= 0 && BLEN(&so->write_buf) > 0)
+    {
+        if (!so->errors
+            && write(so->fd, BPTR(&so->write_buf), BLEN(&so->write_buf)) != BLEN(&so->write_buf))
+        {
+            so->errors = true;
+        }
+        ASSERT(buf_init(&so->write_buf, 0));
+    }
+}
+
 bool
 status_trigger(struct status_output *so)
 {
@@ -164,6 +189,7 @@ status_reset(struct status_output *so)
 {
     if (so && so->fd >= 0)
     {
+        status_write_pending(so);
         lseek(so->fd, (off_t)0, SEEK_SET);
     }
 }
@@ -173,6 +199,8 @@ status_flush(struct status_output *so)
 {
     if (so && so->fd >= 0 && (so->flags & STATUS_OUTPUT_WRITE))
     {
+        status_write_pending(so);
+
 #if defined(HAVE_FTRUNCATE)
         {
             const off_t off = lseek(so->fd, (off_t)0, SEEK_CUR);
@@ -205,6 +233,11 @@ status_close(struct status_output *so)
     bool ret = true;
     if (so)
     {
+        if (buf_defined(&so->write_buf))
+        {
+            status_write_pending(so);
+            free_buf(&so->write_buf);
+        }
         if (so->errors)
         {
             ret = false;
@@ -264,13 +297,11 @@ status_printf(struct status_output *so, const char *format, ...)
             int len;
             strcat(buf, "\n");
             len = strlen(buf);
-            if (len > 0)
+            if (len > BCAP(&so->write_buf))
             {
-                if (write(so->fd, buf, len) != len)
-                {
-                    so->errors = true;
-                }
+                status_write_pending(so);
             }
+            buf_write(&so->write_buf, buf, len);
         }
 
         if (so->vout && !so->errors)
@@ -45,6 +45,8 @@ virtual_output_print(const struct virtual_output *vo, const unsigned int flags,
  * printf-style interface for inputting/outputting status info
  */
 
+#define STATUS_WRITE_BUF_SIZE 16384
+
 struct status_output
 {
 #define STATUS_OUTPUT_READ  (1<<0)
@@ -57,6 +59,8 @@ struct status_output
     const struct virtual_output *vout;
 
     struct buffer read_buf;
+    struct buffer write_buf;    /* output is collected here and written
+                                 * out in large chunks */
 
     struct event_timeout et;
 
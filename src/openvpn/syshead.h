@@ -187,6 +187,10 @@
 #include <sys/epoll.h>
 #endif
 
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
 #ifdef ENABLE_SELINUX
 #include <selinux/selinux.h>
 #endif
@@ -239,6 +243,14 @@
 #include <linux/errqueue.h>
 #endif
 
+#ifdef HAVE_LINUX_NET_TSTAMP_H
+#include <linux/net_tstamp.h>
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+
 #ifdef HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
 #endif
@@ -432,6 +444,15 @@ typedef int MIB_TCP_STATE;
 #define ENABLE_IP_PKTINFO 0
 #endif
 
+/*
+ * Does this platform support per-packet transmit times (SO_TXTIME)?
+ */
+#if defined(TARGET_LINUX) && HAVE_DECL_SO_TXTIME && defined(HAVE_LINUX_NET_TSTAMP_H) && defined(HAVE_MSGHDR) && defined(HAVE_CMSGHDR) && defined(HAVE_IOVEC) && defined(CMSG_FIRSTHDR) && defined(HAVE_SENDMSG)
+#define ENABLE_TXTIME 1
+#else
+#define ENABLE_TXTIME 0
+#endif
+
 /*
  * Does this platform define SOL_IP
  * or only bsd-style IPPROTO_IP ?
@@ -535,6 +556,15 @@ socket_defined(const socket_descriptor_t sd)
 #define PORT_SHARE 0
 #endif
 
+/*
+ * Hand the server socket and tun device over to a new process
+ */
+#if P2MP_SERVER && defined(TARGET_LINUX) && defined(SCM_RIGHTS) && defined(HAVE_MSGHDR) && defined(HAVE_CMSGHDR) && defined(HAVE_IOVEC) && defined(CMSG_FIRSTHDR) && defined(HAVE_RECVMSG) && defined(HAVE_SENDMSG) && defined(HAVE_SYS_POLL_H)
+#define SOCKET_HANDOVER 1
+#else
+#define SOCKET_HANDOVER 0
+#endif
+
 /*
  * Enable deferred authentication?
  */
@@ -678,7 +708,7 @@ socket_defined(const socket_descriptor_t sd)
  * Compression support
  */
 #if defined(ENABLE_LZO) || defined(ENABLE_LZ4)    \
-    || defined(ENABLE_COMP_STUB)
+    || defined(ENABLE_ZSTD) || defined(ENABLE_COMP_STUB)
 #define USE_COMP
 #endif
 
@@ -0,0 +1,872 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#if P2MP_SERVER
+
+#include "fdmisc.h"
+#include "multi.h"
+#include "ping.h"
+#include "platform.h"
+#include "ssl_verify.h"
+#include "trace.h"
+
+#include "memdbg.h"
+
+struct trace_file
+{
+    FILE *fp;
+    const char *filename;
+    bool failed;
+};
+
+#ifdef ENABLE_TRACE_REPLAY
+
+#define TRACE_MAX_SPIN 1000   /* timer passes without the clock advancing */
+
+struct trace_record
+{
+    struct timeval tv;
+    int type;
+    struct link_socket_actual from;
+};
+
+/*
+ * A simulated client, the other end of one client instance of the
+ * server.
+ */
+struct trace_peer
+{
+    struct mroute_addr real;
+    struct link_socket_actual remote;
+    char *common_name;
+    struct multi_instance *mi;  /* the instance which has our keys */
+    struct crypto_options co;   /* client side of the data channel */
+#ifdef USE_COMP
+    struct compress_context *comp;
+#endif
+    time_t last_sent;
+};
+
+struct trace_replay
+{
+    struct multi_context *m;
+    struct trace_file *tf;
+    struct hash *peers;         /* trace_peer objects by client address */
+
+    struct timeval base;        /* virtual time of the first record of this pass */
+    struct timeval first;       /* time stamp of the first record in the file */
+    time_t ping_check;
+
+    struct buffer in;           /* payload of the current record */
+    struct buffer work;
+    struct buffer compress_buf;
+    struct buffer encrypt_buf;
+    struct buffer decrypt_buf;
+    struct buffer decompress_buf;
+
+    counter_type records;
+    counter_type clients;       /* instances created */
+    counter_type link_in;
+    counter_type tun_in;
+    counter_type tun_out;
+    counter_type tun_out_bytes;
+    counter_type link_out;
+    counter_type link_out_bytes;
+    counter_type link_out_errors;   /* sent to a client, but not decryptable */
+    uint32_t hash;              /* sum of the hashes of all output */
+};
+
+#endif /* ENABLE_TRACE_REPLAY */
+
+static inline void
+trace_put16(uint8_t *p, uint16_t v)
+{
+    v = htons(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void
+trace_put32(uint8_t *p, uint32_t v)
+{
+    v = htonl(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint16_t
+trace_get16(const uint8_t *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohs(v);
+}
+
+static inline uint32_t
+trace_get32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohl(v);
+}
+
+struct trace_file *
+trace_open_capture(const char *filename)
+{
+    struct trace_file *tf;
+    int fd;
+
+    ALLOC_OBJ_CLEAR(tf, struct trace_file);
+    tf->filename = filename;
+
+    /* a server which restarts continues its trace, the file holds
+     * decrypted traffic and is only made readable for the owner */
+    fd = platform_open(filename, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+    {
+        msg(M_ERR, "Cannot open --trace-capture file %s", filename);
+    }
+    set_cloexec(fd);
+    tf->fp = fdopen(fd, "ab");
+    if (!tf->fp)
+    {
+        msg(M_ERR, "Cannot open --trace-capture file %s", filename);
+    }
+    if (lseek(fd, (off_t)0, SEEK_END) == 0
+        && fwrite(TRACE_MAGIC, TRACE_MAGIC_SIZE, 1, tf->fp) != 1)
+    {
+        msg(M_ERR, "Cannot write to --trace-capture file %s", filename);
+    }
+    msg(M_INFO, "Capturing traffic to %s", filename);
+    return tf;
+}
+
+void
+trace_capture(struct trace_file *tf, int type,
+              const struct link_socket_actual *from,
+              const uint8_t *data, int len)
+{
+    uint8_t h[TRACE_HEADER_SIZE];
+    struct timeval tv;
+
+    if (tf->failed)
+    {
+        return;
+    }
+
+    CLEAR(h);
+    openvpn_gettimeofday(&tv, NULL);
+    trace_put32(h, (uint32_t) tv.tv_sec);
+    trace_put32(h + 4, (uint32_t) tv.tv_usec);
+    trace_put16(h + 8, (uint16_t) len);
+    h[10] = (uint8_t) type;
+    if (from)
+    {
+        const struct openvpn_sockaddr *sa = &from->dest;
+        if (sa->addr.sa.sa_family == AF_INET)
+        {
+            h[11] = 4;
+            memcpy(h + 12, &sa->addr.in4.sin_port, 2);
+            memcpy(h + 14, &sa->addr.in4.sin_addr, 4);
+        }
+        else if (sa->addr.sa.sa_family == AF_INET6)
+        {
+            h[11] = 6;
+            memcpy(h + 12, &sa->addr.in6.sin6_port, 2);
+            memcpy(h + 14, &sa->addr.in6.sin6_addr, 16);
+        }
+    }
+
+    if (fwrite(h, sizeof(h), 1, tf->fp) != 1
+        || (len > 0 && fwrite(data, len, 1, tf->fp) != 1))
+    {
+        msg(M_WARN | M_ERRNO, "Write to --trace-capture file %s failed, capture stopped",
+            tf->filename);
+        tf->failed = true;
+    }
+}
+
+void
+trace_close(struct trace_file *tf)
+{
+    if (tf)
+    {
+        if (fclose(tf->fp) && !tf->failed)
+        {
+            msg(M_WARN | M_ERRNO, "Write to --trace-capture file %s failed", tf->filename);
+        }
+        free(tf);
+    }
+}
+
+#ifdef ENABLE_TRACE_REPLAY
+
+static struct trace_file *
+trace_open_replay(const char *filename)
+{
+    struct trace_file *tf;
+    char magic[TRACE_MAGIC_SIZE];
+
+    ALLOC_OBJ_CLEAR(tf, struct trace_file);
+    tf->filename = filename;
+    tf->fp = platform_fopen(filename, "rb");
+    if (!tf->fp)
+    {
+        msg(M_ERR, "Cannot open --trace-replay file %s", filename);
+    }
+    if (fread(magic, sizeof(magic), 1, tf->fp) != 1
+        || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE))
+    {
+        msg(M_FATAL, "%s is not a --trace-capture file", filename);
+    }
+    return tf;
+}
+
+/*
+ * Read the next record and its payload, return false at the end of
+ * the file.
+ */
+static bool
+trace_read(struct trace_file *tf, struct trace_record *rec, struct buffer *buf)
+{
+    uint8_t h[TRACE_HEADER_SIZE];
+    int len;
+
+    if (fread(h, sizeof(h), 1, tf->fp) != 1)
+    {
+        if (ferror(tf->fp))
+        {
+            msg(M_WARN | M_ERRNO, "Read from --trace-replay file %s failed", tf->filename);
+        }
+        return false;
+    }
+
+    rec->tv.tv_sec = trace_get32(h);
+    rec->tv.tv_usec = trace_get32(h + 4);
+    len = trace_get16(h + 8);
+    rec->type = h[10];
+
+    CLEAR(rec->from);
+    if (h[11] == 4)
+    {
+        rec->from.dest.addr.in4.sin_family = AF_INET;
+        memcpy(&rec->from.dest.addr.in4.sin_port, h + 12, 2);
+        memcpy(&rec->from.dest.addr.in4.sin_addr, h + 14, 4);
+    }
+    else if (h[11] == 6)
+    {
+        rec->from.dest.addr.in6.sin6_family = AF_INET6;
+        memcpy(&rec->from.dest.addr.in6.sin6_port, h + 12, 2);
+        memcpy(&rec->from.dest.addr.in6.sin6_addr, h + 14, 16);
+    }
+
+    buf_reset_len(buf);
+    if (len > buf_forward_capacity(buf)
+        || (len > 0 && fread(BPTR(buf), len, 1, tf->fp) != 1))
+    {
+        msg(M_WARN, "--trace-replay file %s is truncated or corrupt", tf->filename);
+        return false;
+    }
+    ASSERT(buf_inc_len(buf, len));
+    return true;
+}
+
+/* unlike tv_add(), exact for any src->tv_usec < 1000000 */
+static void
+trace_tv_add(struct timeval *dest, const struct timeval *src)
+{
+    dest->tv_sec += src->tv_sec;
+    dest->tv_usec += src->tv_usec;
+    if (dest->tv_usec >= 1000000)
+    {
+        dest->tv_usec -= 1000000;
+        dest->tv_sec += 1;
+    }
+}
+
+static double
+trace_seconds(const struct timeval *from, const struct timeval *to)
+{
+    return (double) (to->tv_sec - from->tv_sec) + (to->tv_usec - from->tv_usec) / 1e6;
+}
+
+/*
+ * Advance the virtual clock, but never backwards.
+ */
+static void
+trace_set_time(const struct timeval *tv)
+{
+    if (tv_gt(tv, &virtual_now))
+    {
+        set_virtual_time(tv);
+    }
+}
+
+/*
+ * Consume what the server wants to send: packets for the tun/tap
+ * device are counted, packets for the clients are decrypted by the
+ * simulated client they are for.
+ */
+static void
+trace_replay_output(struct trace_replay *r, struct multi_instance *mi)
+{
+    struct context *c = &mi->context;
+
+    if (BLEN(&c->c2.to_tun) > 0)
+    {
+        r->hash += hash_func(BPTR(&c->c2.to_tun), BLEN(&c->c2.to_tun), 0);
+        ++r->tun_out;
+        r->tun_out_bytes += BLEN(&c->c2.to_tun);
+        c->c2.tun_write_bytes += BLEN(&c->c2.to_tun);
+        buf_reset(&c->c2.to_tun);
+    }
+
+    if (BLEN(&c->c2.to_link) > 0)
+    {
+        struct trace_peer *peer = hash_lookup(r->peers, &mi->real);
+        struct buffer buf = c->c2.to_link;
+        const uint8_t *ad_start = BPTR(&buf);
+        const int op = *BPTR(&buf) >> P_OPCODE_SHIFT;
+
+        ++r->link_out;
+        r->link_out_bytes += BLEN(&buf);
+        c->c2.link_write_bytes += BLEN(&buf);
+
+        if (peer && (op == P_DATA_V1 || op == P_DATA_V2)
+            && buf_advance(&buf, op == P_DATA_V2 ? 4 : 1)
+            && openvpn_decrypt(&buf, r->decrypt_buf, &peer->co, &c->c2.frame, ad_start))
+        {
+#ifdef USE_COMP
+            if (peer->comp)
+            {
+                (*peer->comp->alg.decompress)(&buf, r->decompress_buf, peer->comp, &c->c2.frame);
+            }
+#endif
+            r->hash += hash_func(BPTR(&buf), BLEN(&buf), 0);
+        }
+        else
+        {
+            ++r->link_out_errors;
+        }
+        buf_reset(&c->c2.to_link);
+    }
+}
+
+/*
+ * Process the output of instances until no more is pending, as the
+ * event loop of tunnel_server_udp() does when the tun/tap device and
+ * the socket are always ready for writing.
+ */
+static void
+trace_replay_drain(struct trace_replay *r)
+{
+    struct multi_context *m = r->m;
+    struct multi_instance *mi;
+
+    while ((mi = multi_process_outgoing_link_pre(m)))
+    {
+        set_prefix(mi);
+        trace_replay_output(r, mi);
+        multi_process_post(m, mi, MPP_PRE_SELECT|MPP_CLOSE_ON_SIGNAL);
+        clear_prefix();
+    }
+}
+
+/* does the instance the client set up still exist? */
+static bool
+trace_peer_connected(const struct trace_replay *r, const struct trace_peer *peer)
+{
+    return peer->mi && hash_lookup(r->m->hash, &peer->real) == peer->mi;
+}
+
+static struct trace_peer *
+trace_peer_get(struct trace_replay *r, const struct link_socket_actual *from)
+{
+    struct mroute_addr real;
+    struct trace_peer *peer;
+
+    if (!mroute_extract_openvpn_sockaddr(&real, &from->dest, true))
+    {
+        return NULL;
+    }
+    peer = hash_lookup(r->peers, &real);
+    if (!peer)
+    {
+        ALLOC_OBJ_CLEAR(peer, struct trace_peer);
+        peer->real = real;
+        peer->remote = *from;
+        ASSERT(hash_add(r->peers, &peer->real, peer, false));
+    }
+    return peer;
+}
+
+static void
+trace_peer_free_keys(struct trace_peer *peer)
+{
+    if (peer->co.key_ctx_bi.initialized)
+    {
+        free_key_ctx_bi(&peer->co.key_ctx_bi);
+        packet_id_free(&peer->co.packet_id);
+    }
+    CLEAR(peer->co);
+}
+
+/*
+ * Create the client instance of a simulated client, as if it had just
+ * completed the TLS handshake.
+ */
+static bool
+trace_peer_connect(struct trace_replay *r, struct trace_peer *peer)
+{
+    struct gc_arena gc = gc_new();
+    struct multi_context *m = r->m;
+    struct multi_instance *mi;
+    struct context *c;
+    const char *cn = peer->common_name;
+
+    peer->mi = NULL;
+    mi = multi_create_instance(m, &peer->real);
+    if (!mi)
+    {
+        gc_free(&gc);
+        return false;
+    }
+    ASSERT(hash_add(m->hash, &mi->real, mi, false));
+    mi->did_real_hash = true;
+
+    c = &mi->context;
+    c->c2.from = peer->remote;
+    c->c2.tls_multi->peer_id = peer_table_alloc(m->peers, mi, &peer->remote.dest);
+    ASSERT(c->c2.tls_multi->peer_id != MAX_PEER_ID);
+
+    if (!cn)
+    {
+        struct buffer out = alloc_buf_gc(64, &gc);
+        buf_printf(&out, "replay-%s", mroute_addr_print(&peer->real, &gc));
+        cn = BSTR(&out);
+    }
+
+    trace_peer_free_keys(peer);
+    tls_multi_init_replay(c->c2.tls_multi, &c->options, &c->c2.frame, cn,
+                          get_link_socket_info(c), &peer->remote,
+                          &peer->co.key_ctx_bi);
+    packet_id_init(&peer->co.packet_id, c->options.replay_window,
+                   c->options.replay_window_max, c->options.replay_time, "TRACE", 0);
+    peer->co.flags = c->c2.tls_multi->opt.crypto_flags;
+#ifdef USE_COMP
+    if (c->c2.comp_context && !peer->comp)
+    {
+        peer->comp = comp_init(&c->options.comp);
+    }
+#endif
+    peer->mi = mi;
+    peer->last_sent = now;
+    ++r->clients;
+
+    /* run the client-connect processing */
+    set_prefix(mi);
+    multi_process_post(m, mi, MPP_PRE_SELECT|MPP_CLOSE_ON_SIGNAL);
+    clear_prefix();
+    trace_replay_drain(r);
+
+    gc_free(&gc);
+    return trace_peer_connected(r, peer);
+}
+
+/*
+ * Encrypt a packet like the simulated client would, and hand it to the
+ * server as if it had just been read from the socket.
+ */
+static void
+trace_peer_send(struct trace_replay *r, struct trace_peer *peer, const struct buffer *payload)
+{
+    struct multi_context *m = r->m;
+    struct context *c = &peer->mi->context;
+    const struct frame *frame = &m->top.c2.frame;
+    struct buffer buf = r->work;
+    struct buffer work = r->encrypt_buf;
+    uint32_t op;
+
+    ASSERT(buf_init(&buf, FRAME_HEADROOM(frame)));
+    ASSERT(buf_copy(&buf, payload));
+#ifdef USE_COMP
+    if (peer->comp)
+    {
+        (*peer->comp->alg.compress)(&buf, r->compress_buf, peer->comp, &c->c2.frame);
+    }
+#endif
+
+    ASSERT(buf_init(&work, FRAME_HEADROOM(frame)));
+    op = htonl((P_DATA_V2 << P_OPCODE_SHIFT) << 24
+               | (c->c2.tls_multi->peer_id & 0xFFFFFF));
+    ASSERT(buf_write_prepend(&work, &op, 4));
+    openvpn_encrypt(&buf, work, &peer->co);
+
+    /* as read_incoming_link() would leave it */
+    m->top.c2.buf = m->top.c2.buffers->read_link_buf;
+    ASSERT(buf_init(&m->top.c2.buf, FRAME_HEADROOM_ADJ(frame, FRAME_HEADROOM_MARKER_READ_LINK)));
+    ASSERT(buf_copy(&m->top.c2.buf, &buf));
+    m->top.c2.from = peer->remote;
+    peer->last_sent = now;
+
+    ++r->link_in;
+    multi_process_incoming_link(m, NULL, MPP_PRE_SELECT|MPP_CLOSE_ON_SIGNAL);
+    trace_replay_drain(r);
+}
+
+/*
+ * The simulated clients keep their tunnels alive with --ping, like
+ * the real clients did.  Their pings are not in the trace.
+ */
+static void
+trace_replay_pings(struct trace_replay *r)
+{
+    struct hash_iterator hi;
+    struct hash_element *he;
+    struct buffer ping;
+
+    if (r->ping_check == now)
+    {
+        return;
+    }
+    r->ping_check = now;
+
+    buf_set_read(&ping, ping_string, PING_STRING_SIZE);
+    hash_iterator_init(r->peers, &hi);
+    while ((he = hash_iterator_next(&hi)))
+    {
+        struct trace_peer *peer = (struct trace_peer *) he->value;
+        if (trace_peer_connected(r, peer))
+        {
+            const int interval = peer->mi->context.options.ping_send_timeout;
+            if (interval && now >= peer->last_sent + interval)
+            {
+                trace_peer_send(r, peer, &ping);
+            }
+        }
+    }
+    hash_iterator_free(&hi);
+}
+
+/*
+ * Advance the virtual clock to tv, serving the timers which expire on
+ * the way, in order, like the event loop of tunnel_server_udp() would.
+ */
+static void
+trace_replay_advance(struct trace_replay *r, const struct timeval *tv)
+{
+    struct multi_context *m = r->m;
+    int spin = 0;
+
+    while (!IS_SIG(&m->top) && spin < TRACE_MAX_SPIN)
+    {
+        struct timeval timeout, wakeup;
+
+        multi_get_timeout(m, &timeout);
+        wakeup = virtual_now;
+        trace_tv_add(&wakeup, &timeout);
+        if (tv_gt(&wakeup, tv))
+        {
+            break;
+        }
+        spin = tv_gt(&wakeup, &virtual_now) ? 0 : spin + 1;
+        trace_set_time(&wakeup);
+
+        multi_process_per_second_timers(m);
+        trace_replay_pings(r);
+        multi_process_timeout(m, MPP_PRE_SELECT|MPP_CLOSE_ON_SIGNAL);
+        trace_replay_drain(r);
+    }
+    trace_set_time(tv);
+    multi_process_per_second_timers(m);
+    trace_replay_pings(r);
+}
+
+static void
+trace_replay_record(struct trace_replay *r, const struct trace_record *rec)
+{
+    struct multi_context *m = r->m;
+    struct trace_peer *peer;
+
+    switch (rec->type)
+    {
+        case TRACE_CLIENT:
+            peer = trace_peer_get(r, &rec->from);
+            if (peer)
+            {
+                /* a new client: connect again, unless it is the same */
+                char *cn;
+
+                buf_null_terminate(&r->in);
+                cn = string_alloc(BSTR(&r->in), NULL);
+                if (!peer->common_name || strcmp(cn, peer->common_name))
+                {
+                    if (trace_peer_connected(r, peer))
+                    {
+                        multi_close_instance(m, peer->mi, false);
+                    }
+                    peer->mi = NULL;
+                }
+                free(peer->common_name);
+                peer->common_name = cn;
+            }
+            break;
+
+        case TRACE_LINK:
+            peer = trace_peer_get(r, &rec->from);
+            if (peer && (trace_peer_connected(r, peer) || trace_peer_connect(r, peer)))
+            {
+                multi_learn_packet_source(m, peer->mi, &r->in);
+                trace_peer_send(r, peer, &r->in);
+            }
+            break;
+
+        case TRACE_TUN:
+            m->top.c2.buf = m->top.c2.buffers->read_tun_buf;
+            ASSERT(buf_init(&m->top.c2.buf, FRAME_HEADROOM(&m->top.c2.frame)));
+            ASSERT(buf_copy(&m->top.c2.buf, &r->in));
+            ++r->tun_in;
+            multi_process_incoming_tun(m, MPP_PRE_SELECT|MPP_CLOSE_ON_SIGNAL);
+            trace_replay_drain(r);
+            break;
+    }
+}
+
+static void
+trace_replay_init(struct trace_replay *r, struct multi_context *m)
+{
+    const struct frame *frame = &m->top.c2.frame;
+
+    CLEAR(*r);
+    r->m = m;
+    r->tf = trace_open_replay(m->top.options.trace_replay_file);
+    r->peers = hash_init(m->top.options.real_hash_size, 0,
+                         mroute_addr_hash_function, mroute_addr_compare_function);
+
+    r->in = alloc_buf(BUF_SIZE(frame));
+    r->work = alloc_buf(BUF_SIZE(frame));
+    r->compress_buf = alloc_buf(BUF_SIZE(frame));
+    r->encrypt_buf = alloc_buf(BUF_SIZE(frame));
+    r->decrypt_buf = alloc_buf(BUF_SIZE(frame));
+    r->decompress_buf = alloc_buf(BUF_SIZE(frame));
+}
+
+static void
+trace_replay_free(struct trace_replay *r)
+{
+    struct hash_iterator hi;
+    struct hash_element *he;
+
+    hash_iterator_init(r->peers, &hi);
+    while ((he = hash_iterator_next(&hi)))
+    {
+        struct trace_peer *peer = (struct trace_peer *) he->value;
+        trace_peer_free_keys(peer);
+#ifdef USE_COMP
+        if (peer->comp)
+        {
+            comp_uninit(peer->comp);
+        }
+#endif
+        free(peer->common_name);
+        free(peer);
+    }
+    hash_iterator_free(&hi);
+    hash_free(r->peers);
+
+    free_buf(&r->in);
+    free_buf(&r->work);
+    free_buf(&r->compress_buf);
+    free_buf(&r->encrypt_buf);
+    free_buf(&r->decrypt_buf);
+    free_buf(&r->decompress_buf);
+
+    fclose(r->tf->fp);
+    free(r->tf);
+}
+
+/*
+ * Replay the trace file n times, each pass starting where the previous
+ * one ended.
+ */
+static void
+trace_replay_run(struct trace_replay *r, int n)
+{
+    struct multi_context *m = r->m;
+    struct trace_record rec;
+    struct timeval start, wall_start, wall_end;
+    int pass;
+
+    /*
+     * The wall clock is read with gettimeofday() directly, as
+     * openvpn_gettimeofday() never goes back behind the virtual clock.
+     */
+    gettimeofday(&wall_start, NULL);
+    openvpn_gettimeofday(&start, NULL);
+    /* timers have a resolution of one second, start on a full one */
+    start.tv_usec = 0;
+    set_virtual_time(&start);
+    r->base = start;
+
+    for (pass = 0; pass < n && !IS_SIG(&m->top); ++pass)
+    {
+        if (pass > 0)
+        {
+            r->base = virtual_now;
+            if (fseek(r->tf->fp, TRACE_MAGIC_SIZE, SEEK_SET))
+            {
+                msg(M_WARN | M_ERRNO, "Cannot rewind --trace-replay file %s",
+                    r->tf->filename);
+                break;
+            }
+        }
+
+        while (!IS_SIG(&m->top) && trace_read(r->tf, &rec, &r->in))
+        {
+            struct timeval tv = r->base;
+            struct timeval delta;
+
+            if (!r->records)
+            {
+                r->first = rec.tv;
+            }
+            ++r->records;
+
+            /* records of a server restart may go back in time */
+            tv_delta(&delta, &r->first, &rec.tv);
+            trace_tv_add(&tv, &delta);
+            trace_replay_advance(r, &tv);
+
+            trace_replay_record(r, &rec);
+        }
+    }
+
+    gettimeofday(&wall_end, NULL);
+    virtual_clock = false;
+    update_time();
+
+    {
+        const double secs = trace_seconds(&wall_start, &wall_end) + 1e-6;
+        const double virtual_secs = trace_seconds(&start, &virtual_now);
+
+        msg(M_INFO, "TRACE REPLAY RESULT: " counter_format " records in %d pass(es), "
+            "%.3f s (%.0f records/s), %.3f s of virtual time, " counter_format " clients",
+            r->records, pass, secs, r->records / secs, virtual_secs, r->clients);
+        msg(M_INFO, "TRACE REPLAY RESULT: in: link " counter_format " tun " counter_format
+            ", out: tun " counter_format "/" counter_format " bytes"
+            ", link " counter_format "/" counter_format " bytes"
+            " (" counter_format " undecryptable), hash %08x",
+            r->link_in, r->tun_in, r->tun_out, r->tun_out_bytes,
+            r->link_out, r->link_out_bytes, r->link_out_errors, r->hash);
+    }
+}
+
+void
+tunnel_server_replay(struct context *top)
+{
+    struct options *o = &top->options;
+    struct multi_context multi;
+    struct trace_replay r;
+    const char *dev = o->dev;
+    const char *dev_type = o->dev_type;
+    int type;
+
+    top->mode = CM_TOP;
+    context_clear_2(top);
+
+    /*
+     * Nothing leaves the process: the tun/tap device is not opened,
+     * the socket is not bound, and neither scripts nor state files
+     * are run or written.
+     */
+    type = dev_type_enum(dev, dev_type);
+    o->dev = "null";
+    o->dev_type = NULL;
+    o->dev_node = NULL;
+    o->persist_tun = false;
+    o->ifconfig_noexec = true;
+    o->route_noexec = true;
+    o->ce.bind_local = false;
+    o->up_script = NULL;
+    o->down_script = NULL;
+    o->route_script = NULL;
+    o->route_predown_script = NULL;
+    o->learn_address_script = NULL;
+    o->client_connect_script = NULL;
+    o->client_disconnect_script = NULL;
+    o->status_file = NULL;
+    o->ifconfig_pool_persist_filename = NULL;
+
+    init_instance_handle_signals(top, top->es, CC_HARD_USR1_TO_HUP);
+    if (IS_SIG(top))
+    {
+        return;
+    }
+
+    /*
+     * The instances route packets as if they had the real device.  The
+     * dummy descriptor makes tuntap_defined() true, it is never read
+     * from or written to.
+     */
+    o->dev = dev;
+    o->dev_type = dev_type;
+    top->c1.tuntap->type = type;
+    top->c1.tuntap->fd = platform_open("/dev/null", O_RDWR, 0);
+    if (top->c1.tuntap->fd < 0)
+    {
+        msg(M_ERR, "Cannot open /dev/null");
+    }
+
+    multi_init(&multi, top, false, MC_SINGLE_THREADED);
+    multi_top_init(&multi, top);
+    initialization_sequence_completed(top, ISC_SERVER);
+
+    msg(M_INFO, "Replaying %s", o->trace_replay_file);
+    trace_replay_init(&r, &multi);
+    trace_replay_run(&r, o->trace_replay_repeat);
+
+    multi_uninit(&multi);
+    trace_replay_free(&r);
+    multi_top_free(&multi);
+
+    close(top->c1.tuntap->fd);
+    top->c1.tuntap->fd = -1;
+    top->c1.tuntap->type = DEV_TYPE_NULL;
+    close_instance(top);
+
+    /* the replay is done */
+    if (!IS_SIG(top))
+    {
+        top->sig->signal_received = SIGTERM;
+        top->sig->signal_text = "trace-replay";
+    }
+}
+
+#endif /* ENABLE_TRACE_REPLAY */
+#endif /* P2MP_SERVER */
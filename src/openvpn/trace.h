@@ -0,0 +1,106 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single TCP/UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * --trace-capture and --trace-replay: record the traffic of a server and
+ * run it through the server code again offline.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#if P2MP_SERVER
+
+#include "buffer.h"
+#include "socket.h"
+
+/*
+ * A trace file starts with TRACE_MAGIC, followed by records.  Each
+ * record has a header of TRACE_HEADER_SIZE bytes, all fields in network
+ * byte order:
+ *
+ *   uint32 sec, uint32 usec   time the packet was received
+ *   uint16 len                length of the payload after the header
+ *   uint8  type               TRACE_x
+ *   uint8  family             4 or 6 for the address below, else 0
+ *   uint16 port
+ *   uint8  addr[16]           client address (IPv4 in the first 4 bytes)
+ */
+#define TRACE_MAGIC       "OVPNTRC1"
+#define TRACE_MAGIC_SIZE  8
+#define TRACE_HEADER_SIZE 30
+
+#define TRACE_LINK    1  /**< Decrypted packet from the client at addr */
+#define TRACE_TUN     2  /**< Packet read from the tun/tap device */
+#define TRACE_CLIENT  3  /**< Common name of a new client at addr */
+
+struct trace_file;
+struct context;
+
+/**
+ * Open a file for \c --trace-capture, exits on error.
+ */
+struct trace_file *trace_open_capture(const char *filename);
+
+/**
+ * Append a record to a capture file.  After a write error, a warning is
+ * printed and the capture stops.
+ *
+ * @param tf        The capture file.
+ * @param type      The record type, \c TRACE_x.
+ * @param from      The client address, NULL for \c TRACE_TUN.
+ * @param data      The payload.
+ * @param len       The length of the payload.
+ */
+void trace_capture(struct trace_file *tf, int type,
+                   const struct link_socket_actual *from,
+                   const uint8_t *data, int len);
+
+/**
+ * Flush and close a capture file.
+ */
+void trace_close(struct trace_file *tf);
+
+#ifdef ENABLE_TRACE_REPLAY
+/**************************************************************************/
+/**
+ * Main loop of OpenVPN in server mode with \c --trace-replay.
+ * @ingroup eventloop
+ *
+ * Sets up the server like \c tunnel_server_udp() does, without a tun/tap
+ * device and without receiving or sending anything on its socket.  The
+ * records of the trace file are then fed to \c
+ * multi_process_incoming_link() and \c multi_process_incoming_tun(), on
+ * a virtual clock which advances to the time of each record.  A
+ * simulated client is connected for each client address in the trace;
+ * its packets are encrypted with data channel keys made up for it,
+ * and the packets sent to it are decrypted.  The packet counts and a
+ * hash over the server output are logged at the end.
+ *
+ * @param top          - Top-level context structure.
+ */
+void tunnel_server_replay(struct context *top);
+#endif
+
+#endif /* P2MP_SERVER */
+#endif /* TRACE_H */
@@ -46,6 +46,7 @@
 #include "route.h"
 #include "win32.h"
 #include "block_dns.h"
+#include "handover.h"
 
 #include "memdbg.h"
 
@@ -1793,6 +1794,27 @@ open_tun(const char *dev, const char *dev_type, const char *dev_node, struct tun
             node = "/dev/net/tun";
         }
 
+#if SOCKET_HANDOVER && defined(TUNGETIFF)
+        /*
+         * Reuse the device of the server we are replacing
+         */
+        if ((tt->fd = handover_take_tun_fd()) >= 0)
+        {
+            CLEAR(ifr);
+            if (ioctl(tt->fd, TUNGETIFF, (void *) &ifr) < 0)
+            {
+                msg(M_ERR, "ERROR: Cannot ioctl TUNGETIFF on inherited TUN/TAP device");
+            }
+            if (!!(ifr.ifr_flags & IFF_TAP) != (tt->type == DEV_TYPE_TAP))
+            {
+                msg(M_FATAL, "ERROR: inherited TUN/TAP device %s is of the wrong type",
+                    ifr.ifr_name);
+            }
+            msg(M_INFO, "TUN/TAP device %s taken over from previous server", ifr.ifr_name);
+            goto opened;
+        }
+#endif
+
         /*
          * Open the interface
          */
@@ -1847,6 +1869,9 @@ open_tun(const char *dev, const char *dev_type, const char *dev_node, struct tun
 
         msg(M_INFO, "TUN/TAP device %s opened", ifr.ifr_name);
 
+#if SOCKET_HANDOVER && defined(TUNGETIFF)
+opened:
+#endif
         /*
          * Try making the TX send queue bigger
          */
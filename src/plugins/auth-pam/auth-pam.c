@@ -43,8 +43,11 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
 #include <signal.h>
 #include <syslog.h>
 #include "utils.h"
@@ -54,8 +57,9 @@
 #define DEBUG(verb) ((verb) >= 4)
 
 /* Command codes for foreground -> background communication */
-#define COMMAND_VERIFY 0
-#define COMMAND_EXIT   1
+#define COMMAND_VERIFY          0
+#define COMMAND_EXIT            1
+#define COMMAND_VERIFY_DEFERRED 2
 
 /* Response codes for background -> foreground communication */
 #define RESPONSE_INIT_SUCCEEDED   10
@@ -63,6 +67,10 @@
 #define RESPONSE_VERIFY_SUCCEEDED 12
 #define RESPONSE_VERIFY_FAILED    13
 
+/* Number of PAM worker processes, unless set with "setenv auth_pam_workers n" */
+#define DEFAULT_WORKERS 4
+#define MAX_WORKERS     64
+
 /* Pointers to functions exported from openvpn */
 static plugin_secure_memzero_t plugin_secure_memzero = NULL;
 static plugin_base64_decode_t plugin_base64_decode = NULL;
@@ -80,6 +88,9 @@ struct auth_pam_context
 
     /* Verbosity level of OpenVPN */
     int verb;
+
+    /* ID of the last request sent to the background process */
+    unsigned int request_id;
 };
 
 /*
@@ -119,8 +130,36 @@ struct user_pass {
     const struct name_value_list *name_value_list;
 };
 
+/*
+ * An authentication request queued or running in the background
+ * process.  Requests are matched with the responses of the workers
+ * by their id.
+ */
+struct pam_request {
+    struct pam_request *next;
+    unsigned int id;
+
+    /* auth_control_file of a deferred request, -1 if the foreground waits */
+    int acf_fd;
+
+    char username[128];
+    char password[128];
+    char common_name[128];
+};
+
+/*
+ * A PAM worker process, forked by the background process.  Each
+ * worker runs one PAM conversation at a time.
+ */
+struct pam_worker {
+    pid_t pid;
+    int fd;
+    struct pam_request *request;
+};
+
 /* Background process function */
-static void pam_server(int fd, const char *service, int verb, const struct name_value_list *name_value_list);
+static void pam_server(int fd, const char *service, int verb, int n_workers,
+                       const struct name_value_list *name_value_list);
 
 
 /*
@@ -190,6 +229,103 @@ send_string(int fd, const char *string)
     }
 }
 
+static int
+send_id(int fd, unsigned int id)
+{
+    const ssize_t size = write(fd, &id, sizeof(id));
+    if (size == sizeof(id))
+    {
+        return (int) size;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+static int
+recv_id(int fd, unsigned int *id)
+{
+    const ssize_t size = read(fd, id, sizeof(*id));
+    if (size == sizeof(*id))
+    {
+        return (int) size;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+/*
+ * Pass a file descriptor to the other process.
+ */
+static int
+send_fd(int fd, int fd_to_send)
+{
+    unsigned char c = 0;
+    struct iovec iov = { &c, sizeof(c) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr mesg;
+    struct cmsghdr *cmsg;
+
+    memset(&mesg, 0, sizeof(mesg));
+    memset(&control, 0, sizeof(control));
+    mesg.msg_iov = &iov;
+    mesg.msg_iovlen = 1;
+    mesg.msg_control = control.buf;
+    mesg.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&mesg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd_to_send, sizeof(int));
+
+    if (sendmsg(fd, &mesg, 0) == sizeof(c))
+    {
+        return sizeof(c);
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+static int
+recv_fd(int fd)
+{
+    unsigned char c;
+    struct iovec iov = { &c, sizeof(c) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr mesg;
+    struct cmsghdr *cmsg;
+    int ret = -1;
+
+    memset(&mesg, 0, sizeof(mesg));
+    mesg.msg_iov = &iov;
+    mesg.msg_iovlen = 1;
+    mesg.msg_control = control.buf;
+    mesg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(fd, &mesg, 0) == sizeof(c))
+    {
+        cmsg = CMSG_FIRSTHDR(&mesg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+            && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+        {
+            memcpy(&ret, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    return ret;
+}
+
 #ifdef DO_DAEMONIZE
 
 /*
@@ -350,6 +486,7 @@ openvpn_plugin_open_v3(const int v3structver,
 
     struct auth_pam_context *context;
     struct name_value_list name_value_list;
+    int n_workers = DEFAULT_WORKERS;
 
     const int base_parms = 2;
 
@@ -428,6 +565,23 @@ openvpn_plugin_open_v3(const int v3structver,
         }
     }
 
+    /*
+     * Get number of PAM worker processes from environment
+     */
+    {
+        const char *workers_string = get_env("auth_pam_workers", envp);
+        if (workers_string)
+        {
+            n_workers = atoi(workers_string);
+            if (n_workers < 1 || n_workers > MAX_WORKERS)
+            {
+                fprintf(stderr, "AUTH-PAM: auth_pam_workers must be between 1 and %d\n",
+                        MAX_WORKERS);
+                goto error;
+            }
+        }
+    }
+
     /*
      * Make a socket for foreground and background processes
      * to communicate.
@@ -490,7 +644,7 @@ openvpn_plugin_open_v3(const int v3structver,
 #endif
 
         /* execute the event loop */
-        pam_server(fd[1], argv[1], context->verb, &name_value_list);
+        pam_server(fd[1], argv[1], context->verb, n_workers, &name_value_list);
 
         close(fd[1]);
 
@@ -517,19 +671,56 @@ openvpn_plugin_func_v1(openvpn_plugin_handle_t handle, const int type, const cha
         const char *username = get_env("username", envp);
         const char *password = get_env("password", envp);
         const char *common_name = get_env("common_name", envp) ? get_env("common_name", envp) : "";
+        const char *auth_control_file = get_env("auth_control_file", envp);
 
         if (username && strlen(username) > 0 && password)
         {
-            if (send_control(context->foreground_fd, COMMAND_VERIFY) == -1
+            const unsigned int id = ++context->request_id;
+            int acf_fd = -1;
+
+            /*
+             * If OpenVPN supports deferred authentication, hand the
+             * auth_control_file to the background process, which writes
+             * the result into it, and return at once.  Otherwise wait.
+             */
+            if (auth_control_file)
+            {
+                acf_fd = open(auth_control_file, O_WRONLY | O_TRUNC);
+                if (acf_fd < 0)
+                {
+                    fprintf(stderr, "AUTH-PAM: Cannot open auth_control_file '%s', authenticating synchronously\n",
+                            auth_control_file);
+                }
+            }
+
+            if (send_control(context->foreground_fd,
+                             acf_fd >= 0 ? COMMAND_VERIFY_DEFERRED : COMMAND_VERIFY) == -1
+                || send_id(context->foreground_fd, id) == -1
                 || send_string(context->foreground_fd, username) == -1
                 || send_string(context->foreground_fd, password) == -1
-                || send_string(context->foreground_fd, common_name) == -1)
+                || send_string(context->foreground_fd, common_name) == -1
+                || (acf_fd >= 0 && send_fd(context->foreground_fd, acf_fd) == -1))
             {
                 fprintf(stderr, "AUTH-PAM: Error sending auth info to background process\n");
             }
+            else if (acf_fd >= 0)
+            {
+                close(acf_fd);
+                return OPENVPN_PLUGIN_FUNC_DEFERRED;
+            }
             else
             {
-                const int status = recv_control(context->foreground_fd);
+                int status;
+                unsigned int response_id;
+
+                /* skip responses to requests we stopped waiting for */
+                do
+                {
+                    status = recv_control(context->foreground_fd);
+                } while (status != -1
+                         && (recv_id(context->foreground_fd, &response_id) == -1
+                             || response_id != id));
+
                 if (status == RESPONSE_VERIFY_SUCCEEDED)
                 {
                     return OPENVPN_PLUGIN_FUNC_SUCCESS;
@@ -539,6 +730,11 @@ openvpn_plugin_func_v1(openvpn_plugin_handle_t handle, const int type, const cha
                     fprintf(stderr, "AUTH-PAM: Error receiving auth confirmation from background process\n");
                 }
             }
+
+            if (acf_fd >= 0)
+            {
+                close(acf_fd);
+            }
         }
     }
     return OPENVPN_PLUGIN_FUNC_ERROR;
@@ -777,23 +973,233 @@ pam_auth(const char *service, const struct user_pass *up)
 }
 
 /*
- * Background process -- runs with privilege.
+ * PAM worker process -- runs with privilege, forked
+ * by the background process.
  */
 static void
-pam_server(int fd, const char *service, int verb, const struct name_value_list *name_value_list)
+pam_worker(int fd, const char *service, int verb, const struct name_value_list *name_value_list)
 {
     struct user_pass up;
     int command;
+    unsigned int id;
+
+    while (1)
+    {
+        memset(&up, 0, sizeof(up));
+        up.verb = verb;
+        up.name_value_list = name_value_list;
+
+        /* get a command from background process */
+        command = recv_control(fd);
+
+        switch (command)
+        {
+            case COMMAND_VERIFY:
+                if (recv_id(fd, &id) == -1
+                    || recv_string(fd, up.username, sizeof(up.username)) == -1
+                    || recv_string(fd, up.password, sizeof(up.password)) == -1
+                    || recv_string(fd, up.common_name, sizeof(up.common_name)) == -1)
+                {
+                    fprintf(stderr, "AUTH-PAM: WORKER: read error on command channel: code=%d, exiting\n",
+                            command);
+                    goto done;
+                }
+
+                if (DEBUG(verb))
+                {
+                    fprintf(stderr, "AUTH-PAM: WORKER: request %u USER: %s\n", id, up.username);
+                }
+
+                /* If password is of the form SCRV1:base64:base64 split it up */
+                split_scrv1_password(&up);
+
+                if (send_control(fd, pam_auth(service, &up) ? RESPONSE_VERIFY_SUCCEEDED
+                                 : RESPONSE_VERIFY_FAILED) == -1
+                    || send_id(fd, id) == -1)
+                {
+                    fprintf(stderr, "AUTH-PAM: WORKER: write error on response socket\n");
+                    goto done;
+                }
+                plugin_secure_memzero(up.password, sizeof(up.password));
+                break;
+
+            case COMMAND_EXIT:
+            case -1:
+                goto done;
+
+            default:
+                fprintf(stderr, "AUTH-PAM: WORKER: unknown command code: code=%d, exiting\n",
+                        command);
+                goto done;
+        }
+        plugin_secure_memzero(up.response, sizeof(up.response));
+    }
+done:
+    plugin_secure_memzero(up.password, sizeof(up.password));
+    plugin_secure_memzero(up.response, sizeof(up.response));
+}
+
+/*
+ * Fork a PAM worker.  Return 0 on success.
+ */
+static int
+start_worker(struct pam_worker *w, const char *service, int verb,
+             const struct name_value_list *name_value_list)
+{
+    int fd[2];
+
+    if (socketpair(PF_UNIX, SOCK_DGRAM, 0, fd) == -1)
+    {
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: socketpair call failed\n");
+        return -1;
+    }
+
+    w->pid = fork();
+    if (w->pid == 0)
+    {
+        close_fds_except(fd[1]);
+        pam_worker(fd[1], service, verb, name_value_list);
+        close(fd[1]);
+        exit(0);
+    }
+
+    close(fd[1]);
+    if (w->pid < 0)
+    {
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: fork of PAM worker failed\n");
+        close(fd[0]);
+        w->fd = -1;
+        return -1;
+    }
+    w->fd = fd[0];
+    w->request = NULL;
+    return 0;
+}
+
+static void
+stop_worker(struct pam_worker *w)
+{
+    if (w->fd >= 0)
+    {
+        send_control(w->fd, COMMAND_EXIT);
+        close(w->fd);
+        w->fd = -1;
+    }
+    if (w->pid > 0)
+    {
+        waitpid(w->pid, NULL, 0);
+        w->pid = 0;
+    }
+}
+
+static void
+free_request(struct pam_request *req)
+{
+    if (req->acf_fd >= 0)
+    {
+        close(req->acf_fd);
+    }
+    plugin_secure_memzero(req->password, sizeof(req->password));
+    free(req);
+}
+
+/*
+ * Report the result of a request: into its auth_control_file
+ * if it was deferred, otherwise back to the foreground.
+ */
+static int
+finish_request(int fd, struct pam_request *req, int succeeded, int verb)
+{
+    int ret = 0;
+
+    if (DEBUG(verb))
+    {
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: request %u %s\n", req->id,
+                succeeded ? "succeeded" : "failed");
+    }
+
+    if (req->acf_fd >= 0)
+    {
+        if (write(req->acf_fd, succeeded ? "1" : "0", 1) != 1)
+        {
+            fprintf(stderr, "AUTH-PAM: BACKGROUND: write error on auth_control_file\n");
+        }
+    }
+    else if (send_control(fd, succeeded ? RESPONSE_VERIFY_SUCCEEDED : RESPONSE_VERIFY_FAILED) == -1
+             || send_id(fd, req->id) == -1)
+    {
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: write error on response socket\n");
+        ret = -1;
+    }
+    free_request(req);
+    return ret;
+}
+
+/*
+ * Read an authentication request from the foreground.
+ */
+static struct pam_request *
+recv_request(int fd, int command)
+{
+    struct pam_request *req = calloc(1, sizeof(struct pam_request));
+
+    if (!req)
+    {
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: out of memory\n");
+        return NULL;
+    }
+    req->acf_fd = -1;
+
+    if (recv_id(fd, &req->id) == -1
+        || recv_string(fd, req->username, sizeof(req->username)) == -1
+        || recv_string(fd, req->password, sizeof(req->password)) == -1
+        || recv_string(fd, req->common_name, sizeof(req->common_name)) == -1
+        || (command == COMMAND_VERIFY_DEFERRED && (req->acf_fd = recv_fd(fd)) < 0))
+    {
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: read error on command channel: code=%d, exiting\n",
+                command);
+        free_request(req);
+        return NULL;
+    }
+    return req;
+}
+
+/*
+ * Background process -- runs with privilege.
+ *
+ * Receives authentication requests from the foreground, queues them
+ * and hands them to a pool of PAM worker processes, so that slow PAM
+ * conversations (LDAP, RADIUS, ...) run concurrently.  The workers
+ * are processes rather than threads because PAM modules are not
+ * required to be thread-safe.
+ */
+static void
+pam_server(int fd, const char *service, int verb, int n_workers,
+           const struct name_value_list *name_value_list)
+{
+    struct pam_worker workers[MAX_WORKERS];
+    struct pollfd pfd[MAX_WORKERS + 1];
+    struct pam_request *queue = NULL;
+    struct pam_request **queue_tail = &queue;
+    struct pam_request *req;
+    int command;
+    int i;
 #ifdef USE_PAM_DLOPEN
     static const char pam_so[] = "libpam.so";
 #endif
 
+    memset(workers, 0, sizeof(workers));
+    for (i = 0; i < n_workers; ++i)
+    {
+        workers[i].fd = -1;
+    }
+
     /*
      * Do initialization
      */
     if (DEBUG(verb))
     {
-        fprintf(stderr, "AUTH-PAM: BACKGROUND: INIT service='%s'\n", service);
+        fprintf(stderr, "AUTH-PAM: BACKGROUND: INIT service='%s' workers=%d\n", service, n_workers);
     }
 
 #ifdef USE_PAM_DLOPEN
@@ -808,6 +1214,18 @@ pam_server(int fd, const char *service, int verb, const struct name_value_list *
     }
 #endif
 
+    /*
+     * Start the PAM workers
+     */
+    for (i = 0; i < n_workers; ++i)
+    {
+        if (start_worker(&workers[i], service, verb, name_value_list) == -1)
+        {
+            send_control(fd, RESPONSE_INIT_FAILED);
+            goto done;
+        }
+    }
+
     /*
      * Tell foreground that we initialized successfully
      */
@@ -822,79 +1240,153 @@ pam_server(int fd, const char *service, int verb, const struct name_value_list *
      */
     while (1)
     {
-        memset(&up, 0, sizeof(up));
-        up.verb = verb;
-        up.name_value_list = name_value_list;
+        /* hand queued requests to idle workers */
+        for (i = 0; i < n_workers && queue; ++i)
+        {
+            struct pam_worker *w = &workers[i];
+            if (w->request || w->fd < 0)
+            {
+                continue;
+            }
+            req = queue;
+            queue = req->next;
+            if (!queue)
+            {
+                queue_tail = &queue;
+            }
+            w->request = req;
+            if (send_control(w->fd, COMMAND_VERIFY) == -1
+                || send_id(w->fd, req->id) == -1
+                || send_string(w->fd, req->username) == -1
+                || send_string(w->fd, req->password) == -1
+                || send_string(w->fd, req->common_name) == -1)
+            {
+                fprintf(stderr, "AUTH-PAM: BACKGROUND: write error on worker socket\n");
+            }
+            plugin_secure_memzero(req->password, sizeof(req->password));
+        }
 
-        /* get a command from foreground process */
-        command = recv_control(fd);
+        pfd[0].fd = fd;
+        pfd[0].events = POLLIN;
+        for (i = 0; i < n_workers; ++i)
+        {
+            pfd[i + 1].fd = workers[i].fd;
+            pfd[i + 1].events = POLLIN;
+        }
 
-        if (DEBUG(verb))
+        /* wake up now and then to notice workers which died, a datagram
+         * socket does not report when its peer is gone */
+        if (poll(pfd, n_workers + 1, 1000) < 0)
         {
-            fprintf(stderr, "AUTH-PAM: BACKGROUND: received command code: %d\n", command);
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "AUTH-PAM: BACKGROUND: poll failed\n");
+            goto done;
         }
 
-        switch (command)
+        /* responses of the workers */
+        for (i = 0; i < n_workers; ++i)
         {
-            case COMMAND_VERIFY:
-                if (recv_string(fd, up.username, sizeof(up.username)) == -1
-                    || recv_string(fd, up.password, sizeof(up.password)) == -1
-                    || recv_string(fd, up.common_name, sizeof(up.common_name)) == -1)
+            struct pam_worker *w = &workers[i];
+            unsigned int id;
+
+            if (!(pfd[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                if (w->pid <= 0 || waitpid(w->pid, NULL, WNOHANG) != w->pid)
+                {
+                    continue;
+                }
+                w->pid = 0;
+            }
+            else if ((command = recv_control(w->fd)) != -1
+                     && (command == RESPONSE_VERIFY_SUCCEEDED || command == RESPONSE_VERIFY_FAILED)
+                     && recv_id(w->fd, &id) != -1
+                     && w->request && w->request->id == id)
+            {
+                req = w->request;
+                w->request = NULL;
+                if (finish_request(fd, req, command == RESPONSE_VERIFY_SUCCEEDED, verb) == -1)
                 {
-                    fprintf(stderr, "AUTH-PAM: BACKGROUND: read error on command channel: code=%d, exiting\n",
-                            command);
                     goto done;
                 }
+                continue;
+            }
 
-                if (DEBUG(verb))
+            /* the worker died or is out of sync, replace it */
+            fprintf(stderr, "AUTH-PAM: BACKGROUND: PAM worker failed, restarting it\n");
+            if (w->request)
+            {
+                req = w->request;
+                w->request = NULL;
+                if (finish_request(fd, req, 0, verb) == -1)
                 {
-#if 0
-                    fprintf(stderr, "AUTH-PAM: BACKGROUND: USER/PASS: %s/%s\n",
-                            up.username, up.password);
-#else
-                    fprintf(stderr, "AUTH-PAM: BACKGROUND: USER: %s\n", up.username);
-#endif
+                    goto done;
                 }
+            }
+            stop_worker(w);
+            start_worker(w, service, verb, name_value_list);
+        }
 
-                /* If password is of the form SCRV1:base64:base64 split it up */
-                split_scrv1_password(&up);
+        /* requests of the foreground */
+        if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            command = recv_control(fd);
 
-                if (pam_auth(service, &up)) /* Succeeded */
-                {
-                    if (send_control(fd, RESPONSE_VERIFY_SUCCEEDED) == -1)
+            if (DEBUG(verb))
+            {
+                fprintf(stderr, "AUTH-PAM: BACKGROUND: received command code: %d\n", command);
+            }
+
+            switch (command)
+            {
+                case COMMAND_VERIFY:
+                case COMMAND_VERIFY_DEFERRED:
+                    req = recv_request(fd, command);
+                    if (!req)
                     {
-                        fprintf(stderr, "AUTH-PAM: BACKGROUND: write error on response socket [2]\n");
                         goto done;
                     }
-                }
-                else /* Failed */
-                {
-                    if (send_control(fd, RESPONSE_VERIFY_FAILED) == -1)
+                    if (DEBUG(verb))
                     {
-                        fprintf(stderr, "AUTH-PAM: BACKGROUND: write error on response socket [3]\n");
-                        goto done;
+                        fprintf(stderr, "AUTH-PAM: BACKGROUND: request %u USER: %s%s\n",
+                                req->id, req->username,
+                                req->acf_fd >= 0 ? " (deferred)" : "");
                     }
-                }
-                plugin_secure_memzero(up.password, sizeof(up.password));
-                break;
+                    *queue_tail = req;
+                    queue_tail = &req->next;
+                    break;
 
-            case COMMAND_EXIT:
-                goto done;
+                case COMMAND_EXIT:
+                    goto done;
 
-            case -1:
-                fprintf(stderr, "AUTH-PAM: BACKGROUND: read error on command channel\n");
-                goto done;
+                case -1:
+                    fprintf(stderr, "AUTH-PAM: BACKGROUND: read error on command channel\n");
+                    goto done;
 
-            default:
-                fprintf(stderr, "AUTH-PAM: BACKGROUND: unknown command code: code=%d, exiting\n",
-                        command);
-                goto done;
+                default:
+                    fprintf(stderr, "AUTH-PAM: BACKGROUND: unknown command code: code=%d, exiting\n",
+                            command);
+                    goto done;
+            }
         }
-        plugin_secure_memzero(up.response, sizeof(up.response));
     }
 done:
-    plugin_secure_memzero(up.password, sizeof(up.password));
-    plugin_secure_memzero(up.response, sizeof(up.response));
+    for (i = 0; i < n_workers; ++i)
+    {
+        if (workers[i].request)
+        {
+            free_request(workers[i].request);
+        }
+        stop_worker(&workers[i]);
+    }
+    while (queue)
+    {
+        req = queue;
+        queue = req->next;
+        free_request(req);
+    }
 #ifdef USE_PAM_DLOPEN
     dlclose_pam();
 #endif
@@ -0,0 +1,137 @@
+#! /bin/sh
+#
+# t_latency.sh - measure the round trip time through a tunnel
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+# 02110-1301, USA.
+
+# Two OpenVPN peers in their own network namespaces, connected by a
+# veth pair, play ping-pong through the tunnel; the 50th and 99th
+# percentile of the round trip time are reported, first without and
+# then with --busy-poll.  This needs root and Linux, so it is not run
+# by "make check".
+#
+# COUNT         number of pings (default 2000)
+# BUSY_POLL     --busy-poll value (default 50)
+# EXTRA         options for both peers
+
+set -eu
+top_builddir="${top_builddir:-..}"
+OPENVPN="${top_builddir}/src/openvpn/openvpn"
+COUNT="${COUNT:-2000}"
+BUSY_POLL="${BUSY_POLL:-50}"
+EXTRA="${EXTRA:-}"
+NS_A="ovpn_lat_a.$$"
+NS_B="ovpn_lat_b.$$"
+WORK="lat.$$"
+
+if [ "$(id -u)" != 0 ] || ! ip netns list >/dev/null 2>&1 ; then
+    echo "$0: needs root and ip netns, skipping"
+    exit 77
+fi
+
+cleanup()
+{
+    for pidfile in "${WORK}"/*.pid ; do
+        [ -f "${pidfile}" ] && kill "$(cat "${pidfile}")" 2>/dev/null
+    done
+    sleep 1
+    ip netns del "${NS_A}" 2>/dev/null
+    ip netns del "${NS_B}" 2>/dev/null
+    rm -rf "${WORK}"
+}
+trap "cleanup ; trap 0 ; exit 77" 1 2 15
+trap "cleanup ; exit 1" 0 3
+
+mkdir "${WORK}"
+"${OPENVPN}" --genkey --secret "${WORK}/key"
+
+ip netns add "${NS_A}"
+ip netns add "${NS_B}"
+ip link add lat_a type veth peer name lat_b
+ip link set lat_a netns "${NS_A}"
+ip link set lat_b netns "${NS_B}"
+ip -n "${NS_A}" addr add 192.168.254.1/24 dev lat_a
+ip -n "${NS_B}" addr add 192.168.254.2/24 dev lat_b
+ip -n "${NS_A}" link set lat_a up
+ip -n "${NS_B}" link set lat_b up
+
+# start both peers with the options in $1 and $2, wait until they are up
+start_peers()
+{
+    ip netns exec "${NS_A}" "${OPENVPN}" --dev tun --proto udp \
+        --secret "${WORK}/key" 0 --cipher AES-128-CBC --auth SHA256 \
+        --local 192.168.254.1 --remote 192.168.254.2 \
+        --ifconfig 10.254.0.1 10.254.0.2 --writepid "${WORK}/a.pid" \
+        --daemon --log "${WORK}/a.log" ${EXTRA} $1
+    ip netns exec "${NS_B}" "${OPENVPN}" --dev tun --proto udp \
+        --secret "${WORK}/key" 1 --cipher AES-128-CBC --auth SHA256 \
+        --local 192.168.254.2 --remote 192.168.254.1 \
+        --ifconfig 10.254.0.2 10.254.0.1 --writepid "${WORK}/b.pid" \
+        --daemon --log "${WORK}/b.log" ${EXTRA} $2
+
+    i=0
+    until grep -q "Initialization Sequence Completed" "${WORK}/a.log" 2>/dev/null \
+          && grep -q "Initialization Sequence Completed" "${WORK}/b.log" 2>/dev/null
+    do
+        i=$((i + 1))
+        if [ $i -gt 30 ] ; then
+            echo "$0: the peers did not come up"
+            cat "${WORK}/a.log" "${WORK}/b.log"
+            exit 1
+        fi
+        sleep 1
+    done
+}
+
+stop_peers()
+{
+    kill "$(cat "${WORK}/a.pid")" "$(cat "${WORK}/b.pid")"
+    sleep 1
+    rm -f "${WORK}"/*.pid "${WORK}"/*.log
+}
+
+# print the 50th and 99th percentile of the ping times, in microseconds
+measure()
+{
+    ip netns exec "${NS_A}" ping -n -c 100 -i 0.01 10.254.0.2 >/dev/null
+    ip netns exec "${NS_A}" ping -n -c "${COUNT}" -i 0.002 10.254.0.2 \
+        | sed -n 's/.*time=\([0-9.]*\) ms/\1/p' | sort -n \
+        | awk '{ t[NR] = $1 * 1000 }
+               END { if (NR) printf "p50 %d us  p99 %d us  (%d samples)\n",
+                                    t[int(NR * 0.50 + 0.5)], t[int(NR * 0.99 + 0.5)], NR }'
+}
+
+CPUS=$(getconf _NPROCESSORS_ONLN)
+AFFINITY_A=""
+AFFINITY_B=""
+if [ "${CPUS}" -ge 2 ] ; then
+    AFFINITY_A="--cpu-affinity 0"
+    AFFINITY_B="--cpu-affinity 1"
+fi
+
+echo -n "default:           "
+start_peers "" ""
+measure
+stop_peers
+
+echo -n "--busy-poll ${BUSY_POLL}:    "
+start_peers "--busy-poll ${BUSY_POLL} ${AFFINITY_A}" "--busy-poll ${BUSY_POLL} ${AFFINITY_B}"
+measure
+stop_peers
+
+trap 0
+cleanup
+exit 0
@@ -0,0 +1,322 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Micro-benchmark driver.
+ *
+ * Without arguments every benchmark runs a few operations only, so that
+ * "make check" verifies they still work.  With -f each benchmark is
+ * calibrated to run for BENCH_TARGET_NS per repetition and repeated
+ * BENCH_REPS times; the median is reported, which is stable against
+ * the occasional interruption.  "make bench" does this and writes the
+ * results to bench.json.
+ *
+ *   bench_testdriver [-f] [-o file] [name-prefix...]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include <time.h>
+
+#include "otime.h"
+#include "session_id.h"
+#include "socket.h"
+#include "bench.h"
+
+#include "mock_msg.h"
+
+#define BENCH_QUICK_OPS 1000
+#define BENCH_TARGET_NS 20000000ULL     /* 20 ms per repetition */
+#define BENCH_REPS      9
+
+/*
+ * Heap allocations are counted by wrapping the allocator with the
+ * linker's --wrap option.
+ */
+static unsigned long long n_allocs;
+static unsigned long long n_alloc_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+    ++n_allocs;
+    n_alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+    ++n_allocs;
+    n_alloc_bytes += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    ++n_allocs;
+    n_alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+/*
+ * mroute.c and reliable.c only use these in debug messages, which
+ * mock_msg.c does not print.
+ */
+const struct session_id x_session_id_zero;
+
+const char *
+session_id_print(const struct session_id *sid, struct gc_arena *gc)
+{
+    return "[session id]";
+}
+
+const char *
+print_in_addr_t(in_addr_t addr, unsigned int flags, struct gc_arena *gc)
+{
+    return "[in_addr_t]";
+}
+
+const char *
+print_in6_addr(struct in6_addr a6, unsigned int flags, struct gc_arena *gc)
+{
+    return "[in6_addr]";
+}
+
+static volatile uintptr_t bench_sink;
+
+void
+bench_consume(uintptr_t value)
+{
+    bench_sink += value;
+}
+
+struct bench_result {
+    const char *name;
+    unsigned long ops;          /* per repetition */
+    int reps;
+    double ns_per_op;           /* median */
+    double ns_per_op_min;
+    double ns_per_op_max;
+    double allocs_per_op;
+    double bytes_per_op;
+    double ratio;               /* 0 if the benchmark has none */
+};
+
+static unsigned long long
+bench_clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long
+bench_time_run(const struct bench_case *bc, void *state, unsigned long n)
+{
+    const unsigned long long start = bench_clock_ns();
+    update_time();
+    bc->run(state, n);
+    return bench_clock_ns() - start;
+}
+
+static int
+bench_cmp_double(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void
+bench_run_case(const struct bench_case *bc, bool full, struct bench_result *r)
+{
+    double ns[BENCH_REPS];
+    unsigned long long allocs, bytes;
+    unsigned long n = BENCH_QUICK_OPS;
+    int i;
+    void *state = bc->setup ? bc->setup() : NULL;
+
+    r->name = bc->name;
+    r->reps = 1;
+
+    if (full)
+    {
+        /* warm up and find the number of operations per repetition */
+        n = 1;
+        while (bench_time_run(bc, state, n) < BENCH_TARGET_NS && n < (1UL << 30))
+        {
+            n *= 2;
+        }
+        r->reps = BENCH_REPS;
+    }
+
+    allocs = n_allocs;
+    bytes = n_alloc_bytes;
+    for (i = 0; i < r->reps; ++i)
+    {
+        ns[i] = (double) bench_time_run(bc, state, n) / n;
+    }
+    allocs = n_allocs - allocs;
+    bytes = n_alloc_bytes - bytes;
+
+    r->ratio = bc->ratio ? bc->ratio(state) : 0;
+    if (bc->teardown)
+    {
+        bc->teardown(state);
+    }
+
+    qsort(ns, r->reps, sizeof(ns[0]), bench_cmp_double);
+    r->ops = n;
+    r->ns_per_op = ns[r->reps / 2];
+    r->ns_per_op_min = ns[0];
+    r->ns_per_op_max = ns[r->reps - 1];
+    r->allocs_per_op = (double) allocs / ((double) n * r->reps);
+    r->bytes_per_op = (double) bytes / ((double) n * r->reps);
+}
+
+static bool
+bench_selected(const char *name, int argc, char *argv[])
+{
+    int i;
+
+    if (argc == 0)
+    {
+        return true;
+    }
+    for (i = 0; i < argc; ++i)
+    {
+        if (!strncmp(name, argv[i], strlen(argv[i])))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+bench_print_json(FILE *fp, const struct bench_result *r, int n, bool full)
+{
+    int i;
+
+    fprintf(fp, "{\n  \"mode\": \"%s\",\n  \"benchmarks\": [", full ? "full" : "quick");
+    for (i = 0; i < n; ++i)
+    {
+        fprintf(fp, "%s\n    {\"name\": \"%s\", \"ops\": %lu, \"reps\": %d, "
+                "\"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f, \"ns_per_op_max\": %.2f, "
+                "\"allocs_per_op\": %.4f, \"bytes_per_op\": %.2f",
+                i ? "," : "", r[i].name, r[i].ops, r[i].reps,
+                r[i].ns_per_op, r[i].ns_per_op_min, r[i].ns_per_op_max,
+                r[i].allocs_per_op, r[i].bytes_per_op);
+        if (r[i].ratio)
+        {
+            fprintf(fp, ", \"ratio\": %.4f", r[i].ratio);
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const struct bench_case *const suites[] = {
+        bench_core_cases,
+        bench_packet_cases,
+        bench_comp_cases,
+    };
+    struct bench_result results[64];
+    const char *json_file = NULL;
+    bool full = false;
+    int n = 0;
+    int opt;
+    size_t s;
+
+    while ((opt = getopt(argc, argv, "fo:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+                full = true;
+                break;
+
+            case 'o':
+                json_file = optarg;
+                break;
+
+            default:
+                fprintf(stderr, "usage: %s [-f] [-o file] [name-prefix...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    for (s = 0; s < SIZE(suites); ++s)
+    {
+        const struct bench_case *bc;
+        for (bc = suites[s]; bc->name; ++bc)
+        {
+            if (bench_selected(bc->name, argc - optind, argv + optind))
+            {
+                ASSERT(n < SIZE(results));
+                bench_run_case(bc, full, &results[n]);
+                fprintf(stderr, "%-32s %10.1f ns/op %8.3f allocs/op %10.1f B/op",
+                        results[n].name, results[n].ns_per_op,
+                        results[n].allocs_per_op, results[n].bytes_per_op);
+                if (results[n].ratio)
+                {
+                    fprintf(stderr, " %8.3f ratio", results[n].ratio);
+                }
+                fprintf(stderr, "\n");
+                ++n;
+            }
+        }
+    }
+
+    if (json_file)
+    {
+        FILE *fp = fopen(json_file, "w");
+        if (!fp)
+        {
+            fprintf(stderr, "cannot write %s\n", json_file);
+            return 1;
+        }
+        bench_print_json(fp, results, n, full);
+        fclose(fp);
+    }
+    else
+    {
+        bench_print_json(stdout, results, n, full);
+    }
+    return 0;
+}
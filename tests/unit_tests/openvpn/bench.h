@@ -0,0 +1,60 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * A micro-benchmark.  \c run performs \c n operations of the code under
+ * test on the state returned by \c setup; the harness times it and counts
+ * the heap allocations it makes, and reports both per operation.  A
+ * compression benchmark also reports the ratio \c ratio returns for the
+ * state after all runs.
+ */
+struct bench_case {
+    const char *name;
+    void *(*setup)(void);                       /**< may be NULL */
+    void (*run)(void *state, unsigned long n);
+    void (*teardown)(void *state);              /**< may be NULL */
+    double (*ratio)(void *state);               /**< may be NULL */
+};
+
+/** Benchmarks of buffer.c, list.c, schedule.c, mbuf.c, pktbuf.c and ring.c */
+extern const struct bench_case bench_core_cases[];
+
+/**
+ * Benchmarks of mroute.c, packet_id.c, reliable.c, fragment.c, crypto.c
+ * and the key selection of ssl.c
+ */
+extern const struct bench_case bench_packet_cases[];
+
+/** Benchmarks of the compression algorithms of comp-lz4.c and comp-zstd.c */
+extern const struct bench_case bench_comp_cases[];
+
+/**
+ * Keep the compiler from optimizing away a computation whose result the
+ * benchmark does not otherwise use.
+ */
+void bench_consume(uintptr_t value);
+
+#endif /* BENCH_H */
@@ -0,0 +1,303 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "buffer.h"
+#include "comp.h"
+#include "mtu.h"
+#include "bench.h"
+
+#if defined(ENABLE_ZSTD)
+#include <zdict.h>
+#endif
+
+#if defined(ENABLE_LZ4) || defined(ENABLE_ZSTD)
+
+/*
+ * Compression of small packets, each compressed on its own like the data
+ * channel does.  The packets are JSON telemetry messages of about 300
+ * bytes that differ in their values but share their structure, which is
+ * what a shared zstd dictionary is meant for.  Besides the time, the
+ * benchmarks report the ratio of the bytes sent, compression header
+ * included, to the bytes of the original packets.
+ */
+#define BENCH_COMP_PACKETS       1024   /* cycled through by the benchmarks */
+#define BENCH_COMP_PACKET_MAX    512
+
+static int
+bench_comp_packet(uint8_t *p, unsigned int i)
+{
+    static const char *const status[] = { "ok", "ok", "ok", "degraded", "failed" };
+    const unsigned int r = i * 2654435761u;
+
+    return snprintf((char *) p, BENCH_COMP_PACKET_MAX,
+                    "{\"device\":\"sensor-%04u\",\"timestamp\":%u,\"seq\":%u,"
+                    "\"temperature\":%u.%u,\"humidity\":%u,\"pressure\":%u,"
+                    "\"battery\":%u,\"status\":\"%s\",\"firmware\":\"2.4.%u\","
+                    "\"location\":{\"lat\":48.%05u,\"lon\":11.%05u},"
+                    "\"readings\":[%u,%u,%u,%u,%u,%u]}",
+                    r % 2000, 1500000000 + i * 10, i,
+                    15 + r % 20, r % 10, 30 + r % 50, 950 + r % 100,
+                    r % 101, status[r % SIZE(status)], r % 4,
+                    r % 100000, (r >> 8) % 100000,
+                    r % 997, (r >> 3) % 997, (r >> 6) % 997,
+                    (r >> 9) % 997, (r >> 12) % 997, (r >> 15) % 997);
+}
+
+struct bench_comp {
+    struct compress_context *compctx;
+    struct frame frame;
+    uint8_t packets[BENCH_COMP_PACKETS][BENCH_COMP_PACKET_MAX];
+    int lens[BENCH_COMP_PACKETS];
+    struct buffer packet;
+    struct buffer compress_buf;
+    struct buffer decompress_buf;
+    counter_type bytes_in;
+    counter_type bytes_out;
+};
+
+#if defined(ENABLE_ZSTD)
+#define BENCH_COMP_DICT_SIZE     16384
+#define BENCH_COMP_TRAIN_PACKETS 8192
+
+/*
+ * Train a dictionary on packets other than the ones the benchmarks
+ * compress, like "zstd --train" on captured traffic would, and load it
+ * under a temporary name.  zstd_dict_preload() keeps it for the whole
+ * process, so the file is not needed afterwards.
+ */
+static const char *
+bench_comp_dict(void)
+{
+    static char file[] = "/tmp/openvpn_bench_dict_XXXXXX";
+    static bool trained;
+
+    if (!trained)
+    {
+        uint8_t *samples = malloc(BENCH_COMP_TRAIN_PACKETS * BENCH_COMP_PACKET_MAX);
+        size_t *sizes = malloc(BENCH_COMP_TRAIN_PACKETS * sizeof(size_t));
+        uint8_t dict[BENCH_COMP_DICT_SIZE];
+        size_t len = 0;
+        size_t dict_len;
+        unsigned int i;
+        int fd;
+
+        check_malloc_return(samples);
+        check_malloc_return(sizes);
+        for (i = 0; i < BENCH_COMP_TRAIN_PACKETS; ++i)
+        {
+            sizes[i] = bench_comp_packet(samples + len, BENCH_COMP_PACKETS + i);
+            len += sizes[i];
+        }
+        dict_len = ZDICT_trainFromBuffer(dict, sizeof(dict), samples, sizes,
+                                         BENCH_COMP_TRAIN_PACKETS);
+        ASSERT(!ZDICT_isError(dict_len));
+        free(samples);
+        free(sizes);
+
+        fd = mkstemp(file);
+        ASSERT(fd >= 0);
+        ASSERT(write(fd, dict, dict_len) == (ssize_t) dict_len);
+        close(fd);
+        zstd_dict_preload(file);
+        unlink(file);
+        trained = true;
+    }
+    return file;
+}
+#endif /* ENABLE_ZSTD */
+
+static struct bench_comp *
+bench_comp_setup(int alg, int level, bool dict, unsigned int flags)
+{
+    struct bench_comp *bc;
+    struct compress_options opt = { .alg = alg, .flags = flags, .level = level };
+    unsigned int i;
+
+#if defined(ENABLE_ZSTD)
+    if (dict)
+    {
+        opt.dict_file = bench_comp_dict();
+    }
+#endif
+
+    ALLOC_OBJ_CLEAR(bc, struct bench_comp);
+    for (i = 0; i < BENCH_COMP_PACKETS; ++i)
+    {
+        bc->lens[i] = bench_comp_packet(bc->packets[i], i);
+    }
+
+    bc->frame.link_mtu = 1500;
+    bc->frame.link_mtu_dynamic = 1500;
+    comp_add_to_extra_frame(&bc->frame);
+    comp_add_to_extra_buffer(&bc->frame);
+    bc->packet = alloc_buf(BUF_SIZE(&bc->frame));
+    bc->compress_buf = alloc_buf(BUF_SIZE(&bc->frame));
+    bc->decompress_buf = alloc_buf(BUF_SIZE(&bc->frame));
+
+    bc->compctx = comp_init(&opt);
+    ASSERT(bc->compctx);
+    return bc;
+}
+
+static void
+bench_comp_teardown(void *state)
+{
+    struct bench_comp *bc = state;
+    comp_uninit(bc->compctx);
+    free_buf(&bc->packet);
+    free_buf(&bc->compress_buf);
+    free_buf(&bc->decompress_buf);
+    free(bc);
+}
+
+static void
+bench_comp_roundtrip(void *state, unsigned long n)
+{
+    struct bench_comp *bc = state;
+    struct compress_context *compctx = bc->compctx;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        const unsigned int k = i % BENCH_COMP_PACKETS;
+        struct buffer buf;
+
+        ASSERT(buf_init(&bc->packet, FRAME_HEADROOM(&bc->frame)));
+        ASSERT(buf_write(&bc->packet, bc->packets[k], bc->lens[k]));
+        buf = bc->packet;
+
+        (*compctx->alg.compress)(&buf, bc->compress_buf, compctx, &bc->frame);
+        bc->bytes_in += bc->lens[k];
+        bc->bytes_out += BLEN(&buf);
+
+        (*compctx->alg.decompress)(&buf, bc->decompress_buf, compctx, &bc->frame);
+        ASSERT(BLEN(&buf) == bc->lens[k]);
+    }
+}
+
+static double
+bench_comp_ratio(void *state)
+{
+    struct bench_comp *bc = state;
+    return (double) bc->bytes_out / bc->bytes_in;
+}
+
+#if defined(ENABLE_LZ4)
+static void *
+bench_comp_setup_lz4(void)
+{
+    return bench_comp_setup(COMP_ALGV2_LZ4, 0, false, 0);
+}
+#endif
+
+#if defined(ENABLE_ZSTD)
+static void *
+bench_comp_setup_zstd_1(void)
+{
+    return bench_comp_setup(COMP_ALGV2_ZSTD, 1, false, 0);
+}
+
+static void *
+bench_comp_setup_zstd_3(void)
+{
+    return bench_comp_setup(COMP_ALGV2_ZSTD, 3, false, 0);
+}
+
+static void *
+bench_comp_setup_zstd_1_dict(void)
+{
+    return bench_comp_setup(COMP_ALGV2_ZSTD, 1, true, 0);
+}
+
+static void *
+bench_comp_setup_zstd_3_dict(void)
+{
+    return bench_comp_setup(COMP_ALGV2_ZSTD, 3, true, 0);
+}
+
+/*
+ * Server side of a tunnel whose server pushed "compress zstd", so both
+ * sides have COMP_F_DICT_NEGOTIATE set.  Neither side may use the
+ * dictionary before the negotiation: the server starts once the client
+ * announced the same dictionary, the client once the first frame made
+ * with it arrives.
+ */
+static void *
+bench_comp_setup_zstd_1_dict_pushed(void)
+{
+    struct bench_comp *bc = bench_comp_setup(COMP_ALGV2_ZSTD, 1, true,
+                                             COMP_F_DICT_NEGOTIATE);
+    struct compress_options opt = {
+        .alg = COMP_ALGV2_ZSTD,
+        .flags = COMP_F_DICT_NEGOTIATE,
+        .level = 1,
+        .dict_file = bench_comp_dict()
+    };
+    struct compress_context *client = comp_init(&opt);
+    struct gc_arena gc = gc_new();
+    struct buffer peer_info = alloc_buf_gc(256, &gc);
+    struct buffer buf;
+
+    ASSERT(!bc->compctx->wu.zstd.use_dict && !client->wu.zstd.use_dict);
+
+    comp_generate_peer_info_string(&opt, &peer_info);
+    comp_check_peer_info(bc->compctx, BSTR(&peer_info));
+    ASSERT(bc->compctx->wu.zstd.use_dict);
+
+    ASSERT(buf_init(&bc->packet, FRAME_HEADROOM(&bc->frame)));
+    ASSERT(buf_write(&bc->packet, bc->packets[0], bc->lens[0]));
+    buf = bc->packet;
+    (*bc->compctx->alg.compress)(&buf, bc->compress_buf, bc->compctx, &bc->frame);
+    (*client->alg.decompress)(&buf, bc->decompress_buf, client, &bc->frame);
+    ASSERT(BLEN(&buf) == bc->lens[0]);
+    ASSERT(client->wu.zstd.use_dict);
+
+    comp_uninit(client);
+    gc_free(&gc);
+    return bc;
+}
+#endif
+
+#endif /* ENABLE_LZ4 || ENABLE_ZSTD */
+
+const struct bench_case bench_comp_cases[] = {
+#if defined(ENABLE_LZ4)
+    { "comp_lz4", bench_comp_setup_lz4, bench_comp_roundtrip, bench_comp_teardown, bench_comp_ratio },
+#endif
+#if defined(ENABLE_ZSTD)
+    { "comp_zstd_1", bench_comp_setup_zstd_1, bench_comp_roundtrip, bench_comp_teardown, bench_comp_ratio },
+    { "comp_zstd_3", bench_comp_setup_zstd_3, bench_comp_roundtrip, bench_comp_teardown, bench_comp_ratio },
+    { "comp_zstd_1_dict", bench_comp_setup_zstd_1_dict, bench_comp_roundtrip, bench_comp_teardown, bench_comp_ratio },
+    { "comp_zstd_3_dict", bench_comp_setup_zstd_3_dict, bench_comp_roundtrip, bench_comp_teardown, bench_comp_ratio },
+    { "comp_zstd_1_dict_pushed", bench_comp_setup_zstd_1_dict_pushed, bench_comp_roundtrip, bench_comp_teardown, bench_comp_ratio },
+#endif
+    { NULL }
+};
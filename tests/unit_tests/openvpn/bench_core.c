@@ -0,0 +1,437 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include <pthread.h>
+
+#include "buffer.h"
+#include "list.h"
+#include "mbuf.h"
+#include "mroute.h"
+#include "pktbuf.h"
+#include "ring.h"
+#include "schedule.h"
+#include "bench.h"
+
+/* number of clients the per-client structures are filled with */
+#define N_CLIENTS 1024
+
+/*
+ * gc_malloc(): allocations of a typical small size, the arena is freed
+ * every 16 allocations, like a gc_arena of a packet handling function.
+ */
+static void
+bench_gc_malloc(void *state, unsigned long n)
+{
+    struct gc_arena gc = gc_new();
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        bench_consume((uintptr_t) gc_malloc(64, false, &gc));
+        if ((i & 15) == 15)
+        {
+            gc_free(&gc);
+        }
+    }
+    gc_free(&gc);
+}
+
+static void
+bench_gc_malloc_clear(void *state, unsigned long n)
+{
+    struct gc_arena gc = gc_new();
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        bench_consume((uintptr_t) gc_malloc(256, true, &gc));
+        if ((i & 15) == 15)
+        {
+            gc_free(&gc);
+        }
+    }
+    gc_free(&gc);
+}
+
+/*
+ * hash_*: a table of virtual addresses as kept by the server,
+ * with the default --hash-size.
+ */
+struct bench_hash {
+    struct hash *hash;
+    struct mroute_addr addr[N_CLIENTS];
+};
+
+static void
+bench_set_addr(struct mroute_addr *addr, int i)
+{
+    CLEAR(*addr);
+    mroute_extract_in_addr_t(addr, 0x0a080000 + i);
+}
+
+static void *
+bench_hash_setup(void)
+{
+    struct bench_hash *bh;
+    int i;
+
+    ALLOC_OBJ_CLEAR(bh, struct bench_hash);
+    bh->hash = hash_init(256, 0x5eed, mroute_addr_hash_function,
+                         mroute_addr_compare_function);
+    for (i = 0; i < N_CLIENTS; ++i)
+    {
+        bench_set_addr(&bh->addr[i], i);
+        ASSERT(hash_add(bh->hash, &bh->addr[i], &bh->addr[i], false));
+    }
+    return bh;
+}
+
+static void
+bench_hash_teardown(void *state)
+{
+    struct bench_hash *bh = state;
+    hash_free(bh->hash);
+    free(bh);
+}
+
+static void
+bench_hash_lookup(void *state, unsigned long n)
+{
+    struct bench_hash *bh = state;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        /* visit the clients in a scattered order */
+        const struct mroute_addr *addr = &bh->addr[(i * 421) % N_CLIENTS];
+        bench_consume((uintptr_t) hash_lookup(bh->hash, addr));
+    }
+}
+
+static void
+bench_hash_remove_add(void *state, unsigned long n)
+{
+    struct bench_hash *bh = state;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct mroute_addr *addr = &bh->addr[(i * 421) % N_CLIENTS];
+        ASSERT(hash_remove(bh->hash, addr));
+        ASSERT(hash_add(bh->hash, addr, addr, false));
+    }
+}
+
+/*
+ * schedule_*: one timer per client, as in the server's event loop.
+ */
+struct bench_schedule {
+    struct schedule *s;
+    struct schedule_entry e[N_CLIENTS];
+};
+
+static void *
+bench_schedule_setup(void)
+{
+    struct bench_schedule *bs;
+    int i;
+
+    ALLOC_OBJ_CLEAR(bs, struct bench_schedule);
+    bs->s = schedule_init();
+    for (i = 0; i < N_CLIENTS; ++i)
+    {
+        struct timeval tv = { i % 60, (i * 7919) % 1000000 };
+        schedule_add_entry(bs->s, &bs->e[i], &tv, 0);
+    }
+    return bs;
+}
+
+static void
+bench_schedule_teardown(void *state)
+{
+    struct bench_schedule *bs = state;
+    schedule_free(bs->s);
+    free(bs);
+}
+
+/* move a random timer, then find the earliest one */
+static void
+bench_schedule_modify(void *state, unsigned long n)
+{
+    struct bench_schedule *bs = state;
+    struct timeval wakeup;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct timeval tv = { (i * 31) % 60, (i * 7919) % 1000000 };
+        schedule_add_entry(bs->s, &bs->e[(i * 421) % N_CLIENTS], &tv, 0);
+        bench_consume((uintptr_t) schedule_get_earliest_wakeup(bs->s, &wakeup));
+    }
+}
+
+/* take the earliest timer and rearm it later */
+static void
+bench_schedule_earliest(void *state, unsigned long n)
+{
+    struct bench_schedule *bs = state;
+    struct timeval wakeup;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct schedule_entry *e = schedule_get_earliest_wakeup(bs->s, &wakeup);
+        wakeup.tv_sec += 60;
+        schedule_remove_entry(bs->s, e);
+        schedule_add_entry(bs->s, e, &wakeup, 0);
+    }
+}
+
+/*
+ * mbuf_*: the broadcast/multicast queue of a client, a packet is
+ * queued and another one dequeued at a depth of 16.  The _pool variant
+ * copies the packets into buffers of a pktbuf.c pool like the server.
+ */
+struct bench_mbuf {
+    struct mbuf_set *ms;
+    struct pkt_pool *pool;
+    struct buffer buf;
+};
+
+static void
+bench_mbuf_add(struct bench_mbuf *bm, unsigned long i)
+{
+    struct mbuf_item item;
+
+    item.buffer = mbuf_alloc_buf(bm->pool, &bm->buf);
+    item.buffer->prio = 0;
+    item.instance = (struct multi_instance *) (uintptr_t) (0x1000 + (i & 7) * 0x10);
+    mbuf_add_item(bm->ms, &item);
+    mbuf_free_buf(item.buffer);
+}
+
+static void *
+bench_mbuf_setup(void)
+{
+    struct bench_mbuf *bm;
+    unsigned long i;
+
+    ALLOC_OBJ_CLEAR(bm, struct bench_mbuf);
+    bm->ms = mbuf_init(64, 0);
+    bm->buf = alloc_buf(1400);
+    memset(BPTR(&bm->buf), 0x5a, 1400);
+    ASSERT(buf_inc_len(&bm->buf, 1400));
+    for (i = 0; i < 16; ++i)
+    {
+        bench_mbuf_add(bm, i);
+    }
+    return bm;
+}
+
+static void *
+bench_mbuf_setup_pool(void)
+{
+    struct bench_mbuf *bm;
+    unsigned long i;
+
+    ALLOC_OBJ_CLEAR(bm, struct bench_mbuf);
+    bm->ms = mbuf_init(64, 0);
+    bm->pool = pkt_pool_new(1600, 64, 256);
+    bm->buf = alloc_buf(1400);
+    memset(BPTR(&bm->buf), 0x5a, 1400);
+    ASSERT(buf_inc_len(&bm->buf, 1400));
+    for (i = 0; i < 16; ++i)
+    {
+        bench_mbuf_add(bm, i);
+    }
+    return bm;
+}
+
+static void
+bench_mbuf_teardown(void *state)
+{
+    struct bench_mbuf *bm = state;
+    mbuf_free(bm->ms);
+    pkt_pool_free(bm->pool);
+    free_buf(&bm->buf);
+    free(bm);
+}
+
+static void
+bench_mbuf_add_extract(void *state, unsigned long n)
+{
+    struct bench_mbuf *bm = state;
+    struct mbuf_item item;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        bench_mbuf_add(bm, i);
+        ASSERT(mbuf_extract_item(bm->ms, &item));
+        mbuf_free_buf(item.buffer);
+    }
+}
+
+/*
+ * ring.c: handing packets over in bursts of RING_BURST, one operation is
+ * one packet.  The _thread variant has a consumer thread on the other
+ * side of the ring and so includes the cache line transfers; on a single
+ * CPU it mostly measures the context switches.
+ */
+#define RING_BURST 32
+
+struct bench_ring {
+    struct ring *ring;
+    pthread_t consumer;
+    int stop;
+};
+
+static void *
+bench_ring_setup_spsc(void)
+{
+    struct bench_ring *br;
+
+    ALLOC_OBJ_CLEAR(br, struct bench_ring);
+    br->ring = ring_new(1024, 0);
+    return br;
+}
+
+static void *
+bench_ring_setup_mpsc(void)
+{
+    struct bench_ring *br;
+
+    ALLOC_OBJ_CLEAR(br, struct bench_ring);
+    br->ring = ring_new(1024, RING_MP);
+    return br;
+}
+
+static void
+bench_ring_teardown(void *state)
+{
+    struct bench_ring *br = state;
+    ring_free(br->ring);
+    free(br);
+}
+
+static void
+bench_ring_burst(void *state, unsigned long n)
+{
+    struct bench_ring *br = state;
+    void *objs[RING_BURST];
+    unsigned long i;
+    unsigned int j;
+
+    for (j = 0; j < RING_BURST; ++j)
+    {
+        objs[j] = (void *) (uintptr_t) (0x1000 + j * 0x10);
+    }
+    for (i = 0; i < n; i += RING_BURST)
+    {
+        ASSERT(ring_enqueue_burst(br->ring, objs, RING_BURST) == RING_BURST);
+        ASSERT(ring_dequeue_burst(br->ring, objs, RING_BURST) == RING_BURST);
+    }
+}
+
+static void *
+bench_ring_consumer(void *arg)
+{
+    struct bench_ring *br = arg;
+    void *objs[RING_BURST];
+
+    while (!__atomic_load_n(&br->stop, __ATOMIC_ACQUIRE))
+    {
+        if (!ring_dequeue_burst(br->ring, objs, RING_BURST))
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *
+bench_ring_setup_thread(void)
+{
+    struct bench_ring *br = bench_ring_setup_spsc();
+    ASSERT(!pthread_create(&br->consumer, NULL, bench_ring_consumer, br));
+    return br;
+}
+
+static void
+bench_ring_teardown_thread(void *state)
+{
+    struct bench_ring *br = state;
+    __atomic_store_n(&br->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(br->consumer, NULL);
+    bench_ring_teardown(br);
+}
+
+static void
+bench_ring_thread(void *state, unsigned long n)
+{
+    struct bench_ring *br = state;
+    void *objs[RING_BURST];
+    unsigned long i;
+    unsigned int j;
+
+    for (j = 0; j < RING_BURST; ++j)
+    {
+        objs[j] = (void *) (uintptr_t) (0x1000 + j * 0x10);
+    }
+    for (i = 0; i < n; )
+    {
+        const unsigned int done = ring_enqueue_burst(br->ring, objs, RING_BURST);
+        if (!done)
+        {
+            sched_yield();
+        }
+        i += done;
+    }
+    while (ring_count(br->ring))
+    {
+        sched_yield();
+    }
+}
+
+const struct bench_case bench_core_cases[] = {
+    { "gc_malloc", NULL, bench_gc_malloc, NULL },
+    { "gc_malloc_clear", NULL, bench_gc_malloc_clear, NULL },
+    { "hash_lookup", bench_hash_setup, bench_hash_lookup, bench_hash_teardown },
+    { "hash_remove_add", bench_hash_setup, bench_hash_remove_add, bench_hash_teardown },
+    { "schedule_modify", bench_schedule_setup, bench_schedule_modify, bench_schedule_teardown },
+    { "schedule_earliest", bench_schedule_setup, bench_schedule_earliest, bench_schedule_teardown },
+    { "mbuf_add_extract", bench_mbuf_setup, bench_mbuf_add_extract, bench_mbuf_teardown },
+    { "mbuf_add_extract_pool", bench_mbuf_setup_pool, bench_mbuf_add_extract, bench_mbuf_teardown },
+    { "ring_spsc_burst", bench_ring_setup_spsc, bench_ring_burst, bench_ring_teardown },
+    { "ring_mpsc_burst", bench_ring_setup_mpsc, bench_ring_burst, bench_ring_teardown },
+    { "ring_spsc_thread", bench_ring_setup_thread, bench_ring_thread, bench_ring_teardown_thread },
+    { NULL }
+};
@@ -0,0 +1,616 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include "buffer.h"
+#include "crypto.h"
+#include "fragment.h"
+#include "mroute.h"
+#include "packet_id.h"
+#include "reliable.h"
+#include "ssl_common.h"
+#include "bench.h"
+
+#define PACKET_SIZE 1400
+
+/*
+ * mroute_extract_addr_from_packet(): routing a packet read from tun.
+ */
+static void *
+bench_mroute_setup_packet(int version)
+{
+    struct buffer *buf;
+    uint8_t *p;
+
+    ALLOC_OBJ_CLEAR(buf, struct buffer);
+    *buf = alloc_buf(PACKET_SIZE);
+    p = BPTR(buf);
+    memset(p, 0, PACKET_SIZE);
+    if (version == 4)
+    {
+        p[0] = 0x45;                        /* version, header length */
+        p[2] = PACKET_SIZE >> 8;            /* total length */
+        p[3] = PACKET_SIZE & 0xff;
+        p[8] = 64;                          /* ttl */
+        p[9] = 17;                          /* udp */
+        p[12] = 10; p[13] = 8; p[15] = 2;   /* 10.8.0.2 -> 10.8.1.7 */
+        p[16] = 10; p[17] = 8; p[18] = 1; p[19] = 7;
+    }
+    else
+    {
+        p[0] = 0x60;
+        p[4] = (PACKET_SIZE - 40) >> 8;     /* payload length */
+        p[5] = (PACKET_SIZE - 40) & 0xff;
+        p[6] = 17;                          /* next header udp */
+        p[7] = 64;                          /* hop limit */
+        p[8] = 0xfd; p[23] = 2;             /* fd00::2 -> fd00::1:7 */
+        p[24] = 0xfd; p[37] = 1; p[39] = 7;
+    }
+    ASSERT(buf_inc_len(buf, PACKET_SIZE));
+    return buf;
+}
+
+static void *
+bench_mroute_setup_ipv4(void)
+{
+    return bench_mroute_setup_packet(4);
+}
+
+static void *
+bench_mroute_setup_ipv6(void)
+{
+    return bench_mroute_setup_packet(6);
+}
+
+static void
+bench_mroute_teardown(void *state)
+{
+    struct buffer *buf = state;
+    free_buf(buf);
+    free(buf);
+}
+
+static void
+bench_mroute_extract(void *state, unsigned long n)
+{
+    const struct buffer *buf = state;
+    struct mroute_addr src, dest;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        const unsigned int ret = mroute_extract_addr_from_packet(&src, &dest, NULL, NULL,
+                                                                 buf, DEV_TYPE_TUN);
+        ASSERT(ret & MROUTE_EXTRACT_SUCCEEDED);
+        bench_consume(dest.len);
+    }
+}
+
+/*
+ * packet_id_test()/packet_id_add(): the replay check of a UDP tunnel
+ * with the default --replay-window, and with the largest one.
+ */
+struct bench_packet_id {
+    struct packet_id pid;
+    packet_id_type next;
+    packet_id_type block;
+};
+
+static void *
+bench_packet_id_setup(void)
+{
+    struct bench_packet_id *bp;
+
+    ALLOC_OBJ_CLEAR(bp, struct bench_packet_id);
+    packet_id_init(&bp->pid, DEFAULT_SEQ_BACKTRACK, DEFAULT_SEQ_BACKTRACK,
+                   DEFAULT_TIME_BACKTRACK, "bench", 0);
+    bp->next = 1;
+    bp->block = 8;
+    return bp;
+}
+
+static void *
+bench_packet_id_setup_wide(void)
+{
+    struct bench_packet_id *bp;
+
+    ALLOC_OBJ_CLEAR(bp, struct bench_packet_id);
+    packet_id_init(&bp->pid, MAX_SEQ_BACKTRACK, MAX_SEQ_BACKTRACK,
+                   DEFAULT_TIME_BACKTRACK, "bench", 0);
+    bp->next = 1;
+    bp->block = 4096;
+    return bp;
+}
+
+static void
+bench_packet_id_teardown(void *state)
+{
+    struct bench_packet_id *bp = state;
+    packet_id_free(&bp->pid);
+    free(bp);
+}
+
+static void
+bench_packet_id_in_order(void *state, unsigned long n)
+{
+    struct bench_packet_id *bp = state;
+    struct packet_id_net pin = { 0, 1 };
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        pin.id = bp->next++;
+        ASSERT(packet_id_test(&bp->pid.rec, &pin));
+        packet_id_add(&bp->pid.rec, &pin);
+    }
+}
+
+/* blocks of bp->block packets arrive in reverse order */
+static void
+bench_packet_id_reordered(void *state, unsigned long n)
+{
+    struct bench_packet_id *bp = state;
+    struct packet_id_net pin = { 0, 1 };
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        const packet_id_type k = (bp->next - 1) & (bp->block - 1);
+        pin.id = bp->next + bp->block - 1 - 2 * k;
+        ++bp->next;
+        ASSERT(packet_id_test(&bp->pid.rec, &pin));
+        packet_id_add(&bp->pid.rec, &pin);
+    }
+}
+
+/*
+ * reliable_*: control channel packets of a TLS session, sent and
+ * acknowledged, or received in order and handed on.
+ */
+struct bench_reliable {
+    struct reliable rel;
+    uint8_t payload[100];
+};
+
+static void *
+bench_reliable_setup(void)
+{
+    struct bench_reliable *br;
+
+    ALLOC_OBJ_CLEAR(br, struct bench_reliable);
+    reliable_init(&br->rel, PACKET_SIZE, 128, 8, false);
+    reliable_set_timeout(&br->rel, 2);
+    memset(br->payload, 0x5a, sizeof(br->payload));
+    return br;
+}
+
+static void
+bench_reliable_teardown(void *state)
+{
+    struct bench_reliable *br = state;
+    reliable_free(&br->rel);
+    reliable_pool_free();
+    free(br);
+}
+
+static void
+bench_reliable_send(void *state, unsigned long n)
+{
+    struct bench_reliable *br = state;
+    struct reliable_ack ack;
+    unsigned long i;
+    int opcode;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct buffer *buf = reliable_get_buf_output_sequenced(&br->rel);
+        ASSERT(buf);
+        ASSERT(buf_write(buf, br->payload, sizeof(br->payload)));
+        reliable_mark_active_outgoing(&br->rel, buf, 4);
+
+        ASSERT(reliable_can_send(&br->rel));
+        buf = reliable_send(&br->rel, &opcode);
+        ASSERT(buf);
+
+        ack.len = 1;
+        ack.packet_id[0] = br->rel.packet_id - 1;
+        reliable_send_purge(&br->rel, &ack);
+    }
+}
+
+static void
+bench_reliable_receive(void *state, unsigned long n)
+{
+    struct bench_reliable *br = state;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        const packet_id_type id = br->rel.packet_id;
+        struct buffer *buf;
+
+        ASSERT(reliable_can_get(&br->rel));
+        ASSERT(reliable_not_replay(&br->rel, id));
+        ASSERT(reliable_wont_break_sequentiality(&br->rel, id));
+        buf = reliable_get_buf(&br->rel);
+        ASSERT(buf_write(buf, br->payload, sizeof(br->payload)));
+        reliable_mark_active_incoming(&br->rel, buf, id, 4);
+
+        buf = reliable_get_buf_sequenced(&br->rel);
+        ASSERT(buf);
+        reliable_mark_deleted(&br->rel, buf, true);
+    }
+}
+
+/*
+ * fragment_outgoing()/fragment_incoming(): a full size packet split
+ * for --fragment 500 and reassembled.
+ */
+struct bench_fragment {
+    struct frame frame;
+    struct fragment_master *tx;
+    struct fragment_master *rx;
+    struct buffer packet;
+    struct buffer work;
+};
+
+static void *
+bench_fragment_setup(void)
+{
+    struct bench_fragment *bf;
+
+    ALLOC_OBJ_CLEAR(bf, struct bench_fragment);
+    bf->frame.link_mtu = 1500;
+    bf->frame.link_mtu_dynamic = 1500;
+    bf->tx = fragment_init(&bf->frame);
+    bf->rx = fragment_init(&bf->frame);
+    bf->frame.link_mtu_dynamic = 500;
+    fragment_frame_init(bf->tx, &bf->frame);
+    fragment_frame_init(bf->rx, &bf->frame);
+    bf->packet = alloc_buf(BUF_SIZE(&bf->frame));
+    bf->work = alloc_buf(BUF_SIZE(&bf->frame));
+    return bf;
+}
+
+static void
+bench_fragment_teardown(void *state)
+{
+    struct bench_fragment *bf = state;
+    fragment_free(bf->tx);
+    fragment_free(bf->rx);
+    free_buf(&bf->packet);
+    free_buf(&bf->work);
+    free(bf);
+}
+
+/* return the length of the reassembled packet, 0 if it is incomplete */
+static int
+bench_fragment_receive(struct bench_fragment *bf, const struct buffer *buf)
+{
+    struct buffer in;
+
+    ASSERT(buf_init(&bf->work, FRAME_HEADROOM(&bf->frame)));
+    ASSERT(buf_copy(&bf->work, buf));
+    in = bf->work;  /* may be pointed to the reassembly buffer */
+    fragment_incoming(bf->rx, &in, &bf->frame);
+    return BLEN(&in);
+}
+
+static void
+bench_fragment_roundtrip(void *state, unsigned long n)
+{
+    struct bench_fragment *bf = state;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct buffer buf;
+        int len;
+
+        ASSERT(buf_init(&bf->packet, FRAME_HEADROOM(&bf->frame)));
+        memset(BPTR(&bf->packet), (int) i, PACKET_SIZE);
+        ASSERT(buf_inc_len(&bf->packet, PACKET_SIZE));
+
+        buf = bf->packet;
+        fragment_outgoing(bf->tx, &buf, &bf->frame);
+        len = bench_fragment_receive(bf, &buf);
+        while (fragment_outgoing_defined(bf->tx))
+        {
+            ASSERT(fragment_ready_to_send(bf->tx, &buf, &bf->frame));
+            len = bench_fragment_receive(bf, &buf);
+        }
+        ASSERT(len == PACKET_SIZE);
+    }
+}
+
+/*
+ * openvpn_encrypt()/openvpn_decrypt(): a packet through the data channel
+ * of a TLS mode tunnel, encrypted by one side and decrypted by the
+ * other.  Full size packets show the cost of the cipher, small ones
+ * (e.g. VoIP or TCP ACKs) the fixed cost per packet.
+ */
+#define SMALL_PACKET_SIZE 64
+
+struct bench_crypto {
+    int len;
+    struct frame frame;
+    struct crypto_options tx;
+    struct crypto_options rx;
+    struct buffer packet;
+    struct buffer encrypt_buf;
+    struct buffer decrypt_buf;
+};
+
+static void
+bench_crypto_set_implicit_iv(struct key_ctx *ctx, const uint8_t *iv)
+{
+    ctx->implicit_iv_len = ctx->iv_len - sizeof(packet_id_type);
+    memcpy(ctx->implicit_iv, iv, ctx->implicit_iv_len);
+}
+
+static void *
+bench_crypto_setup(const char *ciphername, const char *authname, int len)
+{
+    struct bench_crypto *bc;
+    struct key_type kt;
+    struct key2 key2 = { .n = 2 };
+
+    ALLOC_OBJ_CLEAR(bc, struct bench_crypto);
+    bc->len = len;
+    init_key_type(&kt, ciphername, authname, 0, true, false);
+    generate_key_random(&key2.keys[0], &kt);
+    generate_key_random(&key2.keys[1], &kt);
+    init_key_ctx_bi(&bc->tx.key_ctx_bi, &key2, KEY_DIRECTION_NORMAL, &kt, "bench");
+    init_key_ctx_bi(&bc->rx.key_ctx_bi, &key2, KEY_DIRECTION_INVERSE, &kt, "bench");
+    if (bc->tx.key_ctx_bi.encrypt.mode == KEY_CTX_MODE_AEAD)
+    {
+        bench_crypto_set_implicit_iv(&bc->tx.key_ctx_bi.encrypt, key2.keys[0].hmac);
+        bench_crypto_set_implicit_iv(&bc->rx.key_ctx_bi.decrypt, key2.keys[0].hmac);
+    }
+    packet_id_init(&bc->tx.packet_id, DEFAULT_SEQ_BACKTRACK, DEFAULT_SEQ_BACKTRACK,
+                   DEFAULT_TIME_BACKTRACK, "bench", 0);
+    packet_id_init(&bc->rx.packet_id, DEFAULT_SEQ_BACKTRACK, DEFAULT_SEQ_BACKTRACK,
+                   DEFAULT_TIME_BACKTRACK, "bench", 1);
+
+    bc->frame.link_mtu = 1500;
+    bc->frame.link_mtu_dynamic = 1500;
+    crypto_adjust_frame_parameters(&bc->frame, &kt, true, false);
+    bc->packet = alloc_buf(BUF_SIZE(&bc->frame));
+    bc->encrypt_buf = alloc_buf(BUF_SIZE(&bc->frame));
+    bc->decrypt_buf = alloc_buf(BUF_SIZE(&bc->frame));
+    return bc;
+}
+
+static void *
+bench_crypto_setup_gcm(void)
+{
+    return bench_crypto_setup("AES-256-GCM", "none", PACKET_SIZE);
+}
+
+static void *
+bench_crypto_setup_gcm_small(void)
+{
+    return bench_crypto_setup("AES-256-GCM", "none", SMALL_PACKET_SIZE);
+}
+
+static void *
+bench_crypto_setup_cbc(void)
+{
+    return bench_crypto_setup("AES-256-CBC", "SHA1", PACKET_SIZE);
+}
+
+static void *
+bench_crypto_setup_cbc_small(void)
+{
+    return bench_crypto_setup("AES-256-CBC", "SHA1", SMALL_PACKET_SIZE);
+}
+
+static void
+bench_crypto_teardown(void *state)
+{
+    struct bench_crypto *bc = state;
+    free_key_ctx_bi(&bc->tx.key_ctx_bi);
+    free_key_ctx_bi(&bc->rx.key_ctx_bi);
+    packet_id_free(&bc->tx.packet_id);
+    packet_id_free(&bc->rx.packet_id);
+    free_buf(&bc->packet);
+    free_buf(&bc->encrypt_buf);
+    free_buf(&bc->decrypt_buf);
+    free(bc);
+}
+
+static void
+bench_crypto_roundtrip(void *state, unsigned long n)
+{
+    struct bench_crypto *bc = state;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct buffer buf;
+
+        ASSERT(buf_init(&bc->packet, FRAME_HEADROOM(&bc->frame)));
+        memset(BPTR(&bc->packet), (int) i, bc->len);
+        ASSERT(buf_inc_len(&bc->packet, bc->len));
+        ASSERT(buf_init(&bc->encrypt_buf, FRAME_HEADROOM(&bc->frame)));
+
+        buf = bc->packet;
+        openvpn_encrypt(&buf, bc->encrypt_buf, &bc->tx);
+        ASSERT(openvpn_decrypt(&buf, bc->decrypt_buf, &bc->rx, &bc->frame, BPTR(&buf)));
+        ASSERT(BLEN(&buf) == bc->len);
+    }
+}
+
+/*
+ * Key selection of tls_pre_decrypt() and tls_pre_encrypt()/
+ * tls_post_encrypt(): the key_state and tls_multi members they read and
+ * write for one received and one sent packet, for clients picked at
+ * random among more than fit in the cache.  The member order of both
+ * structures in ssl_common.h decides how many cache lines this touches.
+ */
+#define BENCH_KEY_SELECT_CLIENTS 8192
+
+struct bench_key_select {
+    struct tls_multi *multi[BENCH_KEY_SELECT_CLIENTS];
+    struct link_socket_actual from;
+    uint32_t rand;
+};
+
+static void *
+bench_key_select_setup(void)
+{
+    struct bench_key_select *bk;
+    int i;
+
+    ALLOC_OBJ_CLEAR(bk, struct bench_key_select);
+    bk->from.dest.addr.in4.sin_family = AF_INET;
+    bk->from.dest.addr.in4.sin_addr.s_addr = htonl(0x0a000001);
+    bk->from.dest.addr.in4.sin_port = htons(1194);
+    for (i = 0; i < BENCH_KEY_SELECT_CLIENTS; ++i)
+    {
+        struct tls_multi *multi;
+        struct key_state *ks;
+
+        /* like tls_multi_init() */
+        ALLOC_OBJ_CLEAR(multi, struct tls_multi);
+        multi->key_scan[0] = &multi->session[TM_ACTIVE].key[KS_PRIMARY];
+        multi->key_scan[1] = &multi->session[TM_ACTIVE].key[KS_LAME_DUCK];
+        multi->key_scan[2] = &multi->session[TM_LAME_DUCK].key[KS_LAME_DUCK];
+        multi->opt.server = true;
+        multi->peer_id = i;
+        multi->use_peer_id = true;
+
+        ks = multi->key_scan[0];
+        ks->state = S_ACTIVE;
+        ks->key_id = 1;
+        ks->authenticated = true;
+        ks->remote_addr = bk->from;
+        ks->crypto_options.key_ctx_bi.initialized = true;
+        bk->multi[i] = multi;
+    }
+    bk->rand = 1;
+    return bk;
+}
+
+static void
+bench_key_select_teardown(void *state)
+{
+    struct bench_key_select *bk = state;
+    int i;
+
+    for (i = 0; i < BENCH_KEY_SELECT_CLIENTS; ++i)
+    {
+        free(bk->multi[i]);
+    }
+    free(bk);
+}
+
+static void
+bench_key_select(void *state, unsigned long n)
+{
+    struct bench_key_select *bk = state;
+    unsigned long i;
+
+    for (i = 0; i < n; ++i)
+    {
+        struct tls_multi *multi;
+        struct key_state *ks_select = NULL;
+        int k;
+
+        bk->rand = bk->rand * 1103515245 + 12345;
+        multi = bk->multi[(bk->rand >> 8) % BENCH_KEY_SELECT_CLIENTS];
+
+        /* tls_pre_decrypt() for a packet with key id 1 */
+        for (k = 0; k < KEY_SCAN_SIZE; ++k)
+        {
+            struct key_state *ks = multi->key_scan[k];
+            if (ks->key_id == 1
+                && ks->state >= S_GOT_KEY - multi->opt.server
+                && ks->authenticated
+#ifdef ENABLE_DEF_AUTH
+                && !ks->auth_deferred
+#endif
+                && link_socket_actual_match(&bk->from, &ks->remote_addr))
+            {
+                ASSERT(ks->crypto_options.key_ctx_bi.initialized);
+                ++ks->n_packets;
+                ks->n_bytes += PACKET_SIZE;
+                break;
+            }
+        }
+        ASSERT(k < KEY_SCAN_SIZE);
+
+        /* tls_pre_encrypt() and tls_post_encrypt() */
+        for (k = 0; k < KEY_SCAN_SIZE; ++k)
+        {
+            struct key_state *ks = multi->key_scan[k];
+            if (ks->state >= S_ACTIVE
+                && ks->authenticated
+                && ks->crypto_options.key_ctx_bi.initialized
+#ifdef ENABLE_DEF_AUTH
+                && !ks->auth_deferred
+#endif
+                )
+            {
+                if (!ks_select)
+                {
+                    ks_select = ks;
+                }
+                if (now >= ks->auth_deferred_expire)
+                {
+                    ks_select = ks;
+                    break;
+                }
+            }
+        }
+        ASSERT(ks_select);
+        multi->save_ks = ks_select;
+        ++multi->save_ks->n_packets;
+        multi->save_ks->n_bytes += PACKET_SIZE;
+        bench_consume(multi->use_peer_id ? multi->peer_id : 0);
+    }
+}
+
+const struct bench_case bench_packet_cases[] = {
+    { "mroute_extract_ipv4", bench_mroute_setup_ipv4, bench_mroute_extract, bench_mroute_teardown },
+    { "mroute_extract_ipv6", bench_mroute_setup_ipv6, bench_mroute_extract, bench_mroute_teardown },
+    { "packet_id_in_order", bench_packet_id_setup, bench_packet_id_in_order, bench_packet_id_teardown },
+    { "packet_id_reordered", bench_packet_id_setup, bench_packet_id_reordered, bench_packet_id_teardown },
+    { "packet_id_reordered_wide", bench_packet_id_setup_wide, bench_packet_id_reordered, bench_packet_id_teardown },
+    { "reliable_send", bench_reliable_setup, bench_reliable_send, bench_reliable_teardown },
+    { "reliable_receive", bench_reliable_setup, bench_reliable_receive, bench_reliable_teardown },
+    { "fragment_roundtrip", bench_fragment_setup, bench_fragment_roundtrip, bench_fragment_teardown },
+    { "crypto_aes_gcm", bench_crypto_setup_gcm, bench_crypto_roundtrip, bench_crypto_teardown },
+    { "crypto_aes_gcm_small", bench_crypto_setup_gcm_small, bench_crypto_roundtrip, bench_crypto_teardown },
+    { "crypto_aes_cbc_sha1", bench_crypto_setup_cbc, bench_crypto_roundtrip, bench_crypto_teardown },
+    { "crypto_aes_cbc_sha1_small", bench_crypto_setup_cbc_small, bench_crypto_roundtrip, bench_crypto_teardown },
+    { "ssl_key_select", bench_key_select_setup, bench_key_select, bench_key_select_teardown },
+    { NULL }
+};
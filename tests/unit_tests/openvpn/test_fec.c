@@ -0,0 +1,352 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "fec.h"
+
+#include "mock_msg.h"
+
+#define N_PACKETS 32
+
+struct test_fec_context {
+    struct frame frame;
+    struct fec_master *tx;
+    struct fec_master *rx;
+    struct buffer work;
+    struct buffer sent[N_PACKETS];      /* what went in on the sending side */
+    struct buffer received[N_PACKETS];  /* what came out on the receiving side */
+    int n_received;
+};
+
+static int
+setup(void **state)
+{
+    struct test_fec_context *ctx = calloc(1, sizeof(*ctx));
+    int i;
+
+    ctx->frame.link_mtu = 1500;
+    ctx->frame.link_mtu_dynamic = 1500;
+    ctx->tx = fec_init(&ctx->frame, 4, 4);
+    ctx->rx = fec_init(&ctx->frame, 4, 4);
+    fec_frame_init(ctx->tx, &ctx->frame);
+    fec_frame_init(ctx->rx, &ctx->frame);
+    ctx->work = alloc_buf(BUF_SIZE(&ctx->frame));
+
+    for (i = 0; i < N_PACKETS; ++i)
+    {
+        /* lengths differ so that the padding is exercised */
+        const int len = 40 + (i * 97) % 1300;
+        int j;
+
+        ctx->sent[i] = alloc_buf(len);
+        for (j = 0; j < len; ++j)
+        {
+            buf_write_u8(&ctx->sent[i], (uint8_t) (i * 31 + j * 7));
+        }
+        ctx->received[i] = alloc_buf(BUF_SIZE(&ctx->frame));
+    }
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    struct test_fec_context *ctx = *state;
+    int i;
+
+    for (i = 0; i < N_PACKETS; ++i)
+    {
+        free_buf(&ctx->sent[i]);
+        free_buf(&ctx->received[i]);
+    }
+    free_buf(&ctx->work);
+    fec_free(ctx->tx);
+    fec_free(ctx->rx);
+    free(ctx);
+    return 0;
+}
+
+/* give a packet to the receiving side and record what it delivers */
+static void
+receive(struct test_fec_context *ctx, struct buffer *buf)
+{
+    struct buffer rec;
+
+    fec_incoming(ctx->rx, buf);
+    if (BLEN(buf))
+    {
+        assert_true(ctx->n_received < N_PACKETS);
+        assert_true(buf_copy(&ctx->received[ctx->n_received++], buf));
+    }
+
+    while (fec_recovered_ready(ctx->rx, &rec))
+    {
+        fec_incoming(ctx->rx, &rec);
+        assert_true(BLEN(&rec) > 0);
+        assert_true(ctx->n_received < N_PACKETS);
+        assert_true(buf_copy(&ctx->received[ctx->n_received++], &rec));
+    }
+}
+
+/*
+ * Send n packets.  Data packet i is lost if bit i of data_loss is set,
+ * parity packets are lost according to parity_loss, one bit per parity
+ * packet in the order they are sent.
+ */
+static void
+transfer(struct test_fec_context *ctx, int n, unsigned int data_loss,
+         unsigned int parity_loss)
+{
+    int i, parity = 0;
+    struct buffer buf;
+
+    for (i = 0; i < n; ++i)
+    {
+        ASSERT(buf_init(&ctx->work, FRAME_HEADROOM(&ctx->frame)));
+        ASSERT(buf_copy(&ctx->work, &ctx->sent[i]));
+        fec_outgoing(ctx->tx, &ctx->work);
+        if (!(data_loss & (1u << i)))
+        {
+            receive(ctx, &ctx->work);
+        }
+
+        while (fec_parity_ready(ctx->tx, &buf))
+        {
+            if (!(parity_loss & (1u << parity)))
+            {
+                receive(ctx, &buf);
+            }
+            ++parity;
+        }
+    }
+}
+
+/* every packet that was sent was delivered, in any order */
+static void
+assert_all_delivered(struct test_fec_context *ctx, int n)
+{
+    int i, j;
+
+    assert_int_equal(ctx->n_received, n);
+    for (i = 0; i < n; ++i)
+    {
+        bool found = false;
+        for (j = 0; j < ctx->n_received && !found; ++j)
+        {
+            found = BLEN(&ctx->received[j]) == BLEN(&ctx->sent[i])
+                    && !memcmp(BPTR(&ctx->received[j]), BPTR(&ctx->sent[i]),
+                               BLEN(&ctx->sent[i]));
+        }
+        assert_true(found);
+    }
+}
+
+static void
+fec_gf_arithmetic(void **state)
+{
+    uint8_t src[67], dst[67], expect[67];
+    int a, b, c, len;
+
+    fec_gf_init();
+
+    for (a = 0; a < 256; ++a)
+    {
+        int inverses = 0;
+
+        assert_int_equal(fec_gf_mul(a, 0), 0);
+        assert_int_equal(fec_gf_mul(a, 1), a);
+        for (b = 1; b < 256; ++b)
+        {
+            assert_int_equal(fec_gf_mul(a, b), fec_gf_mul(b, a));
+            inverses += fec_gf_mul(a, b) == 1;
+        }
+        assert_int_equal(inverses, a ? 1 : 0);
+    }
+
+    /* x^8 = x^4 + x^3 + x^2 + 1 */
+    assert_int_equal(fec_gf_mul(0x80, 0x02), 0x1d);
+
+    /* the vectorized region multiply matches the scalar one */
+    for (len = 0; len <= (int) sizeof(src); ++len)
+    {
+        for (c = 0; c < 256; c += 7)
+        {
+            int i;
+            for (i = 0; i < len; ++i)
+            {
+                src[i] = (uint8_t) (i * 13 + c);
+                dst[i] = (uint8_t) (i * 5);
+                expect[i] = dst[i] ^ fec_gf_mul(c, src[i]);
+            }
+            fec_gf_mul_add(dst, src, c, len);
+            assert_memory_equal(dst, expect, len);
+        }
+    }
+}
+
+static void
+fec_no_loss(void **state)
+{
+    struct test_fec_context *ctx = *state;
+
+    transfer(ctx, 8, 0, 0);
+    assert_all_delivered(ctx, 8);
+    assert_int_equal(ctx->tx->n_data_sent, 8);
+    assert_int_equal(ctx->tx->n_parity_sent, 2);
+    assert_int_equal(ctx->rx->n_recovered, 0);
+}
+
+static void
+fec_recover_single(void **state)
+{
+    struct test_fec_context *ctx = *state;
+
+    /* one packet lost in each of the first three blocks */
+    transfer(ctx, 12, (1 << 0) | (1 << 6) | (1 << 11), 0);
+    assert_all_delivered(ctx, 12);
+    assert_int_equal(ctx->rx->n_recovered, 3);
+}
+
+static void
+fec_recover_multiple(void **state)
+{
+    struct test_fec_context *ctx = *state;
+
+    /* the peer reports heavy loss, so blocks get all 4 parity packets */
+    ctx->tx->peer_loss = 50;
+
+    /* lose 3 of 4 data packets and one parity packet */
+    transfer(ctx, 4, (1 << 0) | (1 << 1) | (1 << 3), 1 << 2);
+    assert_int_equal(ctx->tx->n_parity_sent, 4);
+    assert_all_delivered(ctx, 4);
+    assert_int_equal(ctx->rx->n_recovered, 3);
+}
+
+static void
+fec_late_original(void **state)
+{
+    struct test_fec_context *ctx = *state;
+    struct buffer late = alloc_buf(BUF_SIZE(&ctx->frame));
+    struct buffer buf;
+    int i;
+
+    /* packet 1 is delayed past the parity of its block */
+    for (i = 0; i < 4; ++i)
+    {
+        ASSERT(buf_init(&ctx->work, FRAME_HEADROOM(&ctx->frame)));
+        ASSERT(buf_copy(&ctx->work, &ctx->sent[i]));
+        fec_outgoing(ctx->tx, &ctx->work);
+        if (i == 1)
+        {
+            ASSERT(buf_init(&late, FRAME_HEADROOM(&ctx->frame)));
+            ASSERT(buf_copy(&late, &ctx->work));
+        }
+        else
+        {
+            receive(ctx, &ctx->work);
+        }
+    }
+    while (fec_parity_ready(ctx->tx, &buf))
+    {
+        receive(ctx, &buf);
+    }
+    assert_all_delivered(ctx, 4);
+    assert_int_equal(ctx->rx->n_recovered, 1);
+
+    /* it was recovered from parity, so it is not delivered again */
+    receive(ctx, &late);
+    assert_int_equal(ctx->n_received, 4);
+
+    free_buf(&late);
+}
+
+static void
+fec_too_much_loss(void **state)
+{
+    struct test_fec_context *ctx = *state;
+
+    /* two packets lost but only one parity packet */
+    transfer(ctx, 4, (1 << 1) | (1 << 2), 0);
+    assert_int_equal(ctx->n_received, 2);
+    assert_int_equal(ctx->rx->n_recovered, 0);
+
+    /* further blocks push the damaged one out of the window */
+    transfer(ctx, 4 * (FEC_N_BLOCKS + 1), 0, 0);
+    assert_int_equal(ctx->rx->n_unrecovered, 2);
+    assert_true(ctx->rx->rx_loss > 0);
+}
+
+static void
+fec_flush(void **state)
+{
+    struct test_fec_context *ctx = *state;
+    struct timeval tv = { BIG_TIMEOUT, 0 };
+    struct buffer buf;
+
+    /* a lone packet waits for more */
+    transfer(ctx, 1, 1, 0);
+    fec_housekeeping(ctx->tx, &tv);
+    assert_false(fec_parity_ready(ctx->tx, &buf));
+    assert_int_equal(tv.tv_sec, 0);
+    assert_true(tv.tv_usec > 0 && tv.tv_usec <= FEC_FLUSH_USEC);
+
+    /* until it has waited too long, then its parity is sent */
+    ctx->tx->tx_start.tv_sec -= 1;
+    fec_housekeeping(ctx->tx, &tv);
+    assert_true(fec_parity_ready(ctx->tx, &buf));
+    receive(ctx, &buf);
+    assert_all_delivered(ctx, 1);
+    assert_int_equal(ctx->rx->n_recovered, 1);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(fec_gf_arithmetic),
+        cmocka_unit_test_setup_teardown(fec_no_loss, setup, teardown),
+        cmocka_unit_test_setup_teardown(fec_recover_single, setup, teardown),
+        cmocka_unit_test_setup_teardown(fec_recover_multiple, setup, teardown),
+        cmocka_unit_test_setup_teardown(fec_late_original, setup, teardown),
+        cmocka_unit_test_setup_teardown(fec_too_much_loss, setup, teardown),
+        cmocka_unit_test_setup_teardown(fec_flush, setup, teardown),
+    };
+
+    return cmocka_run_group_tests_name("fec tests", tests, NULL, NULL);
+}
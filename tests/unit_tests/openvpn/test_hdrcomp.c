@@ -0,0 +1,375 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "hdrcomp.h"
+
+#include "mock_msg.h"
+
+#define PAYLOAD 160     /* 20 ms of G.711 */
+
+struct test_hc_context {
+    struct frame frame;
+    struct hc_context *tx;
+    struct hc_context *rx;
+    struct buffer sent;
+    struct buffer work;
+    struct buffer out;          /* what the receiving side got */
+};
+
+/* what a packet of the test flow looks like */
+struct test_packet {
+    bool v6;
+    bool rtp;
+    uint16_t sn;
+    uint32_t ts;
+    uint16_t ipid;
+    uint8_t ttl;
+    uint16_t csum;
+};
+
+static int
+setup(void **state)
+{
+    struct test_hc_context *ctx = calloc(1, sizeof(*ctx));
+
+    ctx->frame.link_mtu = 1500;
+    ctx->frame.link_mtu_dynamic = 1500;
+    ctx->frame.extra_frame = 100;
+    ctx->frame.extra_buffer = 100;
+    ctx->tx = hc_init(4, &ctx->frame);
+    ctx->rx = hc_init(4, &ctx->frame);
+    ctx->sent = alloc_buf(BUF_SIZE(&ctx->frame));
+    ctx->work = alloc_buf(BUF_SIZE(&ctx->frame));
+    now = 1000000;
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    struct test_hc_context *ctx = *state;
+
+    free_buf(&ctx->sent);
+    free_buf(&ctx->work);
+    hc_free(ctx->tx);
+    hc_free(ctx->rx);
+    free(ctx);
+    return 0;
+}
+
+static void
+write_packet(struct buffer *buf, const struct test_packet *pkt)
+{
+    const int udp_len = 8 + (pkt->rtp ? 12 : 0) + PAYLOAD;
+    int i;
+
+    if (pkt->v6)
+    {
+        const uint8_t ip[8] = { 0x60, 0, 0, 0, udp_len >> 8, udp_len, 17, pkt->ttl };
+        buf_write(buf, ip, sizeof(ip));
+        for (i = 0; i < 32; ++i)
+        {
+            buf_write_u8(buf, i < 16 ? 0x20 : i);
+        }
+    }
+    else
+    {
+        uint8_t ip[20] = { 0x45, 0xb8, 0, 20 + udp_len, pkt->ipid >> 8, pkt->ipid,
+                           0x40, 0, pkt->ttl, 17, 0, 0, 10, 8, 0, 2, 10, 8, 0, 1 };
+        uint32_t sum = 0;
+        for (i = 0; i < 20; i += 2)
+        {
+            sum += (ip[i] << 8) | ip[i + 1];
+        }
+        sum = (sum & 0xffff) + (sum >> 16);
+        ip[10] = ~sum >> 8;
+        ip[11] = ~sum;
+        buf_write(buf, ip, sizeof(ip));
+    }
+
+    buf_write_u16(buf, 4000);
+    buf_write_u16(buf, 5004);
+    buf_write_u16(buf, udp_len);
+    buf_write_u16(buf, pkt->csum);
+    if (pkt->rtp)
+    {
+        buf_write_u8(buf, 0x80);
+        buf_write_u8(buf, 0);   /* PCMU */
+        buf_write_u16(buf, pkt->sn);
+        buf_write_u32(buf, pkt->ts);
+        buf_write_u32(buf, 0x12345678);
+    }
+    for (i = 0; i < PAYLOAD; ++i)
+    {
+        buf_write_u8(buf, pkt->sn + i);
+    }
+}
+
+/*
+ * Compress the next packet of the flow, and if it is not lost check
+ * that it decompresses to what was sent.  Returns the compressed length.
+ */
+static int
+transfer(struct test_hc_context *ctx, struct test_packet *pkt, bool lost)
+{
+    struct buffer buf = ctx->work;
+    int len;
+
+    ASSERT(buf_init(&ctx->sent, 0));
+    write_packet(&ctx->sent, pkt);
+    ASSERT(buf_init(&buf, FRAME_HEADROOM(&ctx->frame)));
+    ASSERT(buf_copy(&buf, &ctx->sent));
+
+    hc_compress(ctx->tx, &buf, &ctx->frame);
+    len = BLEN(&buf);
+    if (!lost)
+    {
+        /* the decompressor may point buf to its own buffer */
+        hc_decompress(ctx->rx, &buf, &ctx->frame);
+        if (BLEN(&buf))
+        {
+            assert_int_equal(BLEN(&buf), BLEN(&ctx->sent));
+            assert_memory_equal(BPTR(&buf), BPTR(&ctx->sent), BLEN(&ctx->sent));
+        }
+        ctx->out = buf;
+    }
+
+    pkt->sn++;
+    pkt->ts += PAYLOAD;
+    pkt->ipid++;
+    return len;
+}
+
+static void
+hc_rtp_ipv4(void **state)
+{
+    struct test_hc_context *ctx = *state;
+    struct test_packet pkt = { .rtp = true, .sn = 65500, .ts = 1000, .ipid = 77, .ttl = 64 };
+    int i;
+
+    /* full headers first, with the two bytes of the context id */
+    for (i = 0; i < HC_REPEAT; ++i)
+    {
+        assert_int_equal(transfer(ctx, &pkt, false), HC_IR_LEN + 40 + PAYLOAD);
+    }
+
+    /* the timestamp stride, until the peer surely knows it */
+    for (i = 0; i < HC_REPEAT; ++i)
+    {
+        assert_int_equal(transfer(ctx, &pkt, false), 5 + 6 + PAYLOAD);
+    }
+
+    /* then the sequence number and the CRC, across the wrap around */
+    for (i = 0; i < 100; ++i)
+    {
+        assert_int_equal(transfer(ctx, &pkt, false), 5 + PAYLOAD);
+    }
+    assert_int_equal(ctx->tx->n_co, HC_REPEAT + 100);
+    assert_int_equal(ctx->rx->n_failed, 0);
+
+    /* a jump of the timestamp is sent until it is known to be there */
+    pkt.ts += 8000;
+    for (i = 0; i < HC_REPEAT; ++i)
+    {
+        assert_int_equal(transfer(ctx, &pkt, false), 5 + 6 + PAYLOAD);
+    }
+    assert_int_equal(transfer(ctx, &pkt, false), 5 + PAYLOAD);
+}
+
+static void
+hc_udp_ipv6(void **state)
+{
+    struct test_hc_context *ctx = *state;
+    struct test_packet pkt = { .v6 = true, .ttl = 64, .csum = 0xbeef };
+    int i;
+
+    for (i = 0; i < HC_REPEAT; ++i)
+    {
+        assert_int_equal(transfer(ctx, &pkt, false), HC_IR_LEN + 48 + PAYLOAD);
+    }
+    for (i = 0; i < 10; ++i)
+    {
+        /* the checksum is sent, it is not zero */
+        pkt.csum += 3;
+        assert_int_equal(transfer(ctx, &pkt, false), 5 + 2 + PAYLOAD);
+    }
+    assert_int_equal(ctx->rx->n_failed, 0);
+}
+
+static void
+hc_ipid_jitter(void **state)
+{
+    struct test_hc_context *ctx = *state;
+    struct test_packet pkt = { .rtp = true, .ipid = 65000, .ttl = 64 };
+    int i;
+
+    for (i = 0; i < 2 * HC_REPEAT; ++i)
+    {
+        transfer(ctx, &pkt, false);
+    }
+
+    /* an id that grows by more than one costs a byte, across the wrap
+     * around, a jump two */
+    for (i = 1; i < 100; ++i)
+    {
+        pkt.ipid += i % 7;
+        assert_int_equal(transfer(ctx, &pkt, i % 5 == 1), 5 + 1 + PAYLOAD);
+    }
+    pkt.ipid += 1000;
+    assert_int_equal(transfer(ctx, &pkt, false), 5 + 2 + PAYLOAD);
+    assert_int_equal(BLEN(&ctx->out), BLEN(&ctx->sent));
+    assert_int_equal(ctx->rx->n_failed, 0);
+}
+
+static void
+hc_loss(void **state)
+{
+    struct test_hc_context *ctx = *state;
+    struct test_packet pkt = { .rtp = true, .sn = 10, .ipid = 1, .ttl = 64 };
+    int i;
+
+    for (i = 0; i < 20; ++i)
+    {
+        transfer(ctx, &pkt, false);
+    }
+
+    /* a burst of 50 lost packets is within the 8 bit window */
+    for (i = 0; i < 50; ++i)
+    {
+        transfer(ctx, &pkt, true);
+    }
+    transfer(ctx, &pkt, false);
+    assert_int_equal(BLEN(&ctx->out), BLEN(&ctx->sent));
+
+    /* a change in the TTL survives losing all but its last repetition */
+    pkt.ttl = 63;
+    transfer(ctx, &pkt, true);
+    transfer(ctx, &pkt, true);
+    transfer(ctx, &pkt, false);
+    transfer(ctx, &pkt, false);
+    assert_int_equal(BLEN(&ctx->out), BLEN(&ctx->sent));
+    assert_int_equal(ctx->rx->n_failed, 0);
+}
+
+static void
+hc_resync_after_loss(void **state)
+{
+    struct test_hc_context *ctx = *state;
+    struct test_packet pkt = { .rtp = true, .sn = 10, .ipid = 1, .ttl = 64 };
+    struct gc_arena gc = gc_new();
+    struct buffer msg = alloc_buf_gc(32, &gc);
+    int i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        transfer(ctx, &pkt, false);
+    }
+
+    /* every repetition of a change is lost, the CRC catches it */
+    pkt.ttl = 1;
+    for (i = 0; i < HC_REPEAT; ++i)
+    {
+        transfer(ctx, &pkt, true);
+    }
+    transfer(ctx, &pkt, false);
+    assert_int_equal(BLEN(&ctx->out), 0);
+    assert_int_equal(ctx->rx->n_failed, 1);
+
+    /* the receiver asks for full headers, once */
+    assert_true(hc_resync_request(ctx->rx, &msg));
+    assert_true(buf_string_match_head_str(&msg, "HC_RESYNC,"));
+    transfer(ctx, &pkt, false);
+    assert_false(hc_resync_request(ctx->rx, &msg));
+
+    buf_null_terminate(&msg);
+    hc_resync(ctx->tx, &msg);
+    for (i = 0; i < HC_REPEAT; ++i)
+    {
+        assert_int_equal(transfer(ctx, &pkt, false), HC_IR_LEN + 40 + PAYLOAD);
+        assert_int_equal(BLEN(&ctx->out), BLEN(&ctx->sent));
+    }
+    transfer(ctx, &pkt, false);
+    assert_int_equal(BLEN(&ctx->out), BLEN(&ctx->sent));
+
+    gc_free(&gc);
+}
+
+static void
+hc_not_compressed(void **state)
+{
+    struct test_hc_context *ctx = *state;
+    struct test_packet pkt = { .rtp = true, .ttl = 64 };
+    uint8_t tcp[40] = { 0x45, 0, 0, 40, 0, 0, 0x40, 0, 64, 6 };
+    struct buffer buf = ctx->work;
+
+    /* TCP */
+    ASSERT(buf_init(&buf, FRAME_HEADROOM(&ctx->frame)));
+    buf_write(&buf, tcp, sizeof(tcp));
+    hc_compress(ctx->tx, &buf, &ctx->frame);
+    assert_int_equal(BLEN(&buf), sizeof(tcp));
+    assert_memory_equal(BPTR(&buf), tcp, sizeof(tcp));
+
+    /* IP fragments */
+    ASSERT(buf_init(&buf, FRAME_HEADROOM(&ctx->frame)));
+    write_packet(&buf, &pkt);
+    BPTR(&buf)[6] = 0x20; /* more fragments */
+    hc_compress(ctx->tx, &buf, &ctx->frame);
+    assert_int_equal(BLEN(&buf), 40 + PAYLOAD);
+
+    /* and the decompressor leaves plain packets alone */
+    hc_decompress(ctx->rx, &buf, &ctx->frame);
+    assert_int_equal(BLEN(&buf), 40 + PAYLOAD);
+    assert_int_equal(ctx->tx->n_ir + ctx->tx->n_co, 0);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(hc_rtp_ipv4, setup, teardown),
+        cmocka_unit_test_setup_teardown(hc_udp_ipv6, setup, teardown),
+        cmocka_unit_test_setup_teardown(hc_ipid_jitter, setup, teardown),
+        cmocka_unit_test_setup_teardown(hc_loss, setup, teardown),
+        cmocka_unit_test_setup_teardown(hc_resync_after_loss, setup, teardown),
+        cmocka_unit_test_setup_teardown(hc_not_compressed, setup, teardown),
+    };
+
+    return cmocka_run_group_tests_name("hdrcomp tests", tests, NULL, NULL);
+}
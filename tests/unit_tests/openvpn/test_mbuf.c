@@ -0,0 +1,268 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "mbuf.h"
+
+#include "mock_instance.h"
+#include "mock_msg.h"
+
+/* queue a packet of len bytes, its first byte is tag */
+static void
+queue_packet(struct mbuf_set *ms, int prio, int len, uint8_t tag, int inst)
+{
+    struct buffer buf = alloc_buf(len);
+    struct mbuf_item item;
+
+    memset(BPTR(&buf), 0, len);
+    *BPTR(&buf) = tag;
+    ASSERT(buf_inc_len(&buf, len));
+
+    item.buffer = mbuf_alloc_buf(NULL, &buf);
+    item.buffer->prio = prio;
+    item.instance = mock_instance(inst);
+    mbuf_add_item(ms, &item);
+    mbuf_free_buf(item.buffer);
+    free_buf(&buf);
+}
+
+/* dequeue a packet and return its tag, or -1 if the set is empty */
+static int
+extract_tag(struct mbuf_set *ms)
+{
+    struct mbuf_item item;
+    int tag;
+
+    if (!mbuf_extract_item(ms, &item))
+    {
+        return -1;
+    }
+    tag = *BPTR(&item.buffer->buf);
+    mbuf_free_buf(item.buffer);
+    return tag;
+}
+
+static void
+mbuf_fifo_within_class(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(16, 0);
+    int i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        queue_packet(ms, MBUF_CLASS_DEFAULT, 100 + i * 200, i, 0);
+    }
+    assert_int_equal(mbuf_len(ms), 10);
+    for (i = 0; i < 10; ++i)
+    {
+        assert_int_equal(extract_tag(ms), i);
+    }
+    assert_int_equal(extract_tag(ms), -1);
+    assert_false(mbuf_defined(ms));
+
+    mbuf_free(ms);
+}
+
+static void
+mbuf_realtime_first(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(16, 0);
+
+    queue_packet(ms, MBUF_CLASS_BULK, 1400, 1, 0);
+    queue_packet(ms, MBUF_CLASS_DEFAULT, 1400, 2, 0);
+    queue_packet(ms, MBUF_CLASS_REALTIME, 200, 3, 0);
+    queue_packet(ms, MBUF_CLASS_INTERACTIVE, 1400, 4, 0);
+    queue_packet(ms, MBUF_CLASS_REALTIME, 200, 5, 0);
+
+    assert_int_equal(extract_tag(ms), 3);
+    assert_int_equal(extract_tag(ms), 5);
+    assert_int_equal(extract_tag(ms), 4);
+    assert_int_equal(extract_tag(ms), 2);
+    assert_int_equal(extract_tag(ms), 1);
+
+    mbuf_free(ms);
+}
+
+static void
+mbuf_drr_share(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(512, 0);
+    int count[MBUF_N_CLASSES] = { 0 };
+    int i;
+
+    for (i = 0; i < 100; ++i)
+    {
+        queue_packet(ms, MBUF_CLASS_INTERACTIVE, 1000, MBUF_CLASS_INTERACTIVE, 0);
+        queue_packet(ms, MBUF_CLASS_DEFAULT, 1000, MBUF_CLASS_DEFAULT, 0);
+        queue_packet(ms, MBUF_CLASS_BULK, 1000, MBUF_CLASS_BULK, 0);
+    }
+
+    /* while all classes are backlogged they share by weight 4:2:1 */
+    for (i = 0; i < 70; ++i)
+    {
+        ++count[extract_tag(ms)];
+    }
+    assert_in_range(count[MBUF_CLASS_INTERACTIVE], 36, 44);
+    assert_in_range(count[MBUF_CLASS_DEFAULT], 17, 23);
+    assert_in_range(count[MBUF_CLASS_BULK], 7, 13);
+
+    /* nothing is starved or lost */
+    while ((i = extract_tag(ms)) >= 0)
+    {
+        ++count[i];
+    }
+    assert_int_equal(count[MBUF_CLASS_INTERACTIVE], 100);
+    assert_int_equal(count[MBUF_CLASS_DEFAULT], 100);
+    assert_int_equal(count[MBUF_CLASS_BULK], 100);
+
+    mbuf_free(ms);
+}
+
+static void
+mbuf_peek_matches_extract(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(64, 0);
+    struct mbuf_item item;
+    int i;
+
+    for (i = 0; i < 30; ++i)
+    {
+        queue_packet(ms, 1 + i % 3, 300 + 50 * i, i, i);
+    }
+    queue_packet(ms, MBUF_CLASS_REALTIME, 100, 99, 99);
+
+    while (mbuf_defined(ms))
+    {
+        struct multi_instance *mi = mbuf_peek(ms);
+        assert_true(mbuf_extract_item(ms, &item));
+        assert_ptr_equal(mi, item.instance);
+        mbuf_free_buf(item.buffer);
+    }
+
+    mbuf_free(ms);
+}
+
+static void
+mbuf_full_drops_lowest_class(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(4, 0);
+    int i;
+
+    for (i = 0; i < 4; ++i)
+    {
+        queue_packet(ms, MBUF_CLASS_DEFAULT, 100, i, 0);
+    }
+
+    /* a less important packet is dropped itself */
+    queue_packet(ms, MBUF_CLASS_BULK, 100, 10, 0);
+    assert_int_equal(mbuf_len(ms), 4);
+    assert_int_equal(ms->classes[MBUF_CLASS_BULK].stats.dropped, 1);
+
+    /* a more important one replaces the oldest default packet */
+    queue_packet(ms, MBUF_CLASS_REALTIME, 100, 11, 0);
+    assert_int_equal(mbuf_len(ms), 4);
+    assert_int_equal(ms->classes[MBUF_CLASS_DEFAULT].stats.dropped, 1);
+
+    assert_int_equal(extract_tag(ms), 11);
+    assert_int_equal(extract_tag(ms), 1);
+    assert_int_equal(extract_tag(ms), 2);
+    assert_int_equal(extract_tag(ms), 3);
+    assert_int_equal(extract_tag(ms), -1);
+
+    mbuf_free(ms);
+}
+
+static void
+mbuf_full_of_closed_instance(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(2, 0);
+    int c;
+
+    queue_packet(ms, MBUF_CLASS_REALTIME, 100, 1, 1);
+    queue_packet(ms, MBUF_CLASS_DEFAULT, 100, 2, 1);
+    mbuf_dereference_instance(ms, mock_instance(1));
+
+    /* the packets of the closed instance make room, nothing is dropped */
+    queue_packet(ms, MBUF_CLASS_BULK, 100, 3, 2);
+    assert_int_equal(mbuf_len(ms), 1);
+    for (c = 0; c < MBUF_N_CLASSES; ++c)
+    {
+        assert_int_equal(ms->classes[c].stats.dropped, 0);
+    }
+    assert_int_equal(extract_tag(ms), 3);
+    assert_int_equal(extract_tag(ms), -1);
+
+    mbuf_free(ms);
+}
+
+static void
+mbuf_dereferenced_instance_skipped(void **state)
+{
+    struct mbuf_set *ms = mbuf_init(16, MBUF_STATS);
+
+    queue_packet(ms, MBUF_CLASS_REALTIME, 100, 1, 1);
+    queue_packet(ms, MBUF_CLASS_REALTIME, 100, 2, 2);
+    queue_packet(ms, MBUF_CLASS_DEFAULT, 100, 3, 1);
+    queue_packet(ms, MBUF_CLASS_DEFAULT, 100, 4, 2);
+
+    mbuf_dereference_instance(ms, mock_instance(1));
+    assert_ptr_equal(mbuf_peek(ms), mock_instance(2));
+    assert_int_equal(extract_tag(ms), 2);
+    assert_int_equal(extract_tag(ms), 4);
+    assert_int_equal(extract_tag(ms), -1);
+
+    assert_int_equal(ms->classes[MBUF_CLASS_REALTIME].stats.packets, 1);
+    assert_int_equal(ms->classes[MBUF_CLASS_DEFAULT].stats.packets, 1);
+
+    mbuf_free(ms);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(mbuf_fifo_within_class),
+        cmocka_unit_test(mbuf_realtime_first),
+        cmocka_unit_test(mbuf_drr_share),
+        cmocka_unit_test(mbuf_peek_matches_extract),
+        cmocka_unit_test(mbuf_full_drops_lowest_class),
+        cmocka_unit_test(mbuf_full_of_closed_instance),
+        cmocka_unit_test(mbuf_dereferenced_instance_skipped),
+    };
+
+    return cmocka_run_group_tests_name("mbuf tests", tests, NULL, NULL);
+}
@@ -0,0 +1,273 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "mpath.h"
+
+#include "mock_msg.h"
+
+#if ENABLE_IP_PKTINFO
+
+/*
+ * The tests set up the paths themselves, so mpath_new() never resolves
+ * anything, and the addresses are only printed in log messages.
+ */
+int
+openvpn_getaddrinfo(unsigned int flags, const char *hostname,
+                    const char *servname, int resolve_retry_seconds,
+                    volatile int *signal_received, int ai_family,
+                    struct addrinfo **res)
+{
+    return EAI_FAIL;
+}
+
+const char *
+print_link_socket_actual(const struct link_socket_actual *act,
+                         struct gc_arena *gc)
+{
+    return "[address]";
+}
+
+static void
+test_addr(struct link_socket_actual *act, int host)
+{
+    CLEAR(*act);
+    act->dest.addr.in4.sin_family = AF_INET;
+    act->dest.addr.in4.sin_addr.s_addr = htonl(0x0a000000 + host);
+    act->dest.addr.in4.sin_port = htons(1194);
+}
+
+/*
+ * Path 0 is the regular connection to 10.0.0.1, path i the one to
+ * 10.0.0.(i + 1).
+ */
+static void
+test_mpath_init(struct mpath *m, struct link_socket_actual *primary, int n)
+{
+    int i;
+
+    CLEAR(*m);
+    test_addr(primary, 1);
+    m->primary = primary;
+    m->n = n;
+    for (i = 0; i < n; ++i)
+    {
+        if (i)
+        {
+            test_addr(&m->paths[i].remote, i + 1);
+        }
+        m->paths[i].weight = MPATH_DEFAULT_WEIGHT;
+        m->paths[i].up = true;
+    }
+}
+
+static int
+test_path_of(const struct mpath *m, const struct link_socket_actual *to)
+{
+    int i;
+
+    for (i = 0; i < m->n; ++i)
+    {
+        if (to == (i ? &m->paths[i].remote : m->primary))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void
+mpath_select_weights(void **state)
+{
+    struct link_socket_actual primary;
+    struct mpath m;
+    int i, last = -1, repeats = 0;
+
+    test_mpath_init(&m, &primary, 3);
+    m.paths[1].weight = 30;
+    m.paths[2].up = false;
+
+    /* paths get their share of the packets, down ones none */
+    for (i = 0; i < 400; ++i)
+    {
+        const int path = test_path_of(&m, mpath_select(&m, 100));
+
+        /* smooth: the lighter path is never skipped for long */
+        repeats = path == last ? repeats + 1 : 0;
+        assert_true(repeats < 3);
+        last = path;
+    }
+    assert_int_equal(m.paths[0].tx_packets, 100);
+    assert_int_equal(m.paths[1].tx_packets, 300);
+    assert_int_equal(m.paths[1].tx_bytes, 30000);
+    assert_int_equal(m.paths[2].tx_packets, 0);
+
+    /* losing packets costs a path its share */
+    m.paths[1].loss = 900;
+    for (i = 0; i < 130; ++i)
+    {
+        mpath_select(&m, 100);
+    }
+    assert_int_equal(m.paths[0].tx_packets, 200);
+    assert_int_equal(m.paths[1].tx_packets, 330);
+}
+
+static void
+mpath_select_fallback(void **state)
+{
+    struct link_socket_actual primary;
+    struct mpath m;
+
+    test_mpath_init(&m, &primary, 2);
+    m.paths[1].up = false;
+
+    /* the regular connection is not used before its peer is known */
+    CLEAR(primary);
+    assert_ptr_equal(mpath_select(&m, 100), &primary);
+    assert_int_equal(m.paths[0].tx_packets, 1);
+    assert_int_equal(m.paths[0].current, 0);
+
+    /* a pinned packet goes where it is pinned to, once */
+    m.paths[1].up = true;
+    m.pinned = m.primary;
+    assert_ptr_equal(mpath_select(&m, 100), &primary);
+    assert_null(m.pinned);
+    assert_ptr_equal(mpath_select(&m, 100), &m.paths[1].remote);
+}
+
+static void
+mpath_probe_reply(void **state)
+{
+    struct link_socket_actual primary, peer_primary, from;
+    struct mpath m, peer;
+    struct buffer buf = alloc_buf(100);
+
+    test_mpath_init(&m, &primary, 2);
+    test_mpath_init(&peer, &peer_primary, 2);
+    m.paths[1].up = false;
+    m.paths[1].loss = 800;
+    update_time();
+
+    /* the probe is pinned to the path it probes */
+    m.probes_due = 1u << 1;
+    assert_true(mpath_next_msg(&m, &buf));
+    assert_true(is_mpath_msg(&buf));
+    assert_ptr_equal(mpath_select(&m, BLEN(&buf)), &m.paths[1].remote);
+    assert_true(m.paths[1].probe_pending);
+    assert_false(mpath_next_msg(&m, &buf));
+
+    /* the peer answers where the probe came from */
+    test_addr(&from, 42);
+    mpath_process_msg(&peer, &buf, &from);
+    buf_clear(&buf);
+    assert_true(mpath_next_msg(&peer, &buf));
+    assert_true(is_mpath_msg(&buf));
+    assert_ptr_equal(mpath_select(&peer, BLEN(&buf)), &peer.reply_to);
+    assert_true(addr_port_match(&peer.reply_to.dest, &from.dest));
+    assert_int_equal(peer.paths[0].tx_packets + peer.paths[1].tx_packets, 0);
+
+    /* the answer brings the path up */
+    mpath_process_msg(&m, &buf, &m.paths[1].remote);
+    assert_true(m.paths[1].up);
+    assert_false(m.paths[1].probe_pending);
+    assert_int_equal(m.paths[1].unanswered, 0);
+    assert_int_equal(m.paths[1].loss, 700);
+
+    /* an answer to no pending probe is ignored */
+    m.paths[1].srtt = 12345;
+    mpath_process_msg(&m, &buf, &m.paths[1].remote);
+    assert_int_equal(m.paths[1].srtt, 12345);
+    assert_int_equal(m.paths[1].loss, 700);
+
+    free_buf(&buf);
+}
+
+static void
+mpath_probe_stale(void **state)
+{
+    struct link_socket_actual primary;
+    struct mpath m;
+    struct buffer buf = alloc_buf(100);
+    struct buffer stale;
+
+    test_mpath_init(&m, &primary, 2);
+    m.paths[1].up = false;
+    update_time();
+
+    /* an answer to an earlier probe does not count for the current one */
+    m.probes_due = 1u << 1;
+    assert_true(mpath_next_msg(&m, &buf));
+    stale = clone_buf(&buf);
+    m.probes_due = 1u << 1;
+    buf_clear(&buf);
+    assert_true(mpath_next_msg(&m, &buf));
+
+    /* our own probe stands in for the answer, the type follows the
+     * 16 byte magic */
+    BPTR(&stale)[16] = 1;
+    mpath_process_msg(&m, &stale, &m.paths[1].remote);
+    assert_false(m.paths[1].up);
+    assert_true(m.paths[1].probe_pending);
+
+    BPTR(&buf)[16] = 1;
+    mpath_process_msg(&m, &buf, &m.paths[1].remote);
+    assert_true(m.paths[1].up);
+
+    free_buf(&stale);
+    free_buf(&buf);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(mpath_select_weights),
+        cmocka_unit_test(mpath_select_fallback),
+        cmocka_unit_test(mpath_probe_reply),
+        cmocka_unit_test(mpath_probe_stale),
+    };
+
+    return cmocka_run_group_tests_name("mpath tests", tests, NULL, NULL);
+}
+
+#else  /* if ENABLE_IP_PKTINFO */
+
+int
+main(void)
+{
+    return 0;
+}
+
+#endif /* ENABLE_IP_PKTINFO */
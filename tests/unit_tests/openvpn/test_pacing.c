@@ -0,0 +1,197 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "pacing.h"
+
+#include "mock_msg.h"
+
+#define MSEC 1000000ull
+
+static void
+pacer_spacing(void **state)
+{
+    struct pacer p;
+    const uint64_t start = 1000 * MSEC;
+
+    CLEAR(p);
+
+    /* an idle pacer sends at once, it may be up to the slack behind */
+    assert_true(pacer_schedule(&p, 1000000, 1000, start) <= start);
+
+    /* at 1 MB/s, 1000 byte packets leave 1 ms apart */
+    assert_int_equal(pacer_schedule(&p, 1000000, 1000, start),
+                     start - PACING_SLACK_NSEC + MSEC);
+    assert_int_equal(pacer_schedule(&p, 1000000, 1000, start),
+                     start - PACING_SLACK_NSEC + 2 * MSEC);
+    assert_int_equal(pacer_schedule(&p, 1000000, 500, start),
+                     start - PACING_SLACK_NSEC + 3 * MSEC);
+    assert_int_equal(p.next, start - PACING_SLACK_NSEC + 3 * MSEC + MSEC / 2);
+
+    /* after a pause there is no credit beyond the slack */
+    assert_int_equal(pacer_schedule(&p, 1000000, 1000, start + 1000 * MSEC),
+                     start + 1000 * MSEC - PACING_SLACK_NSEC);
+    assert_int_equal(p.dropped, 0);
+}
+
+static void
+pacer_horizon(void **state)
+{
+    struct pacer p;
+    const uint64_t start = 1000 * MSEC;
+    int sent = 0, i;
+
+    CLEAR(p);
+
+    /* 100 packets of 1000 bytes at once at 100 kB/s, 10 ms apart */
+    for (i = 0; i < 100; ++i)
+    {
+        sent += pacer_schedule(&p, 100000, 1000, start) != 0;
+    }
+
+    /* what fits into the horizon is sent, the rest is dropped */
+    assert_int_equal(sent, 1 + (PACING_HORIZON_NSEC + PACING_SLACK_NSEC) / (10 * MSEC));
+    assert_int_equal(p.dropped, 100 - sent);
+
+    /* as time goes on, packets are accepted again */
+    assert_int_not_equal(pacer_schedule(&p, 100000, 1000, start + 20 * MSEC), 0);
+}
+
+static void
+calendar_order(void **state)
+{
+    struct pacing_calendar *cal = pacing_calendar_new(100);
+    struct link_socket_actual to;
+    struct buffer buf = alloc_buf(100);
+    struct pacing_entry *e;
+    struct timeval tv = { 10, 0 };
+    int i;
+
+    CLEAR(to);
+
+    /* several peers, each in order, interleaved */
+    for (i = 0; i < 60; ++i)
+    {
+        const uint64_t due = (uint64_t)(i % 3) * 7 + (i / 3) * 10 + 100;
+
+        buf_clear(&buf);
+        buf_write_u8(&buf, i);
+        assert_true(pacing_calendar_add(cal, due, &buf, &to));
+    }
+    assert_int_equal(cal->n, 60);
+
+    /* wake up in time for the first one */
+    pacing_calendar_timeout(cal, 0, &tv);
+    assert_int_equal(tv.tv_sec, 0);
+    assert_int_equal(tv.tv_usec, 1);
+
+    /* nothing is due yet */
+    assert_null(pacing_calendar_next(cal, 99));
+
+    /* packets come out by departure time */
+    {
+        uint64_t last = 0;
+        int n = 0;
+
+        while ((e = pacing_calendar_next(cal, 1000)))
+        {
+            const int j = *BPTR(&e->buf);
+
+            assert_int_equal(BLEN(&e->buf), 1);
+            assert_true(e->due >= last);
+            assert_int_equal(e->due, (uint64_t)(j % 3) * 7 + (j / 3) * 10 + 100);
+            last = e->due;
+            ++n;
+        }
+        assert_int_equal(n, 60);
+    }
+    assert_int_equal(cal->n, 0);
+    assert_int_equal(cal->n_late, 0);
+
+    /* packets sent after the slack are counted as late */
+    assert_true(pacing_calendar_add(cal, 1000, &buf, &to));
+    assert_non_null(pacing_calendar_next(cal, 1000 + PACING_SLACK_NSEC + 1));
+    assert_int_equal(cal->n_late, 1);
+
+    free_buf(&buf);
+    pacing_calendar_free(cal);
+}
+
+static void
+calendar_full(void **state)
+{
+    struct pacing_calendar *cal = pacing_calendar_new(100);
+    struct link_socket_actual to;
+    struct buffer buf = alloc_buf(200);
+    int i;
+
+    CLEAR(to);
+    buf_write_u8(&buf, 1);
+
+    for (i = 0; i < PACING_CALENDAR_SIZE; ++i)
+    {
+        assert_true(pacing_calendar_add(cal, 100 + i, &buf, &to));
+    }
+    assert_false(pacing_calendar_add(cal, 50, &buf, &to));
+
+    /* a slot that was freed is used again */
+    assert_non_null(pacing_calendar_next(cal, 100));
+    assert_true(pacing_calendar_add(cal, 50, &buf, &to));
+    assert_int_equal(pacing_calendar_next(cal, 100)->due, 50);
+
+    /* packets larger than the calendar's buffers are dropped */
+    buf_clear(&buf);
+    ASSERT(buf_write_alloc(&buf, 101));
+    assert_false(pacing_calendar_add(cal, 50, &buf, &to));
+    assert_int_equal(cal->n_dropped, 2);
+
+    free_buf(&buf);
+    pacing_calendar_free(cal);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(pacer_spacing),
+        cmocka_unit_test(pacer_horizon),
+        cmocka_unit_test(calendar_order),
+        cmocka_unit_test(calendar_full),
+    };
+
+    return cmocka_run_group_tests_name("pacing tests", tests, NULL, NULL);
+}
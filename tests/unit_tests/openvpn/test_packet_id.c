@@ -154,6 +154,192 @@ test_packet_id_write_long_wrap(void **state)
     assert_true(data->test_buf_data.buf_time == htonl(now));
 }
 
+static bool
+rec_accept(struct packet_id_rec *rec, time_t time, packet_id_type id)
+{
+    struct packet_id_net pin = { .id = id, .time = time };
+
+    if (!packet_id_test(rec, &pin))
+    {
+        return false;
+    }
+    packet_id_add(rec, &pin);
+    return true;
+}
+
+static void
+test_packet_id_rec_window(void **state)
+{
+    struct packet_id pid;
+    packet_id_type id;
+
+    now = 5010;
+    packet_id_init(&pid, 64, 64, 15, "test", 0);
+
+    assert_false(rec_accept(&pid.rec, 0, 0));
+    assert_true(rec_accept(&pid.rec, 0, 100));
+    for (id = 99; id > 36; --id)
+    {
+        assert_true(rec_accept(&pid.rec, 0, id));
+    }
+    /* behind the window */
+    assert_false(rec_accept(&pid.rec, 0, 36));
+    /* replays */
+    assert_false(rec_accept(&pid.rec, 0, 100));
+    assert_false(rec_accept(&pid.rec, 0, 50));
+    assert_int_equal(pid.rec.too_late, 1);
+
+    /* a jump ahead by more than the window starts a new one */
+    assert_true(rec_accept(&pid.rec, 0, 200));
+    assert_true(rec_accept(&pid.rec, 0, 150));
+    assert_false(rec_accept(&pid.rec, 0, 150));
+
+    /* so does a new time stamp, an old one is rejected */
+    assert_true(rec_accept(&pid.rec, 5011, 1));
+    assert_false(rec_accept(&pid.rec, 5010, 201));
+    assert_true(rec_accept(&pid.rec, 5011, 2));
+
+    packet_id_free(&pid);
+}
+
+static void
+test_packet_id_rec_wrap(void **state)
+{
+    struct packet_id pid;
+
+    now = 5010;
+    packet_id_init(&pid, 1000, 1000, 0, "test", 0);
+
+    /* advance across most of the bitmap, then across all of it */
+    assert_true(rec_accept(&pid.rec, 0, 1));
+    assert_true(rec_accept(&pid.rec, 0, 500));
+    assert_true(rec_accept(&pid.rec, 0, 1400));
+    assert_true(rec_accept(&pid.rec, 0, 450));
+    assert_false(rec_accept(&pid.rec, 0, 500));
+    assert_false(rec_accept(&pid.rec, 0, 1));
+    assert_true(rec_accept(&pid.rec, 0, 2300));
+    assert_true(rec_accept(&pid.rec, 0, 1400 + 1024));
+    assert_false(rec_accept(&pid.rec, 0, 2300));
+    assert_true(rec_accept(&pid.rec, 0, 1430));
+    assert_false(rec_accept(&pid.rec, 0, 1400));
+
+    packet_id_free(&pid);
+}
+
+static void
+test_packet_id_rec_grow(void **state)
+{
+    struct packet_id pid;
+
+    now = 5010;
+    packet_id_init(&pid, 64, MAX_SEQ_BACKTRACK, 15, "test", 0);
+
+    assert_true(rec_accept(&pid.rec, 0, 1000));
+    assert_true(rec_accept(&pid.rec, 0, 990));
+
+    /* too late, but the window grows so that the next one that late fits */
+    assert_false(rec_accept(&pid.rec, 0, 700));
+    assert_int_equal(pid.rec.too_late, 1);
+    assert_int_equal(pid.rec.seq_backtrack, 512);
+    assert_true(rec_accept(&pid.rec, 0, 1300));
+    assert_true(rec_accept(&pid.rec, 0, 1001));
+    assert_false(rec_accept(&pid.rec, 0, 1001));
+
+    /* only what the old window knew to be unseen is accepted */
+    assert_true(rec_accept(&pid.rec, 0, 999));
+    assert_false(rec_accept(&pid.rec, 0, 990));
+    assert_false(rec_accept(&pid.rec, 0, 900));
+
+    /* never beyond the maximum */
+    assert_false(rec_accept(&pid.rec, 0, 1));
+    assert_int_equal(pid.rec.seq_backtrack, 2048);
+    assert_true(rec_accept(&pid.rec, 0, 100000));
+    assert_false(rec_accept(&pid.rec, 0, 10000));
+    assert_int_equal(pid.rec.seq_backtrack, MAX_SEQ_BACKTRACK);
+    assert_true(rec_accept(&pid.rec, 0, 140000));
+    assert_true(rec_accept(&pid.rec, 0, 100001));
+    assert_false(rec_accept(&pid.rec, 0, 140000 - MAX_SEQ_BACKTRACK));
+    assert_int_equal(pid.rec.seq_backtrack, MAX_SEQ_BACKTRACK);
+    assert_int_equal(pid.rec.too_late, 4);
+
+    packet_id_free(&pid);
+}
+
+static void
+test_packet_id_rec_grow_after_jump(void **state)
+{
+    struct packet_id pid;
+
+    now = 5010;
+    /* window_bits is 128, more than seq_backtrack */
+    packet_id_init(&pid, 100, 1000, 15, "test", 0);
+
+    assert_true(rec_accept(&pid.rec, 0, 10));
+    /* a jump by more than seq_backtrack, but less than window_bits */
+    assert_true(rec_accept(&pid.rec, 0, 115));
+
+    /* too late, grows the window, and must stay a replay after that */
+    assert_false(rec_accept(&pid.rec, 0, 10));
+    assert_int_equal(pid.rec.seq_backtrack, 200);
+    assert_false(rec_accept(&pid.rec, 0, 10));
+    assert_true(rec_accept(&pid.rec, 0, 20));
+    assert_false(rec_accept(&pid.rec, 0, 20));
+
+    packet_id_free(&pid);
+}
+
+static void
+test_packet_id_rec_expire(void **state)
+{
+    struct packet_id pid;
+
+    packet_id_init(&pid, 64, 64, 15, "test", 0);
+
+    now = 5000;
+    assert_true(rec_accept(&pid.rec, 0, 10));
+    now = 5010;
+    assert_true(rec_accept(&pid.rec, 0, 20));
+    now = 5020;
+    packet_id_reap(&pid.rec);
+
+    /* received more than 15 seconds ago */
+    assert_false(rec_accept(&pid.rec, 0, 5));
+    assert_false(rec_accept(&pid.rec, 0, 10));
+    assert_true(rec_accept(&pid.rec, 0, 15));
+
+    now = 5030;
+    packet_id_reap(&pid.rec);
+    assert_false(rec_accept(&pid.rec, 0, 19));
+    assert_true(rec_accept(&pid.rec, 0, 21));
+
+    packet_id_free(&pid);
+}
+
+static void
+test_packet_id_rec_reorder_stats(void **state)
+{
+    struct packet_id pid;
+
+    now = 5010;
+    packet_id_init(&pid, 64, 64, 15, "test", 0);
+
+    assert_true(rec_accept(&pid.rec, 0, 10));
+    assert_true(rec_accept(&pid.rec, 0, 8));
+    assert_true(rec_accept(&pid.rec, 0, 9));
+    assert_true(rec_accept(&pid.rec, 0, 11));
+    assert_true(rec_accept(&pid.rec, 0, 70));
+    assert_true(rec_accept(&pid.rec, 0, 12));
+    assert_false(rec_accept(&pid.rec, 0, 1));
+
+    assert_int_equal(pid.rec.reorder[0], 3);
+    assert_int_equal(pid.rec.reorder[1], 1);
+    assert_int_equal(pid.rec.reorder[2], 1);
+    assert_int_equal(pid.rec.reorder[6], 1);
+    assert_int_equal(pid.rec.too_late, 1);
+
+    packet_id_free(&pid);
+}
+
 int
 main(void) {
     const struct CMUnitTest tests[] = {
@@ -169,6 +355,12 @@ main(void) {
                     test_packet_id_write_setup, test_packet_id_write_teardown),
             cmocka_unit_test_setup_teardown(test_packet_id_write_long_wrap,
                     test_packet_id_write_setup, test_packet_id_write_teardown),
+            cmocka_unit_test(test_packet_id_rec_window),
+            cmocka_unit_test(test_packet_id_rec_wrap),
+            cmocka_unit_test(test_packet_id_rec_grow),
+            cmocka_unit_test(test_packet_id_rec_grow_after_jump),
+            cmocka_unit_test(test_packet_id_rec_expire),
+            cmocka_unit_test(test_packet_id_rec_reorder_stats),
     };
 
     return cmocka_run_group_tests_name("packet_id tests", tests, NULL, NULL);
@@ -0,0 +1,195 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "peer_table.h"
+
+#include "mock_instance.h"
+#include "mock_msg.h"
+
+static void
+peer_table_alloc_sequential(void **state)
+{
+    struct peer_table *pt = peer_table_new(16);
+    uint32_t i;
+
+    for (i = 0; i < 16; ++i)
+    {
+        uint32_t peer_id = peer_table_alloc(pt, mock_instance(i), NULL);
+        assert_int_equal(peer_id, i);
+        assert_ptr_equal(peer_table_lookup(pt, peer_id)->mi, mock_instance(i));
+    }
+    assert_int_equal(pt->n_used, 16);
+
+    /* table is full */
+    assert_int_equal(peer_table_alloc(pt, mock_instance(16), NULL),
+                     PEER_TABLE_INVALID_ID);
+
+    peer_table_free(pt);
+}
+
+static void
+peer_table_release_bumps_generation(void **state)
+{
+    struct peer_table *pt = peer_table_new(4);
+    uint32_t old_id, new_id;
+
+    old_id = peer_table_alloc(pt, mock_instance(0), NULL);
+    peer_table_release(pt, old_id);
+    assert_null(peer_table_lookup(pt, old_id));
+
+    /* allocate all other slots, so the released slot is reused next */
+    assert_int_equal(peer_table_alloc(pt, mock_instance(1), NULL), 1);
+    assert_int_equal(peer_table_alloc(pt, mock_instance(2), NULL), 2);
+    assert_int_equal(peer_table_alloc(pt, mock_instance(3), NULL), 3);
+
+    new_id = peer_table_alloc(pt, mock_instance(4), NULL);
+    assert_int_not_equal(new_id, old_id);
+    assert_int_equal(new_id & pt->index_mask, old_id & pt->index_mask);
+
+    /* a packet for the old owner must not reach the new one */
+    assert_null(peer_table_lookup(pt, old_id));
+    assert_ptr_equal(peer_table_lookup(pt, new_id)->mi, mock_instance(4));
+
+    /* releasing a stale peer-id is a no-op */
+    peer_table_release(pt, old_id);
+    assert_non_null(peer_table_lookup(pt, new_id));
+
+    peer_table_free(pt);
+}
+
+static void
+peer_table_fifo_reuse(void **state)
+{
+    struct peer_table *pt = peer_table_new(3);
+    uint32_t a, b, c;
+
+    a = peer_table_alloc(pt, mock_instance(0), NULL);
+    b = peer_table_alloc(pt, mock_instance(1), NULL);
+    c = peer_table_alloc(pt, mock_instance(2), NULL);
+
+    peer_table_release(pt, b);
+    peer_table_release(pt, a);
+
+    /* the slot released first is handed out first */
+    assert_int_equal(peer_table_alloc(pt, mock_instance(3), NULL) & pt->index_mask, b);
+    assert_int_equal(peer_table_alloc(pt, mock_instance(4), NULL) & pt->index_mask, a);
+    assert_non_null(peer_table_lookup(pt, c));
+
+    peer_table_free(pt);
+}
+
+static void
+peer_table_grows_on_demand(void **state)
+{
+    const int max = PEER_TABLE_INITIAL_SIZE * 3;
+    struct peer_table *pt = peer_table_new(max);
+    int i;
+
+    assert_int_equal(pt->size, PEER_TABLE_INITIAL_SIZE);
+    for (i = 0; i < max; ++i)
+    {
+        assert_int_equal(peer_table_alloc(pt, mock_instance(i), NULL), i);
+    }
+    assert_int_equal(pt->size, max);
+    assert_int_equal((uintptr_t)pt->entries % PEER_TABLE_CACHE_LINE, 0);
+
+    for (i = 0; i < max; ++i)
+    {
+        assert_ptr_equal(peer_table_lookup(pt, i)->mi, mock_instance(i));
+    }
+
+    peer_table_free(pt);
+}
+
+static void
+peer_table_generation_wraps(void **state)
+{
+    struct peer_table *pt = peer_table_new(2);
+    const uint32_t generations = 1u << (PEER_TABLE_ID_BITS - pt->index_bits);
+    uint32_t i, peer_id = 0;
+
+    /* keep slot 0 busy so slot 1 is reused over and over */
+    peer_table_alloc(pt, mock_instance(0), NULL);
+    for (i = 0; i < generations + 2; ++i)
+    {
+        peer_id = peer_table_alloc(pt, mock_instance(1), NULL);
+        assert_int_equal(peer_id & pt->index_mask, 1);
+        assert_int_not_equal(peer_id, PEER_TABLE_INVALID_ID);
+        peer_table_release(pt, peer_id);
+    }
+
+    peer_table_free(pt);
+}
+
+static void
+peer_table_remote(void **state)
+{
+    struct peer_table *pt = peer_table_new(4);
+    struct openvpn_sockaddr a, b;
+    uint32_t peer_id;
+
+    CLEAR(a);
+    a.addr.in4.sin_family = AF_INET;
+    a.addr.in4.sin_addr.s_addr = htonl(0x7f000001);
+    a.addr.in4.sin_port = htons(1194);
+    b = a;
+    b.addr.in4.sin_port = htons(1195);
+
+    peer_id = peer_table_alloc(pt, mock_instance(0), &a);
+    assert_true(addr_port_match(&peer_table_lookup(pt, peer_id)->remote, &a));
+    assert_false(addr_port_match(&peer_table_lookup(pt, peer_id)->remote, &b));
+
+    peer_table_set_remote(pt, peer_id, &b);
+    assert_true(addr_port_match(&peer_table_lookup(pt, peer_id)->remote, &b));
+
+    peer_table_free(pt);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(peer_table_alloc_sequential),
+        cmocka_unit_test(peer_table_release_bumps_generation),
+        cmocka_unit_test(peer_table_fifo_reuse),
+        cmocka_unit_test(peer_table_grows_on_demand),
+        cmocka_unit_test(peer_table_generation_wraps),
+        cmocka_unit_test(peer_table_remote),
+    };
+
+    return cmocka_run_group_tests_name("peer_table tests", tests, NULL, NULL);
+}
@@ -0,0 +1,155 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "pktbuf.h"
+
+#include "mock_msg.h"
+
+static void
+pkt_headroom_and_reuse(void **state)
+{
+    struct pkt_pool *pool = pkt_pool_new(256, 32, 4);
+    struct pkt *p = pkt_alloc(pool);
+    struct pkt *q;
+
+    assert_non_null(p);
+    assert_int_equal(p->buf.offset, 32);
+    assert_int_equal(BLEN(&p->buf), 0);
+    assert_int_equal(buf_forward_capacity(&p->buf), 256 - 32);
+    assert_true(buf_write_u32(&p->buf, 0x12345678));
+    assert_true(buf_write_prepend(&p->buf, "ab", 2));
+
+    /* the most recently freed packet comes back, empty again */
+    pkt_free(p);
+    q = pkt_alloc(pool);
+    assert_ptr_equal(p, q);
+    assert_int_equal(q->buf.offset, 32);
+    assert_int_equal(BLEN(&q->buf), 0);
+    assert_null(q->next);
+    pkt_free(q);
+
+    assert_int_equal(pool->stats.allocs, 2);
+    assert_int_equal(pool->stats.allocated, 1);
+    assert_int_equal(pool->stats.in_use, 0);
+    pkt_pool_free(pool);
+}
+
+static void
+pkt_clone_copies(void **state)
+{
+    struct pkt_pool *pool = pkt_pool_new(128, 16, 4);
+    struct buffer src = alloc_buf(256);
+    struct pkt *p;
+
+    memset(BPTR(&src), 0xa5, 112);
+    assert_true(buf_inc_len(&src, 112));
+    p = pkt_clone(pool, &src);
+    assert_non_null(p);
+    assert_int_equal(BLEN(&p->buf), 112);
+    assert_int_equal(p->buf.offset, 16);
+    assert_memory_equal(BPTR(&p->buf), BPTR(&src), 112);
+    pkt_free(p);
+
+    /* does not fit behind the headroom */
+    assert_true(buf_inc_len(&src, 1));
+    assert_null(pkt_clone(pool, &src));
+    assert_int_equal(pool->stats.oversize, 1);
+    assert_int_equal(pool->stats.in_use, 0);
+
+    free_buf(&src);
+    pkt_pool_free(pool);
+}
+
+static void
+pkt_limit_and_counters(void **state)
+{
+    struct pkt_pool *pool = pkt_pool_new(64, 0, 3);
+    struct pkt *p[3];
+    int i;
+
+    for (i = 0; i < 3; ++i)
+    {
+        p[i] = pkt_alloc(pool);
+        assert_non_null(p[i]);
+    }
+    assert_null(pkt_alloc(pool));
+    assert_int_equal(pool->stats.exhausted, 1);
+    assert_int_equal(pool->stats.in_use, 3);
+    assert_int_equal(pool->stats.in_use_max, 3);
+
+    pkt_free(p[1]);
+    p[1] = pkt_alloc(pool);
+    assert_non_null(p[1]);
+    assert_int_equal(pool->stats.allocated, 3);
+
+    for (i = 0; i < 3; ++i)
+    {
+        pkt_free(p[i]);
+    }
+    pkt_free(NULL);
+    assert_int_equal(pool->stats.in_use, 0);
+    assert_int_equal(pool->stats.in_use_max, 3);
+    assert_int_equal(pool->stats.allocs, 4);
+    pkt_pool_free(pool);
+}
+
+/* a pool freed while packets are out goes away with the last of them */
+static void
+pkt_pool_free_deferred(void **state)
+{
+    struct pkt_pool *pool = pkt_pool_new(64, 0, 2);
+    struct pkt *p = pkt_alloc(pool);
+    struct pkt *q = pkt_alloc(pool);
+
+    pkt_pool_free(pool);
+    assert_true(pool->closed);
+    pkt_free(p);
+    pkt_free(q);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(pkt_headroom_and_reuse),
+        cmocka_unit_test(pkt_clone_copies),
+        cmocka_unit_test(pkt_limit_and_counters),
+        cmocka_unit_test(pkt_pool_free_deferred),
+    };
+
+    return cmocka_run_group_tests_name("pktbuf tests", tests, NULL, NULL);
+}
@@ -0,0 +1,269 @@
+/*
+ *  OpenVPN -- An application to securely tunnel IP networks
+ *             over a single UDP port, with support for SSL/TLS-based
+ *             session authentication and key exchange,
+ *             packet encryption, packet authentication, and
+ *             packet compression.
+ *
+ *  Copyright (C) 2002-2018 OpenVPN Inc <sales@openvpn.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_MSC_VER)
+#include "config-msvc.h"
+#endif
+
+#include "syshead.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "event.h"
+#include "integer.h"
+#include "ring.h"
+
+#include "mock_msg.h"
+
+/* the ring never dereferences its pointers, any distinct values will do */
+#define OBJ(n) ((void *) (uintptr_t) ((n) + 1))
+#define VAL(p) ((unsigned int) ((uintptr_t) (p) - 1))
+
+static void
+ring_fifo_and_full(void **state)
+{
+    struct ring *r = ring_new(6, 0);
+    void *objs[16];
+    unsigned int i;
+
+    assert_int_equal(r->size, 8);
+    assert_null(ring_dequeue(r));
+
+    for (i = 0; i < 16; ++i)
+    {
+        objs[i] = OBJ(i);
+    }
+    /* only 8 fit */
+    assert_int_equal(ring_enqueue_burst(r, objs, 16), 8);
+    assert_int_equal(ring_count(r), 8);
+    assert_false(ring_enqueue(r, OBJ(99)));
+
+    assert_int_equal(ring_dequeue_burst(r, objs, 3), 3);
+    for (i = 0; i < 3; ++i)
+    {
+        assert_int_equal(VAL(objs[i]), i);
+    }
+    assert_true(ring_enqueue(r, OBJ(8)));
+    assert_int_equal(ring_dequeue_burst(r, objs, 16), 6);
+    for (i = 0; i < 6; ++i)
+    {
+        assert_int_equal(VAL(objs[i]), i + 3);
+    }
+    assert_int_equal(ring_dequeue_burst(r, objs, 16), 0);
+
+    ring_free(r);
+}
+
+/* the free running counters wrap around at UINT_MAX */
+static void
+ring_counter_wrap(void **state)
+{
+    struct ring *r = ring_new(8, 0);
+    unsigned int next_in = 0, next_out = 0, i, round;
+    void *objs[5];
+
+    r->prod_head = r->prod_tail = r->cons_tail = UINT_MAX - 20;
+    r->cons_cache = r->prod_cache = r->cons_tail;
+
+    for (round = 0; round < 20; ++round)
+    {
+        for (i = 0; i < 5; ++i)
+        {
+            objs[i] = OBJ(next_in + i);
+        }
+        next_in += ring_enqueue_burst(r, objs, 5);
+
+        const unsigned int n = ring_dequeue_burst(r, objs, 4);
+        for (i = 0; i < n; ++i)
+        {
+            assert_int_equal(VAL(objs[i]), next_out++);
+        }
+    }
+    while ((i = ring_dequeue_burst(r, objs, 5)) > 0)
+    {
+        unsigned int j;
+        for (j = 0; j < i; ++j)
+        {
+            assert_int_equal(VAL(objs[j]), next_out++);
+        }
+    }
+    assert_int_equal(next_in, next_out);
+    assert_true(r->prod_tail < 100);
+
+    ring_free(r);
+}
+
+#define N_PRODUCERS 4
+#define N_PER_PRODUCER 100000
+#define BURST 16
+
+struct producer
+{
+    struct ring *ring;
+    unsigned int id;
+};
+
+/* enqueue the numbers 0..N_PER_PRODUCER-1, tagged with the producer id */
+static void *
+producer_thread(void *arg)
+{
+    const struct producer *p = arg;
+    void *objs[BURST];
+    unsigned int seq = 0;
+
+    while (seq < N_PER_PRODUCER)
+    {
+        unsigned int i, n = min_int(BURST, N_PER_PRODUCER - seq);
+        for (i = 0; i < n; ++i)
+        {
+            objs[i] = OBJ((p->id << 24) | (seq + i));
+        }
+        i = 0;
+        while (i < n)
+        {
+            const unsigned int done = ring_enqueue_burst(p->ring, objs + i, n - i);
+            if (!done)
+            {
+                sched_yield();
+            }
+            i += done;
+        }
+        seq += n;
+    }
+    return NULL;
+}
+
+/*
+ * Run n_producers threads against one consumer, and check that every
+ * packet arrives, and in order per producer.
+ */
+static void
+run_threads(unsigned int flags, unsigned int n_producers)
+{
+    struct ring *r = ring_new(64, flags);
+    struct producer prod[N_PRODUCERS];
+    pthread_t threads[N_PRODUCERS];
+    unsigned int expected[N_PRODUCERS] = { 0 };
+    unsigned int received = 0, i;
+    void *objs[BURST];
+
+    for (i = 0; i < n_producers; ++i)
+    {
+        prod[i].ring = r;
+        prod[i].id = i;
+        assert_int_equal(pthread_create(&threads[i], NULL, producer_thread, &prod[i]), 0);
+    }
+
+    while (received < n_producers * N_PER_PRODUCER)
+    {
+        const unsigned int n = ring_dequeue_burst(r, objs, BURST);
+        for (i = 0; i < n; ++i)
+        {
+            const unsigned int v = VAL(objs[i]);
+            assert_true((v >> 24) < n_producers);
+            assert_int_equal(v & 0xffffff, expected[v >> 24]);
+            expected[v >> 24]++;
+        }
+        received += n;
+        if (!n)
+        {
+            sched_yield();
+        }
+    }
+
+    for (i = 0; i < n_producers; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    assert_int_equal(ring_count(r), 0);
+    ring_free(r);
+}
+
+static void
+ring_spsc_threads(void **state)
+{
+    run_threads(0, 1);
+}
+
+static void
+ring_mpsc_threads(void **state)
+{
+    run_threads(RING_MP, N_PRODUCERS);
+}
+
+/* the consumer sleeps in event_wait() until a producer adds a packet */
+static void
+ring_wakeup_event(void **state)
+{
+    struct ring *r = ring_new(8, RING_WAKEUP);
+    int maxevents = 4;
+    struct event_set *es = event_set_init(&maxevents, 0);
+    struct event_set_return esr[4];
+    struct timeval tv = { 0, 0 };
+    int arg;
+
+    /* nothing queued: no event */
+    assert_true(ring_wait_set(r, es, &arg));
+    assert_int_equal(event_wait(es, &tv, esr, 4), 0);
+
+    /* a packet wakes up the consumer */
+    assert_true(ring_enqueue(r, OBJ(1)));
+    assert_int_equal(event_wait(es, &tv, esr, 4), 1);
+    assert_ptr_equal(esr[0].arg, &arg);
+    assert_true(esr[0].rwflags & EVENT_READ);
+    ring_wakeup_clear(r);
+    assert_int_equal(event_wait(es, &tv, esr, 4), 0);
+
+    /* with packets in the ring the consumer must not sleep */
+    assert_false(ring_wait_set(r, es, &arg));
+    assert_int_equal(VAL(ring_dequeue(r)), 1);
+
+    /* a producer that finds the consumer awake does not signal */
+    assert_true(ring_enqueue(r, OBJ(2)));
+    assert_int_equal(event_wait(es, &tv, esr, 4), 0);
+    assert_int_equal(VAL(ring_dequeue(r)), 2);
+
+    event_free(es);
+    ring_free(r);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(ring_fifo_and_full),
+        cmocka_unit_test(ring_counter_wrap),
+        cmocka_unit_test(ring_spsc_threads),
+        cmocka_unit_test(ring_mpsc_threads),
+        cmocka_unit_test(ring_wakeup_event),
+    };
+
+    return cmocka_run_group_tests_name("ring tests", tests, NULL, NULL);
+}
@@ -68,7 +68,7 @@ setup(void **state) {
     init_key_ctx(&ctx->co.key_ctx_bi.encrypt, &key, &ctx->kt, true, "TEST");
     init_key_ctx(&ctx->co.key_ctx_bi.decrypt, &key, &ctx->kt, false, "TEST");
 
-    packet_id_init(&ctx->co.packet_id, 0, 0, "test", 0);
+    packet_id_init(&ctx->co.packet_id, 0, 0, 0, "test", 0);
 
     ctx->source = alloc_buf(TESTBUF_SIZE);
     ctx->ciphertext = alloc_buf(TESTBUF_SIZE);